@@ -0,0 +1,546 @@
+/*
+ *   File name: CacheDiff.cpp
+ *   Summary:	Compare two QDirStat cache files
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <stdlib.h>	// strtoll(), strtoull()
+#include <string.h>	// strcasecmp(), strrchr()
+#include <algorithm>	// std::sort()
+
+#include <QUrl>
+#include <QElapsedTimer>
+
+#include "CacheDiff.h"
+#include "Logger.h"
+#include "Exception.h"
+
+#define KB 1024LL
+#define MB (1024LL*1024)
+#define GB (1024LL*1024*1024)
+#define TB (1024LL*1024*1024*1024)
+
+// 64 bit FNV-1a hash for the directory path keys
+#define FNV_OFFSET_BASIS		0xcbf29ce484222325ULL
+#define FNV_PRIME			0x100000001b3ULL
+
+
+using namespace QDirStat;
+
+
+/**
+ * Parse a size field with optional K/M/G/T suffix.
+ **/
+static FileSize parseSize( const char * sizeStr )
+{
+    char * end = 0;
+    FileSize size = strtoll( sizeStr, &end, 10 );
+
+    if ( end )
+    {
+	switch ( *end )
+	{
+	    case 'K':	size *= KB; break;
+	    case 'M':	size *= MB; break;
+	    case 'G':	size *= GB; break;
+	    case 'T':	size *= TB; break;
+	    default: break;
+	}
+    }
+
+    return size;
+}
+
+
+static bool lessPath( const CacheDiff::Change & a, const CacheDiff::Change & b )
+{
+    return a.rawPath < b.rawPath;
+}
+
+
+
+
+CacheDiff::Reader::Reader( const QString & fileName ):
+    _fileName( fileName ),
+    _cache( 0 ),
+    _ok( true ),
+    _lineNo( 0 ),
+    _fieldsCount( 0 )
+{
+    _buffer[0] = 0;
+}
+
+
+CacheDiff::Reader::~Reader()
+{
+    if ( _cache )
+	gzclose( _cache );
+}
+
+
+bool CacheDiff::Reader::open()
+{
+    _cache = gzopen( _fileName.toUtf8(), "r" );
+
+    if ( ! _cache )
+    {
+	logError() << "Can't open " << _fileName << endl;
+	_ok = false;
+	return false;
+    }
+
+    if ( ! readLine() )
+    {
+	logError() << _fileName << ": Empty cache file" << endl;
+	_ok = false;
+	return false;
+    }
+
+    if ( _fieldsCount != 4 ||
+	 ( strcmp( _fields[0], "[qdirstat" ) != 0 &&
+	   strcmp( _fields[0], "[kdirstat" ) != 0   ) ||
+	 strcmp( _fields[2], "cache" ) != 0 ||
+	 strcmp( _fields[3], "file]" ) != 0 )
+    {
+	logError() << _fileName << ":" << _lineNo
+		   << ": Unknown file format" << endl;
+	_ok = false;
+    }
+
+    return _ok;
+}
+
+
+bool CacheDiff::Reader::readLine()
+{
+    char * line = 0;
+
+    do
+    {
+	_fieldsCount = 0;
+	_lineNo++;
+
+	if ( ! gzgets( _cache, _buffer, MAX_CACHE_LINE_LEN-1 ) )
+	{
+	    if ( ! gzeof( _cache ) )
+	    {
+		_ok = false;
+		logError() << _fileName << ":" << _lineNo << ": Read error" << endl;
+	    }
+
+	    return false;
+	}
+
+	line = CacheReader::skipWhiteSpace( _buffer );
+	CacheReader::killTrailingWhiteSpace( line );
+
+	if ( *line == 0 || *line == '#' )
+	    continue;
+
+	char * current = line;
+
+	while ( current && *current && _fieldsCount < MAX_FIELDS_PER_LINE-1 )
+	{
+	    _fields[ _fieldsCount++ ] = current;
+	    current = CacheReader::findNextWhiteSpace( current );
+
+	    if ( current )
+	    {
+		*current++ = 0;
+		current = CacheReader::skipWhiteSpace( current );
+	    }
+	}
+
+	// Silently skip broken lines; CacheReader complains about them
+
+    } while ( _fieldsCount < 4 );
+
+    return true;
+}
+
+
+const char * CacheDiff::Reader::optionalField( const char * keyword ) const
+{
+    for ( int n = 4; n+1 < _fieldsCount; n += 2 )
+    {
+	if ( strcasecmp( _fields[ n ], keyword ) == 0 )
+	    return _fields[ n+1 ];
+    }
+
+    return 0;
+}
+
+
+bool CacheDiff::Reader::isDir() const
+{
+    return strcasecmp( _fields[0], "D" ) == 0;
+}
+
+
+
+
+CacheDiff::CacheDiff( const QString & oldFileName, const QString & newFileName ):
+    _oldFileName( oldFileName ),
+    _newFileName( newFileName ),
+    _comparedDirs( 0 ),
+    _skippedDirs( 0 ),
+    _totalDelta( 0LL )
+{
+}
+
+
+CacheDiff::~CacheDiff()
+{
+    // NOP
+}
+
+
+bool CacheDiff::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if ( ! readOldDigests() || ! readNew() || ! readOld() )
+	return false;
+
+    logInfo() << "Compared " << _oldFileName << " and " << _newFileName << ": "
+	      << _comparedDirs << " dirs compared, "
+	      << _skippedDirs  << " dirs skipped, "
+	      << _changes.size() << " changes"
+	      << " in " << timer.elapsed() << " millisec"
+	      << endl;
+
+    return true;
+}
+
+
+bool CacheDiff::readOldDigests()
+{
+    Reader reader( _oldFileName );
+
+    if ( ! reader.open() )
+	return false;
+
+    while ( reader.readLine() )
+    {
+	if ( ! reader.isDir() )
+	    continue;
+
+	const char * digestStr = reader.optionalField( "digest:" );
+	quint64	     digest    = digestStr ? strtoull( digestStr, 0, 16 ) : 0;
+
+	_oldDigests.insert( pathKey( dirPrefix( reader.field( 1 ) ) ), digest );
+    }
+
+    return reader.ok();
+}
+
+
+bool CacheDiff::readNew()
+{
+    Reader reader( _newFileName );
+
+    if ( ! reader.open() )
+	return false;
+
+    QByteArray skipPrefix;	// subtree with the same digest as in the old file
+    QByteArray addedPrefix;	// subtree that is not in the old file
+    FileSize   addedTotal = 0LL;
+    bool       collecting = false;
+    quint64    currentKey = 0;
+    EntryMap   currentEntries;
+
+    while ( reader.readLine() )
+    {
+	if ( ! reader.isDir() )
+	{
+	    if ( ! addedPrefix.isEmpty() )
+		addedTotal += parseSize( reader.field( 2 ) );
+	    else if ( collecting )
+		currentEntries.insert( entryName( reader ), entry( reader ) );
+
+	    continue;
+	}
+
+	// Subdirectories of a directory follow directly after it, so a
+	// subtree ends with the first directory that is not below it.
+
+	QByteArray prefix = dirPrefix( reader.field( 1 ) );
+
+	if ( ! skipPrefix.isEmpty() )
+	{
+	    if ( prefix.startsWith( skipPrefix ) )
+	    {
+		++_skippedDirs;
+		continue;
+	    }
+
+	    skipPrefix.clear();
+	}
+
+	if ( ! addedPrefix.isEmpty() )
+	{
+	    if ( prefix.startsWith( addedPrefix ) )
+	    {
+		addedTotal += parseSize( reader.field( 2 ) );
+		continue;
+	    }
+
+	    addChange( '+', addedTotal, addedPrefix );
+	    addedPrefix.clear();
+	}
+
+	if ( collecting )
+	{
+	    _changedDirs.insert( currentKey, currentEntries );
+	    currentEntries.clear();
+	    collecting = false;
+	}
+
+	quint64 key = pathKey( prefix );
+	QHash<quint64, quint64>::const_iterator it = _oldDigests.constFind( key );
+
+	if ( it == _oldDigests.constEnd() )
+	{
+	    addedPrefix = prefix;
+	    addedTotal	= parseSize( reader.field( 2 ) );
+	    continue;
+	}
+
+	const char * digestStr = reader.optionalField( "digest:" );
+	quint64	     digest    = digestStr ? strtoull( digestStr, 0, 16 ) : 0;
+
+	if ( digest != 0 && digest == it.value() )
+	{
+	    _sameDirs.insert( key );
+	    skipPrefix = prefix;
+	    ++_skippedDirs;
+	    continue;
+	}
+
+	++_comparedDirs;
+	collecting = true;
+	currentKey = key;
+    }
+
+    if ( ! addedPrefix.isEmpty() )
+	addChange( '+', addedTotal, addedPrefix );
+
+    if ( collecting )
+	_changedDirs.insert( currentKey, currentEntries );
+
+    // Not needed anymore; the second pass over the old file only needs
+    // _sameDirs and _changedDirs.
+
+    _oldDigests.clear();
+
+    return reader.ok();
+}
+
+
+bool CacheDiff::readOld()
+{
+    Reader reader( _oldFileName );
+
+    if ( ! reader.open() )
+	return false;
+
+    QByteArray skipPrefix;	// subtree with the same digest as in the new file
+    QByteArray removedPrefix;	// subtree that is not in the new file
+    FileSize   removedTotal = 0LL;
+    QByteArray currentPrefix;	// changed directory
+    EntryMap   currentEntries;
+
+    while ( reader.readLine() )
+    {
+	if ( ! reader.isDir() )
+	{
+	    if ( ! removedPrefix.isEmpty() )
+		removedTotal += parseSize( reader.field( 2 ) );
+	    else if ( ! currentPrefix.isEmpty() )
+		currentEntries.insert( entryName( reader ), entry( reader ) );
+
+	    continue;
+	}
+
+	QByteArray prefix = dirPrefix( reader.field( 1 ) );
+
+	if ( ! skipPrefix.isEmpty() )
+	{
+	    if ( prefix.startsWith( skipPrefix ) )
+		continue;
+
+	    skipPrefix.clear();
+	}
+
+	if ( ! removedPrefix.isEmpty() )
+	{
+	    if ( prefix.startsWith( removedPrefix ) )
+	    {
+		removedTotal += parseSize( reader.field( 2 ) );
+		continue;
+	    }
+
+	    addChange( '-', -removedTotal, removedPrefix );
+	    removedPrefix.clear();
+	}
+
+	if ( ! currentPrefix.isEmpty() )
+	{
+	    compareDir( currentPrefix, currentEntries );
+	    currentEntries.clear();
+	    currentPrefix.clear();
+	}
+
+	quint64 key = pathKey( prefix );
+
+	if ( _sameDirs.contains( key ) )
+	{
+	    skipPrefix = prefix;
+	}
+	else if ( _changedDirs.contains( key ) )
+	{
+	    currentPrefix = prefix;
+	}
+	else
+	{
+	    removedPrefix = prefix;
+	    removedTotal  = parseSize( reader.field( 2 ) );
+	}
+    }
+
+    if ( ! removedPrefix.isEmpty() )
+	addChange( '-', -removedTotal, removedPrefix );
+
+    if ( ! currentPrefix.isEmpty() )
+	compareDir( currentPrefix, currentEntries );
+
+    return reader.ok();
+}
+
+
+void CacheDiff::compareDir( const QByteArray & rawDir, const EntryMap & oldEntries )
+{
+    EntryMap newEntries = _changedDirs.take( pathKey( rawDir ) );
+
+    for ( EntryMap::const_iterator it = oldEntries.constBegin();
+	  it != oldEntries.constEnd();
+	  ++it )
+    {
+	EntryMap::iterator newIt = newEntries.find( it.key() );
+
+	if ( newIt == newEntries.end() )
+	{
+	    addChange( '-', -it.value().size, rawDir + it.key() );
+	    continue;
+	}
+
+	const Entry & oldEntry = it.value();
+	const Entry & newEntry = newIt.value();
+
+	if ( oldEntry.size  != newEntry.size  ||
+	     oldEntry.mtime != newEntry.mtime ||
+	     oldEntry.type  != newEntry.type )
+	{
+	    addChange( 'M', newEntry.size - oldEntry.size, rawDir + it.key() );
+	}
+
+	newEntries.erase( newIt );
+    }
+
+    for ( EntryMap::const_iterator it = newEntries.constBegin();
+	  it != newEntries.constEnd();
+	  ++it )
+    {
+	addChange( '+', it.value().size, rawDir + it.key() );
+    }
+}
+
+
+CacheDiff::Entry CacheDiff::entry( const Reader & reader )
+{
+    Entry entry;
+    entry.type	= reader.field( 0 );
+    entry.size	= parseSize( reader.field( 2 ) );
+    entry.mtime = strtol( reader.field( 3 ), 0, 0 );
+
+    return entry;
+}
+
+
+QByteArray CacheDiff::entryName( const Reader & reader )
+{
+    // Entries may have an absolute path in the long format
+
+    const char * rawPath = reader.field( 1 );
+    const char * name	 = strrchr( rawPath, '/' );
+
+    return QByteArray( name ? name + 1 : rawPath );
+}
+
+
+QByteArray CacheDiff::dirPrefix( const char * rawPath )
+{
+    QByteArray prefix( rawPath );
+
+    if ( ! prefix.endsWith( '/' ) )
+	prefix += '/';
+
+    return prefix;
+}
+
+
+quint64 CacheDiff::pathKey( const QByteArray & rawPath )
+{
+    // A 64 bit hash instead of the path itself keeps the memory usage for
+    // millions of directories low; a collision is very unlikely.
+
+    quint64 hash = FNV_OFFSET_BASIS;
+
+    for ( int i = 0; i < rawPath.size(); ++i )
+    {
+	hash ^= (unsigned char) rawPath.at( i );
+	hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+void CacheDiff::addChange( char status, FileSize delta, const QByteArray & rawPath )
+{
+    Change change;
+    change.status  = status;
+    change.delta   = delta;
+    change.rawPath = rawPath;
+
+    _changes << change;
+    _totalDelta += delta;
+}
+
+
+void CacheDiff::writeResults( QTextStream & str ) const
+{
+    QList<Change> changes = _changes;
+    std::sort( changes.begin(), changes.end(), lessPath );
+
+    str << "# changes\n";
+
+    foreach ( const Change & change, changes )
+    {
+	str << change.status << "\t"
+	    << change.delta  << "\t"
+	    << QUrl::fromPercentEncoding( change.rawPath ) << "\n";
+    }
+
+    str << "\n# summary\n"
+	<< _totalDelta	   << "\ttotal size difference\n"
+	<< _changes.size() << "\tchanges\n"
+	<< _comparedDirs   << "\tdirs compared\n"
+	<< _skippedDirs	   << "\tdirs skipped\n";
+
+    str.flush();
+}
@@ -0,0 +1,250 @@
+/*
+ *   File name: CacheDiff.h
+ *   Summary:	Compare two QDirStat cache files
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef CacheDiff_h
+#define CacheDiff_h
+
+
+#include <zlib.h>
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QTextStream>
+
+#include "FileSize.h"
+#include "DirTreeCache.h"	// MAX_CACHE_LINE_LEN, MAX_FIELDS_PER_LINE
+
+
+namespace QDirStat
+{
+    /**
+     * Comparison of two cache files of the same directory tree, e.g. from
+     * two nightly runs, without building a DirTree for either of them.
+     *
+     * This uses the digests that QDirStat writes for each directory since
+     * cache file format 2.0: A directory with the same digest in both files
+     * has the same content all the way down, so its subtree is skipped
+     * without looking at its entries. Only the directories that actually
+     * changed are compared entry by entry.
+     *
+     * Cache files are gzip streams, so each file is still read (and
+     * decompressed) completely: The old file twice, the new file once. But
+     * only the directory lines are parsed for the skipped subtrees, and
+     * memory usage is bounded by the number of directories plus the
+     * entries of the changed directories.
+     *
+     * Directories without a digest (older cache files or files from
+     * qdirstat-cache-writer) never match, so they are always compared
+     * entry by entry; the result is the same, it just takes longer.
+     *
+     * Usage:
+     *
+     *	   CacheDiff diff( "/tmp/var-old.cache.gz", "/tmp/var-new.cache.gz" );
+     *
+     *	   if ( diff.run() )
+     *	       diff.writeResults( stream );
+     **/
+    class CacheDiff
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	CacheDiff( const QString & oldFileName, const QString & newFileName );
+
+	/**
+	 * Destructor.
+	 **/
+	~CacheDiff();
+
+	/**
+	 * Compare the two cache files.
+	 * Return 'true' on success, 'false' on error.
+	 **/
+	bool run();
+
+	/**
+	 * Write the differences to 'str': One tab-separated line for each
+	 * added ("+"), removed ("-") or changed ("M") item with the size
+	 * difference in bytes and the path, followed by a summary section
+	 * starting with a "#" comment line. Directories have a trailing "/";
+	 * for added or removed directories, the size is that of everything
+	 * below them.
+	 **/
+	void writeResults( QTextStream & str ) const;
+
+	/**
+	 * Return the number of directories that were compared entry by entry.
+	 **/
+	int comparedDirs() const { return _comparedDirs; }
+
+	/**
+	 * Return the number of directories in the new file that were skipped
+	 * because a parent directory (or the directory itself) had the same
+	 * digest in both files.
+	 **/
+	int skippedDirs() const { return _skippedDirs; }
+
+	/**
+	 * One difference.
+	 **/
+	struct Change
+	{
+	    char       status;	// '+', '-' or 'M'
+	    FileSize   delta;
+	    QByteArray rawPath;	// still URL-encoded
+	};
+
+
+    protected:
+
+	/**
+	 * One entry of a directory.
+	 **/
+	struct Entry
+	{
+	    Entry(): size( 0LL ), mtime( 0 ) {}
+
+	    QByteArray type;
+	    FileSize   size;
+	    time_t     mtime;
+	};
+
+	typedef QHash<QByteArray, Entry> EntryMap;
+
+	/**
+	 * Line reader for one cache file.
+	 **/
+	class Reader
+	{
+	public:
+
+	    Reader( const QString & fileName );
+	    ~Reader();
+
+	    /**
+	     * Open the file and check the header.
+	     * Return 'false' on error.
+	     **/
+	    bool open();
+
+	    /**
+	     * Read the next line that is not empty or a comment and split it
+	     * into fields. Return 'false' at the end of the file or on error.
+	     **/
+	    bool readLine();
+
+	    bool ok() const { return _ok; }
+	    int	 fieldsCount() const { return _fieldsCount; }
+	    const char * field( int no ) const { return _fields[ no ]; }
+
+	    /**
+	     * Return the value of optional field 'keyword' (e.g. "digest:")
+	     * in the current line or 0 if there is none.
+	     **/
+	    const char * optionalField( const char * keyword ) const;
+
+	    /**
+	     * Return 'true' if the current line is a directory.
+	     **/
+	    bool isDir() const;
+
+	protected:
+
+	    QString	_fileName;
+	    gzFile	_cache;
+	    bool	_ok;
+	    int		_lineNo;
+	    char	_buffer[ MAX_CACHE_LINE_LEN ];
+	    char *	_fields[ MAX_FIELDS_PER_LINE ];
+	    int		_fieldsCount;
+	};
+
+	/**
+	 * First pass over the old file: Collect the digests of all
+	 * directories.
+	 **/
+	bool readOldDigests();
+
+	/**
+	 * Pass over the new file: Skip the subtrees with the same digest,
+	 * record added directories and collect the entries of the changed
+	 * ones.
+	 **/
+	bool readNew();
+
+	/**
+	 * Second pass over the old file: Record removed directories, collect
+	 * the entries of the changed directories and compare them.
+	 **/
+	bool readOld();
+
+	/**
+	 * Compare the entries of the changed directory 'rawDir' in the old
+	 * file with those from the new file.
+	 **/
+	void compareDir( const QByteArray & rawDir, const EntryMap & oldEntries );
+
+	/**
+	 * Return the entry of the current line of 'reader'.
+	 **/
+	static Entry entry( const Reader & reader );
+
+	/**
+	 * Return the name of the current (non-directory) line of 'reader'.
+	 **/
+	static QByteArray entryName( const Reader & reader );
+
+	/**
+	 * Return the raw path of directory line 'rawPath' with a trailing '/'.
+	 **/
+	static QByteArray dirPrefix( const char * rawPath );
+
+	/**
+	 * Return the hash key for the raw path of a directory.
+	 **/
+	static quint64 pathKey( const QByteArray & rawPath );
+
+	/**
+	 * Add a change.
+	 **/
+	void addChange( char status, FileSize delta, const QByteArray & rawPath );
+
+
+	//
+	// Data members
+	//
+
+	QString				_oldFileName;
+	QString				_newFileName;
+
+	// Digests of all directories of the old file by path key. A
+	// directory without a digest has digest 0.
+	QHash<quint64, quint64>		_oldDigests;
+
+	// Directories in both files with the same digest
+	QSet<quint64>			_sameDirs;
+
+	// Directories in both files with different digests, with their
+	// entries from the new file
+	QHash<quint64, EntryMap>	_changedDirs;
+
+	QList<Change>			_changes;
+	int				_comparedDirs;
+	int				_skippedDirs;
+	FileSize			_totalDelta;
+    };
+
+}	// namespace QDirStat
+
+#endif	// CacheDiff_h
@@ -0,0 +1,382 @@
+/*
+ *   File name: CacheQuery.cpp
+ *   Summary:	Headless queries over QDirStat cache files
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <pwd.h>	// getpwuid()
+#include <string.h>	// strcasecmp(), strrchr()
+#include <algorithm>	// std::push_heap(), std::pop_heap(), std::sort()
+
+#include <QUrl>
+#include <QElapsedTimer>
+
+#include "CacheQuery.h"
+#include "MimeCategorizer.h"
+#include "MimeCategory.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Name for files that don't fit into any MIME category
+#define OTHER_CATEGORY	"<Other>"
+
+
+using namespace QDirStat;
+
+
+static bool greaterSize( const CacheQueryItem & a, const CacheQueryItem & b )
+{
+    return a.size > b.size;
+}
+
+
+bool CacheQueryTopList::accepts( FileSize size ) const
+{
+    if ( _limit <= 0 )
+	return false;
+
+    return _heap.size() < _limit || size > _heap.first().size;
+}
+
+
+void CacheQueryTopList::add( FileSize size, const QString & path )
+{
+    if ( ! accepts( size ) )
+	return;
+
+    if ( _heap.size() >= _limit )
+    {
+	// Drop the smallest item; with greaterSize() this is a min-heap
+
+	std::pop_heap( _heap.begin(), _heap.end(), greaterSize );
+	_heap.removeLast();
+    }
+
+    _heap.append( CacheQueryItem( size, path ) );
+    std::push_heap( _heap.begin(), _heap.end(), greaterSize );
+}
+
+
+QVector<CacheQueryItem> CacheQueryTopList::sorted() const
+{
+    QVector<CacheQueryItem> result = _heap;
+    std::sort( result.begin(), result.end(), greaterSize );
+
+    return result;
+}
+
+
+
+
+CacheQuery::CacheQuery( const QString & fileName ):
+    CacheReader( fileName, 0 ),
+    _wantCategories( false ),
+    _wantOwners( false ),
+    _mimeCategorizer( 0 ),
+    _unknownOwnerSum( 0LL ),
+    _totalSize( 0LL ),
+    _files( 0 ),
+    _dirs( 0 )
+{
+    // NOP
+}
+
+
+CacheQuery::~CacheQuery()
+{
+    // NOP
+}
+
+
+void CacheQuery::addPrefix( const QString & path )
+{
+    QString prefix = path;
+
+    while ( prefix.size() > 1 && prefix.endsWith( "/" ) )
+	prefix.chop( 1 );
+
+    _prefixes << prefix;
+    _prefixTotals << 0LL;
+}
+
+
+FileSize CacheQuery::prefixTotal( const QString & path ) const
+{
+    int index = _prefixes.indexOf( path );
+
+    return index >= 0 ? _prefixTotals.at( index ) : 0LL;
+}
+
+
+bool CacheQuery::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if ( ! ok() )	// Can't open the file or wrong header
+	return false;
+
+    if ( _wantCategories )
+	_mimeCategorizer = MimeCategorizer::instance();
+
+    read();
+
+    while ( ! _openDirs.isEmpty() )
+	closeDir();
+
+    logDebug() << "Queried " << _fileName << ": "
+	       << _dirs << " dirs, " << _files << " files"
+	       << " in " << timer.elapsed() << " millisec"
+	       << endl;
+
+    return ok();
+}
+
+
+void CacheQuery::addItem()
+{
+    ItemFields fields;
+
+    if ( ! parseItem( fields ) )
+	return;
+
+    const char * type	     = fields.type;
+    const char * rawPath     = fields.rawPath;
+    FileSize	 size	     = fields.size;
+    const char * categories  = 0;
+
+    bool isSummary = strcasecmp( type, "S" ) == 0;
+    bool isDir	   = strcasecmp( type, "D" ) == 0;
+    bool isFile	   = strcasecmp( type, "F" ) == 0;
+
+
+    // Use the same size as FileInfo::size(): The allocated size for sparse
+    // files, and an equal share for each hard link
+
+    if ( fields.blocks >= 0 && ! isSummary )
+	size = fields.blocks * 512;
+
+    if ( isFile && fields.links > 1 )
+	size /= fields.links;
+
+    _totalSize += size;
+
+    if ( _wantOwners )
+    {
+	if ( fields.hasUid )
+	    _ownerSums[ fields.uid ] += size;
+	else
+	    _unknownOwnerSum += size;
+    }
+
+    if ( isDir )
+    {
+	++_dirs;
+	openDir( QByteArray( rawPath ), size );
+	return;
+    }
+
+    if ( ! _openDirs.isEmpty() )
+	_openDirs.last().total += size;
+
+    if ( isSummary )
+    {
+	if ( _wantCategories )
+	{
+	    for ( int n = fields.firstOptional; n+1 < fieldsCount(); n += 2 )
+	    {
+		if ( strcasecmp( field( n ), "categories:" ) == 0 )
+		    categories = field( n+1 );
+	    }
+
+	    addSmallFileCategories( categories, size );
+	}
+
+	return;
+    }
+
+    ++_files;
+
+    if ( ! isFile )
+	return;
+
+    if ( _topFiles.accepts( size ) )
+    {
+	QByteArray path;
+
+	if ( *rawPath == '/' || _openDirs.isEmpty() )
+	    path = rawPath;
+	else
+	    path = _openDirs.last().rawPath + rawPath;
+
+	_topFiles.add( size, unescaped( path ) );
+    }
+
+    if ( _mimeCategorizer )
+    {
+	const char * name = strrchr( rawPath, '/' );
+	name = name ? name + 1 : rawPath;
+
+	MimeCategory * category = _mimeCategorizer->category( unescaped( name ) );
+	_categorySums[ category ? category->name() : OTHER_CATEGORY ] += size;
+    }
+}
+
+
+void CacheQuery::openDir( const QByteArray & rawPath, FileSize size )
+{
+    QByteArray path = rawPath;
+
+    if ( ! path.endsWith( '/' ) )
+	path += '/';
+
+    // Close all open directories that are not an ancestor of this one
+
+    while ( ! _openDirs.isEmpty() && ! path.startsWith( _openDirs.last().rawPath ) )
+	closeDir();
+
+    OpenDir dir;
+    dir.rawPath = path;
+    dir.total	= size;
+
+    _openDirs.append( dir );
+}
+
+
+void CacheQuery::closeDir()
+{
+    OpenDir dir = _openDirs.takeLast();
+
+    if ( ! _openDirs.isEmpty() )
+	_openDirs.last().total += dir.total;
+
+    if ( ! _topDirs.accepts( dir.total ) && _prefixes.isEmpty() )
+	return;
+
+    QString path = unescaped( dir.rawPath );
+
+    if ( path.size() > 1 )
+	path.chop( 1 );	// trailing '/'
+
+    _topDirs.add( dir.total, path );
+
+    for ( int i = 0; i < _prefixes.size(); ++i )
+    {
+	const QString & prefix = _prefixes.at( i );
+
+	// The total of a directory includes those of its subdirectories, so
+	// use the directory itself; or, if the prefix is above the starting
+	// point of the cache, each outermost directory below it.
+
+	if ( path == prefix )
+	{
+	    _prefixTotals[i] += dir.total;
+	}
+	else if ( _openDirs.isEmpty() &&
+		  ( prefix == "/" || path.startsWith( prefix + "/" ) ) )
+	{
+	    _prefixTotals[i] += dir.total;
+	}
+    }
+}
+
+
+void CacheQuery::addSmallFileCategories( const char * categoriesField, FileSize totalSize )
+{
+    // name=count:size,name=count:size,... with URL-encoded names
+
+    FileSize categorized = 0LL;
+
+    if ( categoriesField )
+    {
+	foreach ( const QByteArray & entry, QByteArray( categoriesField ).split( ',' ) )
+	{
+	    int equalPos = entry.indexOf( '=' );
+	    int colonPos = entry.indexOf( ':', equalPos );
+
+	    if ( equalPos < 0 || colonPos < 0 )
+		continue;
+
+	    QString  name = QUrl::fromPercentEncoding( entry.left( equalPos ) );
+	    FileSize sum  = entry.mid( colonPos + 1 ).toLongLong();
+
+	    _categorySums[ name ] += sum;
+	    categorized += sum;
+	}
+    }
+
+    if ( totalSize > categorized )
+	_categorySums[ OTHER_CATEGORY ] += totalSize - categorized;
+}
+
+
+QString CacheQuery::unescaped( const QByteArray & raw )
+{
+    return QUrl::fromPercentEncoding( raw );
+}
+
+
+void CacheQuery::writeResults( QTextStream & str ) const
+{
+    str << "# total\n"
+	<< _totalSize << "\t" << _dirs << " dirs\t" << _files << " files\n";
+
+    if ( _topFiles.limit() > 0 )
+    {
+	str << "\n# top-files " << _topFiles.limit() << "\n";
+
+	foreach ( const CacheQueryItem & item, _topFiles.sorted() )
+	    str << item.size << "\t" << item.path << "\n";
+    }
+
+    if ( _topDirs.limit() > 0 )
+    {
+	str << "\n# top-dirs " << _topDirs.limit() << "\n";
+
+	foreach ( const CacheQueryItem & item, _topDirs.sorted() )
+	    str << item.size << "\t" << item.path << "\n";
+    }
+
+    if ( ! _prefixes.isEmpty() )
+    {
+	str << "\n# prefix totals\n";
+
+	for ( int i = 0; i < _prefixes.size(); ++i )
+	    str << _prefixTotals.at( i ) << "\t" << _prefixes.at( i ) << "\n";
+    }
+
+    if ( _wantCategories )
+    {
+	str << "\n# categories\n";
+
+	for ( QMap<QString, FileSize>::const_iterator it = _categorySums.constBegin();
+	      it != _categorySums.constEnd();
+	      ++it )
+	{
+	    str << it.value() << "\t" << it.key() << "\n";
+	}
+    }
+
+    if ( _wantOwners )
+    {
+	str << "\n# owners\n";
+
+	for ( QMap<uid_t, FileSize>::const_iterator it = _ownerSums.constBegin();
+	      it != _ownerSums.constEnd();
+	      ++it )
+	{
+	    struct passwd * pw = getpwuid( it.key() );
+	    QString name = pw ? QString::fromUtf8( pw->pw_name ) : QString::number( it.key() );
+
+	    str << it.value() << "\t" << name << "\n";
+	}
+
+	if ( _unknownOwnerSum > 0 )
+	    str << _unknownOwnerSum << "\t<unknown>\n";
+    }
+
+    str.flush();
+}
@@ -0,0 +1,247 @@
+/*
+ *   File name: CacheQuery.h
+ *   Summary:	Headless queries over QDirStat cache files
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef CacheQuery_h
+#define CacheQuery_h
+
+
+#include <sys/types.h>		// uid_t
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include <QMap>
+#include <QTextStream>
+
+#include "FileSize.h"
+#include "DirTreeCache.h"
+
+
+namespace QDirStat
+{
+    class MimeCategorizer;
+
+
+    /**
+     * One entry of a top-N list: A size and the (unescaped) path.
+     **/
+    struct CacheQueryItem
+    {
+	CacheQueryItem(): size( 0LL ) {}
+	CacheQueryItem( FileSize sz, const QString & p ): size( sz ), path( p ) {}
+
+	FileSize size;
+	QString	 path;
+    };
+
+
+    /**
+     * List of the 'limit' largest items seen so far. This is a min-heap, so
+     * the smallest of the retained items is always at the front and can be
+     * replaced cheaply by a larger one.
+     **/
+    class CacheQueryTopList
+    {
+    public:
+
+	CacheQueryTopList(): _limit( 0 ) {}
+
+	void setLimit( int limit ) { _limit = limit; }
+	int  limit() const { return _limit; }
+
+	/**
+	 * Return 'true' if an item with size 'size' would make it into the
+	 * list. Use this to avoid building a path for items that don't.
+	 **/
+	bool accepts( FileSize size ) const;
+
+	/**
+	 * Add an item, possibly pushing out the smallest one.
+	 **/
+	void add( FileSize size, const QString & path );
+
+	/**
+	 * Return the items sorted by size, largest first.
+	 **/
+	QVector<CacheQueryItem> sorted() const;
+
+    protected:
+
+	int			_limit;
+	QVector<CacheQueryItem> _heap;
+    };
+
+
+    /**
+     * Headless queries over a cache file without building a DirTree:
+     * The cache file is streamed exactly once, and all requested results
+     * are collected in that single pass. Memory usage is bounded by the size
+     * of the answer (the top lists, the path prefixes, the categories and the
+     * owners) plus the current directory nesting depth, not by the size of
+     * the cache file.
+     *
+     * This uses the CacheReader for reading and parsing the cache file, but
+     * it processes each item itself instead of adding it to a tree.
+     *
+     * Directory totals rely on the cache file listing each directory's
+     * subdirectories directly after it (depth first), like both QDirStat
+     * and the qdirstat-cache-writer script write them.
+     *
+     * Usage:
+     *
+     *	   CacheQuery query( "/tmp/var.cache.gz" );
+     *	   query.setTopFiles( 20 );
+     *	   query.addPrefix( "/var/log" );
+     *
+     *	   if ( query.run() )
+     *	       query.writeResults( stream );
+     **/
+    class CacheQuery: public CacheReader
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	CacheQuery( const QString & fileName );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~CacheQuery();
+
+	/**
+	 * Collect the 'count' largest files.
+	 **/
+	void setTopFiles( int count ) { _topFiles.setLimit( count ); }
+
+	/**
+	 * Collect the 'count' largest directories (by subtree total).
+	 **/
+	void setTopDirs( int count ) { _topDirs.setLimit( count ); }
+
+	/**
+	 * Calculate the subtree total of 'path'.
+	 **/
+	void addPrefix( const QString & path );
+
+	/**
+	 * Collect the sums for each MIME category.
+	 **/
+	void setCategories( bool enable = true ) { _wantCategories = enable; }
+
+	/**
+	 * Collect the sums for each owner. This requires the "uid:" field in
+	 * the cache file which older cache files don't have.
+	 **/
+	void setOwners( bool enable = true ) { _wantOwners = enable; }
+
+	/**
+	 * Read the cache file and collect the results.
+	 * Return 'true' on success, 'false' on error.
+	 **/
+	bool run();
+
+	/**
+	 * Write the results to 'str': One section for each kind of query,
+	 * each one starting with a "#" comment line, and one tab-separated
+	 * line for each result with the size in bytes first.
+	 **/
+	void writeResults( QTextStream & str ) const;
+
+	/**
+	 * Return the sorted top files list.
+	 **/
+	QVector<CacheQueryItem> topFiles() const { return _topFiles.sorted(); }
+
+	/**
+	 * Return the sorted top directories list.
+	 **/
+	QVector<CacheQueryItem> topDirs() const { return _topDirs.sorted(); }
+
+	/**
+	 * Return the total size of the items below 'path'.
+	 **/
+	FileSize prefixTotal( const QString & path ) const;
+
+	/**
+	 * Return the total size of all items in the cache file.
+	 **/
+	FileSize totalSize() const { return _totalSize; }
+
+
+    protected:
+
+	/**
+	 * One directory that is still open: Its subtree total is not complete
+	 * yet.
+	 **/
+	struct OpenDir
+	{
+	    OpenDir(): total( 0LL ) {}
+
+	    QByteArray rawPath;	// Still URL-encoded, with a trailing '/'
+	    FileSize   total;
+	};
+
+	/**
+	 * Process the item of the current line.
+	 *
+	 * Reimplemented from CacheReader.
+	 **/
+	virtual void addItem() Q_DECL_OVERRIDE;
+
+	/**
+	 * Open a new directory with the URL-encoded absolute path 'rawPath'
+	 * and close all open directories that it is not in.
+	 **/
+	void openDir( const QByteArray & rawPath, FileSize size );
+
+	/**
+	 * Close the innermost open directory: Add its total to the parent
+	 * and feed it to the top directories list and the prefix totals.
+	 **/
+	void closeDir();
+
+	/**
+	 * Add the sizes of the small file summary 'categories:' field.
+	 **/
+	void addSmallFileCategories( const char * categoriesField, FileSize totalSize );
+
+	/**
+	 * Return the unescaped form of a URL-encoded path or name.
+	 **/
+	static QString unescaped( const QByteArray & raw );
+
+
+	//
+	// Data members
+	//
+
+	QVector<OpenDir>	_openDirs;
+
+	CacheQueryTopList	_topFiles;
+	CacheQueryTopList	_topDirs;
+	QStringList		_prefixes;
+	QVector<FileSize>	_prefixTotals;
+	bool			_wantCategories;
+	bool			_wantOwners;
+	MimeCategorizer *	_mimeCategorizer;
+	QMap<QString, FileSize> _categorySums;
+	QMap<uid_t, FileSize>	_ownerSums;
+	FileSize		_unknownOwnerSum;
+	FileSize		_totalSize;
+	int			_files;
+	int			_dirs;
+    };
+
+}	// namespace QDirStat
+
+#endif	// CacheQuery_h
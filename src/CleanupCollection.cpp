@@ -316,15 +316,19 @@ void CleanupCollection::execute()
         // segfault because we are iterating over items whose ancestors we just
         // deleted (thus invalidating pointers to it). Normalizing removes
         // items from the set that also have any ancestors in the set.
+        //
+        // Deleting them all at once is much faster for a large selection than
+        // one by one, in particular for the views.
 
-        foreach ( FileInfo * item, selection.invalidRemoved().normalized() )
-        {
-            DirTree * tree = item->tree();
+        FileInfoSet items = selection.invalidRemoved().normalized();
+        DirTree *   tree  = items.isEmpty() ? 0 : items.first()->tree();
 
+        if ( tree )
+        {
             if ( tree->isBusy() )
                 logWarning() << "Ignoring AssumeDeleted: DirTree is being read" << endl;
             else
-                tree->deleteSubtree( item );
+                tree->deleteSubtrees( items );
         }
     }
 
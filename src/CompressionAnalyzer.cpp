@@ -0,0 +1,967 @@
+/*
+ *   File name: CompressionAnalyzer.cpp
+ *   Summary:	Background analysis of btrfs compression for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>		// open(), O_NOATIME
+#include <unistd.h>		// close(), usleep(), geteuid()
+#include <string.h>		// memset()
+#include <stddef.h>		// offsetof()
+#include <endian.h>		// le64toh()
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>		// FS_IOC_FIEMAP
+#include <linux/fiemap.h>
+#include <linux/btrfs.h>	// BTRFS_IOC_TREE_SEARCH_V2
+#include <linux/btrfs_tree.h>	// struct btrfs_file_extent_item
+
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "CompressionAnalyzer.h"
+#include "SnapshotCollectJob.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "FileInfoIterator.h"
+#include "MountPoints.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Number of files for each job in the thread pool
+#define JOB_FILES		64
+
+// Number of extents to get with each FIEMAP call
+#define FIEMAP_EXTENTS		64
+
+// Buffer size for the results of each BTRFS_IOC_TREE_SEARCH_V2 call
+#define TREE_SEARCH_BUF_SIZE	16384
+
+// Interval for taking over the results from the worker threads
+#define RESULTS_INTERVAL_MILLISEC	500
+
+
+using namespace QDirStat;
+
+
+CompressionAnalyzer * CompressionAnalyzer::_instance = 0;
+
+// Set when BTRFS_IOC_TREE_SEARCH_V2 failed with EPERM even though we are
+// root, e.g. in a container without CAP_SYS_ADMIN: No need to try that
+// again for every file.
+
+static QAtomicInt treeSearchDenied( 0 );
+
+
+CompressionInfo & CompressionInfo::operator+=( const CompressionInfo & other )
+{
+    files	     += other.files;
+    unknownFiles     += other.unknownFiles;
+    extentBytes	     += other.extentBytes;
+    encodedBytes     += other.encodedBytes;
+    encodedDiskBytes += other.encodedDiskBytes;
+
+    return *this;
+}
+
+
+CompressionInfo & CompressionInfo::operator-=( const CompressionInfo & other )
+{
+    files	     -= other.files;
+    unknownFiles     -= other.unknownFiles;
+    extentBytes	     -= other.extentBytes;
+    encodedBytes     -= other.encodedBytes;
+    encodedDiskBytes -= other.encodedDiskBytes;
+
+    return *this;
+}
+
+
+/**
+ * Add the sizes of all extents of the file with descriptor 'fd' to 'info'
+ * and the sizes of the compressed ("encoded") extents to
+ * info.encodedBytes. Return 'false' if FIEMAP is not supported.
+ **/
+static bool readExtents( int fd, CompressionInfo & info )
+{
+    __u64 buf[ ( sizeof( struct fiemap ) +
+		 FIEMAP_EXTENTS * sizeof( struct fiemap_extent ) ) / sizeof( __u64 ) ];
+    struct fiemap * fiemap = (struct fiemap *) buf;
+    __u64 start = 0;
+    bool  last	= false;
+
+    while ( ! last )
+    {
+	memset( buf, 0, sizeof( buf ) );
+	fiemap->fm_start	= start;
+	fiemap->fm_length	= FIEMAP_MAX_OFFSET - start;
+	fiemap->fm_extent_count = FIEMAP_EXTENTS;
+
+	if ( ioctl( fd, FS_IOC_FIEMAP, fiemap ) != 0 )
+	    return false;
+
+	if ( fiemap->fm_mapped_extents == 0 )
+	    break;
+
+	for ( __u32 i = 0; i < fiemap->fm_mapped_extents; ++i )
+	{
+	    const struct fiemap_extent & extent = fiemap->fm_extents[ i ];
+
+	    info.extentBytes += extent.fe_length;
+
+	    if ( extent.fe_flags & FIEMAP_EXTENT_ENCODED )
+		info.encodedBytes += extent.fe_length;
+
+	    if ( extent.fe_flags & FIEMAP_EXTENT_LAST )
+		last = true;
+
+	    start = extent.fe_logical + extent.fe_length;
+	}
+    }
+
+    return true;
+}
+
+
+/**
+ * Look up the disk space of the compressed extents of inode 'ino' (opened
+ * as 'fd') in the btrfs metadata and store it in info.encodedDiskBytes.
+ * Return 'false' on error; this needs root permissions.
+ **/
+static bool readCompressedDiskSize( int fd, ino_t ino, CompressionInfo & info )
+{
+    __u64 buf[ TREE_SEARCH_BUF_SIZE / sizeof( __u64 ) ];
+    struct btrfs_ioctl_search_args_v2 * args = (struct btrfs_ioctl_search_args_v2 *) buf;
+    QSet<__u64> diskExtents;	// several file extents may share one compressed extent
+    FileSize	diskBytes = 0;
+
+    memset( args, 0, sizeof( *args ) );
+    args->key.tree_id	   = 0;		// the subvolume of 'fd'
+    args->key.min_objectid = ino;
+    args->key.max_objectid = ino;
+    args->key.min_type	   = BTRFS_EXTENT_DATA_KEY;
+    args->key.max_type	   = BTRFS_EXTENT_DATA_KEY;
+    args->key.min_offset   = 0;
+    args->key.max_offset   = (__u64) -1;
+    args->key.min_transid  = 0;
+    args->key.max_transid  = (__u64) -1;
+
+    while ( true )
+    {
+	args->key.nr_items = (__u32) -1;	// as many as fit into the buffer
+	args->buf_size	   = sizeof( buf ) - sizeof( *args );
+
+	if ( ioctl( fd, BTRFS_IOC_TREE_SEARCH_V2, args ) != 0 )
+	    return false;
+
+	if ( args->key.nr_items == 0 )
+	    break;
+
+	const char * pos	= (const char *) args->buf;
+	__u64	     lastOffset = 0;
+
+	for ( __u32 i = 0; i < args->key.nr_items; ++i )
+	{
+	    const struct btrfs_ioctl_search_header * header =
+		(const struct btrfs_ioctl_search_header *) pos;
+	    const char * item = pos + sizeof( *header );
+
+	    pos	      = item + header->len;
+	    lastOffset = header->offset;
+
+	    if ( header->objectid != ino || header->type != BTRFS_EXTENT_DATA_KEY )
+		continue;
+
+	    // The items themselves are in the on-disk format (little endian)
+
+	    const struct btrfs_file_extent_item * extent =
+		(const struct btrfs_file_extent_item *) item;
+
+	    if ( extent->compression == 0 )	// not compressed
+		continue;
+
+	    if ( extent->type == BTRFS_FILE_EXTENT_INLINE )
+	    {
+		// The compressed data follows right after the header fields
+
+		diskBytes += header->len - offsetof( struct btrfs_file_extent_item, disk_bytenr );
+	    }
+	    else
+	    {
+		__u64 bytenr = le64toh( extent->disk_bytenr );
+
+		if ( bytenr != 0 && ! diskExtents.contains( bytenr ) )	// 0: hole
+		{
+		    diskExtents.insert( bytenr );
+		    diskBytes += le64toh( extent->disk_num_bytes );
+		}
+	    }
+	}
+
+	if ( lastOffset == (__u64) -1 )
+	    break;
+
+	args->key.min_offset = lastOffset + 1;
+    }
+
+    info.encodedDiskBytes = diskBytes;
+
+    return true;
+}
+
+
+
+
+namespace QDirStat
+{
+    /**
+     * One job for the thread pool: Analyze some files.
+     *
+     * This only uses the paths of the files; the FileInfo pointers are only
+     * handed back to the CompressionAnalyzer with the results.
+     **/
+    class CompressionJob: public QRunnable
+    {
+    public:
+
+	CompressionJob( CompressionAnalyzer * analyzer,
+			int		      generation,
+			int		      delayMicrosec ):
+	    _analyzer( analyzer ),
+	    _generation( generation ),
+	    _delayMicrosec( delayMicrosec )
+	    {}
+
+	void add( FileInfo * item, const QByteArray & path )
+	{
+	    _items << item;
+	    _paths << path;
+	}
+
+	int count() const { return _items.size(); }
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    _infos.resize( _items.size() );
+
+	    for ( int i = 0; i < _paths.size(); ++i )
+	    {
+		if ( _analyzer->isCancelled( _generation ) )
+		    return;
+
+		analyze( _paths.at( i ), _infos[ i ] );
+
+		if ( _delayMicrosec > 0 )
+		    usleep( _delayMicrosec );
+	    }
+
+	    _analyzer->addResults( _generation, _items, _infos );
+	}
+
+    protected:
+
+	/**
+	 * Analyze the file 'path' and store the result in 'info'.
+	 * If that fails, info.files remains 0.
+	 **/
+	void analyze( const QByteArray & path, CompressionInfo & info )
+	{
+	    // Don't change the access time of all those files if possible
+
+	    int flags = O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC;
+	    int fd    = ::open( path.constData(), flags | O_NOATIME );
+
+	    if ( fd < 0 && errno == EPERM )	// O_NOATIME only for the owner
+		fd = ::open( path.constData(), flags );
+
+	    if ( fd < 0 )
+		return;
+
+	    struct stat statInfo;
+
+	    if ( fstat( fd, &statInfo ) == 0 && S_ISREG( statInfo.st_mode ) )
+	    {
+		if ( ! _analyzer->cachedInode( statInfo.st_dev, statInfo.st_ino, info ) )
+		{
+		    CompressionInfo result;
+
+		    if ( readExtents( fd, result ) )
+		    {
+			result.files = 1;
+
+			if ( result.encodedBytes > 0 )
+			{
+			    bool ok = false;
+
+			    if ( treeSearchDenied.fetchAndAddOrdered( 0 ) == 0 )
+			    {
+				ok = readCompressedDiskSize( fd, statInfo.st_ino, result );
+
+				if ( ! ok && errno == EPERM )
+				    treeSearchDenied.fetchAndStoreOrdered( 1 );
+			    }
+
+			    if ( ! ok )
+				result.unknownFiles = 1;
+			}
+
+			_analyzer->cacheInode( _generation, statInfo.st_dev, statInfo.st_ino, result );
+			info = result;
+		    }
+		}
+	    }
+
+	    ::close( fd );
+	}
+
+
+	CompressionAnalyzer *		_analyzer;
+	int				_generation;
+	int				_delayMicrosec;
+	QVector<FileInfo *>		_items;
+	QVector<QByteArray>		_paths;
+	QVector<CompressionInfo>	_infos;
+
+    };	// class CompressionJob
+
+
+    /**
+     * Job that collects the files on btrfs from a snapshot of the tree.
+     * 'btrfsByPath' is a copy of the mount points from when the analysis
+     * was started, so this doesn't need to look at MountPoints.
+     **/
+    class CompressionCollectJob: public SnapshotCollectJob
+    {
+    public:
+
+	CompressionCollectJob( CompressionAnalyzer *	     analyzer,
+			       int			     generation,
+			       TreeSnapshotPtr		     snapshot,
+			       const QMap<QString, bool> &   btrfsByPath ):
+	    SnapshotCollectJob( generation, snapshot ),
+	    _analyzer( analyzer ),
+	    _btrfsByPath( btrfsByPath )
+	    {}
+
+    protected:
+
+	virtual void collect( FileInfo * subtree, QVector<FileInfo *> & items ) Q_DECL_OVERRIDE
+	{
+	    if ( subtree->isDirInfo() )
+	    {
+		_analyzer->collect( subtree,
+				    CompressionAnalyzer::isOnBtrfs( subtree, _btrfsByPath ),
+				    _generation,
+				    _btrfsByPath,
+				    items );
+	    }
+	    else if ( subtree->parent() && subtree->isFile() &&
+		      CompressionAnalyzer::isOnBtrfs( subtree->parent(), _btrfsByPath ) )
+	    {
+		items << subtree;
+	    }
+	}
+
+	virtual void handOver( const QVector<FileInfo *> & items ) Q_DECL_OVERRIDE
+	{
+	    // Hash the pending files here, too: With many files on btrfs,
+	    // that would be a noticeable pause for the GUI thread.
+
+	    QSet<FileInfo *> pending;
+	    pending.reserve( items.size() );
+
+	    foreach ( FileInfo * item, items )
+		pending << item;
+
+	    _analyzer->addCollected( _generation, items, pending );
+	}
+
+	CompressionAnalyzer *	_analyzer;
+	QMap<QString, bool>	_btrfsByPath;
+
+    };	// class CompressionCollectJob
+
+}	// namespace QDirStat
+
+
+
+
+CompressionAnalyzer * CompressionAnalyzer::instance()
+{
+    if ( ! _instance )
+    {
+	_instance = new CompressionAnalyzer();
+	CHECK_NEW( _instance );
+    }
+
+    return _instance;
+}
+
+
+CompressionAnalyzer::CompressionAnalyzer():
+    QObject(),
+    _tree( 0 ),
+    _busy( false ),
+    _queuePos( 0 ),
+    _jobsRunning( 0 ),
+    _filesDone( 0 ),
+    _generation( 0 ),
+    _collectedGeneration( -1 )
+{
+    readSettings();
+
+    // Write settings immediately back since the destructor of this singleton
+    // is very likely never called.
+    writeSettings();
+
+    _timer.setInterval( RESULTS_INTERVAL_MILLISEC );
+
+    connect( &_timer, SIGNAL( timeout()	    ),
+	     this,    SLOT  ( processResults() ) );
+}
+
+
+CompressionAnalyzer::~CompressionAnalyzer()
+{
+    cancel();
+    writeSettings();
+}
+
+
+QThreadPool * CompressionAnalyzer::threadPool() const
+{
+    static QThreadPool * pool = 0;
+
+    if ( ! pool )
+    {
+	pool = new QThreadPool();
+	CHECK_NEW( pool );
+    }
+
+    return pool;
+}
+
+
+void CompressionAnalyzer::setTree( DirTree * tree )
+{
+    // Jobs that are still running stop with the next file; their results
+    // are ignored since they refer to the old generation.
+
+    cancel();
+
+    if ( _tree )
+	_tree->disconnect( this );
+
+    _tree = tree;
+    _info.clear();
+
+    {
+	QMutexLocker locker( &_mutex );
+	_generation.fetchAndAddOrdered( 1 );	// don't let old jobs refill the cache
+	_inodeCache.clear();
+    }
+
+    if ( ! _tree )
+	return;
+
+    connect( _tree, SIGNAL( clearing()			 ),
+	     this,  SLOT  ( clearing()			 ) );
+
+    connect( _tree, SIGNAL( deletingChild	( FileInfo * ) ),
+	     this,  SLOT  ( deletingChild	( FileInfo * ) ) );
+
+    connect( _tree, SIGNAL( clearingSubtree	( DirInfo * ) ),
+	     this,  SLOT  ( clearingSubtree	( DirInfo * ) ) );
+}
+
+
+const CompressionInfo * CompressionAnalyzer::info( FileInfo * item ) const
+{
+    QHash<FileInfo *, CompressionInfo>::const_iterator it = _info.constFind( item );
+
+    return it == _info.constEnd() ? 0 : &it.value();
+}
+
+
+bool CompressionAnalyzer::hasPermissions()
+{
+    return geteuid() == 0;
+}
+
+
+bool CompressionAnalyzer::start( FileInfo * subtree )
+{
+    cancel();
+
+    if ( ! _tree || ! subtree )
+	return false;
+
+    if ( ! hasPermissions() )
+    {
+	logInfo() << "Not root - no compression analysis" << endl;
+	return false;
+    }
+
+    if ( ! MountPoints::hasBtrfs() )
+    {
+	logInfo() << "No btrfs filesystem mounted - no compression analysis" << endl;
+	return false;
+    }
+
+    TreeSnapshotPtr snapshot = _tree->snapshot( subtree );
+
+    if ( ! snapshot )
+	return false;
+
+    _queue.clear();
+    _pending.clear();
+    _queuePos	 = 0;
+    _filesDone	 = 0;
+    _jobsRunning = 0;
+    _busy	 = true;
+
+    CompressionCollectJob * job =
+	new CompressionCollectJob( this,
+				   _generation.fetchAndAddOrdered( 0 ),
+				   snapshot,
+				   MountPoints::btrfsByPath() );
+    CHECK_NEW( job );
+    SnapshotCollectJob::start( job );
+
+    return true;
+}
+
+
+void CompressionAnalyzer::collect( FileInfo *		     dir,
+				   bool			     onBtrfs,
+				   int			     generation,
+				   const QMap<QString, bool> & btrfsByPath,
+				   QVector<FileInfo *> &     items ) const
+{
+    if ( isCancelled( generation ) )
+	return;
+
+    FileInfoIterator it( dir );
+
+    while ( *it )
+    {
+	FileInfo * child = *it;
+
+	if ( child->isDirInfo() )
+	{
+	    bool childOnBtrfs = onBtrfs;
+
+	    // Only look up the mount point if this might be a different
+	    // filesystem
+
+	    if ( ! child->isPseudoDir() &&
+		 ( child->isMountPoint() || child->device() != dir->device() ) )
+	    {
+		childOnBtrfs = isOnBtrfs( child, btrfsByPath );
+	    }
+
+	    collect( child, childOnBtrfs, generation, btrfsByPath, items );
+	}
+	else if ( onBtrfs && child->isFile() && child->size() > 0 )
+	{
+	    items << child;
+	}
+
+	++it;
+    }
+
+    if ( dir->attic() )
+	collect( dir->attic(), onBtrfs, generation, btrfsByPath, items );
+}
+
+
+bool CompressionAnalyzer::isOnBtrfs( FileInfo * dir, const QMap<QString, bool> & btrfsByPath )
+{
+    while ( dir && dir->isPseudoDir() )
+	dir = dir->parent();
+
+    if ( ! dir )
+	return false;
+
+    // Find the nearest mount point upwards from 'dir'
+
+    QString path = dir->path();
+
+    while ( true )
+    {
+	QMap<QString, bool>::const_iterator it = btrfsByPath.constFind( path );
+
+	if ( it != btrfsByPath.constEnd() )
+	    return it.value();
+
+	if ( path == "/" || path.isEmpty() )
+	    return false;
+
+	int pos = path.lastIndexOf( '/' );
+	path = pos > 0 ? path.left( pos ) : QString( "/" );
+    }
+}
+
+
+void CompressionAnalyzer::addCollected( int			      generation,
+					const QVector<FileInfo *> &   items,
+					const QSet<FileInfo *> &      pending )
+{
+    QMutexLocker locker( &_mutex );
+
+    _collectedGeneration = generation;
+    _collected		 = items;
+    _collectedPending	 = pending;
+
+    QMetaObject::invokeMethod( this, "collectingFinished", Qt::QueuedConnection );
+}
+
+
+void CompressionAnalyzer::collectingFinished()
+{
+    QVector<FileInfo *> items;
+    QSet<FileInfo *>	pending;
+
+    {
+	QMutexLocker locker( &_mutex );
+
+	items.swap( _collected );
+	pending.swap( _collectedPending );
+
+	if ( _collectedGeneration != _generation.fetchAndAddOrdered( 0 ) )
+	    return;	// cancelled in the meantime
+    }
+
+    // The tree is still frozen by the snapshot of the collect job, so all
+    // those items are still valid.
+
+    _queue = items;
+    _pending.swap( pending );
+
+    logInfo() << "Compression analysis: " << _queue.size() << " files on btrfs" << endl;
+
+    if ( _queue.isEmpty() )
+    {
+	finish();
+	return;
+    }
+
+    threadPool()->setMaxThreadCount( _threads );
+    startJobs();
+    _timer.start();
+
+    emit progress( 0, _queue.size() );
+}
+
+
+void CompressionAnalyzer::startJobs()
+{
+    // Keep a few jobs in the queue of the thread pool, but not all of them:
+    // Items might be deleted in the meantime, and this keeps the memory
+    // for the paths bounded.
+
+    int maxJobs	      = 2 * _threads;
+    int delayMicrosec = _maxFilesPerSecond > 0 ?
+	( 1000000LL * _threads ) / _maxFilesPerSecond : 0;
+
+    while ( _jobsRunning < maxJobs && _queuePos < _queue.size() )
+    {
+	CompressionJob * job = new CompressionJob( this,
+						   _generation.fetchAndAddOrdered( 0 ),
+						   delayMicrosec );
+	CHECK_NEW( job );
+
+	while ( job->count() < JOB_FILES && _queuePos < _queue.size() )
+	{
+	    FileInfo * item = _queue.at( _queuePos++ );
+
+	    if ( ! _pending.contains( item ) ) // deleted in the meantime?
+		continue;
+
+	    if ( _info.contains( item ) )	// analyzed before
+	    {
+		_pending.remove( item );
+		++_filesDone;
+		continue;
+	    }
+
+	    job->add( item, item->path().toUtf8() );
+	}
+
+	if ( job->count() == 0 )
+	{
+	    delete job;
+	    continue;
+	}
+
+	threadPool()->start( job );	// the pool deletes the job when it is done
+	++_jobsRunning;
+    }
+}
+
+
+void CompressionAnalyzer::addResults( int			       generation,
+				      const QVector<FileInfo *> &      items,
+				      const QVector<CompressionInfo> & infos )
+{
+    JobResults results;
+    results.generation = generation;
+    results.items      = items;
+    results.infos      = infos;
+
+    QMutexLocker locker( &_mutex );
+    _results << results;
+}
+
+
+void CompressionAnalyzer::processResults()
+{
+    QList<JobResults> results;
+
+    {
+	QMutexLocker locker( &_mutex );
+	results.swap( _results );
+    }
+
+    int		    generation = _generation.fetchAndAddOrdered( 0 );
+    QSet<DirInfo *> changedDirs;
+
+    foreach ( const JobResults & jobResults, results )
+    {
+	if ( jobResults.generation != generation )
+	    continue;
+
+	--_jobsRunning;
+
+	for ( int i = 0; i < jobResults.items.size(); ++i )
+	{
+	    FileInfo * item = jobResults.items.at( i );
+
+	    if ( ! _pending.remove( item ) ) // deleted in the meantime?
+		continue;
+
+	    ++_filesDone;
+	    CompressionInfo info = jobResults.infos.at( i );
+
+	    if ( info.files == 0 )	// error
+		continue;
+
+	    // Distribute the sizes among hard links just like FileInfo::size()
+
+	    if ( item->links() > 1 && ! FileInfo::ignoreHardLinks() )
+	    {
+		info.extentBytes      /= item->links();
+		info.encodedBytes     /= item->links();
+		info.encodedDiskBytes /= item->links();
+	    }
+
+	    _info.insert( item, info );
+
+	    for ( DirInfo * dir = item->parent(); dir && dir != _tree->root(); dir = dir->parent() )
+	    {
+		_info[ dir ] += info;
+		changedDirs.insert( dir );
+	    }
+	}
+    }
+
+    startJobs();
+
+    foreach ( DirInfo * dir, changedDirs )
+	emit dirChanged( dir );
+
+    emit progress( _filesDone, _queue.size() );
+
+    if ( _jobsRunning <= 0 && _queuePos >= _queue.size() )
+    {
+	logInfo() << "Compression analysis finished: " << _filesDone << " files" << endl;
+
+	if ( treeSearchDenied.fetchAndAddOrdered( 0 ) )
+	    logWarning() << "Permission denied for the btrfs tree search - compressed sizes unknown" << endl;
+
+	finish();
+    }
+}
+
+
+void CompressionAnalyzer::finish()
+{
+    _busy = false;
+    _timer.stop();
+    _queue.clear();
+    _pending.clear();
+
+    emit finished();
+}
+
+
+void CompressionAnalyzer::cancel()
+{
+    if ( ! _busy )
+	return;
+
+    // The jobs that are already running stop with the next file when they
+    // notice the new generation; their results are ignored.
+
+    _generation.fetchAndAddOrdered( 1 );
+
+#if (QT_VERSION >= QT_VERSION_CHECK( 5, 2, 0 ))
+    threadPool()->clear();
+#endif
+
+    {
+	QMutexLocker locker( &_mutex );
+	_results.clear();
+    }
+
+    _jobsRunning = 0;
+
+    logInfo() << "Compression analysis cancelled after " << _filesDone << " files" << endl;
+
+    finish();
+}
+
+
+bool CompressionAnalyzer::cachedInode( dev_t dev, ino_t ino, CompressionInfo & info )
+{
+    QMutexLocker locker( &_mutex );
+    QHash<InodeKey, CompressionInfo>::const_iterator it =
+	_inodeCache.constFind( InodeKey( dev, ino ) );
+
+    if ( it == _inodeCache.constEnd() )
+	return false;
+
+    info = it.value();
+
+    return true;
+}
+
+
+void CompressionAnalyzer::cacheInode( int			  generation,
+				      dev_t			  dev,
+				      ino_t			  ino,
+				      const CompressionInfo & info )
+{
+    QMutexLocker locker( &_mutex );
+
+    if ( ! isCancelled( generation ) )
+	_inodeCache.insert( InodeKey( dev, ino ), info );
+}
+
+
+void CompressionAnalyzer::clearing()
+{
+    cancel();
+    _info.clear();
+
+    QMutexLocker locker( &_mutex );
+    _generation.fetchAndAddOrdered( 1 );	// don't let old jobs refill the cache
+    _inodeCache.clear();
+}
+
+
+void CompressionAnalyzer::deletingChild( FileInfo * child )
+{
+    forget( child );
+}
+
+
+void CompressionAnalyzer::clearingSubtree( DirInfo * subtree )
+{
+    forget( subtree );
+
+    // The files in that subtree are about to be read again, probably
+    // because they changed
+
+    QMutexLocker locker( &_mutex );
+    _inodeCache.clear();
+}
+
+
+void CompressionAnalyzer::forget( FileInfo * item )
+{
+    if ( ! item || ( _info.isEmpty() && _pending.isEmpty() ) )
+	return;
+
+    QHash<FileInfo *, CompressionInfo>::iterator it = _info.find( item );
+
+    if ( it != _info.end() )
+    {
+	CompressionInfo info = it.value();
+	_info.erase( it );
+
+	for ( DirInfo * dir = item->parent(); dir && dir != _tree->root(); dir = dir->parent() )
+	{
+	    it = _info.find( dir );
+
+	    if ( it != _info.end() )
+	    {
+		it.value() -= info;
+
+		if ( it.value().files <= 0 )
+		    _info.erase( it );
+	    }
+	}
+    }
+
+    _pending.remove( item );
+    forgetChildren( item );
+}
+
+
+void CompressionAnalyzer::forgetChildren( FileInfo * dir )
+{
+    FileInfoIterator it( dir );
+
+    while ( *it )
+    {
+	FileInfo * child = *it;
+
+	_info.remove( child );
+	_pending.remove( child );
+
+	if ( child->isDirInfo() )
+	    forgetChildren( child );
+
+	++it;
+    }
+
+    if ( dir->attic() )
+    {
+	_info.remove( dir->attic() );
+	forgetChildren( dir->attic() );
+    }
+}
+
+
+void CompressionAnalyzer::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "CompressionAnalyzer" );
+
+    _threads	       = settings.value( "Threads",	      2 ).toInt();
+    _maxFilesPerSecond = settings.value( "MaxFilesPerSecond", 0 ).toInt();
+
+    settings.endGroup();
+
+    if ( _threads < 1 )
+	_threads = 1;
+}
+
+
+void CompressionAnalyzer::writeSettings()
+{
+    Settings settings;
+    settings.beginGroup( "CompressionAnalyzer" );
+
+    settings.setDefaultValue( "Threads",	   _threads	      );
+    settings.setDefaultValue( "MaxFilesPerSecond", _maxFilesPerSecond );
+
+    settings.endGroup();
+}
@@ -0,0 +1,375 @@
+/*
+ *   File name: CompressionAnalyzer.h
+ *   Summary:	Background analysis of btrfs compression for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+#ifndef CompressionAnalyzer_h
+#define CompressionAnalyzer_h
+
+
+#include <sys/types.h>	// dev_t, ino_t
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "FileSize.h"
+#include "TreeSnapshot.h"
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class DirInfo;
+    class FileInfo;
+
+
+    /**
+     * Compression information for one file or (summed up) for a subtree.
+     **/
+    struct CompressionInfo
+    {
+	CompressionInfo():
+	    files( 0 ),
+	    unknownFiles( 0 ),
+	    extentBytes( 0LL ),
+	    encodedBytes( 0LL ),
+	    encodedDiskBytes( 0LL )
+	    {}
+
+	int	 files;			// number of analyzed files
+	int	 unknownFiles;		// files with unknown compressed size
+	FileSize extentBytes;		// data in extents (uncompressed)
+	FileSize encodedBytes;		// part of that in compressed extents
+	FileSize encodedDiskBytes;	// disk space of the compressed extents
+
+	/**
+	 * Return the disk space used by the data of the file(s).
+	 **/
+	FileSize diskBytes() const
+	    { return extentBytes - encodedBytes + encodedDiskBytes; }
+
+	/**
+	 * Return 'true' if diskBytes() is exact, i.e. if the size of all
+	 * compressed extents is known.
+	 **/
+	bool isDiskSizeKnown() const { return unknownFiles == 0; }
+
+	CompressionInfo & operator+=( const CompressionInfo & other );
+	CompressionInfo & operator-=( const CompressionInfo & other );
+    };
+
+
+    /**
+     * Analyzer for how well files on btrfs filesystems are compressed.
+     *
+     * st_blocks is not helpful for that on btrfs: It reports the size of
+     * the data before compression. So this asks the filesystem for the
+     * extents of each file with the FIEMAP ioctl: Compressed extents are
+     * flagged there as "encoded". FIEMAP only reports their uncompressed
+     * size, though, so for files that have any compressed extents, their
+     * size on disk is looked up in the btrfs metadata with the
+     * BTRFS_IOC_TREE_SEARCH_V2 ioctl. That one requires root permissions,
+     * so the analysis is only available for root: Without that, only the
+     * amount of compressed data would be known, not how much disk space it
+     * takes.
+     *
+     * The files to analyze are collected in a background thread on a
+     * snapshot of the tree. The analysis runs in a few other background
+     * threads (see the "CompressionAnalyzer" settings group) that only get
+     * the paths of the files, never any FileInfo pointers, so the tree may
+     * change in the meantime. The results are collected in the GUI thread
+     * and summed up for all the parent directories. Hard links are only
+     * analyzed once.
+     *
+     * Only files on filesystems that MountPoints reports as btrfs are
+     * analyzed.
+     *
+     * This is a singleton class.
+     **/
+    class CompressionAnalyzer: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Return the singleton instance of this class.
+	 **/
+	static CompressionAnalyzer * instance();
+
+	/**
+	 * Watch 'tree' to forget results for items that are deleted. This
+	 * cancels any running analysis. Use 0 before the tree is destroyed.
+	 **/
+	void setTree( DirTree * tree );
+
+	/**
+	 * Return 'true' if the compression can be analyzed, i.e. if this
+	 * program runs as root.
+	 **/
+	static bool hasPermissions();
+
+	/**
+	 * Start analyzing all files in 'subtree' that are not analyzed yet.
+	 * Return 'false' if that is not possible, e.g. because there is no
+	 * btrfs filesystem at all or because of missing permissions.
+	 *
+	 * The files are collected in the background; if there are none,
+	 * finished() is emitted right away with filesDone() 0.
+	 **/
+	bool start( FileInfo * subtree );
+
+	/**
+	 * Return 'true' if an analysis is in progress.
+	 **/
+	bool isBusy() const { return _busy; }
+
+	/**
+	 * Return the number of files that were analyzed so far by the
+	 * current or the last analysis.
+	 **/
+	int filesDone() const { return _filesDone; }
+
+	/**
+	 * Return the compression information for 'item' or 0 if there is none.
+	 * For directories, this is the sum of all analyzed files below it.
+	 *
+	 * This is only changed in the GUI thread, so it may safely be used
+	 * while sorting in other threads.
+	 **/
+	const CompressionInfo * info( FileInfo * item ) const;
+
+
+    public slots:
+
+	/**
+	 * Cancel the running analysis. Results that were already collected
+	 * are kept.
+	 **/
+	void cancel();
+
+	/**
+	 * Read the settings.
+	 **/
+	void readSettings();
+
+	/**
+	 * Write the settings.
+	 **/
+	void writeSettings();
+
+
+    signals:
+
+	/**
+	 * Emitted from time to time during the analysis.
+	 **/
+	void progress( int filesDone, int filesTotal );
+
+	/**
+	 * Emitted when the compression information of 'dir' or any of its
+	 * direct children changed.
+	 **/
+	void dirChanged( DirInfo * dir );
+
+	/**
+	 * Emitted when the analysis is finished or cancelled.
+	 **/
+	void finished();
+
+
+    protected slots:
+
+	/**
+	 * Take over the files collected by the CompressionCollectJob and
+	 * start the analysis. This is called via a queued connection.
+	 **/
+	void collectingFinished();
+
+	/**
+	 * Take over the results from the worker threads and start new jobs.
+	 * This is triggered by a timer while the analysis is running.
+	 **/
+	void processResults();
+
+	/**
+	 * The tree is being cleared: Cancel and forget everything.
+	 **/
+	void clearing();
+
+	/**
+	 * An item is about to be deleted: Forget it and its subtree.
+	 **/
+	void deletingChild( FileInfo * child );
+
+	/**
+	 * A subtree is about to be cleared: Forget everything below it.
+	 **/
+	void clearingSubtree( DirInfo * subtree );
+
+
+    protected:
+
+	friend class CompressionJob;
+	friend class CompressionCollectJob;
+
+	/**
+	 * Constructor. Use instance() instead.
+	 **/
+	CompressionAnalyzer();
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~CompressionAnalyzer();
+
+	/**
+	 * Return the thread pool for the jobs. It is never deleted: Its
+	 * destructor would wait for threads that hang on a dead mount.
+	 **/
+	QThreadPool * threadPool() const;
+
+	/**
+	 * Add all files below 'dir' that are on btrfs to 'items'.
+	 * 'onBtrfs' tells if 'dir' itself is on btrfs; 'btrfsByPath' is the
+	 * result of MountPoints::btrfsByPath().
+	 *
+	 * This is called in a worker thread on a snapshot of the tree.
+	 **/
+	void collect( FileInfo *		  dir,
+		      bool			  onBtrfs,
+		      int			  generation,
+		      const QMap<QString, bool> & btrfsByPath,
+		      QVector<FileInfo *> &	  items ) const;
+
+	/**
+	 * Return 'true' if 'dir' is on a btrfs filesystem according to
+	 * 'btrfsByPath'. This does not access the filesystem.
+	 **/
+	static bool isOnBtrfs( FileInfo * dir, const QMap<QString, bool> & btrfsByPath );
+
+	/**
+	 * Store the files collected by a CompressionCollectJob and trigger
+	 * collectingFinished(). This is called in a worker thread.
+	 **/
+	void addCollected( int				generation,
+			   const QVector<FileInfo *> &	items,
+			   const QSet<FileInfo *> &	pending );
+
+	/**
+	 * Finish the analysis.
+	 **/
+	void finish();
+
+	/**
+	 * Start new jobs for the queued files until there are enough of them.
+	 **/
+	void startJobs();
+
+	/**
+	 * Remove the results for 'item' and everything below it, and
+	 * subtract them from its parent directories.
+	 **/
+	void forget( FileInfo * item );
+
+	/**
+	 * Remove the results and pending files below 'dir' without touching
+	 * any parent directories.
+	 **/
+	void forgetChildren( FileInfo * dir );
+
+	/**
+	 * Add the results of one job. This is called from the worker threads.
+	 **/
+	void addResults( int				generation,
+			 const QVector<FileInfo *> &	items,
+			 const QVector<CompressionInfo> & infos );
+
+	/**
+	 * Return 'true' if jobs for 'generation' should stop.
+	 * This is called from the worker threads.
+	 **/
+	bool isCancelled( int generation ) const
+	    { return _generation.fetchAndAddOrdered( 0 ) != generation; }
+
+	/**
+	 * Look up the inode 'dev' / 'ino' in the cache and return 'true' if
+	 * it was found. This is called from the worker threads.
+	 **/
+	bool cachedInode( dev_t dev, ino_t ino, CompressionInfo & info );
+
+	/**
+	 * Store the result for inode 'dev' / 'ino' in the cache unless jobs
+	 * for 'generation' were cancelled in the meantime.
+	 * This is called from the worker threads.
+	 **/
+	void cacheInode( int			 generation,
+			 dev_t			 dev,
+			 ino_t			 ino,
+			 const CompressionInfo & info );
+
+
+	/**
+	 * Results of one job.
+	 **/
+	struct JobResults
+	{
+	    int				generation;
+	    QVector<FileInfo *>		items;
+	    QVector<CompressionInfo>	infos;
+	};
+
+	typedef QPair<quint64, quint64> InodeKey;
+
+
+	//
+	// Data members
+	//
+
+	static CompressionAnalyzer *		_instance;
+
+	DirTree *				_tree;
+	QHash<FileInfo *, CompressionInfo>	_info;
+
+	// Used only in the GUI thread
+
+	bool					_busy;
+	QVector<FileInfo *>			_queue;
+	int					_queuePos;
+	QSet<FileInfo *>			_pending;
+	int					_jobsRunning;
+	int					_filesDone;
+	QTimer					_timer;
+
+	// Shared with the worker threads
+
+	mutable QAtomicInt			_generation;
+	QMutex					_mutex;
+	QList<JobResults>			_results;
+	QHash<InodeKey, CompressionInfo>	_inodeCache;
+	int					_collectedGeneration;
+	QVector<FileInfo *>			_collected;
+	QSet<FileInfo *>			_collectedPending;
+
+	// Settings
+
+	int					_threads;
+	int					_maxFilesPerSecond;
+
+    };	// class CompressionAnalyzer
+
+}	// namespace QDirStat
+
+#endif	// CompressionAnalyzer_h
@@ -0,0 +1,936 @@
+/*
+ *   File name: ContentSniffer.cpp
+ *   Summary:	Content-based file type detection for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>		// open(), O_NOATIME
+#include <unistd.h>		// read(), pread(), close(), usleep()
+#include <string.h>		// memcmp()
+#include <stdio.h>		// rename()
+#include <sys/stat.h>
+#include <sys/syscall.h>	// SYS_ioprio_set
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QTextStream>
+
+#include "ContentSniffer.h"
+#include "SnapshotCollectJob.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "FileInfoIterator.h"
+#include "MimeCategorizer.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Number of files for each job in the thread pool
+#define JOB_FILES		32
+
+// Number of bytes to read from the start of each file
+#define SNIFF_BYTES		4096
+
+// Interval for taking over the results from the worker threads
+#define RESULTS_INTERVAL_MILLISEC	500
+
+// Header line of the cache file
+#define CACHE_HEADER		"# QDirStat content type cache 1.0"
+
+// From linux/ioprio.h which is not available everywhere
+#define IOPRIO_CLASS_SHIFT	13
+#define IOPRIO_CLASS_IDLE	3
+#define IOPRIO_WHO_PROCESS	1
+
+
+using namespace QDirStat;
+
+
+ContentSniffer * ContentSniffer::_instance = 0;
+
+
+/**
+ * Magic byte signature of a file type at a fixed offset.
+ **/
+struct MagicSignature
+{
+    int		 offset;
+    const char * bytes;
+    int		 len;
+    const char * suffix;
+};
+
+
+// The suffix is what MimeCategorizer gets to see for files of that type.
+// Longer signatures with the same start must come first.
+
+static const MagicSignature magicSignatures[] =
+{
+    {	0, "\x89PNG\r\n\x1a\n",			 8, "png"	},
+    {	0, "\xff\xd8\xff",			 3, "jpg"	},
+    {	0, "GIF8",				 4, "gif"	},
+    {	0, "II*\0",				 4, "tif"	},
+    {	0, "MM\0*",				 4, "tif"	},
+    {	0, "%PDF-",				 5, "pdf"	},
+    {	0, "PK\x03\x04",			 4, "zip"	},
+    {	0, "\x1f\x8b",				 2, "gz"	},
+    {	0, "BZh",				 3, "bz2"	},
+    {	0, "\xfd" "7zXZ\0",			 6, "xz"	},
+    {	0, "\x28\xb5\x2f\xfd",			 4, "zst"	},
+    {	0, "7z\xbc\xaf\x27\x1c",		 6, "7z"	},
+    {	0, "Rar!\x1a\x07",			 6, "rar"	},
+    { 257, "ustar",				 5, "tar"	},
+    {	0, "SQLite format 3\0",			16, "sqlite"	},
+    {	0, "QFI\xfb",				 4, "qcow2"	},
+    {	0, "KDMV",				 4, "vmdk"	},
+    {	0, "# Disk DescriptorFile",		21, "vmdk"	},
+    {	0, "conectix",				 8, "vhd"	},
+    {	0, "vhdxfile",				 8, "vhdx"	},
+    {	0, "<<< Oracle VM VirtualBox Disk Image", 35, "vdi"	},
+    {	0, "\x1a\x45\xdf\xa3",			 4, "mkv"	},
+    {	0, "ID3",				 3, "mp3"	},
+    {	0, "OggS",				 4, "ogg"	},
+    {	0, "fLaC",				 4, "flac"	},
+    {	0, "\x00\x00\x01\xba",			 4, "mpg"	},
+    {	0, "\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1",	 8, "doc"	},
+    {	0, "\xed\xab\xee\xdb",			 4, "rpm"	},
+    {	0, "!<arch>\ndebian",			14, "deb"	},
+    {	0, "!<arch>\n",				 8, "a"		},
+    {	0, "hsqs",				 4, "squashfs"	},
+    {	0, 0,					 0, 0		}
+};
+
+
+/**
+ * Return the suffix for the file type that the first 'len' bytes 'buf' of a
+ * file indicate or an empty string if none is known.
+ **/
+static QString matchMagic( const char * buf, int len )
+{
+    for ( const MagicSignature * sig = magicSignatures; sig->bytes; ++sig )
+    {
+	if ( sig->offset + sig->len <= len &&
+	     memcmp( buf + sig->offset, sig->bytes, sig->len ) == 0 )
+	{
+	    return sig->suffix;
+	}
+    }
+
+    // Signatures with variable parts
+
+    if ( len >= 12 && memcmp( buf, "RIFF", 4 ) == 0 )
+    {
+	if ( memcmp( buf + 8, "AVI ", 4 ) == 0 ) return "avi";
+	if ( memcmp( buf + 8, "WAVE", 4 ) == 0 ) return "wav";
+	if ( memcmp( buf + 8, "WEBP", 4 ) == 0 ) return "webp";
+    }
+
+    if ( len >= 12 && memcmp( buf + 4, "ftyp", 4 ) == 0 )
+	return "mp4";	// also .mov, .m4a, .heic etc.; close enough
+
+    if ( len >= 18 && memcmp( buf, "\x7f" "ELF", 4 ) == 0 )
+    {
+	// e_type at offset 16 in the byte order given at offset 5
+
+	int type = buf[5] == 2 ?
+	    ( (unsigned char) buf[16] << 8 ) | (unsigned char) buf[17] :
+	    ( (unsigned char) buf[17] << 8 ) | (unsigned char) buf[16];
+
+	if ( type == 4 )	// ET_CORE
+	    return "core";
+    }
+
+    return QString();
+}
+
+
+
+
+namespace QDirStat
+{
+    /**
+     * One job for the thread pool: Detect the types of some files.
+     *
+     * This only uses the paths of the files; the FileInfo pointers are only
+     * handed back to the ContentSniffer with the results.
+     **/
+    class SniffJob: public QRunnable
+    {
+    public:
+
+	SniffJob( ContentSniffer * sniffer,
+		  int		   generation,
+		  int		   delayMicrosec ):
+	    _sniffer( sniffer ),
+	    _generation( generation ),
+	    _delayMicrosec( delayMicrosec )
+	    {}
+
+	void add( FileInfo * item, const QByteArray & path )
+	{
+	    _items << item;
+	    _paths << path;
+	}
+
+	int count() const { return _items.size(); }
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    setIdleIoPriority();
+
+	    for ( int i = 0; i < _paths.size(); ++i )
+	    {
+		if ( _sniffer->isCancelled( _generation ) )
+		    return;
+
+		bool readFile = false;
+		_suffixes << sniff( _paths.at( i ), readFile );
+
+		if ( readFile && _delayMicrosec > 0 )
+		    usleep( _delayMicrosec );
+	    }
+
+	    _sniffer->addResults( _generation, _items, _suffixes );
+	}
+
+    protected:
+
+	/**
+	 * Set the I/O priority of the current thread to "idle", so reading
+	 * all those files does not get in the way of anything else.
+	 **/
+	static void setIdleIoPriority()
+	{
+#ifdef SYS_ioprio_set
+	    // Thread 0 is the calling thread
+	    syscall( SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+		     IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT );
+#endif
+	}
+
+	/**
+	 * Detect the type of file 'path' and return the suffix for it or an
+	 * empty string if it is unknown. 'readFile_ret' is set to 'true' if
+	 * the file was actually read, i.e. if it was not in the cache.
+	 **/
+	QString sniff( const QByteArray & path, bool & readFile_ret )
+	{
+	    struct stat statInfo;
+
+	    if ( lstat( path.constData(), &statInfo ) != 0 || ! S_ISREG( statInfo.st_mode ) )
+		return QString();
+
+	    ContentSniffer::CacheKey key( qMakePair( (quint64) statInfo.st_dev,
+						     (quint64) statInfo.st_ino ),
+					  (qint64) statInfo.st_mtime );
+	    QString suffix;
+
+	    if ( _sniffer->cached( key, suffix ) )
+		return suffix;
+
+	    // Don't change the access time of all those files if possible
+
+	    int flags = O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC;
+	    int fd    = ::open( path.constData(), flags | O_NOATIME );
+
+	    if ( fd < 0 && errno == EPERM )	// O_NOATIME only for the owner
+		fd = ::open( path.constData(), flags );
+
+	    if ( fd < 0 )
+		return QString();
+
+	    readFile_ret = true;
+
+	    char    buf[ SNIFF_BYTES ];
+	    ssize_t len = ::read( fd, buf, sizeof( buf ) );
+
+	    if ( len > 0 )
+	    {
+		suffix = matchMagic( buf, len );
+
+		// ISO 9660 has its signature behind the 32k system area
+
+		if ( suffix.isEmpty() &&
+		     pread( fd, buf, 5, 0x8001 ) == 5 && memcmp( buf, "CD001", 5 ) == 0 )
+		{
+		    suffix = "iso";
+		}
+
+		_sniffer->cache( key, suffix );
+	    }
+
+	    ::close( fd );
+
+	    return suffix;
+	}
+
+
+	ContentSniffer *	_sniffer;
+	int			_generation;
+	int			_delayMicrosec;
+	QVector<FileInfo *>	_items;
+	QVector<QByteArray>	_paths;
+	QStringList		_suffixes;
+
+    };	// class SniffJob
+
+
+    /**
+     * Job that collects the files that need a detection from a snapshot of
+     * the tree.
+     **/
+    class SniffCollectJob: public SnapshotCollectJob
+    {
+    public:
+
+	SniffCollectJob( ContentSniffer * sniffer,
+			 int		  generation,
+			 TreeSnapshotPtr  snapshot ):
+	    SnapshotCollectJob( generation, snapshot ),
+	    _sniffer( sniffer )
+	    {}
+
+    protected:
+
+	virtual void collect( FileInfo * subtree, QVector<FileInfo *> & items ) Q_DECL_OVERRIDE
+	{
+	    if ( subtree->isDirInfo() )
+		_sniffer->collect( subtree, _generation, items );
+	    else if ( _sniffer->needsDetection( subtree ) )
+		items << subtree;
+	}
+
+	virtual void handOver( const QVector<FileInfo *> & items ) Q_DECL_OVERRIDE
+	{
+	    // Reading the cache file is no job for the GUI thread either;
+	    // but don't bother if there is nothing to look up in it.
+
+	    if ( ! items.isEmpty() )
+		_sniffer->loadCache();
+
+	    _sniffer->addCollected( _generation, items );
+	}
+
+	ContentSniffer *	_sniffer;
+
+    };	// class SniffCollectJob
+
+}	// namespace QDirStat
+
+
+
+
+ContentSniffer * ContentSniffer::instance()
+{
+    if ( ! _instance )
+    {
+	_instance = new ContentSniffer();
+	CHECK_NEW( _instance );
+    }
+
+    return _instance;
+}
+
+
+QString ContentSniffer::sniffedSuffix( FileInfo * item )
+{
+    if ( ! _instance )
+	return QString();
+
+    QMutexLocker locker( &_instance->_suffixesMutex );
+
+    return _instance->_suffixes.value( item );
+}
+
+
+ContentSniffer::ContentSniffer():
+    QObject(),
+    _tree( 0 ),
+    _busy( false ),
+    _queuePos( 0 ),
+    _jobsRunning( 0 ),
+    _filesDone( 0 ),
+    _found( 0 ),
+    _generation( 0 ),
+    _collectedGeneration( -1 ),
+    _cacheLoaded( false ),
+    _cacheDirty( false )
+{
+    readSettings();
+
+    // Write settings immediately back since the destructor of this singleton
+    // is very likely never called.
+    writeSettings();
+
+    _timer.setInterval( RESULTS_INTERVAL_MILLISEC );
+
+    connect( &_timer, SIGNAL( timeout()	    ),
+	     this,    SLOT  ( processResults() ) );
+}
+
+
+ContentSniffer::~ContentSniffer()
+{
+    cancel();
+    saveCache();
+    writeSettings();
+}
+
+
+QThreadPool * ContentSniffer::threadPool() const
+{
+    static QThreadPool * pool = 0;
+
+    if ( ! pool )
+    {
+	pool = new QThreadPool();
+	CHECK_NEW( pool );
+    }
+
+    return pool;
+}
+
+
+void ContentSniffer::setTree( DirTree * tree )
+{
+    // Jobs that are still running stop with the next file; their results
+    // are ignored since they refer to the old generation.
+
+    cancel();
+
+    if ( _tree )
+	_tree->disconnect( this );
+
+    _tree = tree;
+    clearSuffixes();
+
+    if ( ! _tree )
+	return;
+
+    connect( _tree, SIGNAL( clearing()			 ),
+	     this,  SLOT  ( clearing()			 ) );
+
+    connect( _tree, SIGNAL( deletingChild	( FileInfo * ) ),
+	     this,  SLOT  ( deletingChild	( FileInfo * ) ) );
+
+    connect( _tree, SIGNAL( clearingSubtree	( DirInfo * ) ),
+	     this,  SLOT  ( clearingSubtree	( DirInfo * ) ) );
+}
+
+
+bool ContentSniffer::start( FileInfo * subtree )
+{
+    cancel();
+
+    if ( ! _enabled || ! _tree || ! subtree )
+	return false;
+
+    TreeSnapshotPtr snapshot = _tree->snapshot( subtree );
+
+    if ( ! snapshot )
+	return false;
+
+    _queue.clear();
+    _pending.clear();
+    _queuePos	 = 0;
+    _filesDone	 = 0;
+    _found	 = 0;
+    _jobsRunning = 0;
+    _busy	 = true;
+
+    SniffCollectJob * job = new SniffCollectJob( this,
+						 _generation.fetchAndAddOrdered( 0 ),
+						 snapshot );
+    CHECK_NEW( job );
+    SnapshotCollectJob::start( job );
+
+    return true;
+}
+
+
+void ContentSniffer::collect( FileInfo *	    dir,
+			      int		    generation,
+			      QVector<FileInfo *> & items ) const
+{
+    if ( isCancelled( generation ) )
+	return;
+
+    FileInfoIterator it( dir );
+
+    while ( *it )
+    {
+	FileInfo * child = *it;
+
+	if ( child->isDirInfo() )
+	    collect( child, generation, items );
+	else if ( needsDetection( child ) )
+	    items << child;
+
+	++it;
+    }
+}
+
+
+void ContentSniffer::addCollected( int generation, const QVector<FileInfo *> & items )
+{
+    QMutexLocker locker( &_mutex );
+
+    _collectedGeneration = generation;
+    _collected		 = items;
+
+    QMetaObject::invokeMethod( this, "collectingFinished", Qt::QueuedConnection );
+}
+
+
+void ContentSniffer::collectingFinished()
+{
+    QVector<FileInfo *> items;
+
+    {
+	QMutexLocker locker( &_mutex );
+
+	items.swap( _collected );
+
+	if ( _collectedGeneration != _generation.fetchAndAddOrdered( 0 ) )
+	    return;	// cancelled in the meantime
+    }
+
+    // The tree is still frozen by the snapshot of the collect job, so all
+    // those items are still valid.
+
+    _queue = items;
+
+    foreach ( FileInfo * item, _queue )
+	_pending << item;
+
+    logInfo() << "Content type detection: " << _queue.size() << " files" << endl;
+
+    if ( _queue.isEmpty() )
+    {
+	finish();
+	return;
+    }
+
+    threadPool()->setMaxThreadCount( _threads );
+    startJobs();
+    _timer.start();
+
+    emit progress( 0, _queue.size() );
+}
+
+
+bool ContentSniffer::needsDetection( FileInfo * item ) const
+{
+    if ( ! item->isFile() || item->size() < _minSize )
+	return false;
+
+    // Only names without any suffix; a leading dot does not count.
+
+    if ( item->name().lastIndexOf( '.' ) > 0 )
+	return false;
+
+    {
+	QMutexLocker locker( &_suffixesMutex );
+
+	if ( _suffixes.contains( item ) )
+	    return false;
+    }
+
+    return ! MimeCategorizer::instance()->category( item->name() );
+}
+
+
+void ContentSniffer::startJobs()
+{
+    // Keep a few jobs in the queue of the thread pool, but not all of them:
+    // Items might be deleted in the meantime, and this keeps the memory
+    // for the paths bounded.
+
+    int maxJobs	      = 2 * _threads;
+    int delayMicrosec = _maxFilesPerSecond > 0 ?
+	( 1000000LL * _threads ) / _maxFilesPerSecond : 0;
+
+    while ( _jobsRunning < maxJobs && _queuePos < _queue.size() )
+    {
+	SniffJob * job = new SniffJob( this,
+				       _generation.fetchAndAddOrdered( 0 ),
+				       delayMicrosec );
+	CHECK_NEW( job );
+
+	while ( job->count() < JOB_FILES && _queuePos < _queue.size() )
+	{
+	    FileInfo * item = _queue.at( _queuePos++ );
+
+	    if ( _pending.contains( item ) ) // not deleted in the meantime?
+		job->add( item, item->path().toUtf8() );
+	}
+
+	if ( job->count() == 0 )
+	{
+	    delete job;
+	    continue;
+	}
+
+	threadPool()->start( job );	// the pool deletes the job when it is done
+	++_jobsRunning;
+    }
+}
+
+
+void ContentSniffer::addResults( int			     generation,
+				 const QVector<FileInfo *> & items,
+				 const QStringList &	     suffixes )
+{
+    JobResults results;
+    results.generation = generation;
+    results.items      = items;
+    results.suffixes   = suffixes;
+
+    QMutexLocker locker( &_mutex );
+    _results << results;
+}
+
+
+void ContentSniffer::processResults()
+{
+    QList<JobResults> results;
+
+    {
+	QMutexLocker locker( &_mutex );
+	results.swap( _results );
+    }
+
+    int generation = _generation.fetchAndAddOrdered( 0 );
+    QMutexLocker suffixesLocker( &_suffixesMutex );
+
+    foreach ( const JobResults & jobResults, results )
+    {
+	if ( jobResults.generation != generation )
+	    continue;
+
+	--_jobsRunning;
+
+	for ( int i = 0; i < jobResults.items.size(); ++i )
+	{
+	    FileInfo * item = jobResults.items.at( i );
+
+	    if ( ! _pending.remove( item ) ) // deleted in the meantime?
+		continue;
+
+	    ++_filesDone;
+
+	    // Also store unknown types, so they are not read again
+
+	    const QString & suffix = jobResults.suffixes.at( i );
+	    _suffixes.insert( item, suffix );
+
+	    if ( ! suffix.isEmpty() )
+		++_found;
+	}
+    }
+
+    suffixesLocker.unlock();
+    startJobs();
+
+    emit progress( _filesDone, _queue.size() );
+
+    if ( _jobsRunning <= 0 && _queuePos >= _queue.size() )
+    {
+	logInfo() << "Content type detection finished: "
+		  << _found << " of " << _filesDone << " files detected"
+		  << endl;
+
+	finish();
+    }
+}
+
+
+void ContentSniffer::finish()
+{
+    _busy = false;
+    _timer.stop();
+    _queue.clear();
+    _pending.clear();
+
+    saveCache();
+
+    emit finished( _found );
+}
+
+
+void ContentSniffer::cancel()
+{
+    if ( ! _busy )
+	return;
+
+    // The jobs that are already running stop with the next file when they
+    // notice the new generation; their results are ignored.
+
+    _generation.fetchAndAddOrdered( 1 );
+
+#if (QT_VERSION >= QT_VERSION_CHECK( 5, 2, 0 ))
+    threadPool()->clear();
+#endif
+
+    {
+	QMutexLocker locker( &_mutex );
+	_results.clear();
+    }
+
+    _jobsRunning = 0;
+
+    logInfo() << "Content type detection cancelled after " << _filesDone << " files" << endl;
+
+    finish();
+}
+
+
+bool ContentSniffer::cached( const CacheKey & key, QString & suffix )
+{
+    QMutexLocker locker( &_mutex );
+    QHash<CacheKey, QString>::const_iterator it = _cache.constFind( key );
+
+    if ( it == _cache.constEnd() )
+	return false;
+
+    suffix = it.value();
+
+    return true;
+}
+
+
+void ContentSniffer::cache( const CacheKey & key, const QString & suffix )
+{
+    QMutexLocker locker( &_mutex );
+    _cache.insert( key, suffix );
+    _cacheDirty = true;
+}
+
+
+QString ContentSniffer::cacheFileName() const
+{
+    QString fileName = _cacheFile;
+
+    if ( fileName.startsWith( "~" ) )
+	fileName.replace( 0, 1, QDir::homePath() );
+
+    return fileName;
+}
+
+
+void ContentSniffer::loadCache()
+{
+    {
+	QMutexLocker locker( &_mutex );
+
+	if ( _cacheLoaded )
+	    return;
+
+	_cacheLoaded = true;
+    }
+
+    QString fileName = cacheFileName();
+
+    if ( fileName.isEmpty() )
+	return;
+
+    QFile file( fileName );
+
+    if ( ! file.open( QIODevice::ReadOnly | QIODevice::Text ) )
+	return;
+
+    QTextStream in( &file );
+    QString	line = in.readLine();
+
+    if ( line != CACHE_HEADER )
+    {
+	logWarning() << "Ignoring " << fileName << ": Wrong format" << endl;
+	return;
+    }
+
+    QHash<CacheKey, QString> cache;
+
+    while ( ! in.atEnd() )
+    {
+	// dev ino mtime suffix
+
+	QStringList fields = in.readLine().split( ' ', QString::SkipEmptyParts );
+
+	if ( fields.size() != 4 )
+	    continue;
+
+	CacheKey key( qMakePair( fields.at( 0 ).toULongLong(),
+				 fields.at( 1 ).toULongLong() ),
+		      fields.at( 2 ).toLongLong() );
+
+	cache.insert( key, fields.at( 3 ) == "-" ? QString() : fields.at( 3 ) );
+    }
+
+    logInfo() << "Read " << cache.size() << " entries from " << fileName << endl;
+
+    QMutexLocker locker( &_mutex );
+    _cache.unite( cache );
+}
+
+
+void ContentSniffer::saveCache()
+{
+    QHash<CacheKey, QString> cache;
+
+    {
+	QMutexLocker locker( &_mutex );
+
+	if ( ! _cacheDirty )
+	    return;
+
+	cache	    = _cache;
+	_cacheDirty = false;
+    }
+
+    QString fileName = cacheFileName();
+
+    if ( fileName.isEmpty() )
+	return;
+
+    // Write a new file and rename it over the old one, so there is always a
+    // complete cache file even if the program is killed while writing it.
+
+    QDir().mkpath( QFileInfo( fileName ).absolutePath() );
+    QString tmpName = fileName + ".new";
+    QFile   file( tmpName );
+
+    if ( ! file.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) )
+    {
+	logWarning() << "Can't write " << tmpName << endl;
+	return;
+    }
+
+    QTextStream out( &file );
+    out << CACHE_HEADER << "\n";
+
+    // There is no useful order to drop the oldest entries, so when the cache
+    // grows too large, just drop any.
+
+    int count = 0;
+
+    for ( QHash<CacheKey, QString>::const_iterator it = cache.constBegin();
+	  it != cache.constEnd() && count < _maxCacheEntries;
+	  ++it, ++count )
+    {
+	out << it.key().first.first  << " "
+	    << it.key().first.second << " "
+	    << it.key().second	     << " "
+	    << ( it.value().isEmpty() ? QString( "-" ) : it.value() )
+	    << "\n";
+    }
+
+    out.flush();
+    file.close();
+
+    if ( out.status() != QTextStream::Ok || file.error() != QFile::NoError ||
+	 rename( QFile::encodeName( tmpName ), QFile::encodeName( fileName ) ) != 0 )
+    {
+	logWarning() << "Can't write " << fileName << endl;
+	QFile::remove( tmpName );
+	return;
+    }
+
+    logInfo() << "Wrote " << count << " entries to " << fileName << endl;
+}
+
+
+void ContentSniffer::clearing()
+{
+    cancel();
+    clearSuffixes();
+}
+
+
+void ContentSniffer::clearSuffixes()
+{
+    QMutexLocker locker( &_suffixesMutex );
+    _suffixes.clear();
+}
+
+
+void ContentSniffer::deletingChild( FileInfo * child )
+{
+    forget( child );
+}
+
+
+void ContentSniffer::clearingSubtree( DirInfo * subtree )
+{
+    // The files in that subtree are about to be read again; the cache finds
+    // them again by inode and modification time if they did not change.
+
+    forget( subtree );
+}
+
+
+void ContentSniffer::forget( FileInfo * item )
+{
+    if ( ! item || ( _suffixes.isEmpty() && _pending.isEmpty() ) )
+	return;
+
+    {
+	QMutexLocker locker( &_suffixesMutex );
+	_suffixes.remove( item );
+    }
+
+    _pending.remove( item );
+
+    FileInfoIterator it( item );
+
+    while ( *it )
+    {
+	forget( *it );
+	++it;
+    }
+
+    if ( item->attic() )
+	forget( item->attic() );
+}
+
+
+void ContentSniffer::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "ContentSniffer" );
+
+    _enabled	       = settings.value( "Enabled",	      false ).toBool();
+    _minSize	       = settings.value( "MinSizeKB",	      1024  ).toInt() * 1024LL;
+    _threads	       = settings.value( "Threads",	      1	    ).toInt();
+    _maxFilesPerSecond = settings.value( "MaxFilesPerSecond", 50    ).toInt();
+    _maxCacheEntries   = settings.value( "MaxCacheEntries",   100000 ).toInt();
+    _cacheFile	       = settings.value( "CacheFile",
+					 "~/.cache/QDirStat/content-types" ).toString();
+    settings.endGroup();
+
+    if ( _threads < 1 )
+	_threads = 1;
+}
+
+
+void ContentSniffer::writeSettings()
+{
+    Settings settings;
+    settings.beginGroup( "ContentSniffer" );
+
+    settings.setDefaultValue( "Enabled",	   _enabled			);
+    settings.setDefaultValue( "MinSizeKB",	   (int) ( _minSize / 1024 )	);
+    settings.setDefaultValue( "Threads",	   _threads			);
+    settings.setDefaultValue( "MaxFilesPerSecond", _maxFilesPerSecond		);
+    settings.setDefaultValue( "MaxCacheEntries",   _maxCacheEntries		);
+    settings.setDefaultValue( "CacheFile",	   _cacheFile			);
+
+    settings.endGroup();
+}
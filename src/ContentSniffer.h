@@ -0,0 +1,335 @@
+/*
+ *   File name: ContentSniffer.h
+ *   Summary:	Content-based file type detection for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+#ifndef ContentSniffer_h
+#define ContentSniffer_h
+
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QList>
+#include <QPair>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "FileSize.h"
+#include "TreeSnapshot.h"
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class DirInfo;
+    class FileInfo;
+
+
+    /**
+     * Detection of the type of files without a suffix that MimeCategorizer
+     * can't classify by their name, e.g. database files, core dumps or VM
+     * images: This reads the first few kB of each such file and looks for
+     * well-known magic byte signatures.
+     *
+     * The result for a file is a suffix that is typical for that file type
+     * (e.g. "qcow2" or "sqlite"); MimeCategorizer then uses the category for
+     * that suffix. So a file type is only categorized if the user's MIME
+     * categories contain that suffix.
+     *
+     * Only files above a size threshold are examined since only they make a
+     * difference in the treemap and in the statistics. They are collected in
+     * a background thread on a snapshot of the tree, and they are read in
+     * a few background threads with the idle I/O priority and without
+     * changing their access time, optionally throttled, and the results are
+     * cached in a file by device, inode and modification time, so the next
+     * program run does not need to read the same files again. Those threads
+     * might hang on a dead network mount, so nothing ever waits for them.
+     *
+     * This is disabled by default; see the "ContentSniffer" settings group.
+     *
+     * This is a singleton class.
+     **/
+    class ContentSniffer: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Return the singleton instance of this class.
+	 **/
+	static ContentSniffer * instance();
+
+	/**
+	 * Return the suffix that was detected for 'item' from its content or
+	 * an empty string if none was detected (yet). This is cheap if the
+	 * singleton was never created. It may be called in other threads
+	 * while the tree is frozen.
+	 **/
+	static QString sniffedSuffix( FileInfo * item );
+
+	/**
+	 * Watch 'tree' to forget results for items that are deleted. This
+	 * cancels any running detection. Use 0 before the tree is destroyed.
+	 **/
+	void setTree( DirTree * tree );
+
+	/**
+	 * Start the detection for all files in 'subtree' that need it.
+	 * Return 'false' if it is disabled.
+	 **/
+	bool start( FileInfo * subtree );
+
+	/**
+	 * Return 'true' if the detection is enabled in the settings.
+	 **/
+	bool isEnabled() const { return _enabled; }
+
+	/**
+	 * Return 'true' if a detection is in progress.
+	 **/
+	bool isBusy() const { return _busy; }
+
+	/**
+	 * Return the number of files that were examined in the current or
+	 * last detection.
+	 **/
+	int filesDone() const { return _filesDone; }
+
+
+    public slots:
+
+	/**
+	 * Cancel the running detection. Results that were already collected
+	 * are kept.
+	 **/
+	void cancel();
+
+	/**
+	 * Read the settings.
+	 **/
+	void readSettings();
+
+	/**
+	 * Write the settings.
+	 **/
+	void writeSettings();
+
+
+    signals:
+
+	/**
+	 * Emitted from time to time during the detection.
+	 **/
+	void progress( int filesDone, int filesTotal );
+
+	/**
+	 * Emitted when the detection is finished or cancelled.
+	 * 'found' is the number of files whose type was detected.
+	 **/
+	void finished( int found );
+
+
+    protected slots:
+
+	/**
+	 * Take over the files that need a detection from the collect job and
+	 * start the detection jobs.
+	 **/
+	void collectingFinished();
+
+	/**
+	 * Take over the results from the worker threads and start new jobs.
+	 * This is triggered by a timer while the detection is running.
+	 **/
+	void processResults();
+
+	/**
+	 * The tree is being cleared: Cancel and forget everything.
+	 **/
+	void clearing();
+
+	/**
+	 * An item is about to be deleted: Forget it and its subtree.
+	 **/
+	void deletingChild( FileInfo * child );
+
+	/**
+	 * A subtree is about to be cleared: Forget everything below it.
+	 **/
+	void clearingSubtree( DirInfo * subtree );
+
+
+    protected:
+
+	friend class SniffJob;
+	friend class SniffCollectJob;
+
+	/**
+	 * Constructor. Use instance() instead.
+	 **/
+	ContentSniffer();
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~ContentSniffer();
+
+	/**
+	 * Add all files below 'dir' that need a detection to 'items'.
+	 * This is called in a worker thread on a snapshot of the tree.
+	 **/
+	void collect( FileInfo * dir, int generation, QVector<FileInfo *> & items ) const;
+
+	/**
+	 * Store the files that the collect job found for
+	 * collectingFinished(). This is called in a worker thread.
+	 **/
+	void addCollected( int generation, const QVector<FileInfo *> & items );
+
+	/**
+	 * Return 'true' if the type of 'item' should be detected: If it is a
+	 * large enough file without a suffix that MimeCategorizer can't
+	 * classify by its name and that was not already done.
+	 **/
+	bool needsDetection( FileInfo * item ) const;
+
+	/**
+	 * Return the thread pool for reading the files. This is never
+	 * deleted: Its destructor would wait for threads that hang on a
+	 * dead mount.
+	 **/
+	QThreadPool * threadPool() const;
+
+	/**
+	 * Start new jobs for the queued files until there are enough of them.
+	 **/
+	void startJobs();
+
+	/**
+	 * Finish the detection: Write the cache and notify the world.
+	 **/
+	void finish();
+
+	/**
+	 * Forget the results for 'item' and everything below it.
+	 **/
+	void forget( FileInfo * item );
+
+	/**
+	 * Forget all results.
+	 **/
+	void clearSuffixes();
+
+	/**
+	 * Add the results of one job. This is called from the worker threads.
+	 **/
+	void addResults( int				generation,
+			 const QVector<FileInfo *> &	items,
+			 const QStringList &		suffixes );
+
+	/**
+	 * Return 'true' if jobs for 'generation' should stop.
+	 * This is called from the worker threads.
+	 **/
+	bool isCancelled( int generation ) const
+	    { return _generation.fetchAndAddOrdered( 0 ) != generation; }
+
+	/**
+	 * Key for the result cache: device and inode, modification time.
+	 **/
+	typedef QPair<QPair<quint64, quint64>, qint64> CacheKey;
+
+	/**
+	 * Look up 'key' in the cache and return 'true' if it was found.
+	 * This is called from the worker threads.
+	 **/
+	bool cached( const CacheKey & key, QString & suffix );
+
+	/**
+	 * Store the result for 'key' in the cache.
+	 * This is called from the worker threads.
+	 **/
+	void cache( const CacheKey & key, const QString & suffix );
+
+	/**
+	 * Read the cache file if that was not done yet.
+	 * This is called from the collect job.
+	 **/
+	void loadCache();
+
+	/**
+	 * Write the cache file if anything changed.
+	 **/
+	void saveCache();
+
+	/**
+	 * Return the cache file name with '~' expanded.
+	 **/
+	QString cacheFileName() const;
+
+
+	/**
+	 * Results of one job.
+	 **/
+	struct JobResults
+	{
+	    int				generation;
+	    QVector<FileInfo *>		items;
+	    QStringList			suffixes;
+	};
+
+
+	//
+	// Data members
+	//
+
+	static ContentSniffer *		_instance;
+
+	DirTree *			_tree;
+	QHash<FileInfo *, QString>	_suffixes;
+	mutable QMutex			_suffixesMutex;
+
+	// Used only in the GUI thread
+
+	bool				_busy;
+	QVector<FileInfo *>		_queue;
+	int				_queuePos;
+	QSet<FileInfo *>		_pending;
+	int				_jobsRunning;
+	int				_filesDone;
+	int				_found;
+	QTimer				_timer;
+
+	// Shared with the worker threads
+
+	mutable QAtomicInt		_generation;
+	QMutex				_mutex;
+	QList<JobResults>		_results;
+	int				_collectedGeneration;
+	QVector<FileInfo *>		_collected;
+	QHash<CacheKey, QString>	_cache;
+	bool				_cacheLoaded;
+	bool				_cacheDirty;
+
+	// Settings
+
+	bool				_enabled;
+	FileSize			_minSize;
+	int				_threads;
+	int				_maxFilesPerSecond;
+	QString				_cacheFile;
+	int				_maxCacheEntries;
+
+    };	// class ContentSniffer
+
+}	// namespace QDirStat
+
+#endif	// ContentSniffer_h
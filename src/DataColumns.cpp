@@ -69,7 +69,14 @@ const DataColumnList DataColumns::defaultColumns() const
 	    << UserCol
 	    << GroupCol
 	    << PermissionsCol
-	    << OctalPermissionsCol;
+	    << OctalPermissionsCol
+	    << ShortGrowthCol
+	    << LongGrowthCol
+	    << ATimeCol
+	    << CTimeCol
+	    << BTimeCol
+	    << CompressedSizeCol
+	    << CompressionRatioCol;
 
     return columns;
 }
@@ -145,6 +152,13 @@ QString DataColumns::toString( DataColumn col )
 	case GroupCol:			return "GroupCol";
 	case PermissionsCol:		return "PermissionsCol";
 	case OctalPermissionsCol:	return "OctalPermissionsCol";
+	case ShortGrowthCol:		return "ShortGrowthCol";
+	case LongGrowthCol:		return "LongGrowthCol";
+	case ATimeCol:			return "ATimeCol";
+	case CTimeCol:			return "CTimeCol";
+	case BTimeCol:			return "BTimeCol";
+	case CompressedSizeCol:		return "CompressedSizeCol";
+	case CompressionRatioCol:	return "CompressionRatioCol";
 	case ReadJobsCol:		return "ReadJobsCol";
 	case UndefinedCol:		return "UndefinedCol";
 
@@ -37,6 +37,13 @@ namespace QDirStat
         GroupCol,               // Group
         PermissionsCol,         // Permissions (symbolic; -rwxrxxrwx)
         OctalPermissionsCol,    // Permissions (octal; 0644)
+	ShortGrowthCol,		// Growth within the short window (GrowthHistory)
+	LongGrowthCol,		// Growth within the long  window (GrowthHistory)
+	ATimeCol,		// Last access time	  (extended timestamps only)
+	CTimeCol,		// Last status change time (extended timestamps only)
+	BTimeCol,		// Creation time	  (extended timestamps only)
+	CompressedSizeCol,	// Disk space after compression (CompressionAnalyzer)
+	CompressionRatioCol,	// Compressed size in percent of the uncompressed size
 	ReadJobsCol,		// Number of pending read jobs in subtree
 	UndefinedCol
     };
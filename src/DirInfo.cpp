@@ -9,10 +9,13 @@
 
 #include <algorithm>    // std::stable_sort()
 
+#include <QSet>
+
 #include "DirInfo.h"
 #include "DirTree.h"
 #include "DotEntry.h"
 #include "Attic.h"
+#include "SmallFileSummary.h"
 #include "FileInfoIterator.h"
 #include "FileInfoSorter.h"
 #include "FormatUtil.h"
@@ -50,9 +53,6 @@ DirInfo::DirInfo( const QString & filenameWithoutPath,
 		parent )
 {
     init();
-    ensureDotEntry();
-
-    _directChildrenCount++;	// One for the newly created dot entry
 }
 
 
@@ -70,9 +70,6 @@ DirInfo::DirInfo( DirTree *	  tree,
 		mtime )
 {
     init();
-    ensureDotEntry();
-
-    _directChildrenCount++;	// One for the newly created dot entry
 }
 
 
@@ -80,6 +77,7 @@ void DirInfo::init()
 {
     _dotEntry		 = 0;
     _attic		 = 0;
+    _smallFiles		 = 0;
     _isMountPoint	 = false;
     _isExcluded		 = false;
     _summaryDirty	 = false;
@@ -147,7 +145,13 @@ void DirInfo::clear()
 	_attic = 0;
     }
 
-    _summaryDirty = true;
+    if ( _smallFiles )
+    {
+	delete _smallFiles;
+	_smallFiles = 0;
+    }
+
+    setSummaryDirty();
     _deletingAll  = false;
     dropSortCache();
 }
@@ -155,17 +159,12 @@ void DirInfo::clear()
 
 void DirInfo::reset()
 {
-    if ( _firstChild || _dotEntry || _attic )
+    if ( _firstChild || _dotEntry || _attic || _smallFiles )
 	clear();
 
     _readState	     = DirQueued;
     _pendingReadJobs = 0;
-    _summaryDirty    = true;
-
-    ensureDotEntry();
-
-    if ( _tree )
-	_tree->childAddedNotify( _dotEntry );
+    setSummaryDirty();
 
     recalc();
     dropSortCache();
@@ -188,7 +187,9 @@ DotEntry * DirInfo::ensureDotEntry()
 
 void DirInfo::deleteEmptyDotEntry()
 {
-    if ( ! _dotEntry->firstChild() && ! _dotEntry->hasAtticChildren() )
+    if ( ! _dotEntry->firstChild()	   &&
+	 ! _dotEntry->hasAtticChildren() &&
+	 ! _dotEntry->smallFileSummary()    )
     {
 	delete _dotEntry;
 	_dotEntry = 0;
@@ -298,6 +299,25 @@ void DirInfo::recalc()
 	++it;
     }
 
+    if ( _smallFiles )
+    {
+	_totalSize	     += _smallFiles->totalSize();
+	_totalAllocatedSize  += _smallFiles->totalAllocatedSize();
+	_totalBlocks	     += _smallFiles->totalBlocks();
+	_totalItems	     += _smallFiles->count();
+	_totalFiles	     += _smallFiles->count();
+	_totalUnignoredItems += _smallFiles->count();
+
+	if ( _smallFiles->latestMtime() > _latestMtime )
+	    _latestMtime = _smallFiles->latestMtime();
+
+	if ( _smallFiles->oldestMtime() > 0 &&
+	     ( _oldestFileMtime == 0 || _smallFiles->oldestMtime() < _oldestFileMtime ) )
+	{
+	    _oldestFileMtime = _smallFiles->oldestMtime();
+	}
+    }
+
     if ( _attic )
     {
 	_totalIgnoredItems += _attic->totalIgnoredItems();
@@ -502,9 +522,11 @@ void DirInfo::insertChild( FileInfo * newChild )
     if ( newChild->isDir() || ! _dotEntry )
     {
 	/**
-	 * Only directories are stored directly in pure directory nodes -
-	 * unless something went terribly wrong, e.g. there is no dot entry to use.
-	 * If this is a dot entry, store everything it gets directly within it.
+	 * While a directory is being read, it does not have a dot entry yet,
+	 * so everything is stored directly here. Only when it is finalized
+	 * and it turns out that it has both subdirectories and files, the
+	 * files are moved to a dot entry (see cleanupDotEntries()). After
+	 * that, only directories are stored directly in this node.
 	 *
 	 * In any of those cases, insert the new child in the children list.
 	 *
@@ -564,6 +586,116 @@ void DirInfo::addToAttic( FileInfo * newChild )
 }
 
 
+void DirInfo::addSmallFile( struct stat * statInfo, const QString & category )
+{
+    CHECK_PTR( statInfo );
+
+    if ( _dotEntry )
+    {
+	_dotEntry->addSmallFile( statInfo, category );
+	return;
+    }
+
+    // Same logic as in the FileInfo constructor: If the filesystem cannot
+    // report blocks at all, use the byte size as the allocated size.
+
+    FileSize size	   = statInfo->st_size;
+    FileSize blocks	   = statInfo->st_blocks;
+    FileSize allocatedSize = blocks * STD_BLOCK_SIZE;
+
+    if ( blocks == 0 && size > 0 && ! filesystemCanReportBlocks() )
+	allocatedSize = size;
+
+    SmallFileSummary added;
+    added.add( size, allocatedSize, blocks, statInfo->st_mtime, category );
+
+    if ( ! _smallFiles )
+    {
+	_smallFiles = new SmallFileSummary();
+	CHECK_NEW( _smallFiles );
+    }
+
+    _smallFiles->add( &added );
+    smallFilesAdded( added );
+}
+
+
+void DirInfo::addSmallFiles( const SmallFileSummary & summary )
+{
+    if ( summary.isEmpty() )
+	return;
+
+    if ( _dotEntry )
+    {
+	_dotEntry->addSmallFiles( summary );
+	return;
+    }
+
+    if ( ! _smallFiles )
+    {
+	_smallFiles = new SmallFileSummary();
+	CHECK_NEW( _smallFiles );
+    }
+
+    _smallFiles->add( &summary );
+    smallFilesAdded( summary );
+}
+
+
+void DirInfo::smallFilesAdded( const SmallFileSummary & added )
+{
+    // Like in childAdded(): Don't bother updating the summary fields if they
+    // are dirty anyway.
+
+    if ( ! _summaryDirty )
+    {
+	_totalSize	    += added.totalSize();
+	_totalAllocatedSize += added.totalAllocatedSize();
+	_totalBlocks	    += added.totalBlocks();
+	_totalItems	    += added.count();
+	_totalFiles	    += added.count();
+
+	if ( added.latestMtime() > _latestMtime )
+	    _latestMtime = added.latestMtime();
+
+	if ( added.oldestMtime() > 0 &&
+	     ( _oldestFileMtime == 0 || added.oldestMtime() < _oldestFileMtime ) )
+	{
+	    _oldestFileMtime = added.oldestMtime();
+	}
+    }
+
+    _totalUnignoredItems += added.count();
+
+    if ( _lastSortCol != ReadJobsCol )
+	dropSortCache();
+
+    if ( _parent )
+	_parent->smallFilesAdded( added );
+}
+
+
+void DirInfo::takeSmallFiles( DirInfo * oldParent )
+{
+    if ( ! oldParent || ! oldParent->_smallFiles )
+	return;
+
+    if ( _smallFiles )
+    {
+	_smallFiles->add( oldParent->_smallFiles );
+	delete oldParent->_smallFiles;
+    }
+    else
+    {
+	_smallFiles = oldParent->_smallFiles;
+    }
+
+    oldParent->_smallFiles = 0;
+    oldParent->recalc();
+    setSummaryDirty();
+}
+
+
 void DirInfo::childAdded( FileInfo * newChild )
 {
     bool addToTotal = true;
@@ -682,6 +814,48 @@ void DirInfo::deletingChild( FileInfo * child )
 }
 
 
+void DirInfo::deletingChildren( const FileInfoList & deletedChildren )
+{
+    QSet<FileInfo *> deleted;
+
+    foreach ( FileInfo * child, deletedChildren )
+	deleted.insert( child );
+
+    FileInfo * prev  = 0;
+    FileInfo * child = _firstChild;
+
+    while ( child )
+    {
+	FileInfo * next = child->next();
+
+	if ( deleted.contains( child ) )
+	{
+	    if ( prev )
+		prev->setNext( next );
+	    else
+		_firstChild = next;
+	}
+	else
+	{
+	    prev = child;
+	}
+
+	child = next;
+    }
+
+    // Just like in deletingChild(), the summary fields can't simply be
+    // updated by subtracting the deleted children (think of the latest
+    // mtime), so they are recalculated only once when needed. Intentionally
+    // leaving the sort caches of the ancestors alone: Their rows in the
+    // model don't change.
+
+    dropSortCache();
+
+    for ( DirInfo * dir = this; dir; dir = dir->parent() )
+	dir->_summaryDirty = true;
+}
+
+
 void DirInfo::unlinkChild( FileInfo * deletedChild )
 {
     if ( deletedChild->parent() != this )
@@ -692,7 +866,7 @@ void DirInfo::unlinkChild( FileInfo * deletedChild )
     }
 
     dropSortCache();
-    _summaryDirty = true;
+    setSummaryDirty();
 
     if ( deletedChild == _firstChild )
     {
@@ -811,6 +985,23 @@ QString DirInfo::sizePrefix() const
 }
 
 
+void DirInfo::markAsDirty()
+{
+    for ( DirInfo * dir = this; dir; dir = dir->parent() )
+    {
+	dir->_summaryDirty = true;
+	dir->dropSortCache();
+    }
+}
+
+
+void DirInfo::setSummaryDirty()
+{
+    for ( DirInfo * dir = this; dir && ! dir->_summaryDirty; dir = dir->parent() )
+	dir->_summaryDirty = true;
+}
+
+
 void DirInfo::finalizeLocal()
 {
     // logDebug() << this << endl;
@@ -835,14 +1026,11 @@ void DirInfo::finalizeAll()
 	child = child->next();
     }
 
-    // Optimization: As long as this directory is not finalized yet, it does
-    // (very likely) have a dot entry and thus all direct children are
-    // subdirectories, not plain files, so we don't need to bother checking
-    // plain file children as well - so do finalizeLocal() only after all
-    // children are processed. If this step were the first, for directories
-    // that don't have any subdirectories finalizeLocal() would immediately
-    // get all their plain file children reparented to themselves, so they
-    // would need to be processed in the loop, too.
+    // Do finalizeLocal() only after all children are processed: This may
+    // move the plain file children of this directory to a new dot entry,
+    // and then the loop above would not see them anyway; but this way the
+    // subdirectories are already finalized, so their attics are cleaned up
+    // when this directory decides if it needs a dot entry.
 
     finalizeLocal();
 }
@@ -851,13 +1039,17 @@ void DirInfo::finalizeAll()
 void DirInfo::cleanupDotEntries()
 {
     if ( ! _dotEntry )
+    {
+	createNeededDotEntry();
 	return;
+    }
 
     // Reparent dot entry children if there are no subdirectories on this level
 
     if ( ! _firstChild && ! hasAtticChildren() )
     {
 	takeAllChildren( _dotEntry );
+	takeSmallFiles( _dotEntry );
 
 	// Reparent the dot entry's attic's children to this item's attic
 
@@ -880,6 +1072,120 @@ void DirInfo::cleanupDotEntries()
 }
 
 
+void DirInfo::createNeededDotEntry()
+{
+    // Most directories have either only files or only subdirectories, so
+    // they don't need a dot entry at all: Only create one if there are
+    // both, and move the files there. An attic never gets one; it keeps
+    // ignored files and subdirectories together.
+    //
+    // This only saves the dot entries of those other directories; the ones
+    // created here are still full DirInfo objects (see DotEntry.h).
+
+    if ( isAttic() )
+	return;
+
+    bool haveSubDirs = false;
+    bool haveFiles   = _smallFiles != 0;
+
+    for ( FileInfo * child = _firstChild; child; child = child->next() )
+    {
+	if ( child->isDir() )
+	    haveSubDirs = true;
+	else
+	    haveFiles = true;
+    }
+
+    if ( _attic )
+    {
+	// Ignored subdirectories count as subdirectories here, too
+
+	for ( FileInfo * child = _attic->firstChild(); child; child = child->next() )
+	{
+	    if ( child->isDir() )
+		haveSubDirs = true;
+	    else
+		haveFiles = true;
+	}
+    }
+
+    if ( ! haveSubDirs || ! haveFiles )
+	return;
+
+    // logDebug() << "Moving files of " << this << " to a new dot entry" << endl;
+
+    ensureDotEntry();
+    _dotEntry->takeFileChildren( this );
+    _dotEntry->takeSmallFiles( this );
+
+    // Ignored files go to the dot entry's attic, ignored subdirectories
+    // remain in this directory's attic.
+
+    if ( _attic )
+    {
+	_dotEntry->ensureAttic()->takeFileChildren( _attic );
+	_dotEntry->deleteEmptyAttic();
+
+	deleteEmptyAttic();
+    }
+
+    _directChildrenCount = -1;
+    setSummaryDirty();
+    dropSortCache();
+
+    // Anything that refers to the old structure is outdated now
+
+    if ( _tree )
+	_tree->childrenMovedNotify();
+}
+
+
+void DirInfo::takeFileChildren( DirInfo * oldParent )
+{
+    FileInfo * child	 = oldParent->firstChild();
+    FileInfo * prevChild = 0;
+    bool       moved	 = false;
+
+    while ( child )
+    {
+	FileInfo * nextChild = child->next();
+
+	if ( child->isDir() )
+	{
+	    prevChild = child;
+	}
+	else
+	{
+	    // Unlink the child from the old parent's children list
+
+	    if ( prevChild )
+		prevChild->setNext( nextChild );
+	    else
+		oldParent->setFirstChild( nextChild );
+
+	    // Insert it at the head of the children list here
+
+	    child->setNext( _firstChild );
+	    child->setParent( this );
+	    _firstChild = child;
+	    moved	= true;
+	}
+
+	child = nextChild;
+    }
+
+    if ( moved && _tree )
+	_tree->childrenMovedNotify();
+
+    oldParent->_directChildrenCount = -1;
+    oldParent->setSummaryDirty();
+    oldParent->dropSortCache();
+
+    _directChildrenCount = -1;
+    setSummaryDirty();
+}
+
+
 void DirInfo::cleanupAttics()
 {
     if ( _dotEntry )
@@ -897,7 +1203,7 @@ void DirInfo::cleanupAttics()
 	    if ( _lastIncludeAttic )
 		dropSortCache();
 
-	    _summaryDirty = true;
+	    setSummaryDirty();
 	}
     }
 }
@@ -935,7 +1241,7 @@ void DirInfo::ignoreEmptySubDirs()
 	    {
 		// logDebug() << "Ignoring empty subdir " << (*it) << endl;
 		(*it)->setIgnored( true );
-		_summaryDirty = true;
+		setSummaryDirty();
 	    }
 	}
 
@@ -976,20 +1282,33 @@ const FileInfoList & DirInfo::sortedChildren( DataColumn    sortCol,
 					      Qt::SortOrder sortOrder,
 					      bool	    includeAttic )
 {
-    if ( _sortedChildren &&
-	 sortCol      == _lastSortCol	   &&
-	 sortOrder    == _lastSortOrder	   &&
-	 includeAttic == _lastIncludeAttic    )
+    if ( ! hasSortCache( sortCol, sortOrder, includeAttic ) )
     {
-	return *_sortedChildren;
+	setSortedChildren( createSortedChildren( sortCol, sortOrder, includeAttic ),
+			   sortCol, sortOrder, includeAttic );
     }
 
+    return *_sortedChildren;
+}
 
-    // Clean old sorted children list and create a new one
 
-    dropSortCache( true ); // recursive
-    _sortedChildren = new FileInfoList();
-    CHECK_NEW( _sortedChildren );
+bool DirInfo::hasSortCache( DataColumn	  sortCol,
+			    Qt::SortOrder sortOrder,
+			    bool	  includeAttic ) const
+{
+    return _sortedChildren &&
+	sortCol	     == _lastSortCol	  &&
+	sortOrder    == _lastSortOrder	  &&
+	includeAttic == _lastIncludeAttic;
+}
+
+
+FileInfoList * DirInfo::createSortedChildren( DataColumn    sortCol,
+					      Qt::SortOrder sortOrder,
+					      bool	    includeAttic )
+{
+    FileInfoList * sortedChildren = new FileInfoList();
+    CHECK_NEW( sortedChildren );
 
 
     // Populate with unsorted children list
@@ -998,12 +1317,12 @@ const FileInfoList & DirInfo::sortedChildren( DataColumn    sortCol,
 
     while ( child )
     {
-	_sortedChildren->append( child );
+	sortedChildren->append( child );
 	child = child->next();
     }
 
     if ( _dotEntry )
-	_sortedChildren->append( _dotEntry );
+	sortedChildren->append( _dotEntry );
 
 
     // Sort
@@ -1014,40 +1333,53 @@ const FileInfoList & DirInfo::sortedChildren( DataColumn    sortCol,
     {
 	// Do secondary sorting by NameCol (always in ascending order)
 
-	std::stable_sort( _sortedChildren->begin(),
-			  _sortedChildren->end(),
+	std::stable_sort( sortedChildren->begin(),
+			  sortedChildren->end(),
 			  FileInfoSorter( NameCol, Qt::AscendingOrder ) );
     }
 
 
     // Primary sorting by sortCol ascending or descending (as specified in sortOrder)
 
-    std::stable_sort( _sortedChildren->begin(),
-		      _sortedChildren->end(),
+    std::stable_sort( sortedChildren->begin(),
+		      sortedChildren->end(),
 		      FileInfoSorter( sortCol, sortOrder ) );
 
     if ( includeAttic && _attic )
-	_sortedChildren->append( _attic );
-
-    _lastSortCol      = sortCol;
-    _lastSortOrder    = sortOrder;
-    _lastIncludeAttic = includeAttic;
+	sortedChildren->append( _attic );
 
 
 #if DIRECT_CHILDREN_COUNT_SANITY_CHECK
 
-    if ( _sortedChildren->size() != _directChildrenCount )
+    if ( sortedChildren->size() != _directChildrenCount )
     {
-	Debug::dumpChildrenList( this, *_sortedChildren );
+	Debug::dumpChildrenList( this, *sortedChildren );
 
 	THROW( Exception( QString( "_directChildrenCount of %1 corrupted; is %2, should be %3" )
 			  .arg( debugUrl() )
 			  .arg( _directChildrenCount )
-			  .arg( _sortedChildren->size() ) ) );
+			  .arg( sortedChildren->size() ) ) );
     }
 #endif
 
-    return *_sortedChildren;
+    return sortedChildren;
+}
+
+
+void DirInfo::setSortedChildren( FileInfoList * sortedChildren,
+				 DataColumn	sortCol,
+				 Qt::SortOrder	sortOrder,
+				 bool		includeAttic )
+{
+    // Clean old sorted children list: The ones of the subtree are sorted
+    // in the old way, too
+
+    dropSortCache( true ); // recursive
+
+    _sortedChildren   = sortedChildren;
+    _lastSortCol      = sortCol;
+    _lastSortOrder    = sortOrder;
+    _lastIncludeAttic = includeAttic;
 }
 
 
@@ -1132,7 +1464,7 @@ void DirInfo::takeAllChildren( DirInfo * oldParent )
 	oldParent->recalc();
 
 	_directChildrenCount = -1;
-	_summaryDirty	     = true;
+	setSummaryDirty();
 
 	while ( child )
 	{
@@ -20,6 +20,7 @@ namespace QDirStat
     // Forward declarations
     class DirTree;
     class DotEntry;
+    class SmallFileSummary;
 
     /**
      * A more specialized version of FileInfo: This class can actually manage
@@ -61,9 +62,11 @@ namespace QDirStat
 	/**
 	 * Default constructor.
 	 *
-	 * This is the only constructor that will not create a dot entry
-	 * immediately. If that is desired, you can always use ensureDotEntry()
-	 * later.
+	 * None of the constructors creates a dot entry: Files are stored
+	 * directly in the directory while it is being read, and they are only
+	 * moved to a dot entry in finalizeLocal() if the directory also has
+	 * subdirectories. If a dot entry is needed earlier, use
+	 * ensureDotEntry().
 	 **/
 	DirInfo( DirTree * tree,
 		 DirInfo * parent = 0 );
@@ -336,6 +339,29 @@ namespace QDirStat
 	 **/
 	bool hasAtticChildren() const;
 
+	/**
+	 * Return the summary of small files that were aggregated in this
+	 * directory during reading rather than stored as individual FileInfo
+	 * children, or 0 if there is none.
+	 **/
+	const SmallFileSummary * smallFileSummary() const { return _smallFiles; }
+
+	/**
+	 * Add a small file to the small file summary rather than creating a
+	 * FileInfo child for it. Like with insertChild(), it is added to the
+	 * dot entry instead if there is one. 'category' is the name of the
+	 * MimeCategory of that file or empty if it is unclassified.
+	 **/
+	void addSmallFile( struct stat * statInfo,
+			   const QString & category = QString() );
+
+	/**
+	 * Add a complete small file summary, e.g. from a cache file. Like
+	 * with insertChild(), it is added to the dot entry instead if there
+	 * is one.
+	 **/
+	void addSmallFiles( const SmallFileSummary & summary );
+
 	/**
 	 * Notification that a child has been added somewhere in the subtree.
 	 *
@@ -363,6 +389,15 @@ namespace QDirStat
 	 **/
 	virtual void deletingChild( FileInfo * deletedChild ) Q_DECL_OVERRIDE;
 
+	/**
+	 * Notification that the direct children 'deletedChildren' are about
+	 * to be deleted all at once: Unlink them from the children list in a
+	 * single pass and mark the summaries of this directory and all its
+	 * ancestors as dirty.
+	 * This is much faster than deletingChild() for each one of them.
+	 **/
+	void deletingChildren( const FileInfoList & deletedChildren );
+
 	/**
 	 * Notification of a new directory read job somewhere in the subtree.
 	 **/
@@ -452,6 +487,38 @@ namespace QDirStat
 					     Qt::SortOrder sortOrder,
 					     bool	   includeAttic = false );
 
+	/**
+	 * Return 'true' if the cached result of sortedChildren() is up to
+	 * date for these parameters.
+	 **/
+	bool hasSortCache( DataColumn	 sortCol,
+			   Qt::SortOrder sortOrder,
+			   bool		 includeAttic = false ) const;
+
+	/**
+	 * Return a new list of the (direct) children sorted like
+	 * sortedChildren() does, but without using or changing the sort
+	 * cache. The caller takes ownership of the list.
+	 *
+	 * This only reads the tree, so it can be used from a worker thread
+	 * while the tree is frozen (see TreeSnapshot) if the summary fields
+	 * are up to date.
+	 **/
+	FileInfoList * createSortedChildren( DataColumn	   sortCol,
+					     Qt::SortOrder sortOrder,
+					     bool	   includeAttic = false );
+
+	/**
+	 * Use 'sortedChildren' (from createSortedChildren() with the same
+	 * parameters) as the sort cache. This takes ownership of the list and
+	 * drops the sort caches of the subtree. Use this only in the GUI
+	 * thread.
+	 **/
+	void setSortedChildren( FileInfoList * sortedChildren,
+				DataColumn     sortCol,
+				Qt::SortOrder  sortOrder,
+				bool	       includeAttic = false );
+
 	/**
 	 * Drop all cached information about children sorting.
 	 **/
@@ -554,6 +621,12 @@ namespace QDirStat
 	 **/
 	void recalc();
 
+	/**
+	 * Mark the summary fields of this directory and all its ancestors as
+	 * outdated, e.g. after its own size was changed.
+	 **/
+	void markAsDirty();
+
         /**
          * Return 'true' if this child is a dominant one among its siblings,
          * i.e. if its total size is much larger than the other items on the
@@ -571,9 +644,25 @@ namespace QDirStat
 	 * Delete dot entries that don't have any children,
 	 * reparent dot entry children to the "real" (parent) directory if
 	 * there are not subdirectory siblings at the level of the dot entry.
+	 *
+	 * If there is no dot entry yet, create one if it is needed (see
+	 * createNeededDotEntry()).
 	 **/
 	virtual void cleanupDotEntries();
 
+	/**
+	 * Create a dot entry if this directory has both subdirectories and
+	 * files, and move the files (including small files and ignored files)
+	 * there.
+	 **/
+	void createNeededDotEntry();
+
+	/**
+	 * Take all non-directory children from 'oldParent' and move them to
+	 * this DirInfo. Directory children remain where they are.
+	 **/
+	void takeFileChildren( DirInfo * oldParent );
+
 	/**
 	 * Clean up unneeded attics: Delete attic entries that don't have any
 	 * children.
@@ -585,6 +674,30 @@ namespace QDirStat
          **/
         void findDominantChildren();
 
+	/**
+	 * Mark the summary fields of this directory as outdated, and those of
+	 * all its ancestors that are not marked yet.
+	 *
+	 * This keeps up the rule that the ancestors of a directory with a
+	 * dirty summary are dirty, too, so recalc() (which cascades down
+	 * into all dirty children) leaves nothing dirty in the subtree, and
+	 * a directory with a clean summary has a clean subtree.
+	 **/
+	void setSummaryDirty();
+
+	/**
+	 * Notification that small files have been added to a small file
+	 * summary somewhere in the subtree. 'added' contains only the
+	 * newly added files. This is cascaded upward in the tree.
+	 **/
+	void smallFilesAdded( const SmallFileSummary & added );
+
+	/**
+	 * Take over the small file summary of 'oldParent' and merge it with
+	 * this directory's own summary.
+	 **/
+	void takeSmallFiles( DirInfo * oldParent );
+
 
 	//
 	// Data members
@@ -603,6 +716,7 @@ namespace QDirStat
 	FileInfo *	_firstChild;		// pointer to the first child
 	DotEntry *	_dotEntry;		// pseudo entry to hold non-dir children
 	Attic	 *	_attic;			// pseudo entry to hold ignored children
+	SmallFileSummary * _smallFiles;		// aggregated small files (usually 0)
 
 	// Some cached values
 
@@ -7,24 +7,37 @@
  */
 
 
-#include <dirent.h>     // struct dirent
-#include <fcntl.h>	// AT_ constants (fstatat() flags)
-#include <unistd.h>     // R_OK, X_OK
+#include <errno.h>
+#include <sys/stat.h>
 
 #include <QMutableListIterator>
 #include <QMultiMap>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
 
 #include "DirReadJob.h"
 #include "DirTree.h"
 #include "DirInfo.h"
 #include "DirTreeCache.h"
 #include "ExcludeRules.h"
+#include "FileSystemAccess.h"
+#include "MimeCategorizer.h"
 #include "MountPoints.h"
 #include "Exception.h"
 
 #define DONT_TRUST_NTFS_HARD_LINKS      1
 #define VERBOSE_NTFS_HARD_LINKS         0
 
+// Interval for checking for a timeout while waiting for the worker thread
+#define SCAN_WAIT_CHECK_MILLISEC	100
+
+// Maximum number of additional threads for threads that hang on a dead mount
+#define SCAN_MAX_HUNG_THREADS		8
+
+// Number of directory entries read between two progress updates
+#define SCAN_PROGRESS_ENTRIES		256
+
 using namespace QDirStat;
 
 
@@ -191,6 +204,283 @@ bool DirReadJob::shouldCrossIntoFilesystem( const DirInfo * dir ) const
 
 
 
+namespace QDirStat
+{
+    /**
+     * The state of reading one local directory in a worker thread. This is
+     * shared between the LocalDirReadJob and its LocalDirScanTask, so
+     * either one may go away first: The job when it gives up waiting or is
+     * killed, the task when it is finished.
+     **/
+    class LocalDirScan
+    {
+    public:
+
+	struct Entry
+	{
+	    QString	name;
+	    struct stat statInfo;
+	    time_t	btime;
+	    int		result;		// 0 or -1 for an error
+	    int		error;		// errno if 'result' is -1
+	};
+
+	LocalDirScan( const QString & dirName, bool wantBtime, DirReadJobQueue * queue ):
+	    dirName( dirName ),
+	    wantBtime( wantBtime ),
+	    queue( queue ),
+	    readState( DirReading ),
+	    done( false ),
+	    abandoned( false ),
+	    running( false ),
+	    hung( false ),
+	    progress( 0 )
+	    {}
+
+	const QString	dirName;
+	const bool	wantBtime;
+
+	// Everything below is protected by 'mutex'
+
+	QMutex		mutex;
+	DirReadJobQueue * queue;	// to wake up; 0 when the job is gone
+	DirReadState	readState;	// DirPermissionDenied or DirError if the dir can't be opened
+	bool		done;
+	bool		abandoned;	// the job is no longer interested
+	bool		running;	// the task is in a pool thread right now
+	bool		hung;		// counted in the hung threads of the pool
+	QList<Entry>	entries;	// not yet picked up by the job
+	QString		currentPath;	// the system call in progress is for this
+	int		progress;	// completed system calls
+    };
+
+
+    /**
+     * The worker that does all system calls for reading one local directory
+     * in a thread of its own, so a hanging filesystem can only block that
+     * thread, not the whole application.
+     **/
+    class LocalDirScanTask: public QRunnable
+    {
+    public:
+
+	LocalDirScanTask( QSharedPointer<LocalDirScan> scan, FileSystemAccess * fs ):
+	    _scan( scan ),
+	    _fs( fs )
+	    {}
+
+	virtual void run() Q_DECL_OVERRIDE;
+
+    protected:
+
+	/**
+	 * Do all the system calls for reading the directory.
+	 **/
+	void scan();
+
+	/**
+	 * Note that a system call for 'path' is about to start after 'done'
+	 * system calls. Return 'false' if the job is no longer interested.
+	 **/
+	bool progress( const QString & path, int done = 1 );
+
+	/**
+	 * Tell the job that everything is read.
+	 **/
+	void finish( DirReadState readState );
+
+	/**
+	 * Wake up the job's queue if the job is still there. The mutex has to
+	 * be locked: The job clears the queue under the mutex before it goes
+	 * away, and the queue deletes its jobs before it goes away.
+	 **/
+	void wakeUpJob();
+
+	QSharedPointer<LocalDirScan>	_scan;
+	FileSystemAccess *		_fs;
+    };
+
+}	// namespace QDirStat
+
+
+/**
+ * Return the thread pool for reading local directories. This is
+ * intentionally never deleted: A thread might hang forever in a system call
+ * on a dead mount, and the destructor of a QThreadPool would wait for it.
+ **/
+static QThreadPool * dirReadThreadPool()
+{
+    static QThreadPool * threadPool = 0;
+
+    if ( ! threadPool )
+    {
+	threadPool = new QThreadPool();
+	CHECK_NEW( threadPool );
+	threadPool->setMaxThreadCount( 1 );
+    }
+
+    return threadPool;
+}
+
+
+static QMutex hungScanThreadsMutex;
+static int    hungScanThreads = 0;
+
+/**
+ * Add 'delta' to the number of threads of the pool that hang on a dead
+ * mount and make room for that many more threads, up to
+ * SCAN_MAX_HUNG_THREADS, so there is always one for the next directory.
+ * This is called from the main thread and from the pool threads.
+ **/
+static void adjustHungScanThreads( int delta )
+{
+    QMutexLocker locker( &hungScanThreadsMutex );
+
+    hungScanThreads += delta;
+    dirReadThreadPool()->setMaxThreadCount( 1 + qMin( hungScanThreads, SCAN_MAX_HUNG_THREADS ) );
+}
+
+
+/**
+ * Count the thread of 'scan' as hung if its task is still in a system
+ * call. The scan's mutex has to be locked.
+ **/
+static void markScanHung( LocalDirScan * scan )
+{
+    if ( scan->running && ! scan->hung )
+    {
+	scan->hung = true;
+	adjustHungScanThreads( +1 );
+    }
+}
+
+
+void LocalDirScanTask::run()
+{
+    {
+	QMutexLocker locker( &_scan->mutex );
+	_scan->running = true;
+    }
+
+    scan();
+
+    // If the job gave up on this thread, it was counted as hung; it is
+    // available again now.
+
+    QMutexLocker locker( &_scan->mutex );
+    _scan->running = false;
+
+    if ( _scan->hung )
+    {
+	_scan->hung = false;
+	adjustHungScanThreads( -1 );
+    }
+}
+
+
+void LocalDirScanTask::scan()
+{
+    const QString & dirName = _scan->dirName;
+
+    if ( ! progress( dirName, 0 ) )
+	return;
+
+    bool	    canRead = _fs->canRead( dirName );
+    FileSystemDir * dir	    = canRead ? _fs->openDir( dirName ) : 0;
+
+    if ( ! dir )
+    {
+	finish( canRead ? DirError : DirPermissionDenied );
+	return;
+    }
+
+    QMultiMap<ino_t, QString> entryMap;
+    QString name;
+    ino_t   ino;
+
+    while ( dir->readEntry( name, ino ) )
+    {
+	entryMap.insert( ino, name );
+
+	if ( entryMap.size() % SCAN_PROGRESS_ENTRIES == 0 && ! progress( dirName ) )
+	{
+	    delete dir;
+	    return;
+	}
+    }
+
+    // QMultiMap (just like QMap) guarantees sort order by keys, so we are
+    // now iterating over the directory entries by i-number order. Most
+    // filesystems will benefit from that since they store i-nodes sorted
+    // by i-number on disk, so (at least with rotational disks) seek times
+    // are minimized by this strategy.
+    //
+    // Notice that we need a QMultiMap, not just a map: If a file has
+    // multiple hard links in the same directory, a QMap would store only
+    // one of them, all others would go missing in the DirTree.
+
+    QString prefix = dirName == "/" ? dirName : dirName + "/";
+    LocalDirScan::Entry entry;
+
+    foreach ( const QString & entryName, entryMap )
+    {
+	if ( ! progress( prefix + entryName ) )
+	{
+	    delete dir;
+	    return;
+	}
+
+	entry.name   = entryName;
+	entry.btime  = 0;
+	entry.result = dir->statEntry( entryName, &entry.statInfo,
+				       _scan->wantBtime ? &entry.btime : 0 );
+	entry.error  = entry.result == 0 ? 0 : errno;
+
+	QMutexLocker locker( &_scan->mutex );
+	_scan->entries << entry;
+
+	// Only the first entry since the job picked them up the last time
+	// needs to wake it up.
+
+	if ( _scan->entries.size() == 1 )
+	    wakeUpJob();
+    }
+
+    delete dir;
+    finish( DirFinished );
+}
+
+
+bool LocalDirScanTask::progress( const QString & path, int done )
+{
+    QMutexLocker locker( &_scan->mutex );
+
+    _scan->progress   += done;
+    _scan->currentPath = path;
+
+    return ! _scan->abandoned;
+}
+
+
+void LocalDirScanTask::finish( DirReadState readState )
+{
+    QMutexLocker locker( &_scan->mutex );
+
+    _scan->readState = readState;
+    _scan->done	     = true;
+    wakeUpJob();
+}
+
+
+void LocalDirScanTask::wakeUpJob()
+{
+    if ( _scan->queue )
+	QMetaObject::invokeMethod( _scan->queue, "wakeUp", Qt::QueuedConnection );
+}
+
+
+
+
 bool LocalDirReadJob::_warnedAboutNtfsHardLinks = false;
 
 
@@ -198,8 +488,10 @@ LocalDirReadJob::LocalDirReadJob( DirTree * tree,
 				  DirInfo * dir ):
     DirReadJob( tree, dir ),
     _applyFileChildExcludeRules( false ),
+    _aggregateSmallFiles( true ),
     _checkedForNtfs( false ),
-    _isNtfs( false )
+    _isNtfs( false ),
+    _lastProgress( 0 )
 {
     if ( _dir )
 	_dirName = _dir->url();
@@ -208,145 +500,227 @@ LocalDirReadJob::LocalDirReadJob( DirTree * tree,
 
 LocalDirReadJob::~LocalDirReadJob()
 {
-    // NOP
+    if ( _scan )
+    {
+	// The worker thread might still be busy (or even hanging); just tell
+	// it that nobody is interested in the result anymore. Until it
+	// notices, its thread is lost for reading other directories.
+
+	QMutexLocker locker( &_scan->mutex );
+	_scan->abandoned = true;
+	_scan->queue	 = 0;
+	markScanHung( _scan.data() );
+    }
 }
 
 
-void LocalDirReadJob::startReading()
+void LocalDirReadJob::read()
 {
-    struct dirent * entry;
-    struct stat	    statInfo;
-    QString	    defaultCacheName = DEFAULT_CACHE_NAME;
-    DIR *	    diskDir;
+    if ( ! _started )
+    {
+	_started = true;
+	startReading();
+    }
+    else
+    {
+	processScanResults();
+    }
+
+    // Don't do anything after this - this job might already be deleted
+}
 
-    // logDebug() << _dir << endl;
 
-    bool ok = true;
+void LocalDirReadJob::startReading()
+{
+    // logDebug() << _dir << endl;
 
-    if ( access( _dirName.toUtf8(), X_OK | R_OK ) != 0 )
+    if ( _tree->isQuarantined( _dirName ) )
     {
-	ok = false;
-	logWarning() << "No permission to read directory " << _dirName << endl;
-	finishReading( _dir, DirPermissionDenied );
+	logWarning() << "Not reading " << _dirName << " on a hanging mount" << endl;
+	finishReading( _dir, DirError );
+	finished();
+	return;
     }
 
-    if ( ok )
-    {
-	diskDir = ::opendir( _dirName.toUtf8() );
+    _dir->setReadState( DirReading );
 
-	if ( ! diskDir )
-	{
-	    logWarning() << "opendir(" << _dirName << ") failed" << endl;
-	    ok = false;
-	    // opendir() doesn't set 'errno' according to POSIX	 :-(
-	    finishReading( _dir, DirError );
-	}
-    }
+    _scan = QSharedPointer<LocalDirScan>( new LocalDirScan( _dirName, _tree->extTimeStore() != 0, _queue ) );
+    CHECK_NEW( _scan.data() );
 
-    if ( ok )
-    {
-	_dir->setReadState( DirReading );
-	int dirFd = dirfd( diskDir );
-	int flags = AT_SYMLINK_NOFOLLOW;
+    LocalDirScanTask * task = new LocalDirScanTask( _scan, FileSystemAccess::instance() );
+    CHECK_NEW( task );
 
-#ifdef AT_NO_AUTOMOUNT
-	flags |= AT_NO_AUTOMOUNT;
-#endif
+    // Threads hanging on a dead mount are lost until their system call
+    // returns; the pool makes room for one more for each of them (see
+    // markScanHung()), but not without limit. If too many of them hang,
+    // the task waits in the pool until one comes back or the job times out.
 
-	QMultiMap<ino_t, QString> entryMap;
+    dirReadThreadPool()->start( task );
 
-	while ( ( entry = readdir( diskDir ) ) )
-	{
-	    QString entryName = QString::fromUtf8( entry->d_name );
+    _lastProgress = 0;
+    _watchdog.start();
 
-	    if ( entryName != "."  &&
-		 entryName != ".."   )
-	    {
-		entryMap.insert( entry->d_ino, entryName );
-	    }
-	}
+    processScanResults();
+    // Don't add anything after this - this job might already be deleted
+}
 
-	// QMultiMap (just like QMap) guarantees sort order by keys, so we are
-	// now iterating over the directory entries by i-number order. Most
-	// filesystems will benefit from that since they store i-nodes sorted
-	// by i-number on disk, so (at least with rotational disks) seek times
-	// are minimized by this strategy.
-	//
-	// Notice that we need a QMultiMap, not just a map: If a file has
-	// multiple hard links in the same directory, a QMap would store only
-	// one of them, all others would go missing in the DirTree.
 
-	foreach ( QString entryName, entryMap )
+void LocalDirReadJob::processScanResults()
+{
+    QList<LocalDirScan::Entry> entries;
+    DirReadState scanState;
+    bool	 done;
+    int		 progress;
+    QString	 stuckPath;
+
+    {
+	// Never wait for the worker thread here; it wakes up the queue when
+	// there is something new.
+
+	QMutexLocker locker( &_scan->mutex );
+
+	entries.swap( _scan->entries );
+	scanState = _scan->readState;
+	done	  = _scan->done;
+	progress  = _scan->progress;
+	stuckPath = _scan->currentPath;
+    }
+
+    QString defaultCacheName = DEFAULT_CACHE_NAME;
+
+    foreach ( LocalDirScan::Entry entry, entries )
+    {
+	QString	      entryName = entry.name;
+	struct stat & statInfo	= entry.statInfo;
+	time_t	      btime	= entry.btime;
+
+	if ( entry.result == 0 )	// OK?
 	{
-	    if ( fstatat( dirFd, entryName.toUtf8(), &statInfo, flags ) == 0 )	// OK?
+	    if ( S_ISDIR( statInfo.st_mode ) )	// directory child?
 	    {
-		if ( S_ISDIR( statInfo.st_mode ) )	// directory child?
-		{
-		    DirInfo *subDir = new DirInfo( entryName, &statInfo, _tree, _dir );
-		    CHECK_NEW( subDir );
+		DirInfo *subDir = new DirInfo( entryName, &statInfo, _tree, _dir );
+		CHECK_NEW( subDir );
 
-		    processSubDir( entryName, subDir );
+		if ( btime )
+		    subDir->setBtime( btime );
 
-		}
-		else  // non-directory child
+		processSubDir( entryName, subDir );
+
+	    }
+	    else  // non-directory child
+	    {
+		if ( entryName == defaultCacheName )	// .qdirstat.cache.gz found?
 		{
-		    if ( entryName == defaultCacheName )	// .qdirstat.cache.gz found?
-		    {
-			logDebug() << "Found cache file " << defaultCacheName << endl;
+		    logDebug() << "Found cache file " << defaultCacheName << endl;
 
-			// Try to read the cache file. If that was successful and the toplevel
-			// path in that cache file matches the path of the directory we are
-			// reading right now, the directory is finished reading, the read job
-			// (this object) was just deleted, and we may no longer access any
-			// member variables; just return.
+		    // Try to read the cache file. If that was successful and the toplevel
+		    // path in that cache file matches the path of the directory we are
+		    // reading right now, the directory is finished reading, the read job
+		    // (this object) was just deleted, and we may no longer access any
+		    // member variables; just return.
 
-			if ( readCacheFile( entryName ) )
-			    return;
-		    }
+		    if ( readCacheFile( entryName ) )
+			return;
+		}
 
 #if DONT_TRUST_NTFS_HARD_LINKS
 
-                    if ( statInfo.st_nlink > 1 && isNtfs() )
-                    {
-                        // NTFS seems to return bogus hard link counts; use 1 instead.
-                        // See  https://github.com/shundhammer/qdirstat/issues/88
+                if ( statInfo.st_nlink > 1 && isNtfs() )
+                {
+                    // NTFS seems to return bogus hard link counts; use 1 instead.
+                    // See  https://github.com/shundhammer/qdirstat/issues/88
 
 #if ! VERBOSE_NTFS_HARD_LINKS
-                        if ( ! _warnedAboutNtfsHardLinks )
+                    if ( ! _warnedAboutNtfsHardLinks )
 #endif
-                        {
-                            logWarning() << "Not trusting NTFS with hard links: \""
-                                         << _dir->url() << "/" << entryName
-                                         << "\" links: " << statInfo.st_nlink
-                                         << " -> resetting to 1"
-                                         << endl;
-                            _warnedAboutNtfsHardLinks = true;
-                        }
-
-                        statInfo.st_nlink = 1;
+                    {
+                        logWarning() << "Not trusting NTFS with hard links: \""
+                                     << _dir->url() << "/" << entryName
+                                     << "\" links: " << statInfo.st_nlink
+                                     << " -> resetting to 1"
+                                     << endl;
+                        _warnedAboutNtfsHardLinks = true;
                     }
+
+                    statInfo.st_nlink = 1;
+                }
 #endif
-		    FileInfo * child = new FileInfo( entryName, &statInfo, _tree, _dir );
-		    CHECK_NEW( child );
-
-		    if ( checkIgnoreFilters( entryName ) )
-		    {
-			// logDebug() << "Ignoring " << child << endl;
-			_dir->addToAttic( child );
-		    }
-		    else
-			_dir->insertChild( child );
-
-		    childAdded( child );
+		if ( isAggregatedSmallFile( entryName, &statInfo ) )
+		{
+		    MimeCategory * category = MimeCategorizer::instance()->category( entryName );
+		    _dir->addSmallFile( &statInfo, category ? category->name() : QString() );
+		    continue;
 		}
+
+		FileInfo * child = new FileInfo( entryName, &statInfo, _tree, _dir );
+		CHECK_NEW( child );
+
+		if ( btime )
+		    child->setBtime( btime );
+
+		if ( checkIgnoreFilters( entryName ) )
+		{
+		    // logDebug() << "Ignoring " << child << endl;
+		    _dir->addToAttic( child );
+		}
+		else
+		    _dir->insertChild( child );
+
+		childAdded( child );
 	    }
-	    else  // lstat() error
+	}
+	else  // lstat() error
+	{
+	    errno = entry.error;
+	    handleLstatError( entryName );
+	}
+    }
+
+    if ( ! done )
+    {
+	int timeoutSec = _tree->readTimeoutSec();
+
+	if ( progress != _lastProgress )
+	{
+	    _lastProgress = progress;
+	    _watchdog.restart();
+	}
+	else if ( timeoutSec > 0 && _watchdog.elapsed() > timeoutSec * 1000LL )
+	{
+	    logWarning() << "Timeout reading " << _dirName << ": No progress for "
+			 << timeoutSec << " sec in " << stuckPath << endl;
+
 	    {
-		handleLstatError( entryName );
+		QMutexLocker locker( &_scan->mutex );
+		markScanHung( _scan.data() );
 	    }
+
+	    _tree->readTimedOut( _dirName, stuckPath );
+	    finishReading( _dir, DirError );
+	    finished();
+
+	    return;
 	}
 
-	closedir( diskDir );
+	if ( entries.isEmpty() && _queue )
+	    _queue->jobWaiting();
+
+	return;
+    }
+
+    if ( scanState == DirPermissionDenied )
+    {
+	logWarning() << "No permission to read directory " << _dirName << endl;
+	finishReading( _dir, DirPermissionDenied );
+    }
+    else if ( scanState == DirError )
+    {
+	// opendir() doesn't set 'errno' according to POSIX  :-(
+	logWarning() << "opendir(" << _dirName << ") failed" << endl;
+	finishReading( _dir, DirError );
+    }
+    else
+    {
 	DirReadState readState = DirFinished;
 
 	//
@@ -455,6 +829,37 @@ bool LocalDirReadJob::checkIgnoreFilters( const QString & entryName ) const
 }
 
 
+bool LocalDirReadJob::isAggregatedSmallFile( const QString & entryName,
+					      struct stat   * statInfo ) const
+{
+    if ( ! _aggregateSmallFiles || _tree->smallFileThreshold() <= 0 )
+	return false;
+
+    if ( ! S_ISREG( statInfo->st_mode )				||
+	 statInfo->st_size >= _tree->smallFileThreshold()	||
+	 statInfo->st_nlink > 1 )	// Hard links need individual treatment
+    {
+	return false;
+    }
+
+    // Files that are ignored by a filter go to the attic as FileInfo nodes
+
+    if ( checkIgnoreFilters( entryName ) )
+	return false;
+
+    // Files that might make an exclude rule match must remain visible for
+    // ExcludeRules::matchDirectChildren() after the directory is read.
+
+    if ( _applyFileChildExcludeRules &&
+	 ExcludeRules::instance()->matchDirectChild( entryName ) )
+    {
+	return false;
+    }
+
+    return true;
+}
+
+
 bool LocalDirReadJob::readCacheFile( const QString & cacheFileName )
 {
     QString cacheFullName = fullName( cacheFileName );
@@ -567,7 +972,7 @@ FileInfo * LocalDirReadJob::stat( const QString & url,
     struct stat statInfo;
     // logDebug() << "url: \"" << url << "\"" << endl;
 
-    if ( lstat( url.toUtf8(), &statInfo ) == 0 ) // lstat() OK
+    if ( FileSystemAccess::instance()->lstat( url, &statInfo ) == 0 ) // lstat() OK
     {
 	QString name = url;
 
@@ -718,6 +1123,7 @@ void CacheReadJob::read()
 
 DirReadJobQueue::DirReadJobQueue()
     : QObject()
+    , _paused( false )
 {
     connect( &_timer, SIGNAL( timeout() ),
 	     this,    SLOT  ( timeSlicedRead() ) );
@@ -737,7 +1143,7 @@ void DirReadJobQueue::enqueue( DirReadJob * job )
 	_queue.append( job );
 	job->setQueue( this );
 
-	if ( ! _timer.isActive() )
+	if ( ! _timer.isActive() && ! _paused )
 	{
 	    // logDebug() << "First job queued" << endl;
 	    emit startingReading();
@@ -839,10 +1245,31 @@ void DirReadJobQueue::killAll( DirInfo * subtree, DirReadJob * exceptJob )
 
 void DirReadJobQueue::timeSlicedRead()
 {
-    if ( _queue.isEmpty() )
+    if ( _queue.isEmpty() || _paused )
+    {
 	_timer.stop();
+    }
     else
+    {
+	if ( _timer.interval() != 0 )	// after jobWaiting()
+	    _timer.start( 0 );
+
 	_queue.first()->read();
+    }
+}
+
+
+void DirReadJobQueue::jobWaiting()
+{
+    if ( ! _paused )
+	_timer.start( SCAN_WAIT_CHECK_MILLISEC );
+}
+
+
+void DirReadJobQueue::wakeUp()
+{
+    if ( ! _paused && ! _queue.isEmpty() )
+	_timer.start( 0 );
 }
 
 
@@ -863,6 +1290,22 @@ void DirReadJobQueue::jobFinishedNotify( DirReadJob *job )
 }
 
 
+void DirReadJobQueue::pause()
+{
+    _paused = true;
+    _timer.stop();
+}
+
+
+void DirReadJobQueue::resume()
+{
+    _paused = false;
+
+    if ( ! _queue.isEmpty() && ! _timer.isActive() )
+	_timer.start( 0 );
+}
+
+
 void DirReadJobQueue::deletingChildNotify( FileInfo * child )
 {
     if ( child && child->isDirInfo() )
@@ -12,6 +12,8 @@
 
 
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QSharedPointer>
 
 #include "FileInfo.h"
 #include "Logger.h"
@@ -25,6 +27,7 @@ namespace QDirStat
     class CacheReader;
     class DirReadJobQueue;
     class MountPoint;
+    class LocalDirScan;
 
 
     /**
@@ -245,14 +248,50 @@ namespace QDirStat
 	void setApplyFileChildExcludeRules( bool val )
 	    { _applyFileChildExcludeRules = val; }
 
+	/**
+	 * Return 'true' if files below the small file threshold of the tree
+	 * should only be summarized in their parent directory instead of
+	 * being stored as individual FileInfo nodes.
+	 *
+	 * The default is 'true'; it is set to 'false' for a read job that
+	 * reads a directory in full detail on user request.
+	 **/
+	bool aggregateSmallFiles() const
+	    { return _aggregateSmallFiles; }
+
+	/**
+	 * Set the aggregateSmallFiles flag.
+	 **/
+	void setAggregateSmallFiles( bool val )
+	    { _aggregateSmallFiles = val; }
+
+	/**
+	 * Start reading the directory the first time, then process what the
+	 * worker thread found so far each time this is called.
+	 *
+	 * Reimplemented from DirReadJob.
+	 **/
+	virtual void read() Q_DECL_OVERRIDE;
+
     protected:
 
 	/**
-	 * Read the directory. Prior to this nothing happens.
+	 * Start reading the directory: All system calls for this are done in
+	 * a worker thread, so a hanging filesystem (a dead network mount or
+	 * FUSE daemon) cannot block the application. If the worker does not
+	 * make any progress within the read timeout of the tree, the directory
+	 * gets DirError, and nothing on that filesystem is read anymore.
 	 *
 	 * Inherited and reimplemented from DirReadJob.
 	 **/
-	virtual void startReading();
+	virtual void startReading() Q_DECL_OVERRIDE;
+
+	/**
+	 * Create the children for the entries the worker thread has found so
+	 * far. Finish reading when the worker is done, or give up if it did
+	 * not make any progress for too long.
+	 **/
+	void processScanResults();
 
 	/**
 	 * Finish reading the directory: Set the specified read state, send
@@ -309,6 +348,14 @@ namespace QDirStat
 	 **/
 	void excludeDirLate();
 
+	/**
+	 * Return 'true' if the non-directory entry 'entryName' with the
+	 * stat() information 'statInfo' should be added to the small file
+	 * summary of this directory rather than as a FileInfo child.
+	 **/
+	bool isAggregatedSmallFile( const QString & entryName,
+				    struct stat	  * statInfo ) const;
+
 	/**
 	 * Return the full name with path of an entry of this directory.
 	 **/
@@ -326,9 +373,14 @@ namespace QDirStat
 
 	QString _dirName;
 	bool	_applyFileChildExcludeRules;
+	bool	_aggregateSmallFiles;
 	bool	_checkedForNtfs;
 	bool	_isNtfs;
 
+	QSharedPointer<LocalDirScan>	_scan;
+	QElapsedTimer			_watchdog;
+	int				_lastProgress;
+
 	static bool _warnedAboutNtfsHardLinks;
 
     };	// LocalDirReadJob
@@ -481,6 +533,30 @@ namespace QDirStat
 	 **/
 	void jobFinishedNotify( DirReadJob *job );
 
+	/**
+	 * Pause processing jobs: Jobs can still be added, but none of them
+	 * is started or continued until resume() is called.
+	 **/
+	void pause();
+
+	/**
+	 * Resume processing jobs after pause().
+	 **/
+	void resume();
+
+	/**
+	 * Return 'true' if processing jobs is paused.
+	 **/
+	bool isPaused() const { return _paused; }
+
+	/**
+	 * Notification that the head of the queue has nothing to do until
+	 * something else (e.g. a worker thread) calls wakeUp(): Until then,
+	 * call it only every now and then so it can check for a timeout, but
+	 * don't poll it in a busy loop.
+	 **/
+	void jobWaiting();
+
 
     signals:
 
@@ -507,6 +583,12 @@ namespace QDirStat
 	 **/
 	void deletingChildNotify( FileInfo * child );
 
+	/**
+	 * Continue with the head of the queue right away after jobWaiting().
+	 * This may be invoked from another thread with a queued connection.
+	 **/
+	void wakeUp();
+
 
     protected slots:
 
@@ -527,6 +609,7 @@ namespace QDirStat
 	QList<DirReadJob *>  _queue;
 	QList<DirReadJob *>  _blocked;
 	QTimer		     _timer;
+	bool		     _paused;
     };
 
 
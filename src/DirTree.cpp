@@ -9,6 +9,7 @@
 
 #include <QDir>
 #include <QFileInfo>
+#include <QHash>
 
 #include "DirTree.h"
 #include "DirTreeCache.h"
@@ -18,7 +19,10 @@
 #include "FileInfoIterator.h"
 #include "FileInfoSet.h"
 #include "ExcludeRules.h"
+#include "ExtTimeStore.h"
 #include "PkgReader.h"
+#include "PkgInfo.h"
+#include "TopFiles.h"
 #include "MountPoints.h"
 #include "FormatUtil.h"
 #include "Logger.h"
@@ -26,6 +30,9 @@
 
 #define VERBOSE_EXCLUDE_RULES	1
 
+// How long to wait for tree snapshots to be released before discarding the tree
+#define SNAPSHOT_TIMEOUT_MILLISEC	3000
+
 using namespace QDirStat;
 
 
@@ -34,13 +41,24 @@ DirTree::DirTree():
     _excludeRules( 0 ),
     _beingDestroyed( false ),
     _haveClusterSize( false ),
-    _blocksPerCluster( 0 )
+    _blocksPerCluster( 0 ),
+    _smallFileThreshold( 0 ),
+    _extendedTimes( false ),
+    _extTimeStore( 0 ),
+    _readTimeoutSec( 30 )
 {
     _isBusy	      = false;
+    _isFullRead	      = false;
+    _isLazyPkgRead    = false;
     _crossFilesystems = false;
     _root = new DirInfo( this );
     CHECK_NEW( _root );
 
+    _snapshotState = SnapshotStatePtr( new SnapshotState( this ) );
+
+    _topFiles = new TopFiles( this );
+    CHECK_NEW( _topFiles );
+
     connect( & _jobQueue, SIGNAL( finished()	 ),
 	     this,	  SLOT	( slotFinished() ) );
 
@@ -52,10 +70,17 @@ DirTree::DirTree():
 DirTree::~DirTree()
 {
     _beingDestroyed = true;
+    cancelSnapshots();
+    _snapshotState->detach();
 
     if ( _root )
 	delete _root;
 
+    if ( _extTimeStore )
+	delete _extTimeStore;
+
+    delete _topFiles;
+
     if ( _excludeRules )
 	delete _excludeRules;
 
@@ -99,7 +124,9 @@ QString DirTree::url() const
 
 void DirTree::clear()
 {
+    cancelSnapshots();
     _jobQueue.clear();
+    _generation.fetchAndAddOrdered( 1 );
 
     if ( _root )
     {
@@ -108,9 +135,39 @@ void DirTree::clear()
     }
 
     _isBusy	      = false;
+    _isLazyPkgRead    = false;
     _haveClusterSize  = false;
     _blocksPerCluster = 0;
     _device.clear();
+
+    // Only now that there are no more items that might refer to the old
+    // extended timestamps store it is safe to create or remove it.
+
+    updateExtTimeStore();
+}
+
+
+void DirTree::setExtendedTimes( bool enable )
+{
+    _extendedTimes = enable;
+
+    if ( ! _root->hasChildren() )
+	updateExtTimeStore();
+}
+
+
+void DirTree::updateExtTimeStore()
+{
+    if ( _extendedTimes && ! _extTimeStore )
+    {
+	_extTimeStore = new ExtTimeStore();
+	CHECK_NEW( _extTimeStore );
+    }
+    else if ( ! _extendedTimes && _extTimeStore )
+    {
+	delete _extTimeStore;
+	_extTimeStore = 0;
+    }
 }
 
 
@@ -135,7 +192,8 @@ void DirTree::startReading( const QString & rawUrl )
     if ( _root->hasChildren() )
 	clear();
 
-    _isBusy = true;
+    _isBusy	= true;
+    _isFullRead = true;
     emit startingReading();
 
     FileInfo * item = LocalDirReadJob::stat( _url, this, _root );
@@ -192,6 +250,13 @@ void DirTree::refresh( DirInfo * subtree )
     if ( ! _root )
 	return;
 
+    if ( isFrozen() )
+    {
+	logDebug() << "Tree is frozen - deferring refresh of " << subtree << endl;
+	_deferredRefresh << ( subtree ? subtree : _root );
+	return;
+    }
+
     if ( ! subtree->checkMagicNumber() )
     {
 	// Not using CHECK_MAGIC() here which would throw an exception since
@@ -219,18 +284,59 @@ void DirTree::refresh( DirInfo * subtree )
     }
     else	// Refresh subtree
     {
-	// logDebug() << "Refreshing subtree " << subtree << endl;
+	refreshSubtree( subtree, true );
+    }
+}
 
-	clearSubtree( subtree );
 
-	subtree->reset();
-	subtree->setExcluded( false );
+void DirTree::refreshFullDetail( DirInfo * dir )
+{
+    if ( ! _root || ! dir )
+	return;
 
-	_isBusy = true;
-	subtree->setReadState( DirReading );
-	emit startingReading();
-	addJob( new LocalDirReadJob( this, subtree ) );
+    if ( ! dir->checkMagicNumber() )
+    {
+	logWarning() << "Item is no longer valid - not refreshing subtree" << endl;
+	return;
+    }
+
+    if ( isFrozen() )
+    {
+	logDebug() << "Tree is frozen - deferring reading " << dir << endl;
+	_deferredFullDetail << dir;
+	return;
     }
+
+    if ( dir->isDotEntry() )
+	dir = dir->parent();
+
+    if ( ! dir || ! dir->parent() )	// Never re-read the pseudo root
+	return;
+
+    logDebug() << "Reading " << dir << " in full detail" << endl;
+    refreshSubtree( dir, false );
+}
+
+
+void DirTree::refreshSubtree( DirInfo * subtree, bool aggregateSmallFiles )
+{
+    // logDebug() << "Refreshing subtree " << subtree << endl;
+
+    clearSubtree( subtree );
+
+    subtree->reset();
+    subtree->setExcluded( false );
+
+    _isBusy	= true;
+    _isFullRead = false;
+    subtree->setReadState( DirReading );
+    emit startingReading();
+
+    LocalDirReadJob * job = new LocalDirReadJob( this, subtree );
+    CHECK_NEW( job );
+
+    job->setAggregateSmallFiles( aggregateSmallFiles );
+    addJob( job );
 }
 
 
@@ -242,7 +348,16 @@ void DirTree::abortReading()
     _jobQueue.abort();
 
     _isBusy = false;
-    emit aborted();
+
+    if ( _isLazyPkgRead )
+    {
+	_isLazyPkgRead = false;
+	emit lazyPkgReadFinished();
+    }
+    else
+    {
+	emit aborted();
+    }
 }
 
 
@@ -255,20 +370,23 @@ void DirTree::finalizeTree()
 	recalc( _root );
 	moveIgnoredToAttic( _root );
 	recalc( _root );
+
+	// Items were moved to the attic: Any index of this tree is outdated
+	_generation.fetchAndAddOrdered( 1 );
     }
 }
 
 
 void DirTree::slotFinished()
 {
-    finalizeTree();
-    _isBusy = false;
-    emit finished();
+    sendFinished();
 }
 
 
 void DirTree::childAddedNotify( FileInfo * newChild )
 {
+    _generation.fetchAndAddOrdered( 1 );
+
     if ( ! _haveClusterSize )
         detectClusterSize( newChild );
 
@@ -281,6 +399,7 @@ void DirTree::childAddedNotify( FileInfo * newChild )
 
 void DirTree::deletingChildNotify( FileInfo * deletedChild )
 {
+    _generation.fetchAndAddOrdered( 1 );
     logDebug() << "Deleting child " << deletedChild << endl;
     emit deletingChild( deletedChild );
 
@@ -297,6 +416,13 @@ void DirTree::childDeletedNotify()
 
 void DirTree::deleteSubtree( FileInfo *subtree )
 {
+    if ( isFrozen() )
+    {
+	logDebug() << "Tree is frozen - deferring deleting " << subtree << endl;
+	_deferredDeletions << subtree;
+	return;
+    }
+
     // logDebug() << "Deleting subtree " << subtree << endl;
     DirInfo * parent = subtree->parent();
 
@@ -305,7 +431,7 @@ void DirTree::deleteSubtree( FileInfo *subtree )
 
     if ( parent )
     {
-	if ( parent->isDotEntry() && ! parent->hasChildren() )
+	if ( parent->isDotEntry() && ! parent->hasChildren() && ! parent->smallFileSummary() )
 	    // This was the last child of a dot entry
 	{
 	    // Get rid of that now empty and useless dot entry
@@ -356,6 +482,202 @@ void DirTree::deleteSubtree( FileInfo *subtree )
 }
 
 
+void DirTree::deleteSubtrees( const FileInfoSet & subtrees )
+{
+    if ( isFrozen() )
+    {
+	logDebug() << "Tree is frozen - deferring deleting " << subtrees.size() << " subtrees" << endl;
+	_deferredDeletions.unite( subtrees );
+	return;
+    }
+
+    FileInfoSet items = subtrees.invalidRemoved().normalized();
+
+    if ( items.size() < 2 )
+    {
+	if ( ! items.isEmpty() )
+	    deleteSubtree( items.first() );
+
+	return;
+    }
+
+    logInfo() << "Deleting " << items.size() << " subtrees" << endl;
+
+    // Since the set is normalized, none of the parents is in any of the
+    // subtrees to be deleted, so they all stay valid while others are
+    // deleted.
+
+    QHash<DirInfo *, FileInfoList> childrenByParent;
+
+    foreach ( FileInfo * item, items )
+    {
+	if ( item->parent() )
+	    childrenByParent[ item->parent() ] << item;
+	else
+	    logError() << "Not deleting " << item << " without a parent" << endl;
+    }
+
+    QHash<DirInfo *, FileInfoList>::const_iterator it = childrenByParent.constBegin();
+
+    while ( it != childrenByParent.constEnd() )
+    {
+	deleteChildren( it.key(), it.value() );
+	++it;
+    }
+
+    emit childDeleted();
+}
+
+
+void DirTree::deleteChildren( DirInfo * parent, const FileInfoList & children )
+{
+    _generation.fetchAndAddOrdered( 1 );
+    emit deletingChildren( parent, children );
+
+    // Intentionally not using deletingChildNotify() here: Logging each child
+    // would take longer than all the rest together.
+
+    foreach ( FileInfo * child, children )
+	emit deletingChild( child );
+
+    parent->deletingChildren( children );
+    qDeleteAll( children );
+
+    emit childrenDeleted();
+
+    if ( parent->isDotEntry()         &&
+         ! parent->hasChildren()      &&
+         ! parent->hasAtticChildren() &&
+         ! parent->smallFileSummary()    )
+    {
+	// Get rid of that now empty and useless dot entry
+
+	DirInfo * dotEntryParent = parent->parent();
+
+	if ( dotEntryParent && dotEntryParent->isFinished() )
+	{
+	    emit deletingChildren( dotEntryParent, FileInfoList() << parent );
+	    emit deletingChild( parent );
+
+	    dotEntryParent->deleteEmptyDotEntry(); // This deletes the dot entry
+
+	    emit childrenDeleted();
+	}
+    }
+}
+
+
+TreeSnapshotPtr DirTree::snapshot( FileInfo * subtree )
+{
+    if ( ! subtree )
+	subtree = _root;
+
+    if ( ! subtree )
+	return TreeSnapshotPtr();
+
+    // Make sure no other thread ever triggers a recalc() because of a dirty
+    // summary: That would modify the tree.
+
+    recalcSubtree( subtree );
+
+    if ( _snapshotState->add() )
+    {
+	logDebug() << "Freezing tree" << endl;
+	_jobQueue.pause();
+    }
+
+    TreeSnapshot * snapshot = new TreeSnapshot( this, subtree, generation(), _snapshotState );
+    CHECK_NEW( snapshot );
+
+    return TreeSnapshotPtr( snapshot );
+}
+
+
+void DirTree::thaw()
+{
+    if ( isFrozen() )	// A new snapshot was taken in the meantime
+	return;
+
+    logDebug() << "Thawing tree" << endl;
+    _jobQueue.resume();
+
+    if ( ! _deferredDeletions.isEmpty() )
+    {
+	FileInfoSet deletions = _deferredDeletions;
+	_deferredDeletions.clear();
+	deleteSubtrees( deletions );
+    }
+
+    if ( ! _deferredRefresh.isEmpty() )
+    {
+	FileInfoSet refreshSet = _deferredRefresh;
+	_deferredRefresh.clear();
+	refresh( refreshSet );
+    }
+
+    if ( ! _deferredFullDetail.isEmpty() )
+    {
+	FileInfoSet fullDetailSet = _deferredFullDetail.invalidRemoved();
+	_deferredFullDetail.clear();
+
+	foreach ( FileInfo * item, fullDetailSet )
+	    refreshFullDetail( item->toDirInfo() );
+    }
+}
+
+
+void DirTree::cancelSnapshots()
+{
+    if ( isFrozen() )
+    {
+	logInfo() << "Waiting for " << _snapshotState->count()
+		  << " tree snapshot(s) to be released" << endl;
+
+	if ( _snapshotState->cancel( SNAPSHOT_TIMEOUT_MILLISEC ) )
+	{
+	    logInfo() << "All tree snapshots released" << endl;
+	}
+	else
+	{
+	    // Most likely a worker thread hangs in a system call. Leave the
+	    // old items to it; they are never deleted.
+
+	    logError() << "Tree snapshots not released after "
+		       << SNAPSHOT_TIMEOUT_MILLISEC << " millisec - abandoning "
+		       << ( _root ? _root->totalItems() : 0 ) << " items"
+		       << endl;
+
+	    if ( _root )
+	    {
+		_root = new DirInfo( this );
+		CHECK_NEW( _root );
+	    }
+	}
+    }
+
+    // The tree is about to be discarded anyway
+
+    _deferredDeletions.clear();
+    _deferredRefresh.clear();
+    _deferredFullDetail.clear();
+    _jobQueue.resume();
+}
+
+
+void DirTree::recalcSubtree( FileInfo * item )
+{
+    if ( ! item || ! item->isDirInfo() )
+	return;
+
+    // This does a recalc() if the summary is dirty, and recalc() cascades
+    // down into all dirty children. Since the ancestors of a dirty
+    // directory are always dirty, too, that leaves nothing dirty in the
+    // subtree, and it only visits the dirty paths, not the whole subtree.
+
+    item->totalSize();
+}
+
+
 void DirTree::clearSubtree( DirInfo * subtree )
 {
     if ( subtree->hasChildren() )
@@ -385,6 +707,65 @@ void DirTree::unblock( DirReadJob * job )
 }
 
 
+/**
+ * Return the path of the mount point that 'path' is on. Unlike
+ * MountPoints::findNearestMountPoint(), this does not access the
+ * filesystem, so it also works for a hanging mount.
+ **/
+static QString mountPath( const QString & path )
+{
+    QStringList pathComponents = path.split( "/", QString::SkipEmptyParts );
+
+    while ( ! pathComponents.isEmpty() )
+    {
+	QString mountPath = QString( "/" ) + pathComponents.join( "/" );
+
+	if ( MountPoints::findByPath( mountPath ) )
+	    return mountPath;
+
+	pathComponents.removeLast();
+    }
+
+    return "/";
+}
+
+
+void DirTree::readTimedOut( const QString & dirName, const QString & stuckPath )
+{
+    _timedOutDirs.insert( dirName );
+
+    // If the worker never got a thread because all of them hang, there is
+    // nothing to blame.
+
+    if ( stuckPath.isEmpty() )
+	return;
+
+    QString mountPath = ::mountPath( stuckPath );
+
+    // Never stop reading the filesystem the scan started on; that would
+    // leave nothing to read.
+
+    if ( mountPath == ::mountPath( _url ) )
+	return;
+
+    if ( ! _quarantinedMounts.contains( mountPath ) )
+    {
+	logWarning() << "Not reading anything on " << mountPath
+		     << " anymore: Hanging in " << stuckPath << endl;
+	_quarantinedMounts.insert( mountPath );
+    }
+}
+
+
+bool DirTree::isQuarantined( const QString & path ) const
+{
+    if ( _quarantinedMounts.isEmpty() )
+	return false;
+
+    return _quarantinedMounts.contains( mountPath( path ) );
+}
+
+
 void DirTree::sendStartingReading()
 {
     emit startingReading();
@@ -395,7 +776,16 @@ void DirTree::sendFinished()
 {
     finalizeTree();
     _isBusy = false;
-    emit finished();
+
+    if ( _isLazyPkgRead )
+    {
+	_isLazyPkgRead = false;
+	emit lazyPkgReadFinished();
+    }
+    else
+    {
+	emit finished();
+    }
 }
 
 
@@ -452,7 +842,8 @@ bool DirTree::readCache( const QString & cacheFileName )
     if ( ! reader->ok() )
         return false;
 
-    _isBusy = true;
+    _isBusy	= true;
+    _isFullRead = false;
     emit startingReading();
     addJob( new CacheReadJob( this, 0, cacheFileName ) );
 
@@ -470,8 +861,9 @@ void DirTree::clearAndReadCache( const QString & cacheFileName )
 void DirTree::readPkg( const PkgFilter & pkgFilter )
 {
     clear();
-    _isBusy = true;
-    _url    = pkgFilter.url();
+    _isBusy	= true;
+    _isFullRead = false;
+    _url	= pkgFilter.url();
     emit startingReading();
 
     // logDebug() << "Reading " << pkgFilter << endl;
@@ -480,6 +872,72 @@ void DirTree::readPkg( const PkgFilter & pkgFilter )
 }
 
 
+void DirTree::readLazyPkg( const QList<PkgInfo *> & pkgList )
+{
+    PkgInfoList lazyPkgList;
+
+    foreach ( PkgInfo * pkg, pkgList )
+    {
+	if ( pkg->isLazy() && pkg->readState() == DirOnRequestOnly )
+	{
+	    pkg->setReadState( DirQueued );
+	    lazyPkgList << pkg;
+	}
+    }
+
+    if ( lazyPkgList.isEmpty() )
+	return;
+
+    if ( ! _isBusy )
+    {
+	// This only completes the tree, so the views need to know about it,
+	// but not everything that waits for a new tree.
+
+	_isBusy	       = true;
+	_isLazyPkgRead = true;
+	emit startingLazyPkgRead();
+    }
+
+    PkgReader reader( this );
+    reader.readFileLists( lazyPkgList );
+}
+
+
+/**
+ * Return the packages of 'tree' whose file list is not read yet.
+ **/
+static PkgInfoList lazyPkgList( const DirTree * tree )
+{
+    PkgInfoList pkgList;
+    FileInfo *	top = tree->firstToplevel();
+
+    if ( top && top->isPkgInfo() )
+    {
+	for ( FileInfo * child = top->firstChild(); child; child = child->next() )
+	{
+	    PkgInfo * pkg = child->toPkgInfo();
+
+	    if ( pkg && pkg->isLazy() && pkg->readState() == DirOnRequestOnly )
+		pkgList << pkg;
+	}
+    }
+
+    return pkgList;
+}
+
+
+void DirTree::readAllLazyPkg()
+{
+    readLazyPkg( lazyPkgList( this ) );
+}
+
+
+bool DirTree::hasLazyPkg() const
+{
+    return ! lazyPkgList( this ).isEmpty();
+}
+
+
 void DirTree::setExcludeRules( ExcludeRules * newRules )
 {
     if ( _excludeRules )
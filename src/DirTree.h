@@ -12,9 +12,13 @@
 
 
 #include <QList>
+#include <QAtomicInt>
+#include <QSet>
 
 #include "DirReadJob.h"
+#include "FileInfoSet.h"
 #include "PkgFilter.h"
+#include "TreeSnapshot.h"
 
 
 namespace QDirStat
@@ -24,6 +28,9 @@ namespace QDirStat
     class FileInfoSet;
     class ExcludeRules;
     class DirTreeFilter;
+    class ExtTimeStore;
+    class PkgInfo;
+    class TopFiles;
 
 
     /**
@@ -96,11 +103,31 @@ namespace QDirStat
 	 **/
 	void refresh( const FileInfoSet & refreshSet );
 
+	/**
+	 * Refresh a directory, but read its direct children in full detail,
+	 * i.e. create a FileInfo for every file even if it is below the
+	 * small file threshold. Subdirectories are read with the normal
+	 * settings again.
+	 **/
+	void refreshFullDetail( DirInfo * dir );
+
 	/**
 	 * Delete a subtree.
 	 **/
 	void deleteSubtree( FileInfo * subtree );
 
+	/**
+	 * Delete many subtrees at once, e.g. after a cleanup for a large
+	 * selection. This is much faster than deleteSubtree() for each one of
+	 * them: The subtrees are grouped by parent, each parent is updated only
+	 * once, and attached views get deletingChildren() / childrenDeleted()
+	 * for each parent and childDeleted() only once at the end.
+	 *
+	 * Items in 'subtrees' that are in the subtree of other items are
+	 * ignored.
+	 **/
+	void deleteSubtrees( const FileInfoSet & subtrees );
+
 	/**
 	 * Delete all children of a subtree, but leave the subtree inself
 	 * intact.
@@ -204,6 +231,80 @@ namespace QDirStat
 	void setCrossFilesystems( bool doCross )
 	    { _crossFilesystems = doCross; }
 
+	/**
+	 * Return the size in bytes below which regular files are not stored
+	 * as individual FileInfo nodes, but only summarized in their parent
+	 * directory (see SmallFileSummary). 0 means this is disabled.
+	 **/
+	FileSize smallFileThreshold() const { return _smallFileThreshold; }
+
+	/**
+	 * Set the small file threshold. 0 disables small file aggregation.
+	 * This takes effect for directories that are read after this call.
+	 **/
+	void setSmallFileThreshold( FileSize threshold )
+	    { _smallFileThreshold = threshold; }
+
+	/**
+	 * Return 'true' if the extended timestamps (atime, ctime, btime) of
+	 * files are stored in addition to the modification time.
+	 **/
+	bool extendedTimes() const { return _extendedTimes; }
+
+	/**
+	 * Enable or disable storing the extended timestamps. Since this
+	 * needs additional memory for each item, it is disabled by default.
+	 *
+	 * This takes effect when the tree is cleared the next time, i.e.
+	 * when the next directory is read.
+	 **/
+	void setExtendedTimes( bool enable );
+
+	/**
+	 * Return the store for the extended timestamps or 0 if they are not
+	 * enabled for the current tree.
+	 **/
+	ExtTimeStore * extTimeStore() const { return _extTimeStore; }
+
+	/**
+	 * Return the index of the largest / newest / oldest files of this
+	 * tree's subtrees.
+	 **/
+	TopFiles * topFiles() const { return _topFiles; }
+
+	/**
+	 * Return the time in seconds a local directory read job may go
+	 * without any progress before it gives up on that directory. 0 means
+	 * wait forever.
+	 **/
+	int readTimeoutSec() const { return _readTimeoutSec; }
+
+	/**
+	 * Set the read timeout in seconds.
+	 **/
+	void setReadTimeoutSec( int sec ) { _readTimeoutSec = sec; }
+
+	/**
+	 * Notification that reading directory 'dirName' timed out while a
+	 * system call for 'stuckPath' did not return: Remember 'dirName' as
+	 * timed out, and don't read anything on the mounted filesystem of
+	 * 'stuckPath' anymore for the rest of this session unless the scan
+	 * started on that filesystem.
+	 **/
+	void readTimedOut( const QString & dirName, const QString & stuckPath );
+
+	/**
+	 * Return 'true' if 'path' is on a filesystem that is not read anymore
+	 * because reading from it timed out.
+	 **/
+	bool isQuarantined( const QString & path ) const;
+
+	/**
+	 * Return 'true' if reading directory 'dirName' timed out.
+	 **/
+	bool isTimedOut( const QString & dirName ) const
+	    { return _timedOutDirs.contains( dirName ); }
+
 	/**
 	 * Notification that a child has been added.
 	 *
@@ -212,6 +313,13 @@ namespace QDirStat
 	 **/
 	virtual void childAddedNotify( FileInfo *newChild );
 
+	/**
+	 * Notification that existing items were moved to another parent
+	 * within the tree, e.g. files to a new dot entry. This changes the
+	 * generation of the tree.
+	 **/
+	void childrenMovedNotify() { _generation.fetchAndAddOrdered( 1 ); }
+
 	/**
 	 * Notification that a child is about to be deleted.
 	 *
@@ -260,6 +368,39 @@ namespace QDirStat
 	 **/
 	bool isBusy() { return _isBusy; }
 
+	/**
+	 * Returns 'true' if the current or last read of this tree is a read
+	 * of the complete tree from the filesystem with startReading(), not
+	 * a refresh of a subtree, a cache file or the package database.
+	 **/
+	bool isFullRead() const { return _isFullRead; }
+
+	/**
+	 * Take a read-only snapshot of 'subtree' (or of the complete tree if
+	 * 'subtree' is 0) for use in another thread. This freezes the tree
+	 * until the last snapshot is released. See TreeSnapshot for details.
+	 *
+	 * All summary fields of that subtree are recalculated here, so the
+	 * other thread never needs to do that.
+	 *
+	 * Call this only from the GUI thread.
+	 **/
+	TreeSnapshotPtr snapshot( FileInfo * subtree = 0 );
+
+	/**
+	 * Return 'true' if any snapshot of this tree exists, i.e. if changes
+	 * to the tree structure are currently deferred.
+	 **/
+	bool isFrozen() const
+	    { return _snapshotState->count() > 0; }
+
+	/**
+	 * Return the generation of this tree. This changes whenever items
+	 * are added to or removed from the tree.
+	 **/
+	int generation() const
+	    { return _generation.fetchAndAddOrdered( 0 ); }
+
 	/**
 	 * Write the complete tree to a cache file.
 	 *
@@ -285,6 +426,28 @@ namespace QDirStat
 	 **/
 	void readPkg( const PkgFilter & pkgFilter );
 
+	/**
+	 * Read the file lists of the packages in 'pkgList' that were only
+	 * added with their size from the package database so far (see
+	 * PkgInfo::isLazy()). Other packages are ignored.
+	 *
+	 * Unless the tree is busy anyway, this emits startingLazyPkgRead()
+	 * and lazyPkgReadFinished(), not startingReading() and finished().
+	 **/
+	void readLazyPkg( const QList<PkgInfo *> & pkgList );
+
+	/**
+	 * Read the file lists of all lazy packages in the tree so all sizes
+	 * are accurate.
+	 **/
+	void readAllLazyPkg();
+
+	/**
+	 * Return 'true' if the tree has any packages whose file list is not
+	 * read yet.
+	 **/
+	bool hasLazyPkg() const;
+
 	/**
 	 * Return exclude rules specific to this tree (as opposed to the global
 	 * ones stored in the ExcludeRules singleton) or 0 if there are none.
@@ -386,6 +549,19 @@ namespace QDirStat
 	 **/
 	void childDeleted();
 
+	/**
+	 * Emitted when 'children' of 'parent' are about to be deleted all at
+	 * once. This is followed by deletingChild() for each one of them and
+	 * then by childrenDeleted().
+	 **/
+	void deletingChildren( DirInfo * parent, const FileInfoList & children );
+
+	/**
+	 * Emitted after the children from the last deletingChildren() are
+	 * deleted.
+	 **/
+	void childrenDeleted();
+
 	/**
 	 * Emitted when a subtree is about to be cleared, i.e. all its children
 	 * will be deleted (but not the subtree node itself).
@@ -412,6 +588,18 @@ namespace QDirStat
 	 **/
 	void aborted();
 
+	/**
+	 * Emitted when reading the file lists of lazy packages is started
+	 * with readLazyPkg().
+	 **/
+	void startingLazyPkgRead();
+
+	/**
+	 * Emitted when reading the file lists of lazy packages is finished
+	 * or aborted.
+	 **/
+	void lazyPkgReadFinished();
+
 	/**
 	 * Emitted when reading the specified directory is started.
 	 **/
@@ -439,9 +627,51 @@ namespace QDirStat
 	 **/
 	void slotFinished();
 
+	/**
+	 * Resume reading and perform all deferred operations if there are no
+	 * more snapshots of this tree.
+	 **/
+	void thaw();
+
 
     protected:
 
+	/**
+	 * Ask all snapshot owners to release their snapshots, wait until they
+	 * did, and discard all deferred operations. This is used before the
+	 * complete tree is discarded.
+	 *
+	 * If they don't release them in time, leave the current items to
+	 * them (they are never deleted) and continue with a new, empty root.
+	 **/
+	void cancelSnapshots();
+
+	/**
+	 * Create or remove the extended timestamps store according to the
+	 * current setting. This must only be called when the tree is empty.
+	 **/
+	void updateExtTimeStore();
+
+	/**
+	 * Recalculate the summary fields of all directories in 'item' that
+	 * need it. This only walks along the paths to dirty directories.
+	 **/
+	void recalcSubtree( FileInfo * item );
+
+	/**
+	 * Delete 'children' which all are direct children of 'parent' at once
+	 * and send the notifications for them. If this leaves 'parent' as an
+	 * empty dot entry, delete it as well.
+	 **/
+	void deleteChildren( DirInfo * parent, const FileInfoList & children );
+
+	/**
+	 * Clear 'subtree' and start reading it again from disk. If
+	 * 'aggregateSmallFiles' is 'false', the direct children of 'subtree'
+	 * are read in full detail regardless of the small file threshold.
+	 **/
+	void refreshSubtree( DirInfo * subtree, bool aggregateSmallFiles );
+
 	/**
 	 * Recurse through the tree from 'dir' on and move any ignored items to
 	 * the attic on the same level.
@@ -479,6 +709,8 @@ namespace QDirStat
 	DirReadJobQueue		_jobQueue;
 	bool			_crossFilesystems;
 	bool			_isBusy;
+	bool			_isFullRead;
+	bool			_isLazyPkgRead;
 	QString			_device;
 	QString			_url;
 	ExcludeRules *		_excludeRules;
@@ -486,6 +718,19 @@ namespace QDirStat
 	bool			_beingDestroyed;
         bool                    _haveClusterSize;
         int                     _blocksPerCluster;
+	FileSize		_smallFileThreshold;
+	bool			_extendedTimes;
+	ExtTimeStore *		_extTimeStore;
+	TopFiles *		_topFiles;
+	int			_readTimeoutSec;
+	QSet<QString>		_quarantinedMounts;
+	QSet<QString>		_timedOutDirs;
+
+	SnapshotStatePtr	_snapshotState;
+	mutable QAtomicInt	_generation;
+	FileInfoSet		_deferredDeletions;
+	FileInfoSet		_deferredRefresh;
+	FileInfoSet		_deferredFullDetail;
 
     };	// class DirTree
 
@@ -8,6 +8,7 @@
 
 
 #include <ctype.h>      // isspace()
+#include <algorithm>	// std::sort()
 #include <QUrl>
 
 #include "DirTreeCache.h"
@@ -15,6 +16,7 @@
 #include "DirTree.h"
 #include "DotEntry.h"
 #include "ExcludeRules.h"
+#include "SmallFileSummary.h"
 #include "FormatUtil.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -26,6 +28,10 @@
 
 #define MAX_ERROR_COUNT			1000
 
+// 64 bit FNV-1a hash for the directory digests
+#define FNV_OFFSET_BASIS		0xcbf29ce484222325ULL
+#define FNV_PRIME			0x100000001b3ULL
+
 #define VERBOSE_READ			0
 #define VERBOSE_CACHE_DIRS		0
 #define VERBOSE_CACHE_FILE_INFOS	0
@@ -34,6 +40,38 @@
 using namespace QDirStat;
 
 
+/**
+ * Add 'len' bytes 'data' to the FNV-1a hash 'hash' and return the result.
+ **/
+static quint64 fnvHash( const char * data, int len, quint64 hash = FNV_OFFSET_BASIS )
+{
+    for ( int i = 0; i < len; ++i )
+    {
+	hash ^= (unsigned char) data[i];
+	hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+/**
+ * Return the type field of the cache file for 'item'.
+ **/
+static const char * cacheFileType( FileInfo * item )
+{
+    if	    ( item->isFile()		)	return "F";
+    else if ( item->isDir()		)	return "D";
+    else if ( item->isSymLink()		)	return "L";
+    else if ( item->isBlockDevice()	)	return "BlockDev";
+    else if ( item->isCharDevice()	)	return "CharDev";
+    else if ( item->isFifo()		)	return "FIFO";
+    else if ( item->isSocket()		)	return "Socket";
+
+    return "";
+}
+
+
 CacheWriter::CacheWriter( const QString & fileName, DirTree *tree )
 {
     _ok = writeCache( fileName, tree );
@@ -66,8 +104,14 @@ bool CacheWriter::writeCache( const QString & fileName, DirTree *tree )
 	     "# Type\tpath\t\tsize\tmtime\t\t<optional fields>\n"
 	     "\n" );
 
-    writeTree( cache, tree->root()->firstChild() );
+    FileInfo * toplevel = tree->root()->firstChild();
+
+    if ( toplevel && toplevel->isDirInfo() )
+	calcDigest( toplevel );
+
+    writeTree( cache, toplevel );
     gzclose( cache );
+    _digests.clear();
 
     return true;
 }
@@ -85,6 +129,9 @@ void CacheWriter::writeTree( gzFile cache, FileInfo * item )
     if ( ! item->isDotEntry() )
 	writeItem( cache, item );
 
+    if ( item->isDirInfo() )
+	writeSmallFiles( cache, item->toDirInfo() );
+
     //
     // Write file children
     //
@@ -113,16 +160,7 @@ void CacheWriter::writeItem( gzFile cache, FileInfo * item )
 
     // Write file type
 
-    const char * file_type = "";
-    if	    ( item->isFile()		)	file_type = "F";
-    else if ( item->isDir()		)	file_type = "D";
-    else if ( item->isSymLink()		)	file_type = "L";
-    else if ( item->isBlockDevice()	)	file_type = "BlockDev";
-    else if ( item->isCharDevice()	)	file_type = "CharDev";
-    else if ( item->isFifo()		)	file_type = "FIFO";
-    else if ( item->isSocket()		)	file_type = "Socket";
-
-    gzprintf( cache, "%s", file_type );
+    gzprintf( cache, "%s", cacheFileType( item ) );
 
     // Write name
 
@@ -157,10 +195,134 @@ void CacheWriter::writeItem( gzFile cache, FileInfo * item )
     if ( item->isFile() && item->links() > 1 )
 	gzprintf( cache, "\tlinks: %u", (unsigned) item->links() );
 
+    if ( item->hasUid() )
+	gzprintf( cache, "\tuid: %u", (unsigned) item->uid() );
+
+    QHash<FileInfo *, quint64>::const_iterator it = _digests.constFind( item );
+
+    if ( it != _digests.constEnd() )
+	gzprintf( cache, "\tdigest: %016llx", (unsigned long long) it.value() );
+
     gzputc( cache, '\n' );
 }
 
 
+void CacheWriter::writeSmallFiles( gzFile cache, DirInfo * dir )
+{
+    const SmallFileSummary * summary = dir->smallFileSummary();
+
+    if ( ! summary || summary->isEmpty() )
+	return;
+
+    gzprintf( cache, "S\t*" );
+    gzprintf( cache, "\t%s", formatSize( summary->totalSize() ).toUtf8().data() );
+    gzprintf( cache, "\t0x%lx", (unsigned long) summary->latestMtime() );
+    gzprintf( cache, "\tcount: %d", summary->count() );
+    gzprintf( cache, "\tblocks: %lld", summary->totalBlocks() );
+
+    if ( summary->oldestMtime() > 0 )
+	gzprintf( cache, "\toldest: 0x%lx", (unsigned long) summary->oldestMtime() );
+
+    if ( ! summary->categoryCounts().isEmpty() )
+    {
+	QStringList categories;
+
+	for ( SmallFileCategoryCountMap::const_iterator it = summary->categoryCounts().constBegin();
+	      it != summary->categoryCounts().constEnd();
+	      ++it )
+	{
+	    categories << QString( "%1=%2:%3" )
+		.arg( QString::fromLatin1( QUrl::toPercentEncoding( it.key() ) ) )
+		.arg( it.value() )
+		.arg( summary->categorySums().value( it.key() ) );
+	}
+
+	gzprintf( cache, "\tcategories: %s", categories.join( "," ).toUtf8().data() );
+    }
+
+    gzputc( cache, '\n' );
+}
+
+
+quint64 CacheWriter::calcDigest( FileInfo * dir )
+{
+    QVector<quint64> hashes;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() )
+	    hashes << entryHash( child, calcDigest( child ) );
+	else
+	    hashes << entryHash( child );
+    }
+
+    // The files in the dot entry are written as entries of this directory,
+    // and so is the small file summary of either one.
+
+    QList<DirInfo *> summaryDirs;
+    summaryDirs << dir->toDirInfo();
+
+    if ( dir->dotEntry() )
+    {
+	for ( FileInfo * child = dir->dotEntry()->firstChild(); child; child = child->next() )
+	    hashes << entryHash( child );
+
+	summaryDirs << dir->dotEntry();
+    }
+
+    foreach ( DirInfo * summaryDir, summaryDirs )
+    {
+	const SmallFileSummary * summary = summaryDir->smallFileSummary();
+
+	if ( summary && ! summary->isEmpty() )
+	{
+	    QByteArray data = QString( "S\t*\t%1\t%2\t%3" )
+		.arg( summary->totalSize() )
+		.arg( (qulonglong) summary->latestMtime() )
+		.arg( summary->count() ).toUtf8();
+
+	    hashes << fnvHash( data.constData(), data.size() );
+	}
+    }
+
+    // Entries are written in the order they were read from the disk which
+    // may be different the next time, so sort them for the digest.
+
+    std::sort( hashes.begin(), hashes.end() );
+
+    quint64 digest = FNV_OFFSET_BASIS;
+
+    foreach ( quint64 hash, hashes )
+    {
+	char bytes[ 8 ];
+
+	for ( int i = 0; i < 8; ++i )
+	    bytes[i] = (char) ( hash >> ( 8 * i ) );
+
+	digest = fnvHash( bytes, sizeof( bytes ), digest );
+    }
+
+    _digests.insert( dir, digest );
+
+    return digest;
+}
+
+
+quint64 CacheWriter::entryHash( FileInfo * item, quint64 digest )
+{
+    QByteArray data = QString( "%1\t%2\t%3\t%4" )
+	.arg( cacheFileType( item ) )
+	.arg( item->name() )
+	.arg( item->rawByteSize() )
+	.arg( (qulonglong) item->mtime() ).toUtf8();
+
+    if ( item->isDirInfo() )
+	data += QString( "\t%1" ).arg( digest, 16, 16, QChar( '0' ) ).toUtf8();
+
+    return fnvHash( data.constData(), data.size() );
+}
+
+
 QByteArray CacheWriter::urlEncoded( const QString & path )
 {
     // Using a protocol ("scheme") part to avoid directory names with a colon
@@ -281,7 +443,7 @@ bool CacheReader::read( int maxLines )
 }
 
 
-void CacheReader::addItem()
+bool CacheReader::parseItem( ItemFields & item )
 {
     if ( fieldsCount() < 4 )
     {
@@ -289,8 +451,6 @@ void CacheReader::addItem()
 		   << ": Expected at least 4 fields, saw only " << fieldsCount()
 		   << endl;
 
-	setReadError( _lastDir );
-
 	if ( ++_errorCount > MAX_ERROR_COUNT )
 	{
 	    logError() << "Too many syntax errors. Giving up." << endl;
@@ -298,50 +458,43 @@ void CacheReader::addItem()
 	    emit error();
 	}
 
-	return;
+	return false;
     }
 
     int n = 0;
-    char * type		= field( n++ );
-    char * raw_path	= field( n++ );
-    char * size_str	= field( n++ );
-    char * mtime_str	= field( n++ );
-    char * blocks_str	= 0;
-    char * links_str	= 0;
+    item.type		= field( n++ );
+    item.rawPath	= field( n++ );
+    item.size		= parseSize( field( n++ ) );
+    item.mtime		= strtol( field( n++ ), 0, 0 );
+    item.blocks		= -1;
+    item.links		= 1;
+    item.uid		= 0;
+    item.hasUid		= false;
+    item.firstOptional	= n;
 
     while ( fieldsCount() > n+1 )
     {
 	char * keyword	= field( n++ );
 	char * val_str	= field( n++ );
 
-	if ( strcasecmp( keyword, "blocks:" ) == 0 ) blocks_str = val_str;
-	if ( strcasecmp( keyword, "links:"  ) == 0 ) links_str	= val_str;
-    }
-
-
-    // Type
-
-    mode_t mode = S_IFREG;
-
-    if	    ( strcasecmp( type, "F"	   ) == 0 )	mode = S_IFREG;
-    else if ( strcasecmp( type, "D"	   ) == 0 )	mode = S_IFDIR;
-    else if ( strcasecmp( type, "L"	   ) == 0 )	mode = S_IFLNK;
-    else if ( strcasecmp( type, "BlockDev" ) == 0 )	mode = S_IFBLK;
-    else if ( strcasecmp( type, "CharDev"  ) == 0 )	mode = S_IFCHR;
-    else if ( strcasecmp( type, "FIFO"	   ) == 0 )	mode = S_IFIFO;
-    else if ( strcasecmp( type, "Socket"   ) == 0 )	mode = S_IFSOCK;
-
+	if ( strcasecmp( keyword, "blocks:" ) == 0 ) item.blocks = strtoll( val_str, 0, 10 );
+	if ( strcasecmp( keyword, "links:"  ) == 0 ) item.links	 = atoi( val_str );
 
-    // Path
-
-    if ( *raw_path == '/' )
-	_lastDir = 0;
+	if ( strcasecmp( keyword, "uid:"    ) == 0 )
+	{
+	    item.uid	= (uid_t) strtoul( val_str, 0, 10 );
+	    item.hasUid = true;
+	}
+    }
 
+    return true;
+}
 
-    // Size
 
+FileSize CacheReader::parseSize( const char * sizeStr )
+{
     char * end = 0;
-    FileSize size = strtoll( size_str, &end, 10 );
+    FileSize size = strtoll( sizeStr, &end, 10 );
 
     if ( end )
     {
@@ -355,20 +508,56 @@ void CacheReader::addItem()
 	}
     }
 
+    return size;
+}
 
-    // MTime
 
-    time_t mtime = strtol( mtime_str, 0, 0 );
+void CacheReader::addItem()
+{
+    ItemFields fields;
 
+    if ( ! parseItem( fields ) )
+    {
+	setReadError( _lastDir );
+	return;
+    }
 
-    // Blocks
+    char * type		= fields.type;
+    char * raw_path	= fields.rawPath;
+    FileSize size	= fields.size;
+    time_t mtime	= fields.mtime;
+    FileSize blocks	= fields.blocks;
+    int	   links	= fields.links;
 
-    FileSize blocks = blocks_str ? strtoll( blocks_str, 0, 10 ) : -1;
 
+    // Type
 
-    // Links
+    mode_t mode = S_IFREG;
 
-    int links = links_str ? atoi( links_str ) : 1;
+    if	    ( strcasecmp( type, "F"	   ) == 0 )	mode = S_IFREG;
+    else if ( strcasecmp( type, "D"	   ) == 0 )	mode = S_IFDIR;
+    else if ( strcasecmp( type, "L"	   ) == 0 )	mode = S_IFLNK;
+    else if ( strcasecmp( type, "BlockDev" ) == 0 )	mode = S_IFBLK;
+    else if ( strcasecmp( type, "CharDev"  ) == 0 )	mode = S_IFCHR;
+    else if ( strcasecmp( type, "FIFO"	   ) == 0 )	mode = S_IFIFO;
+    else if ( strcasecmp( type, "Socket"   ) == 0 )	mode = S_IFSOCK;
+
+
+    // Path
+
+    if ( *raw_path == '/' )
+	_lastDir = 0;
+
+
+    //
+    // Small file summary of the last directory
+    //
+
+    if ( strcasecmp( type, "S" ) == 0 )
+    {
+	addSmallFiles( _lastDir, size, mtime, fields.firstOptional );
+	return;
+    }
 
 
     //
@@ -452,6 +641,9 @@ void CacheReader::addItem()
 	dir->setReadState( DirReading );
 	_lastDir = dir;
 
+	if ( fields.hasUid )
+	    dir->setUid( fields.uid );
+
 	if ( parent )
 	    parent->insertChild( dir );
 
@@ -494,6 +686,10 @@ void CacheReader::addItem()
 	    FileInfo * item = new FileInfo( _tree, parent, name,
 					    mode, size, mtime,
 					    blocks, links );
+
+	    if ( fields.hasUid )
+		item->setUid( fields.uid );
+
 	    parent->insertChild( item );
 	    _tree->childAddedNotify( item );
 	}
@@ -506,6 +702,65 @@ void CacheReader::addItem()
 }
 
 
+void CacheReader::addSmallFiles( DirInfo * parent,
+				 FileSize  size,
+				 time_t	   mtime,
+				 int	   n )
+{
+    if ( ! parent )
+    {
+	if ( ! _lastExcludedDir )
+	{
+	    logError() << _fileName << ":" << _lineNo << ": "
+		       << "No parent for small files summary" << endl;
+	}
+
+	return;
+    }
+
+    int		count	      = 0;
+    FileSize	blocks	      = 0LL;
+    time_t	oldest	      = 0;
+    char *	categoriesStr = 0;
+
+    while ( fieldsCount() > n+1 )
+    {
+	char * keyword	= field( n++ );
+	char * val_str	= field( n++ );
+
+	if ( strcasecmp( keyword, "count:"	) == 0 ) count	       = atoi( val_str );
+	if ( strcasecmp( keyword, "blocks:"	) == 0 ) blocks	       = strtoll( val_str, 0, 10 );
+	if ( strcasecmp( keyword, "oldest:"	) == 0 ) oldest	       = strtol( val_str, 0, 0 );
+	if ( strcasecmp( keyword, "categories:" ) == 0 ) categoriesStr = val_str;
+    }
+
+    if ( count <= 0 )
+	return;
+
+    FileSize allocatedSize = blocks > 0 ? blocks * STD_BLOCK_SIZE : size;
+
+    SmallFileSummary summary;
+    summary.addFiles( count, size, allocatedSize, blocks, mtime, oldest );
+
+    if ( categoriesStr )
+    {
+	// name=count:sum,name=count:sum,...
+
+	foreach ( const QString & entry, QString::fromUtf8( categoriesStr ).split( ',', QString::SkipEmptyParts ) )
+	{
+	    QString name = QUrl::fromPercentEncoding( entry.section( '=', 0, 0 ).toUtf8() );
+	    QString val	 = entry.section( '=', 1 );
+
+	    summary.addCategory( name,
+				 val.section( ':', 0, 0 ).toInt(),
+				 val.section( ':', 1, 1 ).toLongLong() );
+	}
+    }
+
+    parent->addSmallFiles( summary );
+}
+
+
 bool CacheReader::eof()
 {
     if ( ! _ok || ! _cache )
@@ -12,11 +12,12 @@
 
 
 #include <zlib.h>    // gzFile
+#include <QHash>
 #include "DirTree.h"
 
 
 #define DEFAULT_CACHE_NAME	".qdirstat.cache.gz"
-#define CACHE_FORMAT_VERSION	"1.0"
+#define CACHE_FORMAT_VERSION	"2.0"
 #define MAX_CACHE_LINE_LEN	1024
 #define MAX_FIELDS_PER_LINE	32
 
@@ -72,6 +73,30 @@ namespace QDirStat
 	 **/
 	void writeItem( gzFile cache, FileInfo * item );
 
+	/**
+	 * Write the small file summary of 'dir' (if there is any) to cache
+	 * file 'cache' as one "S" line.
+	 **/
+	void writeSmallFiles( gzFile cache, DirInfo * dir );
+
+	/**
+	 * Calculate the digest of 'dir' and all directories below it and
+	 * store them in _digests.
+	 *
+	 * The digest of a directory covers type, name, size and mtime of each
+	 * entry that is written for it, its small file summary and the
+	 * digests of its subdirectories, so two directories with the same
+	 * digest have the same content all the way down (see
+	 * doc/cache-file-format.txt).
+	 **/
+	quint64 calcDigest( FileInfo * dir );
+
+	/**
+	 * Return the hash of one entry of a directory for calcDigest().
+	 * 'digest' is the digest of a subdirectory or 0.
+	 **/
+	quint64 entryHash( FileInfo * item, quint64 digest = 0 );
+
         /**
          * Return the 'path' in an URL-encoded form, i.e. with some special
          * characters escaped in percent notation (" " -> "%20").
@@ -82,7 +107,8 @@ namespace QDirStat
 	// Data members
 	//
 
-	bool _ok;
+	bool			    _ok;
+	QHash<FileInfo *, quint64>  _digests;
     };
 
 
@@ -198,10 +224,45 @@ namespace QDirStat
 	 **/
 	bool checkHeader();
 
+	/**
+	 * The fields of one item line of the cache file after parseItem().
+	 * The strings point into the current input line.
+	 **/
+	struct ItemFields
+	{
+	    char *   type;
+	    char *   rawPath;
+	    FileSize size;
+	    time_t   mtime;
+	    FileSize blocks;		// -1 if there is no "blocks:" field
+	    int	     links;		//  1 if there is no "links:" field
+	    uid_t    uid;
+	    bool     hasUid;
+	    int	     firstOptional;	// index of the first optional field
+	};
+
+	/**
+	 * Split the current input line into the fields of an item.
+	 * Return 'false' on a syntax error.
+	 **/
+	bool parseItem( ItemFields & item );
+
 	/**
 	 * Use _fields to add one item to _tree.
+	 *
+	 * Derived classes can reimplement this to process the items of the
+	 * cache file without building a tree.
 	 **/
-	void addItem();
+	virtual void addItem();
+
+	/**
+	 * Add a small file summary ("S" line) to 'parent'. 'n' is the
+	 * index of the first optional field.
+	 **/
+	void addSmallFiles( DirInfo * parent,
+			    FileSize  size,
+			    time_t    mtime,
+			    int	      n );
 
 	/**
 	 * Read the next line that is not empty or a comment and store it in
@@ -234,6 +295,11 @@ namespace QDirStat
 			QString	      & path_ret,
 			QString	      & name_ret ) const;
 
+	/**
+	 * Parse a size field with an optional K/M/G/T suffix.
+	 **/
+	static FileSize parseSize( const char * sizeStr );
+
 	/**
 	 * Build a full path from path + file name (without path).
 	 **/
@@ -7,7 +7,15 @@
  */
 
 
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QMutexLocker>
+#include <QPair>
 #include <QPalette>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
 
 #include "Qt4Compat.h"
 
@@ -15,10 +23,15 @@
 #include "DirTree.h"
 #include "DirInfo.h"
 #include "FileInfoIterator.h"
+#include "PkgInfo.h"
+#include "MappedArena.h"
 #include "DataColumns.h"
 #include "SelectionModel.h"
 #include "Settings.h"
 #include "SettingsHelpers.h"
+#include "TreeFilter.h"
+#include "GrowthHistory.h"
+#include "CompressionAnalyzer.h"
 #include "Logger.h"
 #include "FormatUtil.h"
 #include "Exception.h"
@@ -33,9 +46,104 @@
 // like (4k)
 #define SMALL_FILE_SHOW_ALLOC_THRESHOLD		75
 
+// Minimum number of directories to sort their children in parallel jobs
+#define MIN_PARALLEL_SORT_DIRS	64
+
+// Interval for processing events while waiting for the sort jobs
+#define SORT_WAIT_EVENTS_MILLISEC	50
+
 using namespace QDirStat;
 
 
+namespace QDirStat
+{
+    /**
+     * Job for sorting the children of a number of directories in another
+     * thread. The results go to separate lists; it is up to the GUI thread
+     * to install them as the sort caches of the directories when all jobs
+     * are done. This only reads the tree, so it needs to be frozen.
+     **/
+    class SortChildrenJob: public QRunnable
+    {
+    public:
+
+	SortChildrenJob( const QList<DirInfo *> & dirs,
+			 FileInfoList **	  results,
+			 DataColumn		  sortCol,
+			 Qt::SortOrder		  sortOrder ):
+	    _dirs( dirs ),
+	    _results( results ),
+	    _sortCol( sortCol ),
+	    _sortOrder( sortOrder )
+	{}
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    for ( int i = 0; i < _dirs.size(); ++i )
+	    {
+		_results[i] = _dirs.at( i )->createSortedChildren( _sortCol, _sortOrder,
+								  true ); // includeAttic
+	    }
+	}
+
+    protected:
+
+	QList<DirInfo *> _dirs;
+	FileInfoList **	 _results;
+	DataColumn	 _sortCol;
+	Qt::SortOrder	 _sortOrder;
+
+    };	// class SortChildrenJob
+
+
+    /**
+     * Job for applying a TreeFilter in another thread, so a large tree
+     * does not block the GUI while it is filtered.
+     **/
+    class TreeFilterApplyJob: public QRunnable
+    {
+    public:
+
+	TreeFilterApplyJob( DirTreeModel *  model,
+			    TreeFilter *    filter,
+			    int		    generation,
+			    TreeSnapshotPtr snapshot ):
+	    _model( model ),
+	    _filter( filter ),
+	    _generation( generation ),
+	    _snapshot( snapshot )
+	{}
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    _filter->apply( _snapshot );
+
+	    if ( _snapshot->isCancelled() )
+	    {
+		delete _filter;
+		_filter = 0;
+	    }
+
+	    // The tree waits for the snapshot before the model can go away,
+	    // so the model is still there.
+
+	    _model->filterReady( _generation, _filter );
+	    _snapshot.clear();
+	}
+
+    protected:
+
+	DirTreeModel *	_model;
+	TreeFilter *	_filter;
+	int		_generation;
+	TreeSnapshotPtr _snapshot;
+
+    };	// class TreeFilterApplyJob
+
+}	// namespace QDirStat
+
+
+
 DirTreeModel::DirTreeModel( QObject * parent ):
     QAbstractItemModel( parent ),
     _tree(0),
@@ -46,7 +154,11 @@ DirTreeModel::DirTreeModel( QObject * parent ):
     _slowUpdate( false ),
     _sortCol( NameCol ),
     _sortOrder( Qt::AscendingOrder ),
-    _removingRows( false )
+    _removingRows( false ),
+    _deletingChildren( false ),
+    _filter( 0 ),
+    _filterGeneration( 0 ),
+    _shrinkingParent( 0 )
 {
     createTree();
     readSettings();
@@ -62,8 +174,16 @@ DirTreeModel::~DirTreeModel()
 {
     writeSettings();
 
+    if ( _filter )
+	delete _filter;
+
     if ( _tree )
-	delete _tree;
+	delete _tree;	// this waits for a TreeFilterApplyJob
+
+    QMutexLocker locker( &_readyFiltersMutex );
+
+    foreach ( const ReadyFilter & ready, _readyFilters )
+	delete ready.second;
 }
 
 
@@ -78,6 +198,10 @@ void DirTreeModel::readSettings()
     _treeIconDir	 = settings.value( "TreeIconDir" , ":/icons/tree-medium/" ).toString();
     _updateTimerMillisec = settings.value( "UpdateTimerMillisec", 333 ).toInt();
     _slowUpdateMillisec	 = settings.value( "SlowUpdateMillisec", 3000 ).toInt();
+    _tree->setSmallFileThreshold( settings.value( "SmallFileAggregationThreshold", 0 ).toInt() );
+    MappedArena::setScratchDir( settings.value( "TreeScratchDir", "" ).toString() );
+    _tree->setExtendedTimes( settings.value( "ExtendedTimestamps", false ).toBool() );
+    _tree->setReadTimeoutSec( settings.value( "DirReadTimeoutSec", 30 ).toInt() );
 
     settings.endGroup();
 
@@ -114,6 +238,11 @@ void DirTreeModel::writeSettings()
     settings.setDefaultValue( "IgnoreHardLinks",     FileInfo::ignoreHardLinks() );
     settings.setDefaultValue( "TreeIconDir",	     _treeIconDir		 );
     settings.setDefaultValue( "UpdateTimerMillisec", _updateTimerMillisec	 );
+    settings.setDefaultValue( "SmallFileAggregationThreshold",
+			      _tree ? (int) _tree->smallFileThreshold() : 0 );
+    settings.setDefaultValue( "TreeScratchDir", MappedArena::scratchDir() );
+    settings.setDefaultValue( "ExtendedTimestamps", _tree ? _tree->extendedTimes() : false );
+    settings.setDefaultValue( "DirReadTimeoutSec",  _tree ? _tree->readTimeoutSec() : 30 );
 
     settings.endGroup();
 
@@ -159,6 +288,12 @@ void DirTreeModel::createTree()
     connect( _tree, SIGNAL( aborted()	      ),
 	     this,  SLOT  ( readingFinished() ) );
 
+    connect( _tree, SIGNAL( startingLazyPkgRead() ),
+	     this,  SLOT  ( busyDisplay()	  ) );
+
+    connect( _tree, SIGNAL( lazyPkgReadFinished() ),
+	     this,  SLOT  ( readingFinished()	  ) );
+
     connect( _tree, SIGNAL( readJobFinished( DirInfo * ) ),
 	     this,  SLOT  ( readJobFinished( DirInfo * ) ) );
 
@@ -173,6 +308,12 @@ void DirTreeModel::createTree()
 
     connect( _tree, SIGNAL( childDeleted() ),
 	     this,  SLOT  ( childDeleted() ) );
+
+    connect( _tree, SIGNAL( deletingChildren( DirInfo *, FileInfoList ) ),
+	     this,  SLOT  ( deletingChildren( DirInfo *, FileInfoList ) ) );
+
+    connect( _tree, SIGNAL( childrenDeleted() ),
+	     this,  SLOT  ( childrenDeleted() ) );
 }
 
 
@@ -182,11 +323,21 @@ void DirTreeModel::clear()
     {
 	beginResetModel();
 
+	if ( _filter )
+	{
+	    delete _filter;
+	    _filter = 0;
+	    _filteredChildren.clear();
+	}
+
+	++_filterGeneration;	// discard a filter that is still being applied
+
 	// logDebug() << "After beginResetModel()" << endl;
 	// dumpPersistentIndexList();
 
 	_tree->clear();
 	endResetModel();
+	emit filterChanged();
 
 	// logDebug() << "After endResetModel()" << endl;
 	// dumpPersistentIndexList();
@@ -254,14 +405,134 @@ void DirTreeModel::setColumns( const DataColumnList & columns )
 }
 
 
-FileInfo * DirTreeModel::findChild( DirInfo * parent, int childNo ) const
+void DirTreeModel::setFilter( TreeFilter * filter )
 {
-    CHECK_PTR( parent );
+    ++_filterGeneration;	// discard a filter that is still being applied
+
+    if ( filter && filter->isActive() && _tree && _tree->root() )
+    {
+	TreeFilterApplyJob * job =
+	    new TreeFilterApplyJob( this, filter, _filterGeneration, _tree->snapshot() );
+	CHECK_NEW( job );
+
+	QThreadPool::globalInstance()->start( job );
+
+	return;
+    }
+
+    delete filter;
+
+    if ( ! _filter )
+	return;
+
+    beginResetModel();
+
+    delete _filter;
+    _filter = 0;
+    _filteredChildren.clear();
+
+    endResetModel();
+    emit filterChanged();
+}
+
+
+void DirTreeModel::filterReady( int generation, TreeFilter * filter )
+{
+    QMutexLocker locker( &_readyFiltersMutex );
+
+    _readyFilters << ReadyFilter( generation, filter );
+    QMetaObject::invokeMethod( this, "filterApplied", Qt::QueuedConnection );
+}
+
+
+void DirTreeModel::filterApplied()
+{
+    QList<ReadyFilter> readyFilters;
+
+    {
+	QMutexLocker locker( &_readyFiltersMutex );
+	readyFilters.swap( _readyFilters );
+    }
+
+    TreeFilter * newFilter = 0;
+
+    foreach ( const ReadyFilter & ready, readyFilters )
+    {
+	if ( ready.first == _filterGeneration && ready.second )
+	    newFilter = ready.second;
+	else
+	    delete ready.second;	// outdated or cancelled
+    }
+
+    if ( ! newFilter )
+	return;
+
+    beginResetModel();
+
+    delete _filter;
+    _filter = newFilter;
+    _filteredChildren.clear();
 
-    const FileInfoList & childrenList =
+    endResetModel();
+    emit filterChanged();
+}
+
+
+float DirTreeModel::subtreePercent( FileInfo * item ) const
+{
+    if ( ! _filter )
+	return item->subtreeAllocatedPercent();
+
+    // With a filter, this is the share of the filtered size of the parent
+
+    FileSize parentSize = item->parent() ? _filter->sums( item->parent() ).size : 0LL;
+
+    if ( parentSize == 0 || item->isExcluded() )
+	return -1.0;
+
+    FileSize size = item->isDirInfo() ? _filter->sums( item ).size : item->size();
+
+    return ( 100.0 * size ) / (float) parentSize;
+}
+
+
+const FileInfoList & DirTreeModel::childrenList( DirInfo * parent ) const
+{
+    if ( parent == _shrinkingParent )
+	return _shrinkingChildren;
+
+    const FileInfoList & sortedChildren =
 	parent->sortedChildren( _sortCol, _sortOrder,
 				true );	    // includeAttic
 
+    if ( ! _filter )
+	return sortedChildren;
+
+    QHash<DirInfo *, FileInfoList>::iterator it = _filteredChildren.find( parent );
+
+    if ( it == _filteredChildren.end() )
+    {
+	FileInfoList visibleChildren;
+
+	foreach ( FileInfo * child, sortedChildren )
+	{
+	    if ( _filter->isVisible( child ) )
+		visibleChildren << child;
+	}
+
+	it = _filteredChildren.insert( parent, visibleChildren );
+    }
+
+    return it.value();
+}
+
+
+FileInfo * DirTreeModel::findChild( DirInfo * parent, int childNo ) const
+{
+    CHECK_PTR( parent );
+
+    const FileInfoList & childrenList = this->childrenList( parent );
+
     if ( childNo < 0 || childNo >= childrenList.size() )
     {
 	logError() << "Child #" << childNo << " is out of range: 0.."
@@ -283,9 +554,7 @@ int DirTreeModel::rowNumber( FileInfo * child ) const
     if ( ! child->parent() )
 	return 0;
 
-    const FileInfoList & childrenList =
-	child->parent()->sortedChildren( _sortCol, _sortOrder,
-					 true ); // includeAttic
+    const FileInfoList & childrenList = this->childrenList( child->parent() );
 
     int row = childrenList.indexOf( child );
 
@@ -304,6 +573,124 @@ int DirTreeModel::rowNumber( FileInfo * child ) const
 }
 
 
+QModelIndexList DirTreeModel::indexesToExpand( int level, int maxCount )
+{
+    QModelIndexList indexes;
+
+    if ( ! _tree || ! _tree->root() || level < 1 )
+	return indexes;
+
+    // Keep the tree frozen while other threads are sorting
+
+    TreeSnapshotPtr snapshot = _tree->snapshot();
+
+    typedef QPair<DirInfo *, int> Dir;	// dir, row
+    QList<Dir> dirs;
+
+    sortChildren( QList<DirInfo *>() << _tree->root() );
+    int row = 0;
+
+    foreach ( FileInfo * child, childrenList( _tree->root() ) )
+    {
+	if ( child->isDirInfo() )
+	    dirs << Dir( child->toDirInfo(), row );
+
+	++row;
+    }
+
+    for ( int depth = 0; depth < level && ! dirs.isEmpty(); ++depth )
+    {
+	QList<DirInfo *> dirList;
+
+	foreach ( const Dir & dir, dirs.mid( 0, maxCount - indexes.size() ) )
+	    dirList << dir.first;
+
+	sortChildren( dirList );
+	QList<Dir> nextDirs;
+
+	foreach ( const Dir & dir, dirs )
+	{
+	    if ( indexes.size() >= maxCount )
+	    {
+		logWarning() << "Not expanding more than " << maxCount << " directories" << endl;
+		return indexes;
+	    }
+
+	    QModelIndex index = createIndex( dir.second, 0, dir.first );
+
+	    if ( rowCount( index ) == 0 )
+		continue;
+
+	    indexes << index;
+
+	    if ( depth + 1 < level )
+	    {
+		row = 0;
+
+		foreach ( FileInfo * child, childrenList( dir.first ) )
+		{
+		    if ( child->isDirInfo() )
+			nextDirs << Dir( child->toDirInfo(), row );
+
+		    ++row;
+		}
+	    }
+	}
+
+	dirs = nextDirs;
+    }
+
+    return indexes;
+}
+
+
+void DirTreeModel::sortChildren( const QList<DirInfo *> & dirList )
+{
+    QList<DirInfo *> dirs;
+
+    foreach ( DirInfo * dir, dirList )
+    {
+	if ( ! dir->hasSortCache( _sortCol, _sortOrder, true ) ) // includeAttic
+	    dirs << dir;
+    }
+
+    if ( dirs.size() < MIN_PARALLEL_SORT_DIRS )
+    {
+	foreach ( DirInfo * dir, dirs )
+	    dir->sortedChildren( _sortCol, _sortOrder, true ); // includeAttic
+
+	return;
+    }
+
+    int jobCount  = qMax( QThread::idealThreadCount(), 1 );
+    int chunkSize = ( dirs.size() + jobCount - 1 ) / jobCount;
+    QVector<FileInfoList *> results( dirs.size(), 0 );
+    QThreadPool pool;
+
+    for ( int i = 0; i < dirs.size(); i += chunkSize )
+    {
+	SortChildrenJob * job = new SortChildrenJob( dirs.mid( i, chunkSize ),
+						     results.data() + i,
+						     _sortCol, _sortOrder );
+	CHECK_NEW( job );
+
+	pool.start( job ); // The pool deletes the job when it is done
+    }
+
+    // Keep repainting (e.g. the busy popup) while waiting, but don't take
+    // any user input that might change the tree or the sort order.
+
+    while ( ! pool.waitForDone( SORT_WAIT_EVENTS_MILLISEC ) )
+	QCoreApplication::processEvents( QEventLoop::ExcludeUserInputEvents );
+
+    // Only now install the results: Setting a sort cache drops the ones of
+    // the subtree, and no worker may see that.
+
+    for ( int i = 0; i < dirs.size(); ++i )
+	dirs.at( i )->setSortedChildren( results.at( i ), _sortCol, _sortOrder, true ); // includeAttic
+}
+
+
 FileInfo * DirTreeModel::itemFromIndex( const QModelIndex & index )
 {
     FileInfo * item = 0;
@@ -409,6 +796,54 @@ int DirTreeModel::columnCount( const QModelIndex & parent ) const
 }
 
 
+/**
+ * Return the package of 'index' if its file list is not read yet or 0 if it
+ * is anything else.
+ **/
+static PkgInfo * lazyPkg( const QModelIndex & index )
+{
+    if ( ! index.isValid() )
+	return 0;
+
+    FileInfo * item = static_cast<FileInfo *>( index.internalPointer() );
+    CHECK_MAGIC( item );
+
+    if ( ! item->isPkgInfo() )
+	return 0;
+
+    PkgInfo * pkg = item->toPkgInfo();
+
+    return pkg && pkg->isLazy() && pkg->readState() == DirOnRequestOnly ? pkg : 0;
+}
+
+
+bool DirTreeModel::hasChildren( const QModelIndex & parentIndex ) const
+{
+    if ( lazyPkg( parentIndex ) )
+	return true;
+
+    return rowCount( parentIndex ) > 0;
+}
+
+
+bool DirTreeModel::canFetchMore( const QModelIndex & parentIndex ) const
+{
+    return lazyPkg( parentIndex ) != 0;
+}
+
+
+void DirTreeModel::fetchMore( const QModelIndex & parentIndex )
+{
+    PkgInfo * pkg = lazyPkg( parentIndex );
+
+    if ( pkg )
+    {
+	pkg->touch();
+	_tree->readLazyPkg( PkgInfoList() << pkg );
+    }
+}
+
+
 QVariant DirTreeModel::data( const QModelIndex & index, int role ) const
 {
     if ( ! index.isValid() )
@@ -496,6 +931,13 @@ QVariant DirTreeModel::headerData( int		   section,
 		case GroupCol:		  return tr( "Group"		  );
 		case PermissionsCol:	  return tr( "Permissions"	  );
 		case OctalPermissionsCol: return tr( "Perm."	    );
+		case ShortGrowthCol:	  return growthHeader( 0 );
+		case LongGrowthCol:	  return growthHeader( 1 );
+		case ATimeCol:		  return tr( "Last Access"	  );
+		case CTimeCol:		  return tr( "Status Change"	  );
+		case BTimeCol:		  return tr( "Created"		  );
+		case CompressedSizeCol:	  return tr( "Compressed"	  );
+		case CompressionRatioCol: return tr( "Compr. %"	  );
 		default:		  return QVariant();
 	    }
 
@@ -511,7 +953,14 @@ QVariant DirTreeModel::headerData( int		   section,
 		case LatestMTimeCol:
 		case OldestFileMTimeCol:
 		case PermissionsCol:
-		case OctalPermissionsCol: return Qt::AlignHCenter;
+		case OctalPermissionsCol:
+		case ShortGrowthCol:
+		case LongGrowthCol:
+		case ATimeCol:
+		case CTimeCol:
+		case BTimeCol:
+		case CompressedSizeCol:
+		case CompressionRatioCol: return Qt::AlignHCenter;
 		default:		  return Qt::AlignLeft;
 	    }
 
@@ -617,6 +1066,7 @@ void DirTreeModel::sort( int column, Qt::SortOrder order )
 
     _sortCol   = DataColumns::fromViewCol( column );
     _sortOrder = order;
+    _filteredChildren.clear();
 
     updatePersistentIndexes();
     emit layoutChanged();
@@ -631,6 +1081,7 @@ void DirTreeModel::sort( int column, Qt::SortOrder order )
 
 void DirTreeModel::busyDisplay()
 {
+    clearFilter();
     emit layoutAboutToBeChanged();
 
     _sortCol = NameCol;
@@ -694,13 +1145,18 @@ QVariant DirTreeModel::columnText( FileInfo * item, int col ) const
     {
 	case NameCol:		  return item->name();
 	case PercentBarCol:	  return item->isExcluded() ? tr( "[Excluded]" ) : QVariant();
-	case PercentNumCol:	  return item == _tree->firstToplevel() ? QVariant() : formatPercent( item->subtreeAllocatedPercent() );
+	case PercentNumCol:	  return item == _tree->firstToplevel() ? QVariant() : formatPercent( subtreePercent( item ) );
 	case SizeCol:		  return sizeColText( item );
 	case LatestMTimeCol:	  return QString( "  " ) + formatTime( item->latestMtime() );
 	case UserCol:		  return limitedInfo ? QVariant() : item->userName();
 	case GroupCol:		  return limitedInfo ? QVariant() : item->groupName();
 	case PermissionsCol:	  return limitedInfo ? QVariant() : item->symbolicPermissions();
 	case OctalPermissionsCol: return limitedInfo ? QVariant() : item->octalPermissions();
+	case ATimeCol:		  return extTimeText( item, AccessTime	     );
+	case CTimeCol:		  return extTimeText( item, StatusChangeTime );
+	case BTimeCol:		  return extTimeText( item, CreationTime     );
+	case CompressedSizeCol:
+	case CompressionRatioCol: return compressionText( item, col );
     }
 
     if ( item->isDirInfo() )
@@ -721,6 +1177,19 @@ QVariant DirTreeModel::columnText( FileInfo * item, int col ) const
 
 	QString prefix = item->sizePrefix();
 
+	if ( _filter )
+	{
+	    switch ( col )
+	    {
+		case TotalItemsCol:
+		case TotalFilesCol:
+		    return prefix + QString( "%1" ).arg( _filter->sums( item ).files );
+
+		default:
+		    break;
+	    }
+	}
+
 	switch ( col )
 	{
 	    case TotalItemsCol:	  return prefix + QString( "%1" ).arg( item->totalItems() );
@@ -732,6 +1201,8 @@ QVariant DirTreeModel::columnText( FileInfo * item, int col ) const
 		    return prefix + QString( "%1" ).arg( item->totalSubDirs() );
 
 	    case OldestFileMTimeCol:  return QString( "	 " ) + formatTime( item->oldestFileMtime() );
+	    case ShortGrowthCol:      return growthText( item, 0 );
+	    case LongGrowthCol:	      return growthText( item, 1 );
 	}
     }
 
@@ -753,12 +1224,19 @@ QVariant DirTreeModel::columnAlignment( FileInfo * item, int col ) const
 	case TotalFilesCol:
 	case TotalSubDirsCol:
 	case OctalPermissionsCol:
+	case ShortGrowthCol:
+	case LongGrowthCol:
+	case CompressedSizeCol:
+	case CompressionRatioCol:
 	    alignment |= Qt::AlignRight;
 	    break;
 
 	case NameCol:
 	case LatestMTimeCol:
 	case OldestFileMTimeCol:
+	case ATimeCol:
+	case CTimeCol:
+	case BTimeCol:
 	case UserCol:
 	case GroupCol:
 	default:
@@ -836,10 +1314,10 @@ QVariant DirTreeModel::columnRawData( FileInfo * item, int col ) const
 		}
 		else
 		{
-		    return item->subtreeAllocatedPercent();
+		    return subtreePercent( item );
 		}
 	    }
-	case PercentNumCol:	  return item->subtreeAllocatedPercent();
+	case PercentNumCol:	  return subtreePercent( item );
 	case SizeCol:		  return item->totalSize();
 	case TotalItemsCol:	  return item->totalItems();
 	case TotalFilesCol:	  return item->totalFiles();
@@ -850,6 +1328,27 @@ QVariant DirTreeModel::columnRawData( FileInfo * item, int col ) const
 	case GroupCol:		  return item->gid();
 	case PermissionsCol:	  return item->mode();
 	case OctalPermissionsCol: return item->mode();
+	case ShortGrowthCol:	  return GrowthHistory::instance()->growth( item, 0 );
+	case LongGrowthCol:	  return GrowthHistory::instance()->growth( item, 1 );
+	case ATimeCol:		  return (qulonglong) item->atime();
+	case CTimeCol:		  return (qulonglong) item->ctime();
+	case BTimeCol:		  return (qulonglong) item->btime();
+
+	case CompressedSizeCol:
+	case CompressionRatioCol:
+	    {
+		const CompressionInfo * info = CompressionAnalyzer::instance()->info( item );
+
+		if ( ! info || ! info->isDiskSizeKnown() )
+		    return QVariant();
+
+		if ( col == CompressedSizeCol )
+		    return info->diskBytes();
+
+		return info->extentBytes > 0 ?
+		    ( 100.0 * info->diskBytes() ) / info->extentBytes : QVariant();
+	    }
+
 	default:		  return QVariant();
     }
 }
@@ -860,6 +1359,12 @@ int DirTreeModel::directChildrenCount( FileInfo * subtree ) const
     if ( ! subtree )
 	return 0;
 
+    if ( subtree == _shrinkingParent )
+	return _shrinkingChildren.size();
+
+    if ( _filter && subtree->isDirInfo() )
+	return childrenList( subtree->toDirInfo() ).size();
+
     int count = subtree->directChildrenCount();
 
     if ( subtree->attic() )
@@ -983,7 +1488,12 @@ QVariant DirTreeModel::sizeColText( FileInfo * item ) const
     QString leftMargin( 2, ' ' );
 
     if ( item->isDirInfo() )
+    {
+	if ( _filter )
+	    return leftMargin + item->sizePrefix() + formatSize( _filter->sums( item ).size );
+
 	return leftMargin + item->sizePrefix() + formatSize( item->totalAllocatedSize() );
+    }
 
     QString text = sizeText( item );
 
@@ -997,6 +1507,60 @@ QVariant DirTreeModel::sizeColText( FileInfo * item ) const
 }
 
 
+QVariant DirTreeModel::growthText( FileInfo * item, int window ) const
+{
+    bool     known  = false;
+    FileSize growth = GrowthHistory::instance()->growth( item, window, &known );
+
+    if ( ! known )
+	return QVariant();
+
+    if ( growth < 0 )
+	return QString( "-" ) + formatSize( -growth );
+    else
+	return QString( "+" ) + formatSize( growth );
+}
+
+
+QVariant DirTreeModel::extTimeText( FileInfo * item, FileTimeType type ) const
+{
+    time_t time = item->fileTime( type );
+
+    if ( time == 0 )	// no extended timestamps or unknown
+	return QVariant();
+
+    return QString( "  " ) + formatTime( time );
+}
+
+
+QVariant DirTreeModel::compressionText( FileInfo * item, int col ) const
+{
+    const CompressionInfo * info = CompressionAnalyzer::instance()->info( item );
+
+    if ( ! info || info->extentBytes == 0 )
+	return QVariant();
+
+    // If the btrfs tree search was denied, only the amount of compressed
+    // data is known, but not how much disk space it takes
+
+    if ( ! info->isDiskSizeKnown() )
+	return "?";
+
+    if ( col == CompressedSizeCol )
+	return formatSize( info->diskBytes() );
+    else
+	return formatPercent( ( 100.0 * info->diskBytes() ) / info->extentBytes );
+}
+
+
+QString DirTreeModel::growthHeader( int window ) const
+{
+    int days = GrowthHistory::instance()->windowDays( window );
+
+    return days == 1 ? tr( "Growth (1 day)" ) : tr( "Growth (%1 days)" ).arg( days );
+}
+
+
 QVariant DirTreeModel::columnIcon( FileInfo * item, int col ) const
 {
     if ( col != NameCol )
@@ -1186,6 +1750,29 @@ void DirTreeModel::dataChangedNotify( DirInfo * dir )
 }
 
 
+void DirTreeModel::compressionChanged( DirInfo * dir )
+{
+    if ( ! dir )
+	return;
+
+    if ( dir == _tree->root() || dir->isTouched() )
+    {
+	QModelIndex parentIndex = modelIndex( dir, 0 );
+	int rows = rowCount( parentIndex );
+
+	if ( rows > 0 )
+	{
+	    QModelIndex topLeft	    = index( 0, 0, parentIndex );
+	    QModelIndex bottomRight = index( rows - 1, DataColumns::instance()->colCount() - 1, parentIndex );
+
+	    emit dataChanged( topLeft, bottomRight );
+	}
+    }
+
+    dataChangedNotify( dir );
+}
+
+
 void DirTreeModel::readingFinished()
 {
     _updateTimer.stop();
@@ -1276,7 +1863,11 @@ void DirTreeModel::endRemoveRows()
 
 void DirTreeModel::deletingChild( FileInfo * child )
 {
+    if ( _deletingChildren )	// Already handled in deletingChildren()
+	return;
+
     logDebug() << "Deleting child " << child << endl;
+    clearFilter();
 
     if ( child->parent() &&
 	 ( child->parent() == _tree->root() ||
@@ -1298,9 +1889,80 @@ void DirTreeModel::childDeleted()
 }
 
 
+void DirTreeModel::deletingChildren( DirInfo * parent, const FileInfoList & children )
+{
+    logDebug() << "Deleting " << children.size() << " children of " << parent << endl;
+    clearFilter();
+    invalidatePersistent( children );
+    _deletingChildren = true;
+
+    if ( parent == _tree->root() || parent->isTouched() )
+    {
+	// Find the rows of the children in one pass through the parent's
+	// children rather than with rowNumber() for each one of them
+
+	QSet<FileInfo *> deleted;
+
+	foreach ( FileInfo * child, children )
+	    deleted.insert( child );
+
+	const FileInfoList & childrenList = this->childrenList( parent );
+	QList<QPair<int, int> > ranges;	// first row, last row
+
+	for ( int row = 0; row < childrenList.size(); ++row )
+	{
+	    if ( ! deleted.contains( childrenList.at( row ) ) )
+		continue;
+
+	    if ( ! ranges.isEmpty() && ranges.last().second == row - 1 )
+		ranges.last().second = row;
+	    else
+		ranges << qMakePair( row, row );
+	}
+
+	// Qt can only remove adjacent rows at once, and the children are
+	// only deleted after this, all at once. Until then, the rows of this
+	// parent come from a copy of its children list that loses one range
+	// after the other. Starting with the last range keeps the row numbers
+	// of the others valid.
+
+	_shrinkingParent   = parent;
+	_shrinkingChildren = childrenList;
+	QModelIndex parentIndex = modelIndex( parent, 0 );
+
+	for ( int i = ranges.size() - 1; i >= 0; --i )
+	{
+	    int firstRow = ranges.at( i ).first;
+	    int lastRow  = ranges.at( i ).second;
+
+	    logDebug() << "beginRemoveRows for " << parent
+		       << " rows " << firstRow << " to " << lastRow << endl;
+
+	    beginRemoveRows( parentIndex, firstRow, lastRow );
+	    _shrinkingChildren.erase( _shrinkingChildren.begin() + firstRow,
+				      _shrinkingChildren.begin() + lastRow + 1 );
+	    endRemoveRows();
+	}
+    }
+}
+
+
+void DirTreeModel::childrenDeleted()
+{
+    // The children are gone now, and the rest of them are sorted just like
+    // in the copy (the sort is stable), so the parent's own children list
+    // can take over again.
+
+    _deletingChildren = false;
+    _shrinkingParent  = 0;
+    _shrinkingChildren.clear();
+}
+
+
 void DirTreeModel::clearingSubtree( DirInfo * subtree )
 {
     logDebug() << "Deleting all children of " << subtree << endl;
+    clearFilter();
 
     if ( subtree == _tree->root() || subtree->isTouched() )
     {
@@ -1350,6 +2012,29 @@ void DirTreeModel::invalidatePersistent( FileInfo * subtree,
 }
 
 
+void DirTreeModel::invalidatePersistent( const FileInfoList & subtrees )
+{
+    QSet<FileInfo *> subtreeSet;
+
+    foreach ( FileInfo * subtree, subtrees )
+	subtreeSet.insert( subtree );
+
+    foreach ( const QModelIndex & index, persistentIndexList() )
+    {
+	FileInfo * item = static_cast<FileInfo *>( index.internalPointer() );
+	CHECK_PTR( item );
+
+	bool invalid = ! item->checkMagicNumber();
+
+	for ( FileInfo * ancestor = item; ancestor && ! invalid; ancestor = ancestor->parent() )
+	    invalid = subtreeSet.contains( ancestor );
+
+	if ( invalid )
+	    changePersistentIndex( index, QModelIndex() );
+    }
+}
+
+
 QVariant DirTreeModel::formatPercent( float percent ) const
 {
     QString text = ::formatPercent( percent );
@@ -1361,7 +2046,7 @@ QVariant DirTreeModel::formatPercent( float percent ) const
 }
 
 
-void DirTreeModel::refreshSelected()
+void DirTreeModel::refreshSelected( bool fullDetail )
 {
     CHECK_PTR( _selectionModel );
     FileInfo * sel = _selectionModel->selectedItems().first();
@@ -1380,7 +2065,11 @@ void DirTreeModel::refreshSelected()
 	FileInfoSet refreshSet;
 	refreshSet << sel;
 	_selectionModel->prepareRefresh( refreshSet );
-	_tree->refresh( sel->toDirInfo() );
+
+	if ( fullDetail )
+	    _tree->refreshFullDetail( sel->toDirInfo() );
+	else
+	    _tree->refresh( sel->toDirInfo() );
     }
     else
     {
@@ -13,7 +13,11 @@
 #include <QAbstractItemModel>
 #include <QColor>
 #include <QFont>
+#include <QHash>
 #include <QIcon>
+#include <QList>
+#include <QMutex>
+#include <QPair>
 #include <QSet>
 #include <QTimer>
 #include <QTextStream>
@@ -29,6 +33,7 @@ namespace QDirStat
     class DirTree;
     class DirInfo;
     class SelectionModel;
+    class TreeFilter;
 
     enum CustomRoles
     {
@@ -162,6 +167,14 @@ namespace QDirStat
         QIcon itemTypeIcon( FileInfo * item ) const;
 
 
+    signals:
+
+	/**
+	 * Emitted when a filter was set or filtering was switched off.
+	 **/
+	void filterChanged();
+
+
     public slots:
 	/**
 	 * Open a directory URL.
@@ -222,8 +235,12 @@ namespace QDirStat
 	/**
 	 * Refresh the selected items: Re-read their contents from disk.
 	 * This requires a selection model to be set.
+	 *
+	 * If 'fullDetail' is 'true', the files of the selected directory are
+	 * all read as individual items even if they are below the small file
+	 * threshold.
 	 **/
-	void refreshSelected();
+	void refreshSelected( bool fullDetail = false );
 
 	/**
 	 * Set the update speed to slow (3 sec instead of 333 millisec).
@@ -235,6 +252,39 @@ namespace QDirStat
 	 **/
 	bool slowUpdate() const { return _slowUpdate; }
 
+	/**
+	 * Notification that the compression information (see
+	 * CompressionAnalyzer) of 'dir' or its direct children changed.
+	 **/
+	void compressionChanged( DirInfo * dir );
+
+	/**
+	 * Set a filter for the tree: Only items that match the filter (and
+	 * the directories leading to them) are shown, and directories show
+	 * the filtered sizes and file counts. The model takes over ownership
+	 * of the filter. The filter is applied to the tree in another thread;
+	 * until that is finished, the previous filter (if any) remains in
+	 * effect. filterChanged() is emitted when the new filter is in place.
+	 *
+	 * A filter that is not active or 0 switches filtering off right away.
+	 *
+	 * Any change in the tree (reading, refreshing, deleting) also
+	 * switches filtering off.
+	 **/
+	void setFilter( TreeFilter * filter );
+
+	/**
+	 * Switch filtering off.
+	 **/
+	void clearFilter() { setFilter( 0 ); }
+
+	/**
+	 * Notification from the worker thread that 'filter' was applied for
+	 * the setFilter() call with 'generation', or that applying it was
+	 * cancelled if 'filter' is 0. This takes over ownership of 'filter'.
+	 **/
+	void filterReady( int generation, TreeFilter * filter );
+
 
     public:
 
@@ -269,6 +319,23 @@ namespace QDirStat
 	 **/
 	QModelIndex modelIndex( FileInfo * item, int column = 0 ) const;
 
+	/**
+	 * Return the model indexes of all directories that need to be
+	 * expanded to show the tree down to 'level', but not more than
+	 * 'maxCount'. Level 1 is the toplevel directory. Parents always come
+	 * before their children in the result.
+	 *
+	 * The children of those directories are sorted in advance (level by
+	 * level in parallel jobs) so the view does not need to do that one by
+	 * one while it is expanding them.
+	 **/
+	QModelIndexList indexesToExpand( int level, int maxCount );
+
+	/**
+	 * Return the current filter or 0 if there is none.
+	 **/
+	const TreeFilter * filter() const { return _filter; }
+
 	/**
 	 * Return the current sort column.
 	 **/
@@ -294,6 +361,25 @@ namespace QDirStat
 	 **/
 	virtual int columnCount( const QModelIndex & parent ) const Q_DECL_OVERRIDE;
 
+	/**
+	 * Return 'true' if 'parent' has any children or if it is a package
+	 * whose file list is not read yet, so the view can offer to expand
+	 * it.
+	 **/
+	virtual bool hasChildren( const QModelIndex & parent = QModelIndex() ) const Q_DECL_OVERRIDE;
+
+	/**
+	 * Return 'true' if 'parent' is a package whose file list is not read
+	 * yet.
+	 **/
+	virtual bool canFetchMore( const QModelIndex & parent ) const Q_DECL_OVERRIDE;
+
+	/**
+	 * Start reading the file list of package 'parent'. The view calls
+	 * this when the package is expanded.
+	 **/
+	virtual void fetchMore( const QModelIndex & parent ) Q_DECL_OVERRIDE;
+
 	/**
 	 * Return data to be displayed for the specified model index and role.
 	 **/
@@ -362,6 +448,12 @@ namespace QDirStat
 
     protected slots:
 
+	/**
+	 * Use the filter that the worker thread applied last if it is still
+	 * wanted.
+	 **/
+	void filterApplied();
+
 	/**
 	 * Fix up sort order while reading: Sort by read jobs if the sort
 	 * column is the PercentBarCol.
@@ -411,6 +503,19 @@ namespace QDirStat
 	 **/
 	void childDeleted();
 
+	/**
+	 * Notification that 'children' of 'parent' are about to be deleted
+	 * all at once. This removes their rows right away, one range of
+	 * adjacent rows after the other.
+	 **/
+	void deletingChildren( DirInfo * parent, const FileInfoList & children );
+
+	/**
+	 * Notification that deleting the children from deletingChildren() is
+	 * done.
+	 **/
+	void childrenDeleted();
+
 	/**
 	 * Notification that a subtree is about to be cleared.
 	 **/
@@ -428,6 +533,13 @@ namespace QDirStat
 	void invalidatePersistent( FileInfo * subtree,
 				   bool	      includeParent );
 
+	/**
+	 * Invalidate all persistent indexes in any of 'subtrees', including
+	 * the subtrees themselves. This goes through the persistent indexes
+	 * only once.
+	 **/
+	void invalidatePersistent( const FileInfoList & subtrees );
+
     protected:
 	/**
 	 * Create a new tree (and delete the old one if there is one)
@@ -486,11 +598,59 @@ namespace QDirStat
 	 **/
 	int directChildrenCount( FileInfo * subtree ) const;
 
+	/**
+	 * Sort the children of all 'dirs' with the current sort column and
+	 * order so the sort caches are up to date. Many directories are
+	 * sorted in parallel jobs into separate lists which are installed as
+	 * the sort caches when all jobs are done. The tree needs to be frozen
+	 * for this (see DirTree::snapshot()), and none of the directories may
+	 * be an ancestor of another one.
+	 **/
+	void sortChildren( const QList<DirInfo *> & dirList );
+
+	/**
+	 * Return the children of 'parent' in the current sort order (plus the
+	 * attic if there is one). If there is a filter, this contains only
+	 * those that are visible with that filter.
+	 **/
+	const FileInfoList & childrenList( DirInfo * parent ) const;
+
+	/**
+	 * Return the percentage of 'item' of its parent's total size for the
+	 * percent bar and the percent column, or -1.0 if there is none. If
+	 * there is a filter, this uses the filtered sizes.
+	 **/
+	float subtreePercent( FileInfo * item ) const;
+
 	/**
 	 * Return the text for the size for 'item'
 	 **/
 	QVariant sizeColText( FileInfo * item ) const;
 
+	/**
+	 * Return the text for the growth of 'item' within growth window
+	 * no. 'window' (see GrowthHistory).
+	 **/
+	QVariant growthText( FileInfo * item, int window ) const;
+
+	/**
+	 * Return the header text for the column for growth window
+	 * no. 'window'.
+	 **/
+	QString growthHeader( int window ) const;
+
+	/**
+	 * Return the text for timestamp 'type' of 'item' or QVariant() if it
+	 * does not have that timestamp (see FileInfo::hasExtendedTimes()).
+	 **/
+	QVariant extTimeText( FileInfo * item, FileTimeType type ) const;
+
+	/**
+	 * Return the text for the compression column 'col' for 'item' (see
+	 * CompressionAnalyzer) or QVariant() if it was not analyzed.
+	 **/
+	QVariant compressionText( FileInfo * item, int col ) const;
+
 	/**
 	 * Format a percentage value as string if it is non-negative.
 	 * Return QVariant() if it is negative.
@@ -532,7 +692,24 @@ namespace QDirStat
 	DataColumn	 _sortCol;
 	Qt::SortOrder	 _sortOrder;
 	bool		 _removingRows;
+	bool		 _deletingChildren;
 	bool		 _useBoldForDominantItems;
+	TreeFilter *	 _filter;
+	int		 _filterGeneration;
+
+	// Filters applied in a worker thread that were not picked up yet
+
+	typedef QPair<int, TreeFilter *> ReadyFilter;	// generation, filter
+
+	QList<ReadyFilter> _readyFilters;
+	QMutex		   _readyFiltersMutex;
+
+	// Cache for the visible children while there is a filter
+	mutable QHash<DirInfo *, FileInfoList> _filteredChildren;
+
+	// The rows of a parent whose children are being deleted
+	DirInfo *	 _shrinkingParent;
+	FileInfoList	 _shrinkingChildren;
 
 	// Colors and fonts
 
@@ -28,6 +28,7 @@ using namespace QDirStat;
 
 DirTreeView::DirTreeView( QWidget * parent ):
     QTreeView( parent ),
+    _headerTweaker(0),
     _cleanupCollection(0)
 {
     _percentBarDelegate = new DirTreePercentBarDelegate( this, PercentBarCol );
@@ -117,6 +118,7 @@ void DirTreeView::actionContextMenu( const QPoint & pos, FileInfo * item )
     actions.clear();
     actions << "---"
 	    << "actionRefreshSelected"
+	    << "actionReadInFullDetail"
 	    << "actionReadExcludedDirectory"
 	    << "actionContinueReadingAtMountPoint"
         ;
@@ -245,6 +247,40 @@ void DirTreeView::setExpanded( FileInfo * item, bool expanded )
 }
 
 
+void DirTreeView::expandIndexes( const QModelIndexList & indexes )
+{
+    collapseAll();
+
+    // While a layout is pending, QTreeView::expand() only stores the index
+    // and leaves all the work to that one layout.
+
+    scheduleDelayedItemsLayout();
+
+    foreach ( const QModelIndex & index, indexes )
+	expand( index );
+
+    executeDelayedItemsLayout();
+}
+
+
+void DirTreeView::drawRow( QPainter		       * painter,
+			   const QStyleOptionViewItem & option,
+			   const QModelIndex	       & index ) const
+{
+    QTreeView::drawRow( painter, option, index );
+    _headerTweaker->trackCellWidths( option, index );
+}
+
+
+void DirTreeView::reset()
+{
+    QTreeView::reset();
+
+    if ( _headerTweaker )
+	_headerTweaker->resetCellWidths();
+}
+
+
 void DirTreeView::mousePressEvent( QMouseEvent * event )
 {
     if ( event )
@@ -89,6 +89,13 @@ namespace QDirStat
          **/
         void setExpanded( FileInfo * item, bool expanded = true );
 
+	/**
+	 * Collapse all items and then expand all 'indexes' in one batch: The
+	 * layout of the view is only updated once at the end, not for each
+	 * item separately.
+	 **/
+	void expandIndexes( const QModelIndexList & indexes );
+
 
     public slots:
 
@@ -148,6 +155,23 @@ namespace QDirStat
          **/
         virtual void mousePressEvent( QMouseEvent * event ) Q_DECL_OVERRIDE;
 
+	/**
+	 * Paint one row. This also lets the header tweaker know about the
+	 * widths of the cells for the auto size columns.
+	 *
+	 * Reimplemented from QTreeView.
+	 **/
+	virtual void drawRow( QPainter		     * painter,
+			      const QStyleOptionViewItem & option,
+			      const QModelIndex	     & index ) const Q_DECL_OVERRIDE;
+
+	/**
+	 * Reset the view after the model was reset.
+	 *
+	 * Reimplemented from QTreeView.
+	 **/
+	virtual void reset() Q_DECL_OVERRIDE;
+
 
 	// Data members
 
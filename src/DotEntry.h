@@ -25,6 +25,18 @@ namespace QDirStat
      * basic idea is keep the direct file children of a directory in one
      * container so their total size can easily be compared to any of the
      * subdirectories.
+     *
+     * A dot entry is only created for a directory that has both files and
+     * subdirectories when it is finalized (see
+     * DirInfo::createNeededDotEntry()); while reading, and in directories
+     * with only files, the files are direct children of the directory.
+     *
+     * Notice that a dot entry is still a complete DirInfo with all its
+     * summary fields, and so is an attic. Those directories with both
+     * files and subdirectories pay the same memory as before. Making the
+     * <Files> and <Ignored> groups mere partitions of the parent's children
+     * list would need another way to identify them in the model indexes,
+     * the selection and the treemap, which all use FileInfo pointers.
      **/
     class DotEntry: public DirInfo
     {
@@ -93,7 +93,7 @@ PkgInfoList DpkgPkgManager::installedPkg()
     QString output = runCommand( "/usr/bin/dpkg-query",
 				 QStringList()
 				 << "--show"
-				 << "--showformat=${Package} | ${Version} | ${Architecture} | ${Status}\n",
+				 << "--showformat=${Package} | ${Version} | ${Architecture} | ${Status} | ${Installed-Size}\n",
 				 &exitCode );
 
     PkgInfoList pkgList;
@@ -115,7 +115,7 @@ PkgInfoList DpkgPkgManager::parsePkgList( const QString & output )
 	{
 	    QStringList fields = line.split( " | ", QString::KeepEmptyParts );
 
-	    if ( fields.size() != 4 )
+	    if ( fields.size() != 5 )
 		logError() << "Invalid dpkg-query output: \"" << line << "\n" << endl;
 	    else
 	    {
@@ -123,12 +123,14 @@ PkgInfoList DpkgPkgManager::parsePkgList( const QString & output )
 		QString version = fields.takeFirst();
 		QString arch	= fields.takeFirst();
 		QString status	= fields.takeFirst();
+		QString size	= fields.takeFirst();	// KiB; may be empty
 
 		if ( status == "install ok installed" ||
                      status == "hold ok installed"       )
 		{
 		    PkgInfo * pkg = new PkgInfo( name, version, arch, this );
 		    CHECK_NEW( pkg );
+		    pkg->setDbSize( size.toLongLong() * 1024 );
 
 		    pkgList << pkg;
 		}
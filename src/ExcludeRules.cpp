@@ -92,6 +92,18 @@ bool ExcludeRule::matchDirectChildren( DirInfo * dir )
 }
 
 
+bool ExcludeRule::matchDirectChild( const QString & fileName )
+{
+    if ( ! _checkAnyFileChild || fileName.isEmpty() )
+        return false;
+
+    if ( _regexp.pattern().isEmpty() )
+        return false;
+
+    return _regexp.exactMatch( fileName );
+}
+
+
 //
 //---------------------------------------------------------------------------
 //
@@ -237,6 +249,18 @@ bool ExcludeRules::matchDirectChildren( DirInfo * dir )
 }
 
 
+bool ExcludeRules::matchDirectChild( const QString & fileName )
+{
+    foreach ( ExcludeRule * rule, _rules )
+    {
+	if ( rule->matchDirectChild( fileName ) )
+	    return true;
+    }
+
+    return false;
+}
+
+
 const ExcludeRule * ExcludeRules::matchingRule( const QString & fullPath,
 						const QString & fileName )
 {
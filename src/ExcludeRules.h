@@ -84,6 +84,15 @@ namespace QDirStat
          **/
         bool matchDirectChildren( DirInfo * dir );
 
+        /**
+         * If this exclude rule has the 'checkAnyFileChild' flag set, check if
+         * a single non-directory child with name 'fileName' would match the
+         * rule. This is useful before that child is even created.
+         *
+         * This returns 'false' immediately if 'checkAnyFileChild' is not set.
+         **/
+        bool matchDirectChild( const QString & fileName );
+
 	/**
 	 * Returns this rule's regular expression.
 	 **/
@@ -217,6 +226,14 @@ namespace QDirStat
          **/
         bool matchDirectChildren( DirInfo * dir );
 
+        /**
+         * Check a single non-directory child with name 'fileName' against
+         * any rules that have the 'checkAnyFileChild' flag set.
+         *
+	 * This will return 'true' if the name matches any rule.
+         **/
+        bool matchDirectChild( const QString & fileName );
+
 	/**
 	 * Find the exclude rule that matches 'text'.
 	 * Return 0 if there is no match.
@@ -7,9 +7,15 @@
  */
 
 
-#include <QFileSystemModel>
+#include <QStringListModel>
+#include <QWidget>
 
 #include "ExistingDirCompleter.h"
+#include "ExistingDirLister.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "Attic.h"
+#include "MountPoints.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -17,17 +23,27 @@
 using namespace QDirStat;
 
 
-ExistingDirCompleter::ExistingDirCompleter( QObject * parent ):
-    QCompleter( parent )
+/**
+ * Return the path of 'name' in directory 'dir'.
+ **/
+static QString childPath( const QString & dir, const QString & name )
 {
-    QFileSystemModel * model = new QFileSystemModel( this );
-    CHECK_NEW( model );
+    return dir.endsWith( "/" ) ? dir + name : dir + "/" + name;
+}
+
+
+ExistingDirCompleter::ExistingDirCompleter( QObject * parent, DirTree * tree ):
+    QCompleter( parent ),
+    _tree( tree )
+{
+    _model = new QStringListModel( this );
+    CHECK_NEW( _model );
 
-    model->setRootPath( "/" );
-    model->setFilter( QDir::Dirs );
-    model->setReadOnly( true );
+    setModel( _model );
+    setModelSorting( QCompleter::CaseSensitivelySortedModel );
 
-    setModel( model );
+    connect( ExistingDirLister::instance(), SIGNAL( dirListed( QString, QStringList, bool ) ),
+	     this,			    SLOT  ( dirListed( QString, QStringList, bool ) ) );
 }
 
 
@@ -36,3 +52,111 @@ ExistingDirCompleter::~ExistingDirCompleter()
     // NOP
 }
 
+
+void ExistingDirCompleter::updateCompletions( const QString & path )
+{
+    if ( ! path.startsWith( "/" ) )
+	return;
+
+    QString dir = path.left( path.lastIndexOf( '/' ) );
+
+    if ( dir.isEmpty() )
+	dir = "/";
+
+    if ( dir == _dir )
+	return;
+
+    _dir = dir;
+    QStringList subDirs;
+
+    if ( subDirsFromTree( dir, subDirs ) )
+    {
+	setCompletions( subDirs );
+	return;
+    }
+
+    // Show the mount points right away; everything else comes later from
+    // the worker thread.
+
+    addMountPoints( dir, subDirs );
+    setCompletions( subDirs );
+
+    ExistingDirLister::instance()->listDir( dir );
+}
+
+
+bool ExistingDirCompleter::subDirsFromTree( const QString & dir, QStringList & subDirs ) const
+{
+    if ( ! _tree )
+	return false;
+
+    FileInfo * item = _tree->locate( dir );
+
+    if ( ! item || ! item->isDirInfo() )
+	return false;
+
+    // Only use directories that were read completely
+
+    if ( item->readState() != DirFinished && item->readState() != DirCached )
+	return false;
+
+    DirInfo * dirInfo = item->toDirInfo();
+
+    for ( FileInfo * child = dirInfo->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDir() && ! child->isPseudoDir() )
+	    subDirs << childPath( dir, child->name() );
+    }
+
+    if ( dirInfo->attic() )
+    {
+	for ( FileInfo * child = dirInfo->attic()->firstChild(); child; child = child->next() )
+	{
+	    if ( child->isDir() )
+		subDirs << childPath( dir, child->name() );
+	}
+    }
+
+    return true;
+}
+
+
+void ExistingDirCompleter::addMountPoints( const QString & dir, QStringList & subDirs ) const
+{
+    foreach ( MountPoint * mountPoint, MountPoints::normalMountPoints() )
+    {
+	QString path = mountPoint->path();
+
+	if ( path != dir && path.left( path.lastIndexOf( '/' ) ) == ( dir == "/" ? "" : dir ) )
+	    subDirs << path;
+    }
+}
+
+
+void ExistingDirCompleter::setCompletions( const QStringList & subDirs )
+{
+    QStringList sortedSubDirs = subDirs;
+    sortedSubDirs.removeDuplicates();
+    sortedSubDirs.sort();
+
+    _model->setStringList( sortedSubDirs );
+}
+
+
+void ExistingDirCompleter::dirListed( const QString & dir, const QStringList & subDirs, bool ok )
+{
+    // Ignore it if the user is typing somewhere else by now; if it failed,
+    // keep the mount points.
+
+    if ( dir != _dir || ! ok )
+	return;
+
+    QStringList allSubDirs = subDirs;
+    addMountPoints( dir, allSubDirs );
+    setCompletions( allSubDirs );
+
+    // The results came in late; show them now if the user is still there
+
+    if ( widget() && widget()->hasFocus() && ! allSubDirs.isEmpty() )
+	complete();
+}
@@ -12,14 +12,29 @@
 
 
 #include <QCompleter>
+#include <QPointer>
+#include <QStringList>
+
+class QStringListModel;
 
 
 namespace QDirStat
 {
+    class DirTree;
+
     /**
      * Completer class for QCombobox and related to complete names of existing
      * directories.
      *
+     * Unlike a QFileSystemModel, this never accesses the filesystem in the
+     * GUI thread and never watches any directories: The subdirectories of a
+     * directory are taken from the DirTree that is currently loaded (if it
+     * contains that directory) and from the mount points. For other
+     * directories, they are read by the ExistingDirLister in a worker thread
+     * with a time limit, so a dead network mount never blocks the dialog;
+     * the completions just don't show up for it.
+     *
+     * Connect the text change signal of the widget to updateCompletions().
      * See ShowUnpkgFilesDialog for a usage example.
      **/
     class ExistingDirCompleter: public QCompleter
@@ -29,15 +44,58 @@ namespace QDirStat
     public:
 
         /**
-         * Constructor.
+         * Constructor. 'tree' is the directory tree to use for the
+         * completions if it contains the directory the user is typing in.
+         * It may be 0.
          **/
-        ExistingDirCompleter( QObject * parent );
+        ExistingDirCompleter( QObject * parent, DirTree * tree = 0 );
 
         /**
          * Destructor.
          **/
         virtual ~ExistingDirCompleter();
 
+
+    public slots:
+
+        /**
+         * Update the model for the text 'path' of the widget if the user
+         * started typing in a different directory.
+         **/
+        void updateCompletions( const QString & path );
+
+
+    protected slots:
+
+        /**
+         * Notification that the ExistingDirLister read a directory.
+         **/
+        void dirListed( const QString & dir, const QStringList & subDirs, bool ok );
+
+
+    protected:
+
+        /**
+         * Get the subdirectories of 'dir' from the loaded tree.
+         * Return 'false' if the tree does not contain 'dir' completely.
+         **/
+        bool subDirsFromTree( const QString & dir, QStringList & subDirs ) const;
+
+        /**
+         * Add the mount points directly below 'dir' to 'subDirs'.
+         **/
+        void addMountPoints( const QString & dir, QStringList & subDirs ) const;
+
+        /**
+         * Set the completions to 'subDirs'.
+         **/
+        void setCompletions( const QStringList & subDirs );
+
+
+        QPointer<DirTree>       _tree;
+        QStringListModel *      _model;
+        QString                 _dir;
+
     };  // class ExistingDirCompleter
 
 }       // namespace QDirStat
@@ -0,0 +1,309 @@
+/*
+ *   File name: ExistingDirLister.cpp
+ *   Summary:	QDirStat widget support classes
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <QFile>
+#include <QThreadPool>
+
+#include "ExistingDirLister.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Time limit for each request, including the time it waits in the queue
+#define DIR_LIST_TIMEOUT_MILLISEC	1500
+
+// Maximum number of subdirectories to read from one directory
+#define DIR_LIST_MAX_SUBDIRS		5000
+
+// Number of threads for the jobs
+#define DIR_LIST_THREADS		4
+
+// Maximum number of additional threads for threads that hang on a dead
+// network mount
+#define DIR_LIST_MAX_HUNG_THREADS	8
+
+// Interval for checking the deadlines
+#define DEADLINE_CHECK_MILLISEC		100
+
+
+using namespace QDirStat;
+
+
+ExistingDirLister * ExistingDirLister::_instance = 0;
+
+
+/**
+ * Return the path of 'name' in directory 'dir'.
+ **/
+static QString childPath( const QString & dir, const QString & name )
+{
+    return dir.endsWith( "/" ) ? dir + name : dir + "/" + name;
+}
+
+
+
+
+ExistingDirLister * ExistingDirLister::instance()
+{
+    if ( ! _instance )
+    {
+	_instance = new ExistingDirLister();
+	CHECK_NEW( _instance );
+    }
+
+    return _instance;
+}
+
+
+ExistingDirLister::ExistingDirLister():
+    QObject(),
+    _nextId( 0 )
+{
+    // The pool is intentionally never deleted: The QThreadPool destructor
+    // would wait for any threads that hang on dead network mounts.
+
+    _pool = new QThreadPool();
+    CHECK_NEW( _pool );
+
+    _pool->setMaxThreadCount( DIR_LIST_THREADS );
+
+    _timer.setInterval( DEADLINE_CHECK_MILLISEC );
+
+    connect( &_timer, SIGNAL( timeout()	    ),
+	     this,    SLOT  ( checkDeadlines() ) );
+}
+
+
+ExistingDirLister::~ExistingDirLister()
+{
+    // NOP
+}
+
+
+void ExistingDirLister::listDir( const QString & dir )
+{
+    startJob( dir, true );
+}
+
+
+void ExistingDirLister::checkDir( const QString & dir )
+{
+    startJob( dir, false );
+}
+
+
+void ExistingDirLister::startJob( const QString & dir, bool listSubDirs )
+{
+    foreach ( const PendingJob & pending, _pending )
+    {
+	if ( pending.dir == dir && pending.listSubDirs == listSubDirs )
+	    return;
+    }
+
+    int id = _nextId++;
+
+    PendingJob pending;
+    pending.dir		= dir;
+    pending.listSubDirs = listSubDirs;
+    pending.state	= DirListJobStatePtr( new DirListJobState() );
+    pending.timer.start();
+
+    _pending.insert( id, pending );
+
+    DirListJob * job = new DirListJob( this, id, dir, listSubDirs, pending.state );
+    CHECK_NEW( job );
+
+    _pool->start( job );	// the pool deletes the job when it is done
+
+    if ( ! _timer.isActive() )
+	_timer.start();
+}
+
+
+void ExistingDirLister::jobFinished( int		 id,
+				     const QStringList & subDirs,
+				     bool		 ok )
+{
+    if ( _hung.remove( id ) )
+    {
+	// A job that hung came back after all; its result was already
+	// reported as failed.
+
+	adjustPool();
+	return;
+    }
+
+    if ( ! _pending.contains( id ) ) // abandoned before it started
+	return;
+
+    PendingJob pending = _pending.take( id );
+    report( pending.dir, pending.listSubDirs, subDirs, ok );
+
+    if ( _pending.isEmpty() )
+	_timer.stop();
+}
+
+
+void ExistingDirLister::checkDeadlines()
+{
+    QList<PendingJob> expired;
+
+    foreach ( int id, _pending.keys() )
+    {
+	const PendingJob & pending = _pending[ id ];
+
+	if ( pending.timer.elapsed() < DIR_LIST_TIMEOUT_MILLISEC )
+	    continue;
+
+	pending.state->abandoned.fetchAndStoreOrdered( 1 );
+
+	if ( pending.state->started.fetchAndAddOrdered( 0 ) )
+	{
+	    logWarning() << "Timeout reading " << pending.dir << endl;
+
+	    // That thread might hang forever; a started job always reports
+	    // back when it is done.
+
+	    _hung.insert( id );
+	}
+
+	expired << _pending.take( id );
+    }
+
+    if ( _pending.isEmpty() )
+	_timer.stop();
+
+    if ( ! expired.isEmpty() )
+    {
+	adjustPool();
+
+	foreach ( const PendingJob & pending, expired )
+	    report( pending.dir, pending.listSubDirs, QStringList(), false );
+    }
+}
+
+
+void ExistingDirLister::report( const QString &	    dir,
+				bool		    listSubDirs,
+				const QStringList & subDirs,
+				bool		    ok )
+{
+    if ( listSubDirs )
+	emit dirListed( dir, subDirs, ok );
+    else
+	emit dirChecked( dir, ok );
+}
+
+
+void ExistingDirLister::adjustPool()
+{
+    _pool->setMaxThreadCount( DIR_LIST_THREADS +
+			      qMin( _hung.size(), DIR_LIST_MAX_HUNG_THREADS ) );
+}
+
+
+
+
+DirListJob::DirListJob( ExistingDirLister * lister,
+			int		    id,
+			const QString &	    dir,
+			bool		    listSubDirs,
+			DirListJobStatePtr  state ):
+    QRunnable(),
+    _lister( lister ),
+    _id( id ),
+    _dir( dir ),
+    _listSubDirs( listSubDirs ),
+    _state( state )
+{
+    setAutoDelete( true );
+}
+
+
+void DirListJob::run()
+{
+    _state->started.fetchAndStoreOrdered( 1 );
+
+    QStringList subDirs;
+    bool	ok = false;
+
+    if ( ! _state->abandoned.fetchAndAddOrdered( 0 ) )
+    {
+	if ( _listSubDirs )
+	{
+	    ok = readSubDirs( subDirs );
+	}
+	else
+	{
+	    struct stat statInfo;
+	    ok = stat( QFile::encodeName( _dir ).constData(), &statInfo ) == 0 &&
+		S_ISDIR( statInfo.st_mode );
+	}
+    }
+
+    // The lister is never deleted, so this is safe even if the job was
+    // abandoned long ago.
+
+    QMetaObject::invokeMethod( _lister, "jobFinished", Qt::QueuedConnection,
+			       Q_ARG( int,	   _id	   ),
+			       Q_ARG( QStringList, subDirs ),
+			       Q_ARG( bool,	   ok	   ) );
+}
+
+
+bool DirListJob::readSubDirs( QStringList & subDirs )
+{
+    DIR * diskDir = opendir( QFile::encodeName( _dir ).constData() );
+
+    if ( ! diskDir )
+	return false;
+
+    struct dirent * entry;
+
+    while ( ( entry = readdir( diskDir ) ) &&
+	    subDirs.size() < DIR_LIST_MAX_SUBDIRS )
+    {
+	if ( _state->abandoned.fetchAndAddOrdered( 0 ) )
+	    break;
+
+	QString name = QFile::decodeName( entry->d_name );
+
+	if ( name == "." || name == ".." )
+	    continue;
+
+	QString path = childPath( _dir, name );
+
+	// Only use entries that the filesystem reports as directories
+	// without an lstat() call; only if it can't tell, ask it.
+
+	if ( entry->d_type == DT_UNKNOWN )
+	{
+	    struct stat statInfo;
+
+	    if ( lstat( QFile::encodeName( path ).constData(), &statInfo ) != 0 ||
+		 ! S_ISDIR( statInfo.st_mode ) )
+	    {
+		continue;
+	    }
+	}
+	else if ( entry->d_type != DT_DIR )
+	{
+	    continue;
+	}
+
+	subDirs << path;
+    }
+
+    closedir( diskDir );
+
+    return true;
+}
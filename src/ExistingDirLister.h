@@ -0,0 +1,212 @@
+/*
+ *   File name: ExistingDirLister.h
+ *   Summary:	QDirStat widget support classes
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ExistingDirLister_h
+#define ExistingDirLister_h
+
+
+#include <QObject>
+#include <QRunnable>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QSharedPointer>
+#include <QAtomicInt>
+
+class QThreadPool;
+
+
+namespace QDirStat
+{
+    /**
+     * State of a DirListJob that is shared with the ExistingDirLister.
+     **/
+    struct DirListJobState
+    {
+	DirListJobState(): started( 0 ), abandoned( 0 ) {}
+
+	QAtomicInt started;
+	QAtomicInt abandoned;
+    };
+
+    typedef QSharedPointer<DirListJobState> DirListJobStatePtr;
+
+
+    /**
+     * Access to the filesystem for the widgets that let the user pick an
+     * existing directory (ExistingDirCompleter, ExistingDirValidator,
+     * ExistingDirModel): Read the subdirectories of a directory or check if
+     * a directory exists.
+     *
+     * This is never done in the GUI thread: A dead network mount would
+     * block the dialog. The jobs run in a thread pool with a few threads,
+     * and each request has a deadline. When it passes, the request is
+     * reported as failed and its job is abandoned: If it did not start
+     * yet, it does nothing when it starts; if it hangs in a system call, the
+     * pool gets an additional thread instead, up to a limit.
+     *
+     * This is a singleton class.
+     **/
+    class ExistingDirLister: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Return the singleton instance of this class.
+	 **/
+	static ExistingDirLister * instance();
+
+	/**
+	 * Request the subdirectories of 'dir'. The result is reported with
+	 * dirListed().
+	 **/
+	void listDir( const QString & dir );
+
+	/**
+	 * Request a check if 'dir' exists and is a directory. The result is
+	 * reported with dirChecked().
+	 **/
+	void checkDir( const QString & dir );
+
+
+    signals:
+
+	/**
+	 * The subdirectories of 'dir' were read. 'ok' is 'false' if 'dir'
+	 * could not be read or if that did not finish in time.
+	 **/
+	void dirListed( const QString & dir, const QStringList & subDirs, bool ok );
+
+	/**
+	 * 'dir' was checked. 'exists' is 'false' if it is not a directory
+	 * or if the check did not finish in time.
+	 **/
+	void dirChecked( const QString & dir, bool exists );
+
+
+    protected slots:
+
+	/**
+	 * Notification that a job is finished. This is called from the worker
+	 * threads via a queued connection.
+	 **/
+	void jobFinished( int		      id,
+			  const QStringList & subDirs,
+			  bool		      ok );
+
+	/**
+	 * Abandon all requests whose deadline passed.
+	 **/
+	void checkDeadlines();
+
+
+    protected:
+
+	/**
+	 * Constructor. Use instance() instead.
+	 **/
+	ExistingDirLister();
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~ExistingDirLister();
+
+	/**
+	 * Start a job for 'dir' unless there already is one for it.
+	 **/
+	void startJob( const QString & dir, bool listSubDirs );
+
+	/**
+	 * Report the result of a request.
+	 **/
+	void report( const QString &	 dir,
+		     bool		 listSubDirs,
+		     const QStringList & subDirs,
+		     bool		 ok );
+
+	/**
+	 * Set the number of threads of the pool according to the number of
+	 * threads that hang.
+	 **/
+	void adjustPool();
+
+
+	/**
+	 * A request that is not finished yet.
+	 **/
+	struct PendingJob
+	{
+	    QString		dir;
+	    bool		listSubDirs;
+	    QElapsedTimer	timer;
+	    DirListJobStatePtr	state;
+	};
+
+
+	static ExistingDirLister *	_instance;
+
+	QThreadPool *			_pool;
+	QHash<int, PendingJob>		_pending;
+	QSet<int>			_hung;
+	int				_nextId;
+	QTimer				_timer;
+
+    };	// class ExistingDirLister
+
+
+
+    /**
+     * Job to read the subdirectories of a directory or to check if it
+     * exists in a worker thread for the ExistingDirLister.
+     **/
+    class DirListJob: public QRunnable
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	DirListJob( ExistingDirLister * lister,
+		    int			id,
+		    const QString &	dir,
+		    bool		listSubDirs,
+		    DirListJobStatePtr	state );
+
+	/**
+	 * Read or check the directory. This is called in the worker thread.
+	 *
+	 * Reimplemented from QRunnable.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+    protected:
+
+	/**
+	 * Read the subdirectories of the directory into 'subDirs'.
+	 * Return 'false' if it can't be read.
+	 **/
+	bool readSubDirs( QStringList & subDirs );
+
+
+	ExistingDirLister *	_lister;
+	int			_id;
+	QString			_dir;
+	bool			_listSubDirs;
+	DirListJobStatePtr	_state;
+
+    };	// class DirListJob
+
+}	// namespace QDirStat
+
+#endif	// ExistingDirLister_h
@@ -0,0 +1,201 @@
+/*
+ *   File name: ExistingDirModel.cpp
+ *   Summary:	QDirStat widget support classes
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <algorithm>	// std::sort()
+
+#include <QFileIconProvider>
+
+#include "ExistingDirModel.h"
+#include "ExistingDirLister.h"
+#include "Logger.h"
+#include "Exception.h"
+
+#define PathRole	Qt::UserRole
+
+
+using namespace QDirStat;
+
+
+static bool lessThanCaseInsensitive( const QString & a, const QString & b )
+{
+    return QString::compare( a, b, Qt::CaseInsensitive ) < 0;
+}
+
+
+
+
+ExistingDirModel::ExistingDirModel( QObject * parent ):
+    QStandardItemModel( parent ),
+    _dirIcon( QFileIconProvider().icon( QFileIconProvider::Folder ) )
+{
+    QStandardItem * root = new QStandardItem( _dirIcon, "/" );
+    CHECK_NEW( root );
+
+    root->setData( "/", PathRole );
+    root->setEditable( false );
+    invisibleRootItem()->appendRow( root );
+    _items.insert( "/", root );
+
+    connect( ExistingDirLister::instance(), SIGNAL( dirListed( QString, QStringList, bool ) ),
+	     this,			    SLOT  ( dirListed( QString, QStringList, bool ) ) );
+}
+
+
+ExistingDirModel::~ExistingDirModel()
+{
+    // NOP
+}
+
+
+QModelIndex ExistingDirModel::indexForPath( const QString & path )
+{
+    if ( ! path.startsWith( "/" ) )
+	return QModelIndex();
+
+    QStandardItem * item = _items.value( "/" );
+
+    foreach ( const QString & name, path.split( "/", QString::SkipEmptyParts ) )
+    {
+	fetch( item );
+	item = childItem( item, name );
+    }
+
+    return item->index();
+}
+
+
+QString ExistingDirModel::path( const QModelIndex & index ) const
+{
+    return index.data( PathRole ).toString();
+}
+
+
+bool ExistingDirModel::hasChildren( const QModelIndex & parent ) const
+{
+    if ( canFetchMore( parent ) )
+	return true;	// Maybe; we'll know when it is read
+
+    return QStandardItemModel::hasChildren( parent );
+}
+
+
+bool ExistingDirModel::canFetchMore( const QModelIndex & parent ) const
+{
+    return parent.isValid() && ! _fetched.contains( path( parent ) );
+}
+
+
+void ExistingDirModel::fetchMore( const QModelIndex & parent )
+{
+    QStandardItem * item = itemFromIndex( parent );
+
+    if ( item )
+	fetch( item );
+}
+
+
+void ExistingDirModel::fetch( QStandardItem * item )
+{
+    QString dir = item->data( PathRole ).toString();
+
+    if ( _fetched.contains( dir ) )
+	return;
+
+    // A directory that can't be read in time is not tried again; it simply
+    // has no children.
+
+    _fetched.insert( dir );
+    ExistingDirLister::instance()->listDir( dir );
+}
+
+
+QStandardItem * ExistingDirModel::childItem( QStandardItem * parent, const QString & name )
+{
+    QString parentPath = parent->data( PathRole ).toString();
+    QString path       = parentPath.endsWith( "/" ) ? parentPath + name : parentPath + "/" + name;
+
+    QStandardItem * item = _items.value( path );
+
+    if ( item )
+	return item;
+
+    item = new QStandardItem( _dirIcon, name );
+    CHECK_NEW( item );
+
+    item->setData( path, PathRole );
+    item->setEditable( false );
+    _items.insert( path, item );
+
+    int row = 0;
+
+    while ( row < parent->rowCount() &&
+	    lessThanCaseInsensitive( parent->child( row )->text(), name ) )
+    {
+	++row;
+    }
+
+    parent->insertRow( row, item );
+
+    return item;
+}
+
+
+void ExistingDirModel::dirListed( const QString & dir, const QStringList & subDirs, bool ok )
+{
+    QStandardItem * parent = _items.value( dir );
+
+    if ( ! parent )
+	return;
+
+    if ( ! ok )
+    {
+	logWarning() << "Can't read " << dir << endl;
+	return;
+    }
+
+    QStringList names;
+
+    foreach ( const QString & subDir, subDirs )
+    {
+	QString name = subDir.mid( subDir.lastIndexOf( '/' ) + 1 );
+
+	if ( ! name.startsWith( "." ) )
+	    names << name;
+    }
+
+    std::sort( names.begin(), names.end(), lessThanCaseInsensitive );
+
+    if ( parent->rowCount() == 0 )
+    {
+	// The usual case: Add them all at once
+
+	QList<QStandardItem *> items;
+	QString prefix = dir.endsWith( "/" ) ? dir : dir + "/";
+
+	foreach ( const QString & name, names )
+	{
+	    QStandardItem * item = new QStandardItem( _dirIcon, name );
+	    CHECK_NEW( item );
+
+	    item->setData( prefix + name, PathRole );
+	    item->setEditable( false );
+	    _items.insert( prefix + name, item );
+	    items << item;
+	}
+
+	parent->appendRows( items );
+    }
+    else
+    {
+	// Some of them were already added for a path that was selected
+
+	foreach ( const QString & name, names )
+	    childItem( parent, name );
+    }
+}
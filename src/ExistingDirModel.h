@@ -0,0 +1,113 @@
+/*
+ *   File name: ExistingDirModel.h
+ *   Summary:	QDirStat widget support classes
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ExistingDirModel_h
+#define ExistingDirModel_h
+
+
+#include <QStandardItemModel>
+#include <QHash>
+#include <QSet>
+#include <QIcon>
+
+
+namespace QDirStat
+{
+    /**
+     * Model for a tree view of the directories of the filesystem, like a
+     * QFileSystemModel restricted to directories, but without any access to
+     * the filesystem in the GUI thread and without watching anything:
+     *
+     * The subdirectories of a directory are read by the ExistingDirLister in
+     * a worker thread when that directory is expanded in the view, and they
+     * are added when they arrive. A directory that can't be read in time
+     * simply has no children. Hidden directories and symlinks are not shown.
+     **/
+    class ExistingDirModel: public QStandardItemModel
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	ExistingDirModel( QObject * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~ExistingDirModel();
+
+	/**
+	 * Return the index for directory 'path'. Items for 'path' and its
+	 * parent directories are created if they are not there yet, and the
+	 * parent directories are read.
+	 **/
+	QModelIndex indexForPath( const QString & path );
+
+	/**
+	 * Return the path of the directory at 'index'.
+	 **/
+	QString path( const QModelIndex & index ) const;
+
+	/**
+	 * Return 'true' if 'parent' has children or might have some.
+	 *
+	 * Reimplemented from QStandardItemModel.
+	 **/
+	virtual bool hasChildren( const QModelIndex & parent = QModelIndex() ) const Q_DECL_OVERRIDE;
+
+	/**
+	 * Return 'true' if the subdirectories of 'parent' were not read yet.
+	 *
+	 * Reimplemented from QAbstractItemModel.
+	 **/
+	virtual bool canFetchMore( const QModelIndex & parent ) const Q_DECL_OVERRIDE;
+
+	/**
+	 * Start reading the subdirectories of 'parent'.
+	 *
+	 * Reimplemented from QAbstractItemModel.
+	 **/
+	virtual void fetchMore( const QModelIndex & parent ) Q_DECL_OVERRIDE;
+
+
+    protected slots:
+
+	/**
+	 * Notification that the ExistingDirLister read a directory.
+	 **/
+	void dirListed( const QString & dir, const QStringList & subDirs, bool ok );
+
+
+    protected:
+
+	/**
+	 * Return the child item 'name' of 'parent', creating it if it does
+	 * not exist yet.
+	 **/
+	QStandardItem * childItem( QStandardItem * parent, const QString & name );
+
+	/**
+	 * Start reading the subdirectories of the directory of 'item' if that
+	 * was not done yet.
+	 **/
+	void fetch( QStandardItem * item );
+
+
+	QHash<QString, QStandardItem *> _items;		// by path
+	QSet<QString>			_fetched;
+	QIcon				_dirIcon;
+
+    };	// class ExistingDirModel
+
+}	// namespace QDirStat
+
+#endif	// ExistingDirModel_h
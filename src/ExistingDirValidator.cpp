@@ -7,9 +7,8 @@
  */
 
 
-#include <QDir>
-
 #include "ExistingDirValidator.h"
+#include "ExistingDirLister.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -18,8 +17,11 @@ using namespace QDirStat;
 
 
 ExistingDirValidator::ExistingDirValidator( QObject * parent ):
-    QValidator( parent )
+    QValidator( parent ),
+    _checkedDirExists( false )
 {
+    connect( ExistingDirLister::instance(), SIGNAL( dirChecked( QString, bool ) ),
+	     this,			    SLOT  ( dirChecked( QString, bool ) ) );
 }
 
 
@@ -34,7 +36,16 @@ ExistingDirValidator::validate( QString & input, int & pos) const
 {
     Q_UNUSED( pos );
 
-    bool ok = ! input.isEmpty() && QDir( input ).exists();
+    _input = input;
+    bool ok = false;
+
+    if ( ! input.isEmpty() )
+    {
+	if ( input == _checkedDir )
+	    ok = _checkedDirExists;
+	else
+	    ExistingDirLister::instance()->checkDir( input );
+    }
 
     // This is a complex way to do
     //    emit isOk( ok );
@@ -42,11 +53,23 @@ ExistingDirValidator::validate( QString & input, int & pos) const
 
     const_cast<ExistingDirValidator *>( this )->isOk( ok );
 
+    return ok ? QValidator::Acceptable : QValidator::Intermediate;
+}
+
+
+void ExistingDirValidator::dirChecked( const QString & dir, bool exists )
+{
 #if 0
-    logDebug() << "Checking \"" << input << "\": "
-               << ( ok ? "OK" : "no such directory" )
+    logDebug() << "Checked \"" << dir << "\": "
+               << ( exists ? "OK" : "no such directory" )
                << endl;
 #endif
 
-    return ok ? QValidator::Acceptable : QValidator::Intermediate;
+    if ( dir != _input )	// The user typed something else in the meantime
+	return;
+
+    _checkedDir	      = dir;
+    _checkedDirExists = exists;
+
+    emit isOk( exists );
 }
@@ -19,6 +19,10 @@ namespace QDirStat
      * Validator class for QCombobox and related to validate names of existing
      * directories.
      *
+     * The check is done by the ExistingDirLister in a worker thread, so a
+     * dead network mount never blocks the GUI. Until the result is there,
+     * the input is considered intermediate; then isOk() is emitted again.
+     *
      * See ShowUnpkgFilesDialog for a usage example.
      **/
     class ExistingDirValidator: public QValidator
@@ -47,6 +51,21 @@ namespace QDirStat
 
 	void isOk( bool ok );
 
+
+    protected slots:
+
+	/**
+	 * Notification that the ExistingDirLister checked 'dir'.
+	 **/
+	void dirChecked( const QString & dir, bool exists );
+
+
+    protected:
+
+	mutable QString	_input;
+	QString		_checkedDir;
+	bool		_checkedDirExists;
+
     };	// class ExistingDirValidator
 
 }	// namespace QDirStat
@@ -0,0 +1,86 @@
+/*
+ *   File name: ExtTimeStore.cpp
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "ExtTimeStore.h"
+
+
+using namespace QDirStat;
+
+
+ExtTimeStore::ExtTimeStore()
+{
+    clear();
+}
+
+
+void ExtTimeStore::clear()
+{
+    _atime.clear();
+    _ctime.clear();
+    _btime.clear();
+    _freeSlots.clear();
+
+    // Slot 0 means "no extended timestamps"
+
+    _atime.append( 0 );
+    _ctime.append( 0 );
+    _btime.append( 0 );
+}
+
+
+quint32 ExtTimeStore::add( time_t atime, time_t ctime, time_t btime )
+{
+    quint32 index;
+
+    if ( _freeSlots.isEmpty() )
+    {
+	index = _atime.size();
+
+	_atime.append( atime );
+	_ctime.append( ctime );
+	_btime.append( btime );
+    }
+    else
+    {
+	index = _freeSlots.last();
+	_freeSlots.removeLast();
+
+	_atime[ index ] = atime;
+	_ctime[ index ] = ctime;
+	_btime[ index ] = btime;
+    }
+
+    return index;
+}
+
+
+void ExtTimeStore::release( quint32 index )
+{
+    if ( ! valid( index ) )
+	return;
+
+    _atime[ index ] = 0;
+    _ctime[ index ] = 0;
+    _btime[ index ] = 0;
+    _freeSlots.append( index );
+
+    if ( count() == 0 )
+    {
+	// All slots are free again: Give the memory back
+
+	clear();
+    }
+}
+
+
+void ExtTimeStore::setBtime( quint32 index, time_t btime )
+{
+    if ( valid( index ) )
+	_btime[ index ] = btime;
+}
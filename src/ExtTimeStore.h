@@ -0,0 +1,95 @@
+/*
+ *   File name: ExtTimeStore.h
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef ExtTimeStore_h
+#define ExtTimeStore_h
+
+
+#include <time.h>	// time_t
+
+#include <QVector>
+
+
+namespace QDirStat
+{
+    /**
+     * Side store for the extended timestamps of the nodes of a DirTree:
+     * Last access time (atime), last status change time (ctime) and
+     * creation time (btime).
+     *
+     * Most users never need those, and storing them in each FileInfo would
+     * add 24 bytes to every single node, i.e. gigabytes for very large
+     * trees. So they are stored here in one array for each timestamp, and
+     * each FileInfo only keeps an index into those arrays (in bytes that
+     * would otherwise be padding). The DirTree only has an instance of this
+     * class if extended timestamps are enabled.
+     *
+     * Index 0 is never used; it means "no extended timestamps".
+     * Slots of deleted nodes are reused for new nodes.
+     **/
+    class ExtTimeStore
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	ExtTimeStore();
+
+	/**
+	 * Add a node with the specified timestamps and return its index.
+	 * This is never 0.
+	 **/
+	quint32 add( time_t atime, time_t ctime, time_t btime = 0 );
+
+	/**
+	 * Release the slot with index 'index' for reuse.
+	 **/
+	void release( quint32 index );
+
+	/**
+	 * Set the creation time of the node with index 'index'.
+	 **/
+	void setBtime( quint32 index, time_t btime );
+
+	/**
+	 * Return the timestamps of the node with index 'index' or 0 if the
+	 * index is invalid. A btime of 0 means unknown.
+	 **/
+	time_t atime( quint32 index ) const { return valid( index ) ? _atime[ index ] : 0; }
+	time_t ctime( quint32 index ) const { return valid( index ) ? _ctime[ index ] : 0; }
+	time_t btime( quint32 index ) const { return valid( index ) ? _btime[ index ] : 0; }
+
+	/**
+	 * Return the number of nodes that currently use a slot.
+	 **/
+	int count() const { return _atime.size() - 1 - _freeSlots.size(); }
+
+	/**
+	 * Remove all nodes.
+	 **/
+	void clear();
+
+
+    protected:
+
+	bool valid( quint32 index ) const
+	    { return index > 0 && index < (quint32) _atime.size(); }
+
+
+	QVector<time_t>	 _atime;
+	QVector<time_t>	 _ctime;
+	QVector<time_t>	 _btime;
+	QVector<quint32> _freeSlots;
+
+    };	// class ExtTimeStore
+
+}	// namespace QDirStat
+
+#endif	// ExtTimeStore_h
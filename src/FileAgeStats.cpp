@@ -7,6 +7,7 @@
  */
 
 #include <algorithm>    // std::sort()
+#include <time.h>       // gmtime()
 #include <QDate>
 
 #include "FileAgeStats.h"
@@ -22,7 +23,8 @@ short FileAgeStats::_thisMonth = 0;
 short FileAgeStats::_lastYear  = 0;
 
 
-FileAgeStats::FileAgeStats( FileInfo * subtree )
+FileAgeStats::FileAgeStats( FileInfo * subtree ):
+    _timeType( ModificationTime )
 {
     clear();
 
@@ -82,11 +84,11 @@ void FileAgeStats::collectRecursive( FileInfo * dir )
     {
 	FileInfo * item = *it;
 
-        if ( item && item->isFile() )
-        {
-            short year  = item->mtimeYear();
-            short month = item->mtimeMonth();
+        short year;
+        short month;
 
+        if ( item && item->isFile() && timeYearMonth( item, year, month ) )
+        {
             YearStats &yearStats = _yearStats[ year ];
 
             yearStats.year = year;
@@ -112,6 +114,32 @@ void FileAgeStats::collectRecursive( FileInfo * dir )
 }
 
 
+bool FileAgeStats::timeYearMonth( FileInfo * item, short & year, short & month ) const
+{
+    if ( _timeType == ModificationTime )
+    {
+        // Use the values that are cached in the FileInfo
+
+        year  = item->mtimeYear();
+        month = item->mtimeMonth();
+
+        return true;
+    }
+
+    time_t time = item->fileTime( _timeType );
+
+    if ( time == 0 )    // No extended timestamps or unknown
+        return false;
+
+    struct tm * time_tm = gmtime( &time );
+
+    year  = time_tm->tm_year + 1900;
+    month = time_tm->tm_mon  + 1;
+
+    return true;
+}
+
+
 void FileAgeStats::calcPercentages()
 {
     // Sum up the totals over all years
@@ -52,6 +52,10 @@ namespace QDirStat
     /**
      * Class for calculating and storing file age statistics, i.e. statistics
      * about the years of the last modification times of files in a subtree.
+     *
+     * With extended timestamps, one of the other timestamps can be used
+     * instead (see setTimeType()). Files that don't have that timestamp are
+     * not counted.
      **/
     class FileAgeStats
     {
@@ -79,6 +83,17 @@ namespace QDirStat
          **/
         void clear();
 
+        /**
+         * Set the timestamp to use for the statistics. This takes effect
+         * with the next collect().
+         **/
+        void setTimeType( FileTimeType type ) { _timeType = type; }
+
+        /**
+         * Return the timestamp that is used for the statistics.
+         **/
+        FileTimeType timeType() const { return _timeType; }
+
         /**
          * Return a sorted list of the years where files with that modification
          * year were found after collecting data.
@@ -136,6 +151,12 @@ namespace QDirStat
          **/
     	void collectRecursive( FileInfo * subtree );
 
+        /**
+         * Get the year and month of the selected timestamp of 'item'.
+         * Return 'false' if it does not have that timestamp.
+         **/
+        bool timeYearMonth( FileInfo * item, short & year, short & month ) const;
+
         /**
          * Sum up the totals over all years and calculate the percentages for
          * each year
@@ -166,6 +187,7 @@ namespace QDirStat
 
         int             _totalFilesCount;
         FileSize        _totalFilesSize;
+        FileTimeType    _timeType;
 
         static short    _thisYear;
         static short    _thisMonth;
@@ -13,6 +13,7 @@
 #include "SettingsHelpers.h"
 #include "HeaderTweaker.h"
 #include "FormatUtil.h"
+#include "SignalBlocker.h"
 #include "Logger.h"
 #include "Exception.h"
 
@@ -125,6 +126,17 @@ void FileAgeStatsWindow::initWidgets()
 
     connect( _ui->locateButton,  SIGNAL( clicked()     ),
              this,               SLOT  ( locateFiles() ) );
+
+
+    // Timestamp to use
+
+    _ui->timeTypeComboBox->addItem( tr( "Last Modified" ), (int) ModificationTime );
+    _ui->timeTypeComboBox->addItem( tr( "Last Access"   ), (int) AccessTime       );
+    _ui->timeTypeComboBox->addItem( tr( "Status Change" ), (int) StatusChangeTime );
+    _ui->timeTypeComboBox->addItem( tr( "Created"       ), (int) CreationTime     );
+
+    connect( _ui->timeTypeComboBox, SIGNAL( currentIndexChanged( int ) ),
+             this,                  SLOT  ( refresh()                  ) );
 }
 
 
@@ -154,6 +166,14 @@ void FileAgeStatsWindow::populate( FileInfo * newSubtree )
     _ui->heading->setText( tr( "File Age Statistics for %1" )
                            .arg( _subtree.url() ) );
 
+    // The other timestamps are only there with extended timestamps
+
+    FileInfo * subtree = _subtree();
+    bool haveExtTimes  = subtree && subtree->tree() && subtree->tree()->extTimeStore();
+    _ui->timeTypeComboBox->setEnabled( haveExtTimes );
+
+    _stats->setTimeType( haveExtTimes ? timeType() : ModificationTime );
+
     // For better Performance: Disable sorting while inserting many items
     _ui->treeWidget->setSortingEnabled( false );
 
@@ -246,6 +266,16 @@ YearsList FileAgeStatsWindow::findGaps()
 }
 
 
+FileTimeType FileAgeStatsWindow::timeType() const
+{
+    int index = _ui->timeTypeComboBox->currentIndex();
+
+    return index < 0 ?
+        ModificationTime :
+        (FileTimeType) _ui->timeTypeComboBox->itemData( index ).toInt();
+}
+
+
 YearListItem * FileAgeStatsWindow::selectedItem() const
 {
     QTreeWidgetItem *currentItem = _ui->treeWidget->currentItem();
@@ -277,7 +307,9 @@ void FileAgeStatsWindow::enableActions()
 
     YearListItem * sel = selectedItem();
 
-    if ( sel )
+    // The tree walkers for locating files only know the modification time
+
+    if ( sel && _stats->timeType() == ModificationTime )
     {
         locateEnabled =
             sel->stats().filesCount > 0 &&
@@ -295,8 +327,17 @@ void FileAgeStatsWindow::readSettings()
     settings.beginGroup( "FileAgeStatsWindow" );
     _ui->syncCheckBox->setChecked( settings.value( "SyncWithMainWindow", true ).toBool() );
     _startGapsWithCurrentYear = settings.value( "StartGapsWithCurrentYear", true ).toBool();
+    int timeType = settings.value( "TimeType", (int) ModificationTime ).toInt();
     settings.endGroup();
 
+    int index = _ui->timeTypeComboBox->findData( timeType );
+
+    if ( index >= 0 )
+    {
+        SignalBlocker sigBlocker( _ui->timeTypeComboBox );
+        _ui->timeTypeComboBox->setCurrentIndex( index );
+    }
+
     readWindowSettings( this, "FileAgeStatsWindow" );
 }
 
@@ -308,6 +349,7 @@ void FileAgeStatsWindow::writeSettings()
     settings.beginGroup( "FileAgeStatsWindow" );
     settings.setValue( "SyncWithMainWindow",       _ui->syncCheckBox->isChecked() );
     settings.setValue( "StartGapsWithCurrentYear", _startGapsWithCurrentYear      );
+    settings.setValue( "TimeType",                 (int) timeType()               );
     settings.endGroup();
 
     writeWindowSettings( this, "FileAgeStatsWindow" );
@@ -158,6 +158,11 @@ namespace QDirStat
          **/
         YearListItem * selectedItem() const;
 
+        /**
+         * Return the timestamp type currently selected in the combo box.
+         **/
+        FileTimeType timeType() const;
+
 
 	//
 	// Data members
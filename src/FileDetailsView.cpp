@@ -12,13 +12,16 @@
 #include "FileDetailsView.h"
 #include "AdaptiveTimer.h"
 #include "DirInfo.h"
+#include "DirTree.h"
 #include "DirTreeModel.h"
+#include "DotEntry.h"
 #include "FileInfoSet.h"
 #include "MimeCategorizer.h"
 #include "PkgQuery.h"
 #include "SystemFileChecker.h"
 #include "Settings.h"
 #include "SettingsHelpers.h"
+#include "SmallFileSummary.h"
 #include "FormatUtil.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -366,7 +369,12 @@ void FileDetailsView::showSubtreeInfo( DirInfo * dir )
 
 	case DirOnRequestOnly:		msg = tr( "[Not Read]"		); break;
 	case DirPermissionDenied:	msg = tr( "[Permission Denied]" ); break;
-	case DirError:			msg = tr( "[Read Error]"	); break;
+	case DirError:
+	    if ( dir->tree() && dir->tree()->isTimedOut( dir->url() ) )
+		msg = tr( "[Timed Out]" );
+	    else
+		msg = tr( "[Read Error]" );
+	    break;
 
 	case DirFinished:
 	case DirCached:
@@ -386,6 +394,7 @@ void FileDetailsView::showSubtreeInfo( DirInfo * dir )
 	setLabel( _ui->dirFileCountLabel,   dir->totalFiles(),	       prefix );
 	setLabel( _ui->dirSubDirCountLabel, dir->totalSubDirs(),       prefix );
 	_ui->dirLatestMTimeLabel->setText( formatTime( dir->latestMtime() ) );
+	_ui->dirFileCountLabel->setToolTip( smallFilesToolTip( dir ) );
 
 	suppressIfSameContent( _ui->dirTotalSizeLabel, _ui->dirAllocatedLabel, _ui->dirAllocatedCaption );
 	_ui->dirAllocatedLabel->setBold( dir->totalUsedPercent() < ALLOCATED_FAT_PERCENT );
@@ -396,12 +405,30 @@ void FileDetailsView::showSubtreeInfo( DirInfo * dir )
 	_ui->dirAllocatedLabel->clear();
 	_ui->dirItemCountLabel->clear();
 	_ui->dirFileCountLabel->clear();
+	_ui->dirFileCountLabel->setToolTip( QString() );
 	_ui->dirSubDirCountLabel->clear();
 	_ui->dirLatestMTimeLabel->clear();
     }
 }
 
 
+QString FileDetailsView::smallFilesToolTip( DirInfo * dir )
+{
+    const SmallFileSummary * summary = dir->smallFileSummary();
+
+    if ( ! summary && dir->dotEntry() )
+	summary = dir->dotEntry()->smallFileSummary();
+
+    if ( ! summary || summary->isEmpty() )
+	return QString();
+
+    return tr( "%1 small files (%2) in this directory are only summarized.\n"
+	       "Use \"Read in Full Detail\" to show them individually." )
+	.arg( summary->count() )
+	.arg( formatSize( summary->totalSize() ) );
+}
+
+
 void FileDetailsView::showDirNodeInfo( DirInfo * dir )
 {
     CHECK_PTR( dir );
@@ -202,6 +202,7 @@ namespace QDirStat
 	void showSubtreeInfo( DirInfo * dir );
 	void showDirNodeInfo( DirInfo * dir );
 	void setDirBlockVisibility( bool visible );
+	QString smallFilesToolTip( DirInfo * dir );
 
 
 	// Data members
@@ -19,6 +19,8 @@
 #include "Attic.h"
 #include "DirTree.h"
 #include "PkgInfo.h"
+#include "MappedArena.h"
+#include "ExtTimeStore.h"
 #include "FormatUtil.h"
 #include "SysUtil.h"
 #include "Logger.h"
@@ -52,6 +54,7 @@ FileInfo::FileInfo( DirTree    * tree,
     _isLocalFile   = true;
     _isSparseFile  = false;
     _isIgnored	   = false;
+    _hasCachedUid  = false;
     _name	   = name ? name : "";
     _device	   = 0;
     _mode	   = 0;
@@ -63,6 +66,7 @@ FileInfo::FileInfo( DirTree    * tree,
     _mtime	   = 0;
     _mtimeYear     = -1;
     _mtimeMonth    = -1;
+    _extTimesIndex = 0;
     _allocatedSize = 0;
     _magic	   = FileInfoMagic;
 }
@@ -85,6 +89,7 @@ FileInfo::FileInfo( const QString & filenameWithoutPath,
 
     _isLocalFile   = true;
     _isIgnored	   = false;
+    _hasCachedUid  = false;
     _name	   = filenameWithoutPath;
 
     _device	   = statInfo->st_dev;
@@ -98,6 +103,10 @@ FileInfo::FileInfo( const QString & filenameWithoutPath,
     _magic	   = FileInfoMagic;
     _allocatedSize = 0;
 
+    ExtTimeStore * extTimeStore = tree ? tree->extTimeStore() : 0;
+    _extTimesIndex = extTimeStore ?
+	extTimeStore->add( statInfo->st_atime, statInfo->st_ctime ) : 0;
+
     if ( isSpecial() )
     {
 	_size		= 0;
@@ -173,12 +182,14 @@ FileInfo::FileInfo( DirTree *	    tree,
     _name	   = filenameWithoutPath;
     _isLocalFile   = true;
     _isIgnored	   = false;
+    _hasCachedUid  = false;
     _device	   = 0;
     _mode	   = mode;
     _size	   = size;
     _mtime	   = mtime;
     _mtimeYear     = -1;
     _mtimeMonth    = -1;
+    _extTimesIndex = 0;
     _allocatedSize = 0;
     _links	   = links;
     _uid	   = 0;
@@ -220,6 +231,9 @@ FileInfo::~FileInfo()
 {
     _magic = 0;
 
+    if ( _extTimesIndex && _tree && _tree->extTimeStore() )
+	_tree->extTimeStore()->release( _extTimesIndex );
+
     /**
      * The destructor should also take care about unlinking this object from
      * its parent's children list, but regrettably that just doesn't work: At
@@ -233,6 +247,36 @@ FileInfo::~FileInfo()
 }
 
 
+void * FileInfo::operator new( size_t size )
+{
+    MappedArena * arena = MappedArena::instance();
+
+    if ( arena )
+    {
+	void * ptr = arena->allocate( size );
+
+	if ( ptr )
+	    return ptr;
+    }
+
+    return ::operator new( size );
+}
+
+
+void FileInfo::operator delete( void * ptr, size_t size )
+{
+    MappedArena * arena = MappedArena::instance();
+
+    // The arena might have been disabled in the meantime, so check where
+    // this object really came from.
+
+    if ( arena && arena->contains( ptr ) )
+	arena->deallocate( ptr, size );
+    else
+	::operator delete( ptr );
+}
+
+
 bool FileInfo::checkMagicNumber() const
 {
     return _magic == FileInfoMagic;
@@ -530,7 +574,7 @@ bool FileInfo::isCached() const
 
 bool FileInfo::hasUid() const
 {
-    return ! isPkgInfo() && ! isCached();
+    return ! isPkgInfo() && ( ! isCached() || _hasCachedUid );
 }
 
 
@@ -717,6 +761,48 @@ void  FileInfo::processMtime()
 }
 
 
+time_t FileInfo::atime() const
+{
+    return _extTimesIndex && _tree->extTimeStore() ?
+	_tree->extTimeStore()->atime( _extTimesIndex ) : 0;
+}
+
+
+time_t FileInfo::ctime() const
+{
+    return _extTimesIndex && _tree->extTimeStore() ?
+	_tree->extTimeStore()->ctime( _extTimesIndex ) : 0;
+}
+
+
+time_t FileInfo::btime() const
+{
+    return _extTimesIndex && _tree->extTimeStore() ?
+	_tree->extTimeStore()->btime( _extTimesIndex ) : 0;
+}
+
+
+void FileInfo::setBtime( time_t btime )
+{
+    if ( _extTimesIndex && _tree->extTimeStore() )
+	_tree->extTimeStore()->setBtime( _extTimesIndex, btime );
+}
+
+
+time_t FileInfo::fileTime( FileTimeType type ) const
+{
+    switch ( type )
+    {
+	case ModificationTime:	return mtime();
+	case AccessTime:	return atime();
+	case StatusChangeTime:	return ctime();
+	case CreationTime:	return btime();
+    }
+
+    return mtime();
+}
+
+
 bool FileInfo::isDominant()
 {
     return _parent ? _parent->isDominantChild( this ) : false;
@@ -57,6 +57,21 @@ namespace QDirStat
     };
 
 
+    /**
+     * Which one of the timestamps of a file to use.
+     *
+     * All except the modification time are only available if extended
+     * timestamps are enabled (see DirTree::setExtendedTimes()).
+     **/
+    enum FileTimeType
+    {
+	ModificationTime,	// mtime: last change of the content
+	AccessTime,		// atime: last access (if the filesystem records it)
+	StatusChangeTime,	// ctime: last change of the content or the inode
+	CreationTime		// btime: creation (only where statx() reports it)
+    };
+
+
     /**
      * The most basic building block of a DirTree:
      *
@@ -121,6 +136,19 @@ namespace QDirStat
 	 **/
 	virtual ~FileInfo();
 
+	/**
+	 * Allocate memory for a FileInfo or any derived class. This uses
+	 * the MappedArena if a scratch directory is configured, otherwise
+	 * (or if that arena is out of space) the normal heap.
+	 **/
+	static void * operator new( size_t size );
+
+	/**
+	 * Free memory of a FileInfo or any derived class, no matter if it
+	 * was allocated in the MappedArena or on the normal heap.
+	 **/
+	static void operator delete( void * ptr, size_t size );
+
 	/**
 	 * Check with the magic number if this object is valid.
 	 * Return 'true' if it is valid, 'false' if invalid.
@@ -228,10 +256,16 @@ namespace QDirStat
 	 * Return 'true' if this FileInfo has a UID (user ID).
 	 *
 	 * It might not have that information e.g. if it was read from a cache
-	 * file.
+	 * file without a "uid:" field.
 	 **/
 	bool hasUid() const;
 
+	/**
+	 * Set the UID (user ID) of the owner. This is for use from a cache
+	 * file reader.
+	 **/
+	void setUid( uid_t uid ) { _uid = uid; _hasCachedUid = true; }
+
 	/**
 	 * Group ID of the owner.
 	 *
@@ -344,6 +378,34 @@ namespace QDirStat
          **/
         short mtimeMonth();
 
+	/**
+	 * The last access time (atime), the last status change time (ctime)
+	 * and the creation time (btime) of the file.
+	 *
+	 * These are only stored if extended timestamps were enabled when
+	 * the file was read; otherwise they are 0. So is btime if the
+	 * filesystem does not report it.
+	 **/
+	time_t atime() const;
+	time_t ctime() const;
+	time_t btime() const;
+
+	/**
+	 * Set the creation time. This has no effect if this file does not
+	 * have extended timestamps.
+	 **/
+	void setBtime( time_t btime );
+
+	/**
+	 * Return 'true' if this file has extended timestamps.
+	 **/
+	bool hasExtendedTimes() const { return _extTimesIndex != 0; }
+
+	/**
+	 * Return the timestamp of type 'type'.
+	 **/
+	time_t fileTime( FileTimeType type ) const;
+
 	/**
 	 * Returns the total size in bytes of this subtree.
 	 * Derived classes that have children should overwrite this.
@@ -949,6 +1011,7 @@ namespace QDirStat
 	bool		_isLocalFile  :1;	// flag: local or remote file?
 	bool		_isSparseFile :1;	// (cache) flag: sparse file (file with "holes")?
 	bool		_isIgnored    :1;	// flag: ignored by rule?
+	bool		_hasCachedUid :1;	// (cache) flag: UID read from the cache file?
 	dev_t		_device;		// device this object resides on
 	mode_t		_mode;			// file permissions + object type
 	nlink_t		_links;			// number of links
@@ -960,6 +1023,7 @@ namespace QDirStat
 	time_t		_mtime;			// modification time
         short           _mtimeYear;             // year  of the modification time or -1
         short           _mtimeMonth;            // month of the modification time or -1
+	quint32		_extTimesIndex;		// index in the tree's ExtTimeStore or 0
 
 	DirInfo	 *	_parent;		// pointer to the parent entry
 	FileInfo *	_next;			// pointer to the next entry
@@ -9,6 +9,8 @@
 
 #include <algorithm>    // std::swap()
 #include "FileInfoSorter.h"
+#include "GrowthHistory.h"
+#include "CompressionAnalyzer.h"
 
 using namespace QDirStat;
 
@@ -65,6 +67,42 @@ bool FileInfoSorter::operator() ( FileInfo * a, FileInfo * b )
 	case GroupCol:		  return a->gid()	      < b->gid();
 	case PermissionsCol:	  return a->mode()	      < b->mode();
 	case OctalPermissionsCol: return a->mode()	      < b->mode();
+	case ShortGrowthCol:
+	case LongGrowthCol:
+            {
+                int  window = _sortCol == ShortGrowthCol ? 0 : 1;
+                bool a_known;
+                bool b_known;
+                FileSize a_growth = GrowthHistory::instance()->growth( a, window, &a_known );
+                FileSize b_growth = GrowthHistory::instance()->growth( b, window, &b_known );
+
+                if ( a_known != b_known ) return b_known;
+
+                return a_growth < b_growth;
+            }
+
+	case ATimeCol:		  return a->atime()	      < b->atime();
+	case CTimeCol:		  return a->ctime()	      < b->ctime();
+	case BTimeCol:		  return a->btime()	      < b->btime();
+	case CompressedSizeCol:
+	case CompressionRatioCol:
+            {
+                const CompressionInfo * a_info = CompressionAnalyzer::instance()->info( a );
+                const CompressionInfo * b_info = CompressionAnalyzer::instance()->info( b );
+                bool a_known = a_info && a_info->isDiskSizeKnown() && a_info->extentBytes > 0;
+                bool b_known = b_info && b_info->isDiskSizeKnown() && b_info->extentBytes > 0;
+
+                if ( ! a_known || ! b_known ) return b_known && ! a_known;
+
+                if ( _sortCol == CompressedSizeCol )
+                    return a_info->diskBytes() < b_info->diskBytes();
+
+                // Compare the ratios without dividing:
+                // a_disk / a_extent < b_disk / b_extent
+
+                return (double) a_info->diskBytes() * b_info->extentBytes <
+                       (double) b_info->diskBytes() * a_info->extentBytes;
+            }
 	case ReadJobsCol:	  return a->pendingReadJobs() < b->pendingReadJobs();
 	case UndefinedCol:	  return false;
 	    // Intentionally omitting the 'default' branch
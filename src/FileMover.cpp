@@ -0,0 +1,1390 @@
+/*
+ *   File name: FileMover.cpp
+ *   Summary:	Moving subtrees to another filesystem for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>		// open(), AT_FDCWD, AT_SYMLINK_NOFOLLOW
+#include <unistd.h>		// read(), pread(), pwrite(), close(), unlink(), rmdir()
+#include <string.h>		// strerror()
+#include <dirent.h>		// opendir(), readdir()
+#include <ftw.h>		// nftw()
+#include <stdio.h>		// rename(), RENAME_NOREPLACE
+#include <sys/stat.h>
+#include <sys/ioctl.h>		// ioctl(), _IOW()
+#include <sys/syscall.h>	// SYS_copy_file_range
+
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QStringList>
+
+#include "FileMover.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "Refresher.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Maximum number of files for each copy job in the thread pool
+#define JOB_FILES		16
+
+// Start a new copy job after this many bytes, so one subtree with a few
+// large files is still copied in parallel
+#define JOB_BYTES		( 64 * 1024 * 1024LL )
+
+// Bytes to copy with each copy_file_range() call; the jobs check for
+// cancel and report the progress after each chunk
+#define CHUNK_BYTES		( 8 * 1024 * 1024 )
+
+// Buffer size for copying with read() and write()
+#define BUFFER_BYTES		( 1024 * 1024 )
+
+// Interval for taking over the results from the worker threads
+#define RESULTS_INTERVAL_MILLISEC	500
+
+// Maximum time to wait for the worker threads when the FileMover is deleted
+#define SHUTDOWN_TIMEOUT_MILLISEC	5000
+
+// From linux/fs.h which does not mix well with other system headers
+#if defined( __linux__ ) && ! defined( FICLONE )
+#  define FICLONE		_IOW( 0x94, 9, int )
+#endif
+
+#ifndef RENAME_NOREPLACE
+#  define RENAME_NOREPLACE	( 1 << 0 )
+#endif
+
+
+using namespace QDirStat;
+
+
+/**
+ * Return an error message for 'operation' on 'path' with the current errno.
+ **/
+static QString errorText( const char * operation, const QByteArray & path )
+{
+    return QString( "%1 %2: %3" )
+	.arg( operation )
+	.arg( QString::fromUtf8( path ) )
+	.arg( strerror( errno ) );
+}
+
+
+/**
+ * Rename 'src' to 'dst' unless 'dst' already exists, as one atomic
+ * operation. Return 0 on success, -1 and set errno otherwise. errno is
+ * EINVAL or ENOSYS if the kernel or the filesystem cannot do that.
+ **/
+static int renameNoReplace( const QByteArray & src, const QByteArray & dst )
+{
+#ifdef SYS_renameat2
+    return syscall( SYS_renameat2,
+		    AT_FDCWD, src.constData(),
+		    AT_FDCWD, dst.constData(),
+		    RENAME_NOREPLACE );
+#else
+    Q_UNUSED( src );
+    Q_UNUSED( dst );
+    errno = ENOSYS;
+
+    return -1;
+#endif
+}
+
+
+/**
+ * Write everything of directory 'path' to the disk. Return an empty string
+ * on success, an error message otherwise.
+ **/
+static QString syncDir( const QByteArray & path )
+{
+    int fd = ::open( path.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+    if ( fd < 0 )
+	return errorText( "open", path );
+
+    QString error;
+
+    if ( fsync( fd ) != 0 )
+	error = errorText( "fsync", path );
+
+    ::close( fd );
+
+    return error;
+}
+
+
+/**
+ * Set the owner, permissions and timestamps of 'path' to those in 'statInfo'
+ * as far as possible. Without root permissions, the owner can usually not
+ * be changed; this is silently ignored.
+ **/
+static void copyMetaData( const QByteArray & path, const struct stat & statInfo )
+{
+    struct timespec times[2];
+    times[0] = statInfo.st_atim;
+    times[1] = statInfo.st_mtim;
+
+    lchown( path.constData(), statInfo.st_uid, statInfo.st_gid );
+
+    if ( ! S_ISLNK( statInfo.st_mode ) )
+	chmod( path.constData(), statInfo.st_mode & 07777 );
+
+    utimensat( AT_FDCWD, path.constData(), times, AT_SYMLINK_NOFOLLOW );
+}
+
+
+/**
+ * Callback for nftw() for removing a tree.
+ **/
+static int removeEntry( const char * path, const struct stat * statInfo, int typeflag, struct FTW * ftw )
+{
+    Q_UNUSED( statInfo );
+    Q_UNUSED( ftw );
+
+    int result = typeflag == FTW_DP ? rmdir( path ) : unlink( path );
+
+    return result == 0 ? 0 : errno;
+}
+
+
+/**
+ * Remove 'path' with everything below it. Return an empty string on
+ * success, an error message otherwise.
+ **/
+static QString removeTree( const QByteArray & path )
+{
+    struct stat statInfo;
+
+    if ( lstat( path.constData(), &statInfo ) != 0 )
+	return errno == ENOENT ? QString() : errorText( "lstat", path );
+
+    int result = nftw( path.constData(), removeEntry, 16, FTW_DEPTH | FTW_PHYS );
+
+    if ( result != 0 )
+    {
+	if ( result > 0 )
+	    errno = result;
+
+	return errorText( "Removing", path );
+    }
+
+    return QString();
+}
+
+
+
+
+namespace QDirStat
+{
+    /**
+     * Job for the thread pool: Read one subtree from the disk and create
+     * everything but the files in the target directory.
+     *
+     * If the target is on the same filesystem, the subtree is simply
+     * renamed instead.
+     **/
+    class MoveScanJob: public QRunnable
+    {
+    public:
+
+	MoveScanJob( MoveJobStatePtr	  state,
+		     int		  itemIndex,
+		     const QByteArray &	  src,
+		     const QByteArray &	  dst ):
+	    _state( state ),
+	    _itemIndex( itemIndex ),
+	    _src( src ),
+	    _dst( dst ),
+	    _dev( 0 )
+	    {}
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    QString error = move();
+
+	    if ( ! error.isEmpty() && _plan.createdDst )
+	    {
+		QString rollbackError = removeTree( _dst );
+
+		if ( ! rollbackError.isEmpty() )
+		    error += "\n" + rollbackError;
+	    }
+
+	    _state->addResult( _itemIndex, MoveJobState::ScanJobType,
+			       error.isEmpty(), error, _plan );
+	}
+
+    protected:
+
+	QString move()
+	{
+	    if ( _state->isCancelled() )
+		return QObject::tr( "Cancelled" );
+
+	    // Never replace anything in the target: Checking first and then
+	    // renaming would leave a gap for somebody else to create it.
+
+	    if ( renameNoReplace( _src, _dst ) == 0 )
+	    {
+		_plan.renamed = true;
+		return QString();
+	    }
+
+	    if ( errno == EEXIST )
+		return QObject::tr( "%1 already exists" ).arg( QString::fromUtf8( _dst ) );
+
+	    if ( errno != EXDEV && errno != EINVAL && errno != ENOSYS )
+		return errorText( "rename", _src );
+
+	    if ( _dst.startsWith( _src + "/" ) )
+	    {
+		return QObject::tr( "Can't move %1 into itself" )
+		    .arg( QString::fromUtf8( _src ) );
+	    }
+
+	    // Another filesystem, or one that cannot rename without replacing:
+	    // Copy it. mkdir() and O_EXCL never replace anything either.
+
+	    struct stat statInfo;
+
+	    if ( lstat( _src.constData(), &statInfo ) != 0 )
+		return errorText( "lstat", _src );
+
+	    _dev = statInfo.st_dev;
+
+	    return scan( _src, _dst, statInfo );
+	}
+
+	/**
+	 * Add 'src' with the lstat() information 'statInfo' to the plan.
+	 * Create directories, symlinks and special files right away.
+	 **/
+	QString scan( const QByteArray & src, const QByteArray & dst, const struct stat & statInfo )
+	{
+	    if ( _state->isCancelled() )
+		return QObject::tr( "Cancelled" );
+
+	    if ( S_ISDIR( statInfo.st_mode ) )
+	    {
+		if ( statInfo.st_dev != _dev )
+		{
+		    return QObject::tr( "%1 is a mount point" )
+			.arg( QString::fromUtf8( src ) );
+		}
+
+		// Only the owner may get into it while it is being filled;
+		// the permissions are set when all files are copied
+
+		if ( mkdir( dst.constData(), 0700 ) != 0 )
+		    return errorText( "mkdir", dst );
+
+		if ( dst == _dst )
+		    _plan.createdDst = true;
+
+		_plan.srcDirs << src;
+		_plan.dstDirs << dst;
+
+		DIR * dir = opendir( src.constData() );
+
+		if ( ! dir )
+		    return errorText( "opendir", src );
+
+		QString error;
+		struct dirent * entry;
+
+		while ( error.isEmpty() && ( entry = readdir( dir ) ) )
+		{
+		    if ( strcmp( entry->d_name, "." ) == 0 || strcmp( entry->d_name, ".." ) == 0 )
+			continue;
+
+		    QByteArray childSrc = src + "/" + entry->d_name;
+		    QByteArray childDst = dst + "/" + entry->d_name;
+		    struct stat childInfo;
+
+		    if ( lstat( childSrc.constData(), &childInfo ) != 0 )
+			error = errorText( "lstat", childSrc );
+		    else
+			error = scan( childSrc, childDst, childInfo );
+		}
+
+		closedir( dir );
+
+		return error;
+	    }
+
+	    if ( S_ISREG( statInfo.st_mode ) )
+	    {
+		if ( statInfo.st_nlink > 1 )
+		{
+		    // Keep hard links within this subtree as hard links
+
+		    QPair<quint64, quint64> key( statInfo.st_dev, statInfo.st_ino );
+
+		    if ( _links.contains( key ) )
+		    {
+			_plan.linkSrc	 << src;
+			_plan.linkSrcIds << MoveSrcId( statInfo );
+			_plan.linkDst	 << dst;
+			_plan.linkTarget << _links.value( key );
+
+			return QString();
+		    }
+
+		    _links.insert( key, dst );
+		}
+
+		MoveFile file;
+		file.src   = src;
+		file.dst   = dst;
+		file.size  = statInfo.st_size;
+		file.srcId = MoveSrcId( statInfo );
+
+		if ( dst == _dst )
+		{
+		    // Create the file right away so the rollback knows that it
+		    // is ours; the copy job fills it later.
+
+		    int fd = ::open( dst.constData(),
+				     O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600 );
+		    if ( fd < 0 )
+			return errorText( "open", dst );
+
+		    ::close( fd );
+		    _plan.createdDst = true;
+		    file.created     = true;
+		}
+
+		_plan.files << file;
+		_plan.totalBytes += file.size;
+
+		return QString();
+	    }
+
+	    if ( S_ISLNK( statInfo.st_mode ) )
+	    {
+		QByteArray target( statInfo.st_size + 1, '\0' );
+		ssize_t len = readlink( src.constData(), target.data(), target.size() );
+
+		if ( len < 0 )
+		    return errorText( "readlink", src );
+
+		target.truncate( len );
+
+		if ( symlink( target.constData(), dst.constData() ) != 0 )
+		    return errorText( "symlink", dst );
+	    }
+	    else if ( S_ISFIFO( statInfo.st_mode ) ||
+		      S_ISCHR ( statInfo.st_mode ) ||
+		      S_ISBLK ( statInfo.st_mode )   )
+	    {
+		if ( mknod( dst.constData(), statInfo.st_mode, statInfo.st_rdev ) != 0 )
+		    return errorText( "mknod", dst );
+	    }
+	    else
+	    {
+		return QObject::tr( "Cannot move %1: Unsupported file type" )
+		    .arg( QString::fromUtf8( src ) );
+	    }
+
+	    if ( dst == _dst )
+		_plan.createdDst = true;
+
+	    copyMetaData( dst, statInfo );
+	    _plan.otherSrc    << src;
+	    _plan.otherSrcIds << MoveSrcId( statInfo );
+
+	    return QString();
+	}
+
+
+	MoveJobStatePtr	_state;
+	int		_itemIndex;
+	QByteArray	_src;
+	QByteArray	_dst;
+	dev_t		_dev;
+	MovePlan	_plan;
+	QHash<QPair<quint64, quint64>, QByteArray> _links;
+
+    };	// class MoveScanJob
+
+
+
+    /**
+     * Job for the thread pool: Copy some files.
+     **/
+    class MoveCopyJob: public QRunnable
+    {
+    public:
+
+	MoveCopyJob( MoveJobStatePtr state, int itemIndex ):
+	    _state( state ),
+	    _itemIndex( itemIndex ),
+	    _bytes( 0LL )
+	    {}
+
+	void add( const MoveFile & file )
+	{
+	    _files << file;
+	    _bytes += file.size;
+	}
+
+	int	 count() const { return _files.size(); }
+	FileSize bytes() const { return _bytes; }
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    QString error;
+
+	    for ( int i = 0; i < _files.size() && error.isEmpty(); ++i )
+	    {
+		if ( _state->isCancelled() )
+		    error = QObject::tr( "Cancelled" );
+		else
+		    error = copy( _files.at( i ) );
+	    }
+
+	    _state->addResult( _itemIndex, MoveJobState::CopyJobType, error.isEmpty(), error );
+	}
+
+    protected:
+
+	/**
+	 * Copy one file with its owner, permissions and timestamps.
+	 * Return an empty string on success, an error message otherwise.
+	 **/
+	QString copy( const MoveFile & file )
+	{
+	    int srcFd = ::open( file.src.constData(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC );
+
+	    if ( srcFd < 0 )
+		return errorText( "open", file.src );
+
+	    // O_EXCL: Never overwrite anything that is not ours
+
+	    int flags = file.created ?
+		O_WRONLY | O_TRUNC | O_NOFOLLOW | O_CLOEXEC :
+		O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC;
+
+	    int dstFd = ::open( file.dst.constData(), flags, 0600 );
+
+	    if ( dstFd < 0 )
+	    {
+		QString error = errorText( "open", file.dst );
+		::close( srcFd );
+
+		return error;
+	    }
+
+	    QString error = copyFd( file, srcFd, dstFd );
+
+	    ::close( srcFd );
+
+	    if ( ::close( dstFd ) != 0 && error.isEmpty() )
+		error = errorText( "close", file.dst );
+
+	    return error;
+	}
+
+
+	QString copyFd( const MoveFile & file, int srcFd, int dstFd )
+	{
+	    struct stat srcInfo;
+
+	    if ( fstat( srcFd, &srcInfo ) != 0 )
+		return errorText( "fstat", file.src );
+
+	    // The source is only removed later if it still matches the scan,
+	    // so make sure that this is the version that is copied
+
+	    if ( ! file.srcId.matches( srcInfo ) )
+	    {
+		return QObject::tr( "%1 changed after it was scanned" )
+		    .arg( QString::fromUtf8( file.src ) );
+	    }
+
+	    QString error = copyData( file, srcFd, dstFd, srcInfo.st_size );
+
+	    if ( ! error.isEmpty() )
+		return error;
+
+	    if ( fchown( dstFd, srcInfo.st_uid, srcInfo.st_gid ) != 0 && errno != EPERM )
+		return errorText( "fchown", file.dst );
+
+	    if ( fchmod( dstFd, srcInfo.st_mode & 07777 ) != 0 )
+		return errorText( "fchmod", file.dst );
+
+	    struct timespec times[2];
+	    times[0] = srcInfo.st_atim;
+	    times[1] = srcInfo.st_mtim;
+
+	    if ( futimens( dstFd, times ) != 0 )
+		return errorText( "futimens", file.dst );
+
+	    if ( _state->syncFiles() && fdatasync( dstFd ) != 0 )
+		return errorText( "fdatasync", file.dst );
+
+	    // Verify the copy and make sure nobody wrote to the source while we
+	    // were copying it
+
+	    struct stat dstInfo;
+	    struct stat newSrcInfo;
+
+	    if ( fstat( dstFd, &dstInfo ) != 0 )
+		return errorText( "fstat", file.dst );
+
+	    if ( fstat( srcFd, &newSrcInfo ) != 0 )
+		return errorText( "fstat", file.src );
+
+	    if ( newSrcInfo.st_size		!= srcInfo.st_size ||
+		 newSrcInfo.st_mtim.tv_sec  != srcInfo.st_mtim.tv_sec ||
+		 newSrcInfo.st_mtim.tv_nsec != srcInfo.st_mtim.tv_nsec )
+	    {
+		return QObject::tr( "%1 changed while it was copied" )
+		    .arg( QString::fromUtf8( file.src ) );
+	    }
+
+	    if ( dstInfo.st_size != srcInfo.st_size )
+	    {
+		return QObject::tr( "Size mismatch for %1: %2 instead of %3 bytes" )
+		    .arg( QString::fromUtf8( file.dst ) )
+		    .arg( (qint64) dstInfo.st_size )
+		    .arg( (qint64) srcInfo.st_size );
+	    }
+
+	    return QString();
+	}
+
+
+	/**
+	 * Copy 'size' bytes from 'srcFd' to 'dstFd': With a reflink if the
+	 * filesystem supports it, otherwise with copy_file_range() which
+	 * still avoids copying the data through user space, and with plain
+	 * read() and write() as the last resort.
+	 **/
+	QString copyData( const MoveFile & file, int srcFd, int dstFd, FileSize size )
+	{
+#ifdef FICLONE
+	    if ( size > 0 && ioctl( dstFd, FICLONE, srcFd ) == 0 )
+	    {
+		_state->addBytesDone( size );
+		return QString();
+	    }
+#endif
+	    loff_t offset = 0;
+
+#ifdef SYS_copy_file_range
+	    while ( offset < size )
+	    {
+		if ( _state->isCancelled() )
+		    return QObject::tr( "Cancelled" );
+
+		loff_t	srcOffset = offset;
+		loff_t	dstOffset = offset;
+		size_t	len	  = qMin( (FileSize) CHUNK_BYTES, size - offset );
+		ssize_t copied	  = syscall( SYS_copy_file_range,
+					     srcFd, &srcOffset, dstFd, &dstOffset, len, 0 );
+		if ( copied < 0 )
+		{
+		    if ( errno == EXDEV	  || errno == ENOSYS ||
+			 errno == EINVAL  || errno == EOPNOTSUPP )
+		    {
+			break;	// continue with read() and write()
+		    }
+
+		    return errorText( "copy_file_range", file.dst );
+		}
+
+		if ( copied == 0 )	// the file was truncated
+		    return QString();	// the size check will catch that
+
+		offset += copied;
+		_state->addBytesDone( copied );
+	    }
+#endif
+	    QByteArray buffer( BUFFER_BYTES, '\0' );
+
+	    while ( offset < size )
+	    {
+		if ( _state->isCancelled() )
+		    return QObject::tr( "Cancelled" );
+
+		ssize_t len = pread( srcFd, buffer.data(), buffer.size(), offset );
+
+		if ( len < 0 )
+		{
+		    if ( errno == EINTR )
+			continue;
+
+		    return errorText( "read", file.src );
+		}
+
+		if ( len == 0 )
+		    return QString();
+
+		for ( ssize_t written = 0; written < len; )
+		{
+		    ssize_t result = pwrite( dstFd, buffer.constData() + written,
+					     len - written, offset + written );
+		    if ( result < 0 )
+		    {
+			if ( errno == EINTR )
+			    continue;
+
+			return errorText( "write", file.dst );
+		    }
+
+		    written += result;
+		}
+
+		offset += len;
+		_state->addBytesDone( len );
+	    }
+
+	    return QString();
+	}
+
+
+	MoveJobStatePtr	  _state;
+	int		  _itemIndex;
+	QVector<MoveFile> _files;
+	FileSize	  _bytes;
+
+    };	// class MoveCopyJob
+
+
+
+    /**
+     * Job for the thread pool: When all files of a subtree are copied,
+     * create the hard links, set the metadata of the directories (which
+     * changed while they were being filled) and remove the source.
+     **/
+    class MoveFinishJob: public QRunnable
+    {
+    public:
+
+	MoveFinishJob( MoveJobStatePtr	  state,
+		       int		  itemIndex,
+		       const QByteArray & dst,
+		       const MovePlan &	  plan ):
+	    _state( state ),
+	    _itemIndex( itemIndex ),
+	    _dst( dst ),
+	    _plan( plan )
+	    {}
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    // Until the source is touched, any error can still be rolled back
+
+	    for ( int i = 0; i < _plan.linkSrc.size(); ++i )
+	    {
+		if ( link( _plan.linkTarget.at( i ).constData(),
+			   _plan.linkDst.at( i ).constData() ) != 0 )
+		{
+		    _state->addResult( _itemIndex, MoveJobState::FinishJobType, false,
+				       errorText( "link", _plan.linkDst.at( i ) ) );
+		    return;
+		}
+	    }
+
+	    // Children before their parents: Setting the metadata of a child
+	    // would change the timestamps of its parent again.
+
+	    for ( int i = _plan.srcDirs.size() - 1; i >= 0; --i )
+	    {
+		struct stat statInfo;
+
+		if ( lstat( _plan.srcDirs.at( i ).constData(), &statInfo ) != 0 )
+		{
+		    _state->addResult( _itemIndex, MoveJobState::FinishJobType, false,
+				       errorText( "lstat", _plan.srcDirs.at( i ) ) );
+		    return;
+		}
+
+		copyMetaData( _plan.dstDirs.at( i ), statInfo );
+	    }
+
+	    // The copied files are already synced; make sure their directory
+	    // entries are on the disk, too, before the source is gone.
+
+	    if ( _state->syncFiles() )
+	    {
+		QVector<QByteArray> dirs = _plan.dstDirs;
+		int pos = _dst.lastIndexOf( '/' );
+		dirs << ( pos > 0 ? _dst.left( pos ) : QByteArray( "/" ) );
+
+		foreach ( const QByteArray & dir, dirs )
+		{
+		    QString error = syncDir( dir );
+
+		    if ( ! error.isEmpty() )
+		    {
+			_state->addResult( _itemIndex, MoveJobState::FinishJobType, false, error );
+			return;
+		    }
+		}
+	    }
+
+	    // Remove exactly what was copied; anything that was created,
+	    // rewritten or replaced in the source in the meantime is left alone
+	    // (and so is its directory).
+
+	    QStringList errors;
+
+	    foreach ( const MoveFile & file, _plan.files )
+		removeFile( file.src, file.srcId, errors );
+
+	    for ( int i = 0; i < _plan.linkSrc.size(); ++i )
+		removeFile( _plan.linkSrc.at( i ), _plan.linkSrcIds.at( i ), errors );
+
+	    for ( int i = 0; i < _plan.otherSrc.size(); ++i )
+		removeFile( _plan.otherSrc.at( i ), _plan.otherSrcIds.at( i ), errors );
+
+	    for ( int i = _plan.srcDirs.size() - 1; i >= 0; --i )
+	    {
+		if ( rmdir( _plan.srcDirs.at( i ).constData() ) != 0 )
+		    errors << errorText( "rmdir", _plan.srcDirs.at( i ) );
+	    }
+
+	    // The move itself was successful; 'errors' only tells what is left
+	    // of the source
+
+	    _state->addResult( _itemIndex, MoveJobState::FinishJobType, true, errors.join( "\n" ) );
+	}
+
+    protected:
+
+	/**
+	 * Remove the source file 'path' if it is still the one that was
+	 * copied. Otherwise keep it and add a message to 'errors'.
+	 **/
+	void removeFile( const QByteArray & path, const MoveSrcId & srcId, QStringList & errors )
+	{
+	    struct stat statInfo;
+
+	    if ( lstat( path.constData(), &statInfo ) != 0 )
+	    {
+		errors << errorText( "lstat", path );
+		return;
+	    }
+
+	    if ( ! srcId.matches( statInfo ) )
+	    {
+		errors << QObject::tr( "%1 changed after it was copied; not removed" )
+		    .arg( QString::fromUtf8( path ) );
+		return;
+	    }
+
+	    if ( unlink( path.constData() ) != 0 )
+		errors << errorText( "unlink", path );
+	}
+
+
+	MoveJobStatePtr	_state;
+	int		_itemIndex;
+	QByteArray	_dst;
+	MovePlan	_plan;
+
+    };	// class MoveFinishJob
+
+
+
+    /**
+     * Job for the thread pool: Remove the partial copy of a subtree.
+     **/
+    class MoveRollbackJob: public QRunnable
+    {
+    public:
+
+	MoveRollbackJob( MoveJobStatePtr state, int itemIndex, const QByteArray & dst ):
+	    _state( state ),
+	    _itemIndex( itemIndex ),
+	    _dst( dst )
+	    {}
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    QString error = removeTree( _dst );
+	    _state->addResult( _itemIndex, MoveJobState::RollbackJobType, error.isEmpty(), error );
+	}
+
+    protected:
+
+	MoveJobStatePtr	_state;
+	int		_itemIndex;
+	QByteArray	_dst;
+
+    };	// class MoveRollbackJob
+
+}	// namespace QDirStat
+
+
+
+
+void MoveJobState::addBytesDone( FileSize bytes )
+{
+    QMutexLocker locker( &_mutex );
+    _bytesDone += bytes;
+}
+
+
+FileSize MoveJobState::bytesDone()
+{
+    QMutexLocker locker( &_mutex );
+    return _bytesDone;
+}
+
+
+void MoveJobState::addResult( int		 itemIndex,
+			      JobType		 type,
+			      bool		 ok,
+			      const QString &	 error,
+			      const MovePlan &	 plan )
+{
+    JobResult result;
+    result.itemIndex = itemIndex;
+    result.type	     = type;
+    result.ok	     = ok;
+    result.error     = error;
+    result.plan	     = plan;
+
+    QMutexLocker locker( &_mutex );
+    _results << result;
+}
+
+
+QList<MoveJobState::JobResult> MoveJobState::takeResults()
+{
+    QList<JobResult> results;
+
+    QMutexLocker locker( &_mutex );
+    results.swap( _results );
+
+    return results;
+}
+
+
+
+
+FileMover::FileMover( DirTree * tree, QObject * parent ):
+    QObject( parent ),
+    _tree( tree ),
+    _itemsPending( 0 ),
+    _busy( false )
+{
+    readSettings();
+
+    _pool = new QThreadPool();
+    CHECK_NEW( _pool );
+
+    _timer.setInterval( RESULTS_INTERVAL_MILLISEC );
+
+    connect( &_timer, SIGNAL( timeout()	    ),
+	     this,    SLOT  ( processResults() ) );
+
+    if ( _tree )
+    {
+	connect( _tree, SIGNAL( clearing()			 ),
+		 this,	SLOT  ( clearing()			 ) );
+
+	connect( _tree, SIGNAL( deletingChild	    ( FileInfo * ) ),
+		 this,	SLOT  ( deletingChild	    ( FileInfo * ) ) );
+
+	connect( _tree, SIGNAL( clearingSubtree     ( DirInfo * ) ),
+		 this,	SLOT  ( clearingSubtree     ( DirInfo * ) ) );
+    }
+}
+
+
+FileMover::~FileMover()
+{
+    // Nobody should be notified anymore, but the partial copies still need
+    // to be removed.
+
+    blockSignals( true );
+
+    if ( _tree )
+	_tree->disconnect( this );
+
+    _tree = 0;
+    cancel();
+
+    // Wait for the jobs to remove the partial copies, but not forever: A
+    // job might hang in a system call on a dead mount.
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while ( _busy )
+    {
+	int remaining = SHUTDOWN_TIMEOUT_MILLISEC - timer.elapsed();
+
+	if ( remaining <= 0 || ! _pool->waitForDone( remaining ) )
+	    break;
+
+	processResults();
+    }
+
+    if ( _busy )
+    {
+	// The jobs keep their MoveJobState alive on their own, but the
+	// QThreadPool destructor would wait for them: Intentionally leak it.
+
+	logWarning() << "Some move jobs are still running; not waiting for them" << endl;
+    }
+    else
+    {
+	delete _pool;
+    }
+
+    writeSettings();
+}
+
+
+QString FileMover::duplicateName( const FileInfoSet & items )
+{
+    QSet<QString> names;
+
+    foreach ( FileInfo * item, items )
+    {
+	if ( names.contains( item->name() ) )
+	    return item->name();
+
+	names.insert( item->name() );
+    }
+
+    return QString();
+}
+
+
+bool FileMover::start( const FileInfoSet & items, const QString & targetDir )
+{
+    if ( _busy || items.isEmpty() )
+	return false;
+
+    // Two items with the same name would get the same target, and the
+    // rollback of one of them could remove the other one's finished copy.
+
+    QString duplicate = duplicateName( items );
+
+    if ( ! duplicate.isEmpty() )
+    {
+	logError() << "More than one item named " << duplicate << endl;
+	return false;
+    }
+
+    _items.clear();
+    _refreshSet.clear();
+    _targetDir = targetDir;
+
+    // A new state for each move: Jobs of an earlier move that still hang
+    // somewhere can't mix up their results with this one.
+
+    _state = MoveJobStatePtr( new MoveJobState( _syncFiles ) );
+
+    foreach ( FileInfo * item, items )
+    {
+	MoveItem moveItem;
+	moveItem.item	     = item;
+	moveItem.path	     = item->path();
+	moveItem.target	     = targetDir + "/" + item->name();
+	moveItem.state	     = Scanning;
+	moveItem.bytes	     = item->totalSize();
+	moveItem.jobsPending = 0;
+
+	_items << moveItem;
+    }
+
+    logInfo() << "Moving " << _items.size() << " items to " << targetDir << endl;
+
+    _busy	  = true;
+    _itemsPending = _items.size();
+    _pool->setMaxThreadCount( _threads );
+    _stopWatch.start();
+    _timer.start();
+
+    for ( int i = 0; i < _items.size(); ++i )
+    {
+	MoveScanJob * job = new MoveScanJob( _state, i,
+					     _items.at( i ).path.toUtf8(),
+					     _items.at( i ).target.toUtf8() );
+	CHECK_NEW( job );
+
+	++_items[ i ].jobsPending;
+	_pool->start( job );	// the pool deletes the job when it is done
+    }
+
+    emit progress( 0, totalBytes(), 0 );
+
+    return true;
+}
+
+
+FileSize FileMover::totalBytes() const
+{
+    FileSize total = 0LL;
+
+    foreach ( const MoveItem & item, _items )
+	total += item.bytes;
+
+    return total;
+}
+
+
+FileSize FileMover::bytesDone()
+{
+    return _state ? _state->bytesDone() : 0LL;
+}
+
+
+void FileMover::processResults()
+{
+    if ( ! _state )
+	return;
+
+    foreach ( const MoveJobState::JobResult & result, _state->takeResults() )
+	handleResult( result );
+
+    if ( ! _busy )
+	return;
+
+    FileSize done    = bytesDone();
+    qint64   elapsed = _stopWatch.elapsed();
+
+    emit progress( done, totalBytes(), elapsed > 0 ? ( done * 1000 ) / elapsed : 0 );
+
+    if ( _itemsPending <= 0 )
+	finish();
+}
+
+
+void FileMover::handleResult( const MoveJobState::JobResult & result )
+{
+    MoveItem & moveItem = _items[ result.itemIndex ];
+    --moveItem.jobsPending;
+
+    switch ( result.type )
+    {
+	case MoveJobState::ScanJobType:
+
+	    if ( ! result.ok )
+	    {
+		moveItem.state = Failed;
+		moveItem.error = result.error;
+		moveItem.bytes = 0LL;
+		itemDone( result.itemIndex );
+	    }
+	    else if ( result.plan.renamed )
+	    {
+		moveItem.state = Done;
+		moveItem.bytes = 0LL;
+		itemDone( result.itemIndex );
+	    }
+	    else
+	    {
+		moveItem.plan  = result.plan;
+		moveItem.bytes = result.plan.totalBytes;
+
+		if ( _state->isCancelled() )
+		    startRollback( result.itemIndex, tr( "Cancelled" ) );
+		else
+		    startCopying( result.itemIndex );
+	    }
+	    break;
+
+	case MoveJobState::CopyJobType:
+
+	    if ( ! result.ok && moveItem.error.isEmpty() )
+		moveItem.error = result.error;
+
+	    // Wait until all copy jobs for this item are done: They might
+	    // still be writing to the target.
+
+	    if ( moveItem.jobsPending > 0 )
+		break;
+
+	    if ( ! moveItem.error.isEmpty() )
+		startRollback( result.itemIndex, moveItem.error );
+	    else if ( _state->isCancelled() )
+		startRollback( result.itemIndex, tr( "Cancelled" ) );
+	    else
+		startFinishing( result.itemIndex );
+
+	    break;
+
+	case MoveJobState::FinishJobType:
+
+	    if ( ! result.ok )
+	    {
+		startRollback( result.itemIndex, result.error );
+	    }
+	    else
+	    {
+		moveItem.state = Done;
+		moveItem.error = result.error;
+		itemDone( result.itemIndex );
+	    }
+	    break;
+
+	case MoveJobState::RollbackJobType:
+
+	    moveItem.state = Failed;
+
+	    if ( ! result.ok )
+		moveItem.error += "\n" + result.error;
+
+	    itemDone( result.itemIndex );
+	    break;
+    }
+}
+
+
+void FileMover::startCopying( int index )
+{
+    MoveItem & moveItem = _items[ index ];
+    moveItem.state = Copying;
+
+    MoveCopyJob * job = 0;
+
+    foreach ( const MoveFile & file, moveItem.plan.files )
+    {
+	if ( ! job )
+	{
+	    job = new MoveCopyJob( _state, index );
+	    CHECK_NEW( job );
+	}
+
+	job->add( file );
+
+	if ( job->count() >= JOB_FILES || job->bytes() >= JOB_BYTES )
+	{
+	    ++moveItem.jobsPending;
+	    _pool->start( job );
+	    job = 0;
+	}
+    }
+
+    if ( job )
+    {
+	++moveItem.jobsPending;
+	_pool->start( job );
+    }
+
+    if ( moveItem.jobsPending == 0 )	// no files at all
+	startFinishing( index );
+}
+
+
+void FileMover::startFinishing( int index )
+{
+    MoveItem & moveItem = _items[ index ];
+    moveItem.state = Finishing;
+
+    MoveFinishJob * job = new MoveFinishJob( _state, index,
+					     moveItem.target.toUtf8(),
+					     moveItem.plan );
+    CHECK_NEW( job );
+
+    ++moveItem.jobsPending;
+    _pool->start( job );
+}
+
+
+void FileMover::startRollback( int index, const QString & error )
+{
+    MoveItem & moveItem = _items[ index ];
+    moveItem.error = error;
+
+    if ( ! moveItem.plan.createdDst )
+    {
+	// Nothing in the target is ours: Don't touch it
+
+	moveItem.state = Failed;
+	itemDone( index );
+
+	return;
+    }
+
+    moveItem.state = RollingBack;
+
+    logInfo() << "Removing the partial copy " << moveItem.target << endl;
+
+    MoveRollbackJob * job = new MoveRollbackJob( _state, index, moveItem.target.toUtf8() );
+    CHECK_NEW( job );
+
+    ++moveItem.jobsPending;
+    _pool->start( job );
+}
+
+
+void FileMover::itemDone( int index )
+{
+    MoveItem & moveItem = _items[ index ];
+    --_itemsPending;
+
+    if ( moveItem.state == Failed )
+    {
+	logWarning() << "Moving " << moveItem.path << " failed: " << moveItem.error << endl;
+	emit itemFailed( moveItem.path, moveItem.error );
+
+	return;
+    }
+
+    logInfo() << "Moved " << moveItem.path << " to " << moveItem.target << endl;
+    emit itemMoved( moveItem.path, moveItem.target );
+
+    if ( ! moveItem.item || ! _tree )	// deleted from the tree in the meantime
+	return;
+
+    if ( ! moveItem.error.isEmpty() )
+    {
+	// Some of the source could not be removed; find out what is left
+
+	logWarning() << moveItem.error << endl;
+	_refreshSet << moveItem.item;
+    }
+    else if ( _tree->isBusy() )
+    {
+	_refreshSet << moveItem.item;
+    }
+    else
+    {
+	// No need to read anything again: The source is gone completely
+
+	FileInfo * item = moveItem.item;
+	moveItem.item = 0;
+	_tree->deleteSubtree( item );
+    }
+}
+
+
+void FileMover::finish()
+{
+    _busy = false;
+    _timer.stop();
+
+    int moved  = 0;
+    int failed = 0;
+
+    foreach ( const MoveItem & moveItem, _items )
+    {
+	if ( moveItem.state == Done )
+	    ++moved;
+	else
+	    ++failed;
+    }
+
+    logInfo() << "Moved " << moved << " items; " << failed << " failed" << endl;
+
+    if ( _tree && ! _tree->isBusy() )
+    {
+	// Read the parents of the items that could not be deleted from the
+	// tree and show what arrived in the target if it is in the tree
+
+	FileInfoSet refreshSet = Refresher::parents( _refreshSet );
+	FileInfo *  target     = _tree->locate( _targetDir );
+
+	if ( target && target->isDirInfo() )
+	    refreshSet << target;
+
+	_tree->refresh( refreshSet );
+    }
+
+    _refreshSet.clear();
+
+    emit finished( moved, failed );
+}
+
+
+void FileMover::cancel()
+{
+    if ( ! _busy )
+	return;
+
+    logInfo() << "Cancelling the move after " << bytesDone() << " bytes" << endl;
+
+    // The jobs notice this with the next file or chunk. Subtrees that are
+    // already being removed from the source are completed; all others are
+    // rolled back when their jobs are done.
+
+    _state->cancel();
+}
+
+
+void FileMover::clearing()
+{
+    for ( int i = 0; i < _items.size(); ++i )
+	_items[ i ].item = 0;
+
+    _refreshSet.clear();
+}
+
+
+void FileMover::deletingChild( FileInfo * child )
+{
+    forget( child );
+}
+
+
+void FileMover::clearingSubtree( DirInfo * subtree )
+{
+    forget( subtree );
+}
+
+
+void FileMover::forget( FileInfo * subtree )
+{
+    if ( ! subtree )
+	return;
+
+    for ( int i = 0; i < _items.size(); ++i )
+    {
+	FileInfo * item = _items.at( i ).item;
+
+	if ( item && ( item == subtree || item->isInSubtree( subtree ) ) )
+	    _items[ i ].item = 0;
+    }
+
+    foreach ( FileInfo * item, _refreshSet )
+    {
+	if ( item == subtree || item->isInSubtree( subtree ) )
+	    _refreshSet.remove( item );
+    }
+}
+
+
+void FileMover::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "FileMover" );
+
+    _threads   = settings.value( "Threads",   4	   ).toInt();
+    _syncFiles = settings.value( "SyncFiles", true ).toBool();
+
+    settings.endGroup();
+
+    if ( _threads < 1 )
+	_threads = 1;
+}
+
+
+void FileMover::writeSettings()
+{
+    Settings settings;
+    settings.beginGroup( "FileMover" );
+
+    settings.setDefaultValue( "Threads",   _threads   );
+    settings.setDefaultValue( "SyncFiles", _syncFiles );
+
+    settings.endGroup();
+}
@@ -0,0 +1,429 @@
+/*
+ *   File name: FileMover.h
+ *   Summary:	Moving subtrees to another filesystem for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+#ifndef FileMover_h
+#define FileMover_h
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <QObject>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "FileSize.h"
+#include "FileInfoSet.h"
+
+
+class QThreadPool;
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class DirInfo;
+    class FileInfo;
+
+
+    /**
+     * The inode, size and mtime of a source file as it was copied. The
+     * source is only removed if it still matches, so a file that was
+     * rewritten or replaced after it was copied is not lost.
+     **/
+    struct MoveSrcId
+    {
+	MoveSrcId(): ino( 0 ), size( 0LL ), mtimeSec( 0 ), mtimeNsec( 0 ) {}
+
+	MoveSrcId( const struct stat & statInfo ):
+	    ino( statInfo.st_ino ),
+	    size( statInfo.st_size ),
+	    mtimeSec( statInfo.st_mtim.tv_sec ),
+	    mtimeNsec( statInfo.st_mtim.tv_nsec )
+	    {}
+
+	bool matches( const struct stat & statInfo ) const
+	{
+	    return statInfo.st_ino	     == ino	 &&
+		   statInfo.st_size	     == size	 &&
+		   statInfo.st_mtim.tv_sec  == mtimeSec &&
+		   statInfo.st_mtim.tv_nsec == mtimeNsec;
+	}
+
+	ino_t	 ino;
+	FileSize size;
+	time_t	 mtimeSec;
+	long	 mtimeNsec;
+    };
+
+
+    /**
+     * One file that needs to be copied.
+     **/
+    struct MoveFile
+    {
+	MoveFile(): size( 0LL ), created( false ) {}
+
+	QByteArray src;
+	QByteArray dst;
+	FileSize   size;
+	bool	   created;	// 'dst' was already created (empty) by the scan
+	MoveSrcId  srcId;	// from the scan; checked again by the copy job
+    };
+
+
+    /**
+     * What needs to be done to move one subtree, as found on the disk by
+     * a MoveScanJob: The directories are in the order in which they were
+     * created, i.e. parents before their children.
+     **/
+    struct MovePlan
+    {
+	MovePlan(): renamed( false ), createdDst( false ), totalBytes( 0LL ) {}
+
+	bool			renamed;	// done with rename(): nothing else to do
+	bool			createdDst;	// the top destination was created by us
+	QVector<QByteArray>	srcDirs;
+	QVector<QByteArray>	dstDirs;
+	QVector<MoveFile>	files;
+	QVector<QByteArray>	otherSrc;	// symlinks, FIFOs etc., already copied
+	QVector<MoveSrcId>	otherSrcIds;
+	QVector<QByteArray>	linkSrc;	// more hard links of a file in 'files'
+	QVector<MoveSrcId>	linkSrcIds;
+	QVector<QByteArray>	linkDst;
+	QVector<QByteArray>	linkTarget;	// the 'dst' of that file
+	FileSize		totalBytes;
+    };
+
+
+    /**
+     * What a FileMover shares with the jobs in its worker threads. The jobs
+     * keep this alive, so a job that hangs on a dead mount does not access
+     * a FileMover that was deleted in the meantime.
+     **/
+    class MoveJobState
+    {
+    public:
+
+	enum JobType
+	{
+	    ScanJobType,
+	    CopyJobType,
+	    FinishJobType,
+	    RollbackJobType
+	};
+
+	/**
+	 * One finished job.
+	 **/
+	struct JobResult
+	{
+	    int		itemIndex;
+	    JobType	type;
+	    bool	ok;
+	    QString	error;
+	    MovePlan	plan;
+	};
+
+	/**
+	 * Constructor.
+	 **/
+	MoveJobState( bool syncFiles ):
+	    _cancelRequested( 0 ),
+	    _bytesDone( 0LL ),
+	    _syncFiles( syncFiles )
+	    {}
+
+	/**
+	 * Return 'true' if the jobs should stop.
+	 **/
+	bool isCancelled() const
+	    { return _cancelRequested.fetchAndAddOrdered( 0 ) != 0; }
+
+	/**
+	 * Tell the jobs to stop.
+	 **/
+	void cancel() { _cancelRequested.fetchAndStoreOrdered( 1 ); }
+
+	/**
+	 * Return 'true' if the copies should be synced to the disk before the
+	 * sources are removed.
+	 **/
+	bool syncFiles() const { return _syncFiles; }
+
+	/**
+	 * Add 'bytes' to the number of bytes copied.
+	 **/
+	void addBytesDone( FileSize bytes );
+
+	/**
+	 * Return the number of bytes copied so far.
+	 **/
+	FileSize bytesDone();
+
+	/**
+	 * Add the result of one job.
+	 **/
+	void addResult( int		 itemIndex,
+			JobType		 type,
+			bool		 ok,
+			const QString &	 error,
+			const MovePlan & plan = MovePlan() );
+
+	/**
+	 * Take over the results that were added so far.
+	 **/
+	QList<JobResult> takeResults();
+
+    protected:
+
+	mutable QAtomicInt	_cancelRequested;
+	QMutex			_mutex;
+	QList<JobResult>	_results;
+	FileSize		_bytesDone;
+	bool			_syncFiles;
+
+    };	// class MoveJobState
+
+
+    typedef QSharedPointer<MoveJobState> MoveJobStatePtr;
+
+
+    /**
+     * Mover for subtrees to a directory on another filesystem, e.g. to move
+     * old projects to an archive filesystem to free some space.
+     *
+     * Each subtree is first read from the disk (not from the DirTree which
+     * might not contain everything, e.g. with small file summaries or
+     * excluded directories). The directories and symlinks are created right
+     * away; the files are then copied in a number of background threads,
+     * with reflinks or copy_file_range() where the filesystems support it,
+     * keeping owner, permissions and timestamps, and checking the size of
+     * each copy. Only when all files of a subtree are copied, the source of
+     * that subtree is removed and the subtree is deleted from the DirTree,
+     * so there is no need to read the tree again.
+     *
+     * If anything goes wrong with a subtree, or when the move is cancelled,
+     * its partial copy is removed again and the source is left alone.
+     * Subtrees that were already completely moved stay moved.
+     *
+     * If the target is on the same filesystem, a subtree is simply renamed.
+     *
+     * The number of threads is configured in the "FileMover" settings
+     * group.
+     **/
+    class FileMover: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor. 'tree' is the tree that contains the items to move.
+	 **/
+	FileMover( DirTree * tree, QObject * parent = 0 );
+
+	/**
+	 * Destructor. This waits a limited time for the worker threads so
+	 * they can remove the partial copies.
+	 **/
+	virtual ~FileMover();
+
+	/**
+	 * Start moving 'items' (which should be normalized) to directory
+	 * 'targetDir'. Return 'false' if there is nothing to do or if two
+	 * items have the same name (see duplicateName()).
+	 **/
+	bool start( const FileInfoSet & items, const QString & targetDir );
+
+	/**
+	 * Return the first name that more than one of 'items' has, or an
+	 * empty string if all names are different. Those items cannot be
+	 * moved to the same directory.
+	 **/
+	static QString duplicateName( const FileInfoSet & items );
+
+	/**
+	 * Return 'true' if a move is in progress.
+	 **/
+	bool isBusy() const { return _busy; }
+
+	/**
+	 * Return the number of bytes to copy. This is an estimate from the
+	 * tree until all subtrees were read from the disk.
+	 **/
+	FileSize totalBytes() const;
+
+	/**
+	 * Return the number of bytes copied so far.
+	 **/
+	FileSize bytesDone();
+
+
+    public slots:
+
+	/**
+	 * Cancel the move: Remove the partial copies of the subtrees that are
+	 * not completely copied yet.
+	 **/
+	void cancel();
+
+	/**
+	 * Read the settings.
+	 **/
+	void readSettings();
+
+	/**
+	 * Write the settings.
+	 **/
+	void writeSettings();
+
+
+    signals:
+
+	/**
+	 * Emitted from time to time with the number of bytes copied so far,
+	 * the estimated total and the throughput in bytes per second.
+	 **/
+	void progress( FileSize bytesDone, FileSize totalBytes, FileSize bytesPerSec );
+
+	/**
+	 * Emitted when the subtree 'path' was moved to 'target'.
+	 **/
+	void itemMoved( const QString & path, const QString & target );
+
+	/**
+	 * Emitted when moving the subtree 'path' failed or was cancelled.
+	 **/
+	void itemFailed( const QString & path, const QString & reason );
+
+	/**
+	 * Emitted when everything is done.
+	 **/
+	void finished( int movedCount, int failedCount );
+
+
+    protected slots:
+
+	/**
+	 * Take over the results from the worker threads and start the next
+	 * steps. This is triggered by a timer while the move is running.
+	 **/
+	void processResults();
+
+	/**
+	 * The tree is being cleared: Forget all FileInfo pointers.
+	 **/
+	void clearing();
+
+	/**
+	 * An item is about to be deleted: Forget it if it is one of ours.
+	 **/
+	void deletingChild( FileInfo * child );
+
+	/**
+	 * A subtree is about to be cleared: Forget any of ours below it.
+	 **/
+	void clearingSubtree( DirInfo * subtree );
+
+
+    protected:
+
+	enum ItemState
+	{
+	    Scanning,
+	    Copying,
+	    Finishing,
+	    RollingBack,
+	    Done,
+	    Failed
+	};
+
+	/**
+	 * One subtree to move.
+	 **/
+	struct MoveItem
+	{
+	    FileInfo *	item;		// 0 if deleted from the tree
+	    QString	path;
+	    QString	target;
+	    ItemState	state;
+	    MovePlan	plan;
+	    FileSize	bytes;		// estimated until scanned
+	    int		jobsPending;
+	    QString	error;
+	};
+
+	/**
+	 * Handle the result of one job.
+	 **/
+	void handleResult( const MoveJobState::JobResult & result );
+
+	/**
+	 * Start the copy jobs for item no. 'index'.
+	 **/
+	void startCopying( int index );
+
+	/**
+	 * Start the job to set the directory metadata of item no. 'index' and
+	 * to remove its source.
+	 **/
+	void startFinishing( int index );
+
+	/**
+	 * Start the job to remove the partial copy of item no. 'index'.
+	 **/
+	void startRollback( int index, const QString & error );
+
+	/**
+	 * Item no. 'index' is done: Update the tree and notify the world.
+	 **/
+	void itemDone( int index );
+
+	/**
+	 * Everything is done: Update the target in the tree and notify the
+	 * world.
+	 **/
+	void finish();
+
+	/**
+	 * Forget the FileInfo pointers of all items in 'subtree'.
+	 **/
+	void forget( FileInfo * subtree );
+
+
+	//
+	// Data members
+	//
+
+	DirTree *		_tree;
+	QList<MoveItem>		_items;
+	QString			_targetDir;
+	FileInfoSet		_refreshSet;
+	int			_itemsPending;
+	bool			_busy;
+	QTimer			_timer;
+	QElapsedTimer		_stopWatch;
+	QThreadPool *		_pool;
+	MoveJobStatePtr		_state;
+
+	// Settings
+
+	int			_threads;
+	bool			_syncFiles;
+
+    };	// class FileMover
+
+}	// namespace QDirStat
+
+#endif	// FileMover_h
@@ -0,0 +1,1024 @@
+/*
+ *   File name: FileSystemAccess.cpp
+ *   Summary:	Exchangeable filesystem access for reading directories
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <dirent.h>		// opendir(), readdir()
+#include <fcntl.h>		// AT_ constants (fstatat() flags)
+#include <unistd.h>		// access(), R_OK, X_OK, usleep()
+#include <string.h>		// memset(), memchr()
+#include <errno.h>
+#include <sys/sysmacros.h>	// makedev()
+
+#include <QCoreApplication>	// qAddPostRoutine()
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QUrl>
+#include <QVector>
+#include <QPair>
+
+#include "FileSystemAccess.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Header line of a recording
+#define RECORDING_HEADER	"# QDirStat filesystem recording 1.0"
+
+// Timestamps of the synthetic tree
+#define SYNTHETIC_MTIME		1600000000
+
+
+using namespace QDirStat;
+
+
+FileSystemAccess * FileSystemAccess::_instance = 0;
+
+
+/**
+ * Return the path of entry 'name' in directory 'dirName'.
+ **/
+static QString joinPath( const QString & dirName, const QString & name )
+{
+    return dirName == "/" ? "/" + name : dirName + "/" + name;
+}
+
+
+/**
+ * Return a hash of 'path' that is the same for each run (FNV-1a).
+ **/
+static quint64 pathHash( const QString & path )
+{
+    QByteArray bytes = path.toUtf8();
+    quint64 hash = 14695981039346656037ULL;
+
+    for ( int i = 0; i < bytes.size(); ++i )
+    {
+	hash ^= (unsigned char) bytes.at( i );
+	hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+/**
+ * Return the time since 'timer' was started in microseconds.
+ **/
+static qint64 elapsedUsec( const QElapsedTimer & timer )
+{
+    return timer.nsecsElapsed() / 1000;
+}
+
+
+
+
+namespace QDirStat
+{
+    /**
+     * A real directory.
+     **/
+    class RealDir: public FileSystemDir
+    {
+    public:
+
+	RealDir( DIR * diskDir ):
+	    _diskDir( diskDir ),
+	    _dirFd( dirfd( diskDir ) )
+	    {}
+
+	virtual ~RealDir()
+	    { closedir( _diskDir ); }
+
+	virtual bool readEntry( QString & name, ino_t & ino ) Q_DECL_OVERRIDE
+	{
+	    struct dirent * entry;
+
+	    while ( ( entry = readdir( _diskDir ) ) )
+	    {
+		if ( strcmp( entry->d_name, "." ) != 0 && strcmp( entry->d_name, ".." ) != 0 )
+		{
+		    name = QString::fromUtf8( entry->d_name );
+		    ino	 = entry->d_ino;
+
+		    return true;
+		}
+	    }
+
+	    return false;
+	}
+
+	virtual int statEntry( const QString & name,
+			       struct stat *   statInfo,
+			       time_t *	       btime ) Q_DECL_OVERRIDE
+	{
+	    int flags = AT_SYMLINK_NOFOLLOW;
+
+#ifdef AT_NO_AUTOMOUNT
+	    flags |= AT_NO_AUTOMOUNT;
+#endif
+
+	    if ( btime )
+		*btime = 0;
+
+#ifdef STATX_BTIME
+
+	    // statx() is available since kernel 4.11 and glibc 2.28. If the
+	    // kernel does not have it, fall back to fstatat() for good.
+
+	    static bool haveStatx = true;
+
+	    if ( btime && haveStatx )
+	    {
+		struct statx stx;
+
+		if ( statx( _dirFd, name.toUtf8(), flags,
+			    STATX_BASIC_STATS | STATX_BTIME, &stx ) == 0 )
+		{
+		    memset( statInfo, 0, sizeof( *statInfo ) );
+
+		    statInfo->st_dev	 = makedev( stx.stx_dev_major, stx.stx_dev_minor );
+		    statInfo->st_ino	 = stx.stx_ino;
+		    statInfo->st_mode	 = stx.stx_mode;
+		    statInfo->st_nlink	 = stx.stx_nlink;
+		    statInfo->st_uid	 = stx.stx_uid;
+		    statInfo->st_gid	 = stx.stx_gid;
+		    statInfo->st_rdev	 = makedev( stx.stx_rdev_major, stx.stx_rdev_minor );
+		    statInfo->st_size	 = stx.stx_size;
+		    statInfo->st_blksize = stx.stx_blksize;
+		    statInfo->st_blocks	 = stx.stx_blocks;
+		    statInfo->st_atime	 = stx.stx_atime.tv_sec;
+		    statInfo->st_mtime	 = stx.stx_mtime.tv_sec;
+		    statInfo->st_ctime	 = stx.stx_ctime.tv_sec;
+
+		    if ( stx.stx_mask & STATX_BTIME )
+			*btime = stx.stx_btime.tv_sec;
+
+		    return 0;
+		}
+
+		if ( errno != ENOSYS )
+		    return -1;
+
+		logWarning() << "statx() not supported by the kernel - no creation times" << endl;
+		haveStatx = false;
+	    }
+
+#endif
+
+	    return fstatat( _dirFd, name.toUtf8(), statInfo, flags );
+	}
+
+    protected:
+
+	DIR *	_diskDir;
+	int	_dirFd;
+    };
+
+
+
+    /**
+     * A directory of a SyntheticFileSystem.
+     **/
+    class SyntheticDir: public FileSystemDir
+    {
+    public:
+
+	SyntheticDir( SyntheticFileSystem * fs, const QString & dirName, int level ):
+	    _fs( fs ),
+	    _dirName( dirName ),
+	    _level( level ),
+	    _pos( 0 )
+	    {
+		// The deepest level has no subdirectories; isDirName() knows
+		// that, so just count how many there are.
+
+		_dirCount = _fs->isDirName( "dir0", _level ) ? _fs->dirsPerDir() : 0;
+	    }
+
+	virtual bool readEntry( QString & name, ino_t & ino ) Q_DECL_OVERRIDE
+	{
+	    if ( _pos < _dirCount )
+		name = QString( "dir%1" ).arg( _pos );
+	    else if ( _pos < _dirCount + _fs->filesPerDir() )
+		name = SyntheticFileSystem::fileName( _dirName, _pos - _dirCount );
+	    else
+		return false;
+
+	    ++_pos;
+	    ino = pathHash( joinPath( _dirName, name ) );	// like dirStat() and fileStat()
+
+	    return true;
+	}
+
+	virtual int statEntry( const QString & name,
+			       struct stat *   statInfo,
+			       time_t *	       btime ) Q_DECL_OVERRIDE
+	{
+	    QString path = joinPath( _dirName, name );
+
+	    if ( _fs->isDirName( name, _level ) )
+	    {
+		_fs->dirStat( path, statInfo );
+	    }
+	    else
+	    {
+		// "file<n><suffix>"
+
+		int len = 4;
+
+		while ( len < name.size() && name.at( len ).isDigit() )
+		    ++len;
+
+		bool ok	   = false;
+		int  index = name.mid( 4, len - 4 ).toInt( &ok );
+
+		if ( ! name.startsWith( "file" ) || ! ok ||
+		     index >= _fs->filesPerDir() ||
+		     SyntheticFileSystem::fileName( _dirName, index ) != name )
+		{
+		    errno = ENOENT;
+		    return -1;
+		}
+
+		_fs->fileStat( path, statInfo );
+	    }
+
+	    if ( btime )
+		*btime = statInfo->st_mtime;
+
+	    return 0;
+	}
+
+    protected:
+
+	SyntheticFileSystem *	_fs;
+	QString			_dirName;
+	int			_level;
+	int			_dirCount;
+	int			_pos;
+    };
+
+
+
+    /**
+     * A real directory that is recorded by a RecordingFileSystem.
+     **/
+    class RecordingDir: public FileSystemDir
+    {
+    public:
+
+	RecordingDir( RecordingFileSystem *		      fs,
+		      const QString &			      dirName,
+		      FileSystemDir *			      realDir,
+		      const QVector<QPair<QString, ino_t> > & entries ):
+	    _fs( fs ),
+	    _dirName( dirName ),
+	    _realDir( realDir ),
+	    _entries( entries ),
+	    _pos( 0 )
+	    {}
+
+	virtual ~RecordingDir()
+	    { delete _realDir; }
+
+	virtual bool readEntry( QString & name, ino_t & ino ) Q_DECL_OVERRIDE
+	{
+	    if ( _pos >= _entries.size() )
+		return false;
+
+	    name = _entries.at( _pos ).first;
+	    ino	 = _entries.at( _pos ).second;
+	    ++_pos;
+
+	    return true;
+	}
+
+	virtual int statEntry( const QString & name,
+			       struct stat *   statInfo,
+			       time_t *	       btime ) Q_DECL_OVERRIDE
+	{
+	    QElapsedTimer timer;
+	    timer.start();
+
+	    int result = _realDir->statEntry( name, statInfo, btime );
+
+	    _fs->recordStat( "S", elapsedUsec( timer ), result,
+			     joinPath( _dirName, name ), statInfo,
+			     btime ? *btime : 0 );
+	    return result;
+	}
+
+    protected:
+
+	RecordingFileSystem *		_fs;
+	QString				_dirName;
+	FileSystemDir *			_realDir;
+	QVector<QPair<QString, ino_t> > _entries;
+	int				_pos;
+    };
+
+
+
+    /**
+     * A directory of a ReplayFileSystem. The entries are read from the
+     * recording when they are needed.
+     **/
+    class ReplayDir: public FileSystemDir
+    {
+    public:
+
+	ReplayDir( ReplayFileSystem * fs,
+		   const QString &    dirName,
+		   qint64	      entriesOffset ):
+	    _fs( fs ),
+	    _dirName( dirName ),
+	    _offset( entriesOffset )
+	    {}
+
+	virtual bool readEntry( QString & name, ino_t & ino ) Q_DECL_OVERRIDE
+	{
+	    return _fs->readEntry( _offset, name, ino );
+	}
+
+	virtual int statEntry( const QString & name,
+			       struct stat *   statInfo,
+			       time_t *	       btime ) Q_DECL_OVERRIDE
+	{
+	    return _fs->replayStat( "S", joinPath( _dirName, name ), statInfo, btime );
+	}
+
+    protected:
+
+	ReplayFileSystem *	_fs;
+	QString			_dirName;
+	qint64			_offset;
+    };
+
+}	// namespace QDirStat
+
+
+
+
+FileSystemAccess * FileSystemAccess::instance()
+{
+    if ( ! _instance )
+    {
+	QString spec = QString::fromUtf8( qgetenv( "QDIRSTAT_FS" ) );
+
+	if ( ! spec.isEmpty() )
+	{
+	    _instance = create( spec );
+
+	    if ( _instance )
+		logInfo() << "Using filesystem access " << spec << endl;
+	    else
+		logError() << "Invalid QDIRSTAT_FS: " << spec << " - using the real filesystem" << endl;
+	}
+
+	if ( ! _instance )
+	{
+	    _instance = new RealFileSystem();
+	    CHECK_NEW( _instance );
+	}
+
+	// Make sure a recording is complete when the application exits
+
+	qAddPostRoutine( deleteInstance );
+    }
+
+    return _instance;
+}
+
+
+void FileSystemAccess::setInstance( FileSystemAccess * fs )
+{
+    if ( ! _instance )
+	qAddPostRoutine( deleteInstance );
+
+    delete _instance;
+    _instance = fs;
+}
+
+
+void FileSystemAccess::deleteInstance()
+{
+    delete _instance;
+    _instance = 0;
+}
+
+
+FileSystemAccess * FileSystemAccess::create( const QString & spec )
+{
+    QString type = spec.section( ':', 0, 0 );
+    QString args = spec.section( ':', 1 );	// file names may contain ':'
+
+    if ( type == "real" )
+	return new RealFileSystem();
+
+    if ( type == "synthetic" )
+    {
+	QStringList params = args.split( ':' );
+	bool ok = params.size() == 4 && params.at( 0 ).startsWith( "/" );
+	int  depth = 0, dirsPerDir = 0, filesPerDir = 0;
+
+	if ( ok ) depth	      = params.at( 1 ).toInt( &ok );
+	if ( ok ) dirsPerDir  = params.at( 2 ).toInt( &ok );
+	if ( ok ) filesPerDir = params.at( 3 ).toInt( &ok );
+
+	if ( ! ok || depth < 0 || dirsPerDir < 0 || filesPerDir < 0 )
+	    return 0;
+
+	return new SyntheticFileSystem( params.at( 0 ), depth, dirsPerDir, filesPerDir );
+    }
+
+    if ( type == "record" && ! args.isEmpty() )
+    {
+	RecordingFileSystem * fs = new RecordingFileSystem( args );
+	CHECK_NEW( fs );
+
+	if ( fs->ok() )
+	    return fs;
+
+	delete fs;
+	return 0;
+    }
+
+    if ( ( type == "replay" || type == "replay-fast" ) && ! args.isEmpty() )
+    {
+	ReplayFileSystem * fs = new ReplayFileSystem( args, type == "replay" );
+	CHECK_NEW( fs );
+
+	if ( fs->ok() )
+	    return fs;
+
+	delete fs;
+	return 0;
+    }
+
+    return 0;
+}
+
+
+
+
+bool RealFileSystem::canRead( const QString & dirName )
+{
+    return access( dirName.toUtf8(), X_OK | R_OK ) == 0;
+}
+
+
+FileSystemDir * RealFileSystem::openDir( const QString & dirName )
+{
+    DIR * diskDir = ::opendir( dirName.toUtf8() );
+
+    if ( ! diskDir )
+	return 0;
+
+    RealDir * dir = new RealDir( diskDir );
+    CHECK_NEW( dir );
+
+    return dir;
+}
+
+
+int RealFileSystem::lstat( const QString & path, struct stat * statInfo )
+{
+    return ::lstat( path.toUtf8(), statInfo );
+}
+
+
+
+
+SyntheticFileSystem::SyntheticFileSystem( const QString & root,
+					  int		  depth,
+					  int		  dirsPerDir,
+					  int		  filesPerDir ):
+    _root( root ),
+    _depth( depth ),
+    _dirsPerDir( dirsPerDir ),
+    _filesPerDir( filesPerDir ),
+    _uid( getuid() ),
+    _gid( getgid() )
+{
+    if ( _root.size() > 1 && _root.endsWith( "/" ) )
+	_root.chop( 1 );
+}
+
+
+bool SyntheticFileSystem::canRead( const QString & dirName )
+{
+    return dirLevel( dirName ) >= 0;
+}
+
+
+FileSystemDir * SyntheticFileSystem::openDir( const QString & dirName )
+{
+    int level = dirLevel( dirName );
+
+    if ( level < 0 )
+    {
+	errno = ENOENT;
+	return 0;
+    }
+
+    SyntheticDir * dir = new SyntheticDir( this, dirName, level );
+    CHECK_NEW( dir );
+
+    return dir;
+}
+
+
+int SyntheticFileSystem::lstat( const QString & path, struct stat * statInfo )
+{
+    if ( dirLevel( path ) >= 0 )
+    {
+	dirStat( path, statInfo );
+	return 0;
+    }
+
+    // A file in one of our directories?
+
+    int	    pos	    = path.lastIndexOf( '/' );
+    QString dirName = pos > 0 ? path.left( pos ) : QString( "/" );
+    int	    level   = dirLevel( dirName );
+
+    if ( level >= 0 )
+    {
+	SyntheticDir dir( this, dirName, level );
+	return dir.statEntry( path.mid( pos + 1 ), statInfo, 0 );
+    }
+
+    errno = ENOENT;
+    return -1;
+}
+
+
+int SyntheticFileSystem::dirLevel( const QString & path ) const
+{
+    if ( path == _root )
+	return 0;
+
+    QString prefix = _root == "/" ? _root : _root + "/";
+
+    if ( ! path.startsWith( prefix ) )
+	return -1;
+
+    QStringList components = path.mid( prefix.size() ).split( '/' );
+
+    for ( int level = 0; level < components.size(); ++level )
+    {
+	if ( ! isDirName( components.at( level ), level ) )
+	    return -1;
+    }
+
+    return components.size();
+}
+
+
+bool SyntheticFileSystem::isDirName( const QString & name, int parentLevel ) const
+{
+    if ( parentLevel >= _depth || ! name.startsWith( "dir" ) )
+	return false;
+
+    bool ok    = false;
+    int	 index = name.mid( 3 ).toInt( &ok );
+
+    return ok && index >= 0 && index < _dirsPerDir && name == QString( "dir%1" ).arg( index );
+}
+
+
+void SyntheticFileSystem::dirStat( const QString & path, struct stat * statInfo ) const
+{
+    memset( statInfo, 0, sizeof( *statInfo ) );
+
+    statInfo->st_dev	 = 0xfe00;
+    statInfo->st_ino	 = pathHash( path );
+    statInfo->st_mode	 = S_IFDIR | 0755;
+    statInfo->st_nlink	 = 2;
+    statInfo->st_uid	 = _uid;
+    statInfo->st_gid	 = _gid;
+    statInfo->st_size	 = 4096;
+    statInfo->st_blksize = 4096;
+    statInfo->st_blocks	 = 8;
+    statInfo->st_atime	 = SYNTHETIC_MTIME;
+    statInfo->st_mtime	 = SYNTHETIC_MTIME;
+    statInfo->st_ctime	 = SYNTHETIC_MTIME;
+}
+
+
+void SyntheticFileSystem::fileStat( const QString & path, struct stat * statInfo ) const
+{
+    quint64 hash = pathHash( path );
+
+    memset( statInfo, 0, sizeof( *statInfo ) );
+
+    // Sizes from a few bytes up to 128 MB, evenly spread on a log scale
+
+    statInfo->st_dev	 = 0xfe00;
+    statInfo->st_ino	 = hash;
+    statInfo->st_mode	 = S_IFREG | 0644;
+    statInfo->st_nlink	 = 1;
+    statInfo->st_uid	 = _uid;
+    statInfo->st_gid	 = _gid;
+    statInfo->st_size	 = ( 1LL << ( hash % 28 ) ) + ( hash >> 8 ) % 4096;
+    statInfo->st_blksize = 4096;
+    statInfo->st_blocks	 = ( ( statInfo->st_size + 4095 ) / 4096 ) * 8;
+    statInfo->st_mtime	 = SYNTHETIC_MTIME - ( hash >> 16 ) % 100000000;
+    statInfo->st_atime	 = statInfo->st_mtime;
+    statInfo->st_ctime	 = statInfo->st_mtime;
+}
+
+
+QString SyntheticFileSystem::fileName( const QString & dirPath, int index )
+{
+    static const char * suffixes[] =
+    {
+	".cpp", ".h", ".o", ".jpg", ".png", ".mp4", ".gz", ".txt", ".pdf", ".so", ""
+    };
+
+    const int suffixCount = sizeof( suffixes ) / sizeof( suffixes[0] );
+    quint64   hash	  = pathHash( dirPath ) + index;
+
+    return QString( "file%1%2" ).arg( index ).arg( suffixes[ hash % suffixCount ] );
+}
+
+
+
+
+RecordingFileSystem::RecordingFileSystem( const QString & fileName ):
+    RealFileSystem(),
+    _file( fileName )
+{
+    if ( ! _file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+	logError() << "Can't open " << fileName << endl;
+	return;
+    }
+
+    write( RECORDING_HEADER "\n"
+	   "# A  usec result errno path\n"
+	   "# D  usec result errno path  (followed by E ino name)\n"
+	   "# S|L usec result errno path dev ino mode nlink uid gid rdev size"
+	   " blksize blocks atime mtime ctime btime\n" );
+
+    logInfo() << "Recording filesystem access to " << fileName << endl;
+}
+
+
+RecordingFileSystem::~RecordingFileSystem()
+{
+    if ( _file.isOpen() )
+	_file.close();
+}
+
+
+void RecordingFileSystem::write( const QByteArray & line )
+{
+    QMutexLocker locker( &_mutex );
+    _file.write( line );
+}
+
+
+bool RecordingFileSystem::canRead( const QString & dirName )
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    bool result = RealFileSystem::canRead( dirName );
+    int	 error	= errno;
+
+    write( "A\t" + QByteArray::number( elapsedUsec( timer ) ) +
+	   "\t"	 + QByteArray( result ? "0" : "-1" ) +
+	   "\t"	 + QByteArray::number( result ? 0 : error ) +
+	   "\t"	 + QUrl::toPercentEncoding( dirName, "/" ) + "\n" );
+
+    return result;
+}
+
+
+FileSystemDir * RecordingFileSystem::openDir( const QString & dirName )
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Read all entries right away, so the recording has them in one place
+
+    FileSystemDir * realDir = RealFileSystem::openDir( dirName );
+    int		    error   = errno;
+    QVector<QPair<QString, ino_t> > entries;
+
+    if ( realDir )
+    {
+	QString name;
+	ino_t	ino;
+
+	while ( realDir->readEntry( name, ino ) )
+	    entries << qMakePair( name, ino );
+    }
+
+    QByteArray lines = "D\t" + QByteArray::number( elapsedUsec( timer ) ) +
+	"\t" + QByteArray( realDir ? "0" : "-1" ) +
+	"\t" + QByteArray::number( realDir ? 0 : error ) +
+	"\t" + QUrl::toPercentEncoding( dirName, "/" ) + "\n";
+
+    for ( int i = 0; i < entries.size(); ++i )
+    {
+	lines += "E\t" + QByteArray::number( (qulonglong) entries.at( i ).second ) +
+	    "\t" + QUrl::toPercentEncoding( entries.at( i ).first ) + "\n";
+    }
+
+    write( lines );
+
+    // This is never deleted if the application crashes, so don't lose more
+    // than one directory
+
+    {
+	QMutexLocker locker( &_mutex );
+	_file.flush();
+    }
+
+    if ( ! realDir )
+    {
+	errno = error;
+	return 0;
+    }
+
+    RecordingDir * dir = new RecordingDir( this, dirName, realDir, entries );
+    CHECK_NEW( dir );
+
+    return dir;
+}
+
+
+int RecordingFileSystem::lstat( const QString & path, struct stat * statInfo )
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    int result = RealFileSystem::lstat( path, statInfo );
+    recordStat( "L", elapsedUsec( timer ), result, path, statInfo, 0 );
+
+    return result;
+}
+
+
+void RecordingFileSystem::recordStat( const char *    type,
+				      qint64	      usec,
+				      int	      result,
+				      const QString & path,
+				      struct stat *   statInfo,
+				      time_t	      btime )
+{
+    int error = errno;
+
+    QByteArray line = type;
+    line += "\t" + QByteArray::number( usec );
+    line += "\t" + QByteArray::number( result );
+    line += "\t" + QByteArray::number( result == 0 ? 0 : error );
+    line += "\t" + QUrl::toPercentEncoding( path, "/" );
+
+    if ( result == 0 )
+    {
+	qlonglong fields[] =
+	{
+	    (qlonglong) statInfo->st_dev,
+	    (qlonglong) statInfo->st_ino,
+	    (qlonglong) statInfo->st_mode,
+	    (qlonglong) statInfo->st_nlink,
+	    (qlonglong) statInfo->st_uid,
+	    (qlonglong) statInfo->st_gid,
+	    (qlonglong) statInfo->st_rdev,
+	    (qlonglong) statInfo->st_size,
+	    (qlonglong) statInfo->st_blksize,
+	    (qlonglong) statInfo->st_blocks,
+	    (qlonglong) statInfo->st_atime,
+	    (qlonglong) statInfo->st_mtime,
+	    (qlonglong) statInfo->st_ctime,
+	    (qlonglong) btime
+	};
+
+	for ( size_t i = 0; i < sizeof( fields ) / sizeof( fields[0] ); ++i )
+	    line += "\t" + QByteArray::number( fields[i] );
+    }
+
+    write( line + "\n" );
+    errno = error;
+}
+
+
+
+
+ReplayFileSystem::ReplayFileSystem( const QString & fileName, bool withDelays ):
+    _withDelays( withDelays ),
+    _file( fileName ),
+    _data( 0 ),
+    _size( 0 )
+{
+    if ( ! _file.open( QIODevice::ReadOnly ) )
+    {
+	logError() << "Can't open " << fileName << endl;
+	return;
+    }
+
+    if ( _file.readLine().trimmed() != RECORDING_HEADER )
+    {
+	logError() << fileName << " is not a filesystem recording" << endl;
+	return;
+    }
+
+    // Only the offset of each line is kept in memory; the lines are parsed
+    // again when a call is replayed. A recording of a large tree is often
+    // bigger than the tree that is read from it.
+
+    _size = _file.size();
+    _data = (const char *) _file.map( 0, _size );
+
+    if ( ! _data )
+    {
+	logError() << "Can't map " << fileName << ": " << _file.errorString() << endl;
+	return;
+    }
+
+    qint64 offset = _file.pos();
+    qint64 next   = 0;
+
+    while ( offset < _size )
+    {
+	QByteArray line = lineAt( offset, &next );
+
+	if ( ! line.isEmpty() && ! line.startsWith( '#' ) && ! line.startsWith( "E\t" ) )
+	{
+	    QList<QByteArray> fields = line.split( '\t' );
+	    QByteArray	      type   = fields.first();
+
+	    bool ok = fields.size() >= 5;
+
+	    if ( ok && ( type == "S" || type == "L" ) && fields.at( 2 ).toInt() == 0 )
+		ok = fields.size() >= 19;
+
+	    if ( ok )
+	    {
+		QString key = QString::fromLatin1( type ) + QUrl::fromPercentEncoding( fields.at( 4 ) );
+		_offsets.insert( pathHash( key ), offset );
+	    }
+	    else
+	    {
+		logWarning() << "Bad line in " << fileName << ": " << line << endl;
+	    }
+	}
+
+	offset = next;
+    }
+
+    logInfo() << "Replaying " << _offsets.size() << " calls from " << fileName
+	      << ( _withDelays ? " with" : " without" ) << " the recorded delays"
+	      << endl;
+}
+
+
+ReplayFileSystem::~ReplayFileSystem()
+{
+    // The file is unmapped when it is closed
+}
+
+
+QByteArray ReplayFileSystem::lineAt( qint64 offset, qint64 * nextOffset ) const
+{
+    const char * start = _data + offset;
+    const char * end   = (const char *) memchr( start, '\n', _size - offset );
+
+    if ( ! end )
+	end = _data + _size;
+
+    if ( nextOffset )
+	*nextOffset = end - _data + 1;
+
+    return QByteArray::fromRawData( start, end - start );
+}
+
+
+QList<QByteArray> ReplayFileSystem::replay( const char *    type,
+					    const QString & path,
+					    qint64 *	    nextOffset )
+{
+    QByteArray typeField( type );
+    quint64    key = pathHash( QString::fromLatin1( type ) + path );
+
+    // If a call was recorded more than once, the last one wins:
+    // QMultiHash returns the most recently inserted value first.
+
+    QMultiHash<quint64, qint64>::const_iterator it = _offsets.constFind( key );
+
+    while ( it != _offsets.constEnd() && it.key() == key )
+    {
+	QList<QByteArray> fields = lineAt( it.value(), nextOffset ).split( '\t' );
+
+	if ( fields.first() == typeField && QUrl::fromPercentEncoding( fields.at( 4 ) ) == path )
+	{
+	    qint64 usec = fields.at( 1 ).toLongLong();
+
+	    if ( _withDelays && usec > 0 )
+		usleep( usec );
+
+	    return fields;
+	}
+
+	++it;
+    }
+
+    return QList<QByteArray>();
+}
+
+
+bool ReplayFileSystem::canRead( const QString & dirName )
+{
+    QList<QByteArray> fields = replay( "A", dirName );
+
+    return ! fields.isEmpty() && fields.at( 2 ).toInt() == 0;
+}
+
+
+FileSystemDir * ReplayFileSystem::openDir( const QString & dirName )
+{
+    qint64 entriesOffset = 0;
+    QList<QByteArray> fields = replay( "D", dirName, &entriesOffset );
+
+    if ( fields.isEmpty() || fields.at( 2 ).toInt() != 0 )
+    {
+	errno = fields.isEmpty() ? ENOENT : fields.at( 3 ).toInt();
+	return 0;
+    }
+
+    ReplayDir * dir = new ReplayDir( this, dirName, entriesOffset );
+    CHECK_NEW( dir );
+
+    return dir;
+}
+
+
+int ReplayFileSystem::lstat( const QString & path, struct stat * statInfo )
+{
+    return replayStat( "L", path, statInfo, 0 );
+}
+
+
+int ReplayFileSystem::replayStat( const char *	  type,
+				  const QString & path,
+				  struct stat *	  statInfo,
+				  time_t *	  btime )
+{
+    QList<QByteArray> fields = replay( type, path );
+
+    if ( fields.isEmpty() || fields.at( 2 ).toInt() != 0 )
+    {
+	errno = fields.isEmpty() ? ENOENT : fields.at( 3 ).toInt();
+	return -1;
+    }
+
+    memset( statInfo, 0, sizeof( *statInfo ) );
+    int i = 5;
+
+    statInfo->st_dev	 = fields.at( i++ ).toLongLong();
+    statInfo->st_ino	 = fields.at( i++ ).toLongLong();
+    statInfo->st_mode	 = fields.at( i++ ).toLongLong();
+    statInfo->st_nlink	 = fields.at( i++ ).toLongLong();
+    statInfo->st_uid	 = fields.at( i++ ).toLongLong();
+    statInfo->st_gid	 = fields.at( i++ ).toLongLong();
+    statInfo->st_rdev	 = fields.at( i++ ).toLongLong();
+    statInfo->st_size	 = fields.at( i++ ).toLongLong();
+    statInfo->st_blksize = fields.at( i++ ).toLongLong();
+    statInfo->st_blocks	 = fields.at( i++ ).toLongLong();
+    statInfo->st_atime	 = fields.at( i++ ).toLongLong();
+    statInfo->st_mtime	 = fields.at( i++ ).toLongLong();
+    statInfo->st_ctime	 = fields.at( i++ ).toLongLong();
+
+    if ( btime )
+	*btime = fields.at( i++ ).toLongLong();
+
+    return 0;
+}
+
+
+bool ReplayFileSystem::readEntry( qint64 & offset, QString & name, ino_t & ino ) const
+{
+    if ( offset >= _size )
+	return false;
+
+    // The "E" lines of a directory directly follow its "D" line
+
+    qint64 next = 0;
+    QList<QByteArray> fields = lineAt( offset, &next ).split( '\t' );
+
+    if ( fields.size() != 3 || fields.first() != "E" )
+	return false;
+
+    ino	   = (ino_t) fields.at( 1 ).toULongLong();
+    name   = QUrl::fromPercentEncoding( fields.at( 2 ) );
+    offset = next;
+
+    return true;
+}
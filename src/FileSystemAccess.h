@@ -0,0 +1,318 @@
+/*
+ *   File name: FileSystemAccess.h
+ *   Summary:	Exchangeable filesystem access for reading directories
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+#ifndef FileSystemAccess_h
+#define FileSystemAccess_h
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QByteArray>
+#include <QHash>
+#include <QFile>
+#include <QMutex>
+
+
+namespace QDirStat
+{
+    /**
+     * One open directory of a FileSystemAccess.
+     **/
+    class FileSystemDir
+    {
+    public:
+
+	virtual ~FileSystemDir() {}
+
+	/**
+	 * Get the name and the i-number of the next directory entry,
+	 * skipping "." and "..". Return 'false' at the end.
+	 **/
+	virtual bool readEntry( QString & name, ino_t & ino ) = 0;
+
+	/**
+	 * Get the lstat() information for entry 'name' of this directory
+	 * without triggering an automount. If 'btime' is non-null, also get
+	 * the creation time if possible (0 if unknown).
+	 *
+	 * Return 0 on success and -1 on error (with errno set).
+	 **/
+	virtual int statEntry( const QString & name,
+			       struct stat *   statInfo,
+			       time_t *	       btime ) = 0;
+    };
+
+
+    /**
+     * The system calls that LocalDirReadJob needs to read a directory tree
+     * from disk, so they can be replaced for testing and benchmarking:
+     *
+     * - RealFileSystem:      The real system calls (the default)
+     *
+     * - SyntheticFileSystem: A generated tree of any size that only exists
+     *			      in memory
+     *
+     * - RecordingFileSystem: The real system calls, but the results and the
+     *			      time each call took are written to a file
+     *
+     * - ReplayFileSystem:    The results from such a file, with the recorded
+     *			      delays or as fast as possible
+     *
+     * This is selected with the QDIRSTAT_FS environment variable:
+     *
+     *	   QDIRSTAT_FS=synthetic:/synthetic:4:10:1000
+     *	   QDIRSTAT_FS=record:/tmp/scan.rec
+     *	   QDIRSTAT_FS=replay:/tmp/scan.rec
+     *	   QDIRSTAT_FS=replay-fast:/tmp/scan.rec
+     *
+     * See SyntheticFileSystem for the parameters of a synthetic tree.
+     *
+     * Only reading directories goes through this; everything else (cleanups,
+     * the file details view etc.) still uses the real filesystem.
+     **/
+    class FileSystemAccess
+    {
+    public:
+
+	virtual ~FileSystemAccess() {}
+
+	/**
+	 * Return the filesystem access to use. This is created upon the
+	 * first call according to the QDIRSTAT_FS environment variable.
+	 **/
+	static FileSystemAccess * instance();
+
+	/**
+	 * Use 'fs' from now on. This takes over ownership of 'fs'.
+	 **/
+	static void setInstance( FileSystemAccess * fs );
+
+	/**
+	 * Create the filesystem access for 'spec' (the syntax of the
+	 * QDIRSTAT_FS environment variable). Return 0 if 'spec' is invalid.
+	 **/
+	static FileSystemAccess * create( const QString & spec );
+
+	/**
+	 * Return 'true' if directory 'dirName' may be read, i.e. it has read
+	 * and execute permissions.
+	 **/
+	virtual bool canRead( const QString & dirName ) = 0;
+
+	/**
+	 * Open directory 'dirName'. Return 0 on error. The caller has to
+	 * delete the returned object.
+	 **/
+	virtual FileSystemDir * openDir( const QString & dirName ) = 0;
+
+	/**
+	 * Get the lstat() information for 'path'.
+	 * Return 0 on success and -1 on error (with errno set).
+	 **/
+	virtual int lstat( const QString & path, struct stat * statInfo ) = 0;
+
+    protected:
+
+	/**
+	 * Delete the instance. This is called when the application exits.
+	 **/
+	static void deleteInstance();
+
+	static FileSystemAccess * _instance;
+    };
+
+
+    /**
+     * The real system calls.
+     **/
+    class RealFileSystem: public FileSystemAccess
+    {
+    public:
+
+	virtual bool canRead( const QString & dirName ) Q_DECL_OVERRIDE;
+	virtual FileSystemDir * openDir( const QString & dirName ) Q_DECL_OVERRIDE;
+	virtual int lstat( const QString & path, struct stat * statInfo ) Q_DECL_OVERRIDE;
+    };
+
+
+    /**
+     * A generated tree that only exists in memory: Directory 'root' with
+     * 'dirsPerDir' subdirectories "dir0", "dir1", ... on each level down to
+     * 'depth' levels below it, and 'filesPerDir' files in each directory.
+     * The sizes, timestamps and suffixes of the files are derived from their
+     * paths, so they are the same for each run.
+     *
+     * Spec: "synthetic:<root>:<depth>:<dirsPerDir>:<filesPerDir>"
+     *
+     * E.g. "synthetic:/synthetic:4:10:10000" has 11111 directories with
+     * 111 million files.
+     **/
+    class SyntheticFileSystem: public FileSystemAccess
+    {
+    public:
+
+	SyntheticFileSystem( const QString & root,
+			     int	     depth,
+			     int	     dirsPerDir,
+			     int	     filesPerDir );
+
+	virtual bool canRead( const QString & dirName ) Q_DECL_OVERRIDE;
+	virtual FileSystemDir * openDir( const QString & dirName ) Q_DECL_OVERRIDE;
+	virtual int lstat( const QString & path, struct stat * statInfo ) Q_DECL_OVERRIDE;
+
+	int dirsPerDir()  const { return _dirsPerDir;  }
+	int filesPerDir() const { return _filesPerDir; }
+
+	/**
+	 * Return the level of directory 'path' below the root (0 for the
+	 * root) or -1 if there is no such directory.
+	 **/
+	int dirLevel( const QString & path ) const;
+
+	/**
+	 * Return 'true' if 'name' is a subdirectory of a directory on level
+	 * 'parentLevel'.
+	 **/
+	bool isDirName( const QString & name, int parentLevel ) const;
+
+	/**
+	 * Fill 'statInfo' for directory 'path' or file 'path'.
+	 **/
+	void dirStat ( const QString & path, struct stat * statInfo ) const;
+	void fileStat( const QString & path, struct stat * statInfo ) const;
+
+	/**
+	 * Return the name of file no. 'index' in directory 'dirPath'.
+	 **/
+	static QString fileName( const QString & dirPath, int index );
+
+    protected:
+
+	QString _root;
+	int	_depth;
+	int	_dirsPerDir;
+	int	_filesPerDir;
+	uid_t	_uid;
+	gid_t	_gid;
+    };
+
+
+    /**
+     * The real system calls, recording the results with the time each call
+     * took to a file for a ReplayFileSystem.
+     *
+     * Spec: "record:<file>"
+     **/
+    class RecordingFileSystem: public RealFileSystem
+    {
+    public:
+
+	RecordingFileSystem( const QString & fileName );
+	virtual ~RecordingFileSystem();
+
+	bool ok() const { return _file.isOpen(); }
+
+	virtual bool canRead( const QString & dirName ) Q_DECL_OVERRIDE;
+	virtual FileSystemDir * openDir( const QString & dirName ) Q_DECL_OVERRIDE;
+	virtual int lstat( const QString & path, struct stat * statInfo ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Record a stat call for 'path' ('type' is "S" for statEntry() or
+	 * "L" for lstat()) with its result.
+	 **/
+	void recordStat( const char *	 type,
+			 qint64		 usec,
+			 int		 result,
+			 const QString & path,
+			 struct stat *	 statInfo,
+			 time_t		 btime );
+
+    protected:
+
+	/**
+	 * Write 'line' to the file. This may be called from several read
+	 * threads at the same time.
+	 **/
+	void write( const QByteArray & line );
+
+	QFile	_file;
+	QMutex	_mutex;
+    };
+
+
+    /**
+     * The results of a RecordingFileSystem, optionally with the time each
+     * call took originally. Anything that was not recorded does not exist.
+     *
+     * The recording is mapped into memory and only indexed by the offset of
+     * each line, so replaying a large tree does not need more memory than
+     * the tree itself.
+     *
+     * Spec: "replay:<file>" or "replay-fast:<file>" (without the delays)
+     **/
+    class ReplayFileSystem: public FileSystemAccess
+    {
+    public:
+
+	ReplayFileSystem( const QString & fileName, bool withDelays );
+	virtual ~ReplayFileSystem();
+
+	bool ok() const { return _data != 0; }
+
+	virtual bool canRead( const QString & dirName ) Q_DECL_OVERRIDE;
+	virtual FileSystemDir * openDir( const QString & dirName ) Q_DECL_OVERRIDE;
+	virtual int lstat( const QString & path, struct stat * statInfo ) Q_DECL_OVERRIDE;
+
+	/**
+	 * Replay the stat call 'type' ("S" or "L") for 'path'.
+	 **/
+	int replayStat( const char *	type,
+			const QString & path,
+			struct stat *	statInfo,
+			time_t *	btime );
+
+	/**
+	 * Get the directory entry at 'offset' in the recording and advance
+	 * 'offset' to the next one. Return 'false' at the end of the
+	 * directory.
+	 **/
+	bool readEntry( qint64 & offset, QString & name, ino_t & ino ) const;
+
+    protected:
+
+	/**
+	 * Return the fields of the recorded call 'type' for 'path' or an
+	 * empty list if there is none. If 'nextOffset' is non-null, it is set
+	 * to the offset of the line after it. Wait as long as the call took
+	 * originally if configured.
+	 **/
+	QList<QByteArray> replay( const char *	  type,
+				  const QString & path,
+				  qint64 *	  nextOffset = 0 );
+
+	/**
+	 * Return the line at 'offset' without the newline. If 'nextOffset'
+	 * is non-null, it is set to the offset of the next line.
+	 **/
+	QByteArray lineAt( qint64 offset, qint64 * nextOffset = 0 ) const;
+
+	bool				_withDelays;
+	QFile				_file;
+	const char *			_data;
+	qint64				_size;
+	QMultiHash<quint64, qint64>	_offsets;	// by hash of type + path
+    };
+
+}	// namespace QDirStat
+
+#endif	// FileSystemAccess_h
@@ -8,9 +8,12 @@
 
 
 #include "FileTypeStats.h"
+#include "ContentSniffer.h"
 #include "DirTree.h"
+#include "DirInfo.h"
 #include "FileInfoIterator.h"
 #include "MimeCategorizer.h"
+#include "SmallFileSummary.h"
 #include "FormatUtil.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -20,6 +23,8 @@ using namespace QDirStat;
 
 FileTypeStats::FileTypeStats( QObject  * parent ):
     QObject( parent ),
+    _tree( 0 ),
+    _treeGeneration( 0 ),
     _totalSize( 0LL )
 {
     _mimeCategorizer = MimeCategorizer::instance();
@@ -43,6 +48,8 @@ void FileTypeStats::clear()
     _suffixCount.clear();
     _categorySum.clear();
     _categoryCount.clear();
+    _suffixDirs.clear();
+    _tree      = 0;
     _totalSize = 0LL;
 }
 
@@ -84,6 +91,12 @@ FileSize FileTypeStats::categoryNonSuffixRuleSum( MimeCategory * category ) cons
 }
 
 
+bool FileTypeStats::hasValidSuffixDirs() const
+{
+    return _tree && _tree->generation() == _treeGeneration;
+}
+
+
 MimeCategory * FileTypeStats::category( const QString & suffix ) const
 {
     return _mimeCategorizer->category( "x." + suffix );
@@ -107,6 +120,11 @@ void FileTypeStats::calc( FileInfo * subtree )
 
     if ( subtree && subtree->checkMagicNumber() )
     {
+        _tree = subtree->tree();
+
+        if ( _tree )
+            _treeGeneration = _tree->generation();
+
         collect( subtree );
         _totalSize = subtree->totalSize();
         removeCruft();
@@ -123,73 +141,39 @@ void FileTypeStats::collect( FileInfo * dir )
     if ( ! dir )
 	return;
 
+    if ( dir->isDirInfo() )
+	addSmallFileSums( dir->toDirInfo()->smallFileSummary() );
+
     FileInfoIterator it( dir );
 
     while ( *it )
     {
 	FileInfo * item = *it;
 
-	if ( item->hasChildren() )
+	if ( item->hasChildren() ||
+	     ( item->isDirInfo() && item->toDirInfo()->smallFileSummary() ) )
 	{
 	    collect( item );
 	}
 	else if ( item->isFile() )
 	{
-	    QString suffix;
-
-	    // First attempt: Try the MIME categorizer.
-	    //
-	    // If it knows the file's suffix, it can much easier find the
-	    // correct one in case there are multiple to choose from, for
-	    // example ".tar.bz2", not ".bz2" for a bzipped tarball. But on
-	    // Linux systems, having multiple dots in filenames is very common,
-	    // e.g. in .deb or .rpm packages, so the longest possible suffix is
-	    // not always the useful one (because it might contain version
-	    // numbers and all kinds of irrelevant information).
-	    //
-	    // The suffixes the MIME categorizer knows are carefully
-	    // hand-crafted, so if it knows anything about a suffix, it's the
-	    // best choice.
-
-	    MimeCategory * category = _mimeCategorizer->category( item->name(), &suffix );
-
-            if ( category )
-            {
-                addCategorySum( category, item );
-
-                if ( suffix.isEmpty() )
-                    addNonSuffixRuleSum( category, item );
-                else
-                    addSuffixSum( suffix, item );
-            }
-            else // ! category
-            {
-                addCategorySum( _otherCategory, item );
-
-                if ( suffix.isEmpty() )
-                {
-                    if ( item->name().contains( '.' ) && ! item->name().startsWith( '.' ) )
-                    {
-                        // Fall back to the last (i.e. the shortest) suffix if the
-                        // MIME categorizer didn't know it: Use section -1 (the
-                        // last one, ignoring any trailing '.' separator).
-                        //
-                        // The downside is that this would not find a ".tar.bz",
-                        // but just the ".bz" for a compressed tarball. But it's
-                        // much better than getting a ".eab7d88df-git.deb" rather
-                        // than a ".deb".
-
-                        suffix = item->name().section( '.', -1 );
-                    }
-                }
-
-                suffix = suffix.toLower();
-
-                if ( suffix.isEmpty() )
-                    suffix = NO_SUFFIX;
-
-                addSuffixSum( suffix, item );
-            }
+	    MimeCategory * category = 0;
+	    QString suffix = fileSuffix( item, &category );
+
+	    if ( category )
+	    {
+		addCategorySum( category, item );
+
+		if ( suffix.isEmpty() )
+		    addNonSuffixRuleSum( category, item );
+		else
+		    addSuffixSum( suffix, item );
+	    }
+	    else
+	    {
+		addCategorySum( _otherCategory, item );
+		addSuffixSum( suffix, item );
+	    }
             // Disregard symlinks, block devices and other special files
         }
 
@@ -198,6 +182,81 @@ void FileTypeStats::collect( FileInfo * dir )
 }
 
 
+QString FileTypeStats::fileSuffix( FileInfo * file, MimeCategory ** categoryRet )
+{
+    MimeCategorizer * mimeCategorizer = MimeCategorizer::instance();
+    QString suffix;
+
+    // First attempt: Try the MIME categorizer.
+    //
+    // If it knows the file's suffix, it can much easier find the
+    // correct one in case there are multiple to choose from, for
+    // example ".tar.bz2", not ".bz2" for a bzipped tarball. But on
+    // Linux systems, having multiple dots in filenames is very common,
+    // e.g. in .deb or .rpm packages, so the longest possible suffix is
+    // not always the useful one (because it might contain version
+    // numbers and all kinds of irrelevant information).
+    //
+    // The suffixes the MIME categorizer knows are carefully
+    // hand-crafted, so if it knows anything about a suffix, it's the
+    // best choice.
+
+    MimeCategory * category = mimeCategorizer->category( file->name(), &suffix );
+
+    if ( ! category )
+    {
+	// Second attempt: The file type that was detected from the
+	// content. That is not the suffix of the file, so it only
+	// counts for the category.
+
+	QString sniffedSuffix = ContentSniffer::sniffedSuffix( file );
+
+	if ( ! sniffedSuffix.isEmpty() )
+	{
+	    MimeCategory * sniffedCategory = mimeCategorizer->category( "x." + sniffedSuffix );
+
+	    if ( sniffedCategory )
+	    {
+		if ( categoryRet )
+		    *categoryRet = sniffedCategory;
+
+		return QString();
+	    }
+	}
+    }
+
+    if ( categoryRet )
+	*categoryRet = category;
+
+    if ( category )
+	return suffix;
+
+    if ( suffix.isEmpty() )
+    {
+	if ( file->name().contains( '.' ) && ! file->name().startsWith( '.' ) )
+	{
+	    // Fall back to the last (i.e. the shortest) suffix if the
+	    // MIME categorizer didn't know it: Use section -1 (the
+	    // last one, ignoring any trailing '.' separator).
+	    //
+	    // The downside is that this would not find a ".tar.bz",
+	    // but just the ".bz" for a compressed tarball. But it's
+	    // much better than getting a ".eab7d88df-git.deb" rather
+	    // than a ".deb".
+
+	    suffix = file->name().section( '.', -1 );
+	}
+    }
+
+    suffix = suffix.toLower();
+
+    if ( suffix.isEmpty() )
+	suffix = NO_SUFFIX;
+
+    return suffix;
+}
+
+
 void FileTypeStats::addCategorySum( MimeCategory * category, FileInfo * item )
 {
     _categorySum[ category ] += item->size();
@@ -209,6 +268,33 @@ void FileTypeStats::addSuffixSum( const QString & suffix, FileInfo * item )
 {
     _suffixSum[ suffix ] += item->size();
     ++_suffixCount[ suffix ];
+
+    // Add the file to the suffix index. Files in a dot entry belong to its
+    // parent directory. All files of one directory are processed in a row,
+    // so only the last entry in the list needs to be checked.
+
+    DirInfo * dir = item->parent();
+
+    if ( dir && dir->isDotEntry() )
+	dir = dir->parent();
+
+    if ( ! dir )
+	return;
+
+    SuffixDirList & dirList = _suffixDirs[ suffix ];
+
+    if ( dirList.isEmpty() || dirList.last().dir != dir )
+    {
+	SuffixDirEntry entry;
+	entry.dir   = dir;
+	entry.count = 0;
+	entry.size  = 0LL;
+
+	dirList << entry;
+    }
+
+    ++dirList.last().count;
+    dirList.last().size += item->size();
 }
 
 
@@ -219,6 +305,62 @@ void FileTypeStats::addNonSuffixRuleSum( MimeCategory * category, FileInfo * ite
 }
 
 
+void FileTypeStats::addSmallFileSums( const SmallFileSummary * summary )
+{
+    if ( ! summary || summary->isEmpty() )
+	return;
+
+    // Aggregated small files are only known by their MIME category, not by
+    // their name, so they can only be accounted for as non-suffix rule
+    // matches of that category. Everything else goes to "Other" without a
+    // suffix.
+
+    FileSize classifiedSum   = 0LL;
+    int	     classifiedCount = 0;
+
+    SmallFileCategorySumMap::const_iterator it = summary->categorySums().constBegin();
+
+    while ( it != summary->categorySums().constEnd() )
+    {
+	MimeCategory * category = 0;
+
+	foreach ( MimeCategory * cat, _mimeCategorizer->categories() )
+	{
+	    if ( cat->name() == it.key() )
+	    {
+		category = cat;
+		break;
+	    }
+	}
+
+	if ( ! category )
+	    category = _otherCategory;
+
+	int count = summary->categoryCounts().value( it.key() );
+
+	_categorySum  [ category ] += it.value();
+	_categoryCount[ category ] += count;
+	_categoryNonSuffixRuleSum  [ category ] += it.value();
+	_categoryNonSuffixRuleCount[ category ] += count;
+
+	classifiedSum	+= it.value();
+	classifiedCount += count;
+	++it;
+    }
+
+    FileSize otherSum	= summary->totalSize() - classifiedSum;
+    int	     otherCount = summary->count()     - classifiedCount;
+
+    if ( otherCount > 0 )
+    {
+	_categorySum  [ _otherCategory ] += otherSum;
+	_categoryCount[ _otherCategory ] += otherCount;
+	_suffixSum    [ NO_SUFFIX ]	 += otherSum;
+	_suffixCount  [ NO_SUFFIX ]	 += otherCount;
+    }
+}
+
+
 void FileTypeStats::removeCruft()
 {
     // Make sure those two already exist to avoid confusing the iterator
@@ -254,6 +396,10 @@ void FileTypeStats::removeCruft()
 
 	    it = _suffixCount.erase( it );
 	    _suffixSum.remove( suffix );
+
+	    // Nobody can locate files without a suffix, so there is no
+	    // need to merge the directories of that suffix, too.
+	    _suffixDirs.remove( suffix );
 	}
 	else
 	{
@@ -286,6 +432,7 @@ void FileTypeStats::removeEmpty()
 	    logDebug() << "Removing empty suffix *." << suffix << endl;
 	    it = _suffixCount.erase( it );
 	    _suffixSum.remove( suffix );
+	    _suffixDirs.remove( suffix );
 	}
 	else
 	{
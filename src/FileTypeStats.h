@@ -12,6 +12,8 @@
 
 #include <QObject>
 #include <QMap>
+#include <QHash>
+#include <QVector>
 
 #include "ui_file-type-stats-window.h"
 #include "DirInfo.h"
@@ -27,6 +29,7 @@ namespace QDirStat
     class DirTree;
     class MimeCategorizer;
     class MimeCategory;
+    class SmallFileSummary;
 
     typedef QMap<QString, FileSize>		StringFileSizeMap;
     typedef QMap<QString, int>			StringIntMap;
@@ -37,6 +40,21 @@ namespace QDirStat
     typedef CategoryFileSizeMap::const_iterator CategoryFileSizeMapIterator;
 
 
+    /**
+     * One directory in the suffix index of FileTypeStats: The number and
+     * the total size of the files with a suffix directly in that directory
+     * (including its dot entry).
+     **/
+    struct SuffixDirEntry
+    {
+	DirInfo * dir;
+	int	  count;
+	FileSize  size;
+    };
+
+    typedef QVector<SuffixDirEntry>		SuffixDirList;
+
+
     /**
      * Class to calculate file type statistics for a subtree, such as how much
      * disk space is used for each kind of filename extension (*.jpg, *.mp4
@@ -116,11 +134,43 @@ namespace QDirStat
 	 **/
 	FileSize categoryNonSuffixRuleSum( MimeCategory * category ) const;
 
+	/**
+	 * Return the directories that directly contain files with the
+	 * specified suffix, with the number and total size of those files in
+	 * each directory. This is collected along with the sums, so it is
+	 * much faster than searching the tree again.
+	 *
+	 * The list contains DirInfo pointers, so it is only valid as long as
+	 * the tree is not changed; check that with hasValidSuffixDirs().
+	 **/
+	SuffixDirList suffixDirs( const QString & suffix ) const
+	    { return _suffixDirs.value( suffix ); }
+
+	/**
+	 * Return 'true' if the suffix directory index (see suffixDirs()) is
+	 * still valid, i.e. if the tree has not changed since the last calc().
+	 **/
+	bool hasValidSuffixDirs() const;
+
 	/**
 	 * Return the category for the specified suffix or 0 if there is none.
 	 **/
 	MimeCategory * category( const QString & suffix ) const;
 
+	/**
+	 * Return the suffix (without the leading '.') that 'file' is counted
+	 * for in the suffix sums and in the suffix index, NO_SUFFIX if it has
+	 * none, or an empty string if it is only counted for its category
+	 * (matched by a non-suffix rule or by its content).
+	 *
+	 * If 'categoryRet' is non-null, the category of the file is returned
+	 * there, or 0 if it is unclassified.
+	 *
+	 * Use this to find the same files as the statistics.
+	 **/
+	static QString fileSuffix( FileInfo *	    file,
+				   MimeCategory ** categoryRet = 0 );
+
 	/**
 	 * Return the special category for "other", i.e. unclassified files.
 	 **/
@@ -170,6 +220,12 @@ namespace QDirStat
         void addNonSuffixRuleSum( MimeCategory * category, FileInfo * item );
         void addSuffixSum       ( const QString & suffix,  FileInfo * item );
 
+	/**
+	 * Add the sums of small files that were only summarized during
+	 * reading (see SmallFileSummary).
+	 **/
+	void addSmallFileSums( const SmallFileSummary * summary );
+
 	/**
 	 * Remove useless content from the maps. On a Linux system, there tend
 	 * to be a lot of files that have a '.' in the name, but it's not a
@@ -214,6 +270,10 @@ namespace QDirStat
 	CategoryFileSizeMap	_categoryNonSuffixRuleSum;
 	CategoryIntMap		_categoryNonSuffixRuleCount;
 
+	QHash<QString, SuffixDirList> _suffixDirs;
+	DirTree *		_tree;
+	int			_treeGeneration;
+
         FileSize                _totalSize;
     };
 }
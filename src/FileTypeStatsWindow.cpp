@@ -371,7 +371,8 @@ void FileTypeStatsWindow::locateCurrentFileType()
 	_locateFileTypeWindow->raise();
     }
 
-    _locateFileTypeWindow->populate( suffix, _subtree() );
+    // Use the directories that were collected along with the statistics
+    _locateFileTypeWindow->populate( suffix, _subtree(), _stats );
 }
 
 
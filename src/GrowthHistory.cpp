@@ -0,0 +1,692 @@
+/*
+ *   File name: GrowthHistory.cpp
+ *   Summary:	Per-directory size history across scans for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QUrl>
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutexLocker>
+
+#include "GrowthHistory.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+
+#define HISTORY_HEADER		"QDSHIST1\n"
+#define HISTORY_HEADER_LEN	9
+#define SECONDS_PER_DAY		(24*60*60)
+
+
+using namespace QDirStat;
+
+
+GrowthHistory * GrowthHistory::_instance = 0;
+
+
+//
+// Variable-length integers: 7 bits per byte, the highest bit is set if more
+// bytes follow. Signed values are zigzag-encoded first so small negative
+// values are short, too.
+//
+
+static void writeVarint( QByteArray & buf, quint64 value )
+{
+    while ( value >= 0x80 )
+    {
+	buf += (char) ( ( value & 0x7f ) | 0x80 );
+	value >>= 7;
+    }
+
+    buf += (char) value;
+}
+
+
+static bool readVarint( const char *& pos, const char * end, quint64 & value )
+{
+    value = 0;
+    int shift = 0;
+
+    while ( pos < end && shift < 64 )
+    {
+	unsigned char byte = (unsigned char) *pos++;
+	value |= (quint64) ( byte & 0x7f ) << shift;
+
+	if ( ! ( byte & 0x80 ) )
+	    return true;
+
+	shift += 7;
+    }
+
+    return false; // truncated
+}
+
+
+static quint64 zigzag( qint64 value )
+{
+    return ( (quint64) value << 1 ) ^ (quint64) ( value >> 63 );
+}
+
+
+static qint64 unzigzag( quint64 value )
+{
+    return (qint64) ( value >> 1 ) ^ -(qint64) ( value & 1 );
+}
+
+
+
+
+namespace QDirStat
+{
+    /**
+     * Worker job to record a sample of a tree snapshot in its history file
+     * and calculate the growth values.
+     **/
+    class GrowthHistoryJob: public QRunnable
+    {
+    public:
+
+	GrowthHistoryJob( GrowthHistory * history, TreeSnapshotPtr snapshot ):
+	    _history( history ),
+	    _snapshot( snapshot )
+	    {}
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    int generation = _snapshot->generation();
+	    QHash<FileInfo *, DirGrowth> growth = _history->record( _snapshot );
+
+	    // Post the result before releasing the snapshot: Deferred deletions
+	    // are only processed after the result was taken over.
+
+	    _history->addResult( generation, growth );
+	    _snapshot.clear();
+	}
+
+    protected:
+
+	GrowthHistory * _history;
+	TreeSnapshotPtr _snapshot;
+
+    };	// class GrowthHistoryJob
+
+}	// namespace QDirStat
+
+
+
+
+GrowthHistory * GrowthHistory::instance()
+{
+    if ( ! _instance )
+    {
+	_instance = new GrowthHistory();
+	CHECK_NEW( _instance );
+    }
+
+    return _instance;
+}
+
+
+GrowthHistory::GrowthHistory():
+    QObject(),
+    _tree( 0 ),
+    _jobRunning( false ),
+    _rerunJob( false ),
+    _jobGeneration( -1 )
+{
+    readSettings();
+
+    // Write settings immediately back since the destructor of this singleton
+    // is very likely never called.
+    writeSettings();
+}
+
+
+GrowthHistory::~GrowthHistory()
+{
+    writeSettings();
+}
+
+
+void GrowthHistory::setTree( DirTree * tree )
+{
+    if ( _tree )
+	_tree->disconnect( this );
+
+    _tree = tree;
+    _growth.clear();
+    _rerunJob = false;
+
+    if ( ! _tree )
+	return;
+
+    connect( _tree, SIGNAL( finished()			 ),
+	     this,  SLOT  ( readingFinished()		 ) );
+
+    connect( _tree, SIGNAL( clearing()			 ),
+	     this,  SLOT  ( clearing()			 ) );
+
+    connect( _tree, SIGNAL( deletingChild	( FileInfo * ) ),
+	     this,  SLOT  ( deletingChild	( FileInfo * ) ) );
+
+    connect( _tree, SIGNAL( clearingSubtree	( DirInfo * ) ),
+	     this,  SLOT  ( clearingSubtree	( DirInfo * ) ) );
+}
+
+
+FileSize GrowthHistory::growth( FileInfo * dir, int window, bool * known ) const
+{
+    QHash<FileInfo *, DirGrowth>::const_iterator it = _growth.constFind( dir );
+    bool found = it != _growth.constEnd() && window >= 0 && window < GROWTH_WINDOWS &&
+	it.value().known[ window ];
+
+    if ( known )
+	*known = found;
+
+    return found ? it.value().growth[ window ] : 0LL;
+}
+
+
+int GrowthHistory::windowDays( int window ) const
+{
+    return window >= 0 && window < GROWTH_WINDOWS ? _windowDays[ window ] : 0;
+}
+
+
+QString GrowthHistory::historyFileName( const QString & url ) const
+{
+    QString dir = _historyDir;
+    dir.replace( "~", QDir::homePath() );
+
+    return dir + "/" + QString::fromLatin1( QUrl::toPercentEncoding( url ) ) + ".hist";
+}
+
+
+void GrowthHistory::readingFinished()
+{
+    if ( ! _enabled || ! _tree || ! _tree->isFullRead() )
+	return;
+
+    FileInfo * toplevel = _tree->firstToplevel();
+
+    if ( ! toplevel || ! toplevel->isDirInfo() ||
+	 toplevel->isPkgInfo() || ! toplevel->url().startsWith( "/" ) )
+    {
+	return;
+    }
+
+    if ( _jobRunning )
+    {
+	// Only one job at a time so they don't append to the same file
+	// concurrently; the result of the running one is outdated anyway.
+
+	_rerunJob = true;
+	return;
+    }
+
+    TreeSnapshotPtr snapshot = _tree->snapshot( toplevel );
+
+    if ( ! snapshot )
+	return;
+
+    _growth.clear();
+    _jobRunning = true;
+
+    GrowthHistoryJob * job = new GrowthHistoryJob( this, snapshot );
+    CHECK_NEW( job );
+
+    QThreadPool::globalInstance()->start( job );
+}
+
+
+QHash<FileInfo *, DirGrowth> GrowthHistory::record( TreeSnapshotPtr snapshot )
+{
+    QHash<FileInfo *, DirGrowth> result;
+
+    if ( snapshot->isCancelled() )
+	return result;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    FileInfo * toplevel	  = snapshot->subtree();
+    QString	toplevelUrl = toplevel->url();
+    QString	fileName    = historyFileName( toplevelUrl );
+    time_t	now	    = time( 0 );
+    History	history;
+
+    if ( ! load( fileName, now, history ) )
+    {
+	logError() << "Not a growth history file: " << fileName << endl;
+	return result;
+    }
+
+    QList<FileInfo *> dirs;
+    collectDirs( toplevel, dirs );
+
+    if ( snapshot->isCancelled() )
+	return result;
+
+    if ( now - history.lastTime >= _minSampleIntervalHours * 60 * 60 )
+    {
+	QDir().mkpath( QFileInfo( fileName ).path() );
+	append( fileName, toplevelUrl, dirs, now, history );
+    }
+
+
+    // Merge the history with the current tree
+
+    foreach ( FileInfo * dir, dirs )
+    {
+	int id = history.pathIds.value( relativePath( dir, toplevelUrl ), -1 );
+
+	if ( id < 0 )
+	    continue;
+
+	DirGrowth dirGrowth;
+	bool	  haveGrowth = false;
+
+	for ( int window = 0; window < GROWTH_WINDOWS; ++window )
+	{
+	    FileSize oldSize = history.windowValid[ window ] ?
+		history.windowSizes[ window ].value( id, 0LL ) : 0LL;
+
+	    // 0 means the directory did not exist or was below the minimum
+	    // size at that time, so there is no meaningful growth value
+
+	    if ( oldSize > 0 )
+	    {
+		dirGrowth.known [ window ] = true;
+		dirGrowth.growth[ window ] = dir->totalSize() - oldSize;
+		haveGrowth = true;
+	    }
+	}
+
+	if ( haveGrowth )
+	    result.insert( dir, dirGrowth );
+    }
+
+    logDebug() << "Growth history for " << toplevelUrl << ": "
+	       << history.paths.size() << " paths, "
+	       << result.size() << " dirs with growth values"
+	       << " in " << timer.elapsed() << " millisec"
+	       << endl;
+
+    return result;
+}
+
+
+void GrowthHistory::addResult( int generation, const QHash<FileInfo *, DirGrowth> & growth )
+{
+    QMutexLocker locker( &_mutex );
+
+    _jobGeneration = generation;
+    _jobGrowth	   = growth;
+
+    QMetaObject::invokeMethod( this, "jobFinished", Qt::QueuedConnection );
+}
+
+
+void GrowthHistory::jobFinished()
+{
+    QMutexLocker locker( &_mutex );
+
+    // The tree is still frozen by the snapshot of the job unless it had to
+    // discard its content; in that case the generation changed, and the
+    // FileInfo pointers of the result may be dangling.
+
+    if ( _tree && _tree->generation() == _jobGeneration )
+	_growth = _jobGrowth;
+
+    _jobGrowth.clear();
+    _jobRunning = false;
+    locker.unlock();
+
+    if ( _rerunJob )
+    {
+	_rerunJob = false;
+	readingFinished();
+    }
+}
+
+
+bool GrowthHistory::load( const QString & fileName, time_t now, History & history ) const
+{
+    for ( int window = 0; window < GROWTH_WINDOWS; ++window )
+	history.windowValid[ window ] = false;
+
+    QFile file( fileName );
+
+    if ( ! file.exists() )
+	return true;
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+    {
+	logError() << "Can't open " << fileName << ": " << file.errorString() << endl;
+	return false;
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    if ( data.isEmpty() )
+	return true;
+
+    if ( ! data.startsWith( HISTORY_HEADER ) )
+	return false;
+
+    time_t cutoff[ GROWTH_WINDOWS ];
+
+    for ( int window = 0; window < GROWTH_WINDOWS; ++window )
+	cutoff[ window ] = now - (time_t) _windowDays[ window ] * SECONDS_PER_DAY;
+
+    const char * start = data.constData();
+    const char * end   = start + data.size();
+    const char * pos   = start + HISTORY_HEADER_LEN;
+    history.validLength = HISTORY_HEADER_LEN;
+
+    QVector<int>     ids;
+    QVector<qint64>  deltas;
+
+    while ( pos < end )
+    {
+	char type = *pos++;
+
+	if ( type == 'P' )
+	{
+	    quint64 len;
+
+	    if ( ! readVarint( pos, end, len ) || len > (quint64) ( end - pos ) )
+		break;
+
+	    QString path = QString::fromUtf8( pos, len );
+	    pos += len;
+
+	    history.pathIds.insert( path, history.paths.size() );
+	    history.paths << path;
+	    history.sizes << 0LL;
+	}
+	else if ( type == 'S' )
+	{
+	    quint64 timeDelta;
+	    quint64 count;
+
+	    if ( ! readVarint( pos, end, timeDelta ) ||
+		 ! readVarint( pos, end, count	   ) ||
+		 count > (quint64) history.paths.size() )
+	    {
+		break;
+	    }
+
+	    // Parse the complete sample before applying anything in case it
+	    // is truncated
+
+	    bool ok = true;
+	    ids.resize( count );
+	    deltas.resize( count );
+	    quint64 id = 0;
+
+	    for ( quint64 i = 0; i < count && ok; ++i )
+	    {
+		quint64 idDelta;
+		ok = readVarint( pos, end, idDelta );
+		id += idDelta;
+		ok = ok && id < (quint64) history.paths.size();
+		ids[ i ] = id;
+	    }
+
+	    for ( quint64 i = 0; i < count && ok; ++i )
+	    {
+		quint64 value;
+		ok = readVarint( pos, end, value );
+		deltas[ i ] = unzigzag( value );
+	    }
+
+	    if ( ! ok )
+		break;
+
+	    time_t sampleTime = history.lastTime + (time_t) timeDelta;
+
+	    // The size for each window is the state after the newest sample
+	    // that is not newer than the window's cutoff time, i.e. the
+	    // state right before the first sample after it.
+
+	    for ( int window = 0; window < GROWTH_WINDOWS; ++window )
+	    {
+		if ( ! history.windowValid[ window ] &&
+		     history.lastTime > 0 &&
+		     sampleTime > cutoff[ window ] )
+		{
+		    history.windowSizes[ window ] = history.sizes;
+		    history.windowValid[ window ] = true;
+		}
+	    }
+
+	    for ( quint64 i = 0; i < count; ++i )
+		history.sizes[ ids[ i ] ] += deltas[ i ];
+
+	    history.lastTime = sampleTime;
+	}
+	else
+	{
+	    break;
+	}
+
+	history.validLength = pos - start;
+    }
+
+    if ( history.validLength < data.size() )
+    {
+	logWarning() << fileName << ": Ignoring " << data.size() - history.validLength
+		     << " bytes of garbage at the end" << endl;
+    }
+
+    for ( int window = 0; window < GROWTH_WINDOWS; ++window )
+    {
+	if ( ! history.windowValid[ window ] &&
+	     history.lastTime > 0 &&
+	     history.lastTime <= cutoff[ window ] )
+	{
+	    history.windowSizes[ window ] = history.sizes;
+	    history.windowValid[ window ] = true;
+	}
+    }
+
+    return true;
+}
+
+
+bool GrowthHistory::append( const QString & fileName,
+			    const QString & toplevelUrl,
+			    const QList<FileInfo *> & dirs,
+			    time_t now,
+			    History & history )
+{
+    if ( now <= history.lastTime )
+	return false;
+
+    QByteArray buf;
+
+    if ( history.validLength == 0 )
+	buf += HISTORY_HEADER;
+
+
+    // Paths that are new in this sample
+
+    QVector<FileSize> newSizes( history.paths.size(), 0LL );
+
+    foreach ( FileInfo * dir, dirs )
+    {
+	QString path = relativePath( dir, toplevelUrl );
+	int	id   = history.pathIds.value( path, -1 );
+
+	if ( id < 0 )
+	{
+	    id = history.paths.size();
+	    history.pathIds.insert( path, id );
+	    history.paths << path;
+	    history.sizes << 0LL;
+	    newSizes << 0LL;
+
+	    QByteArray utf8 = path.toUtf8();
+	    buf += 'P';
+	    writeVarint( buf, utf8.size() );
+	    buf += utf8;
+	}
+
+	newSizes[ id ] = dir->totalSize();
+    }
+
+
+    // The sample: Only the directories whose size changed
+
+    QByteArray idColumn;
+    QByteArray sizeColumn;
+    int	       count  = 0;
+    int	       lastId = 0;
+
+    for ( int id = 0; id < newSizes.size(); ++id )
+    {
+	if ( newSizes.at( id ) == history.sizes.at( id ) )
+	    continue;
+
+	writeVarint( idColumn,	 id - lastId );
+	writeVarint( sizeColumn, zigzag( newSizes.at( id ) - history.sizes.at( id ) ) );
+	lastId = id;
+	++count;
+    }
+
+    buf += 'S';
+    writeVarint( buf, now - history.lastTime );
+    writeVarint( buf, count );
+    buf += idColumn;
+    buf += sizeColumn;
+
+
+    // Cut off any half-written record from a previous crash and append
+
+    QFile file( fileName );
+
+    if ( file.exists() && file.size() > history.validLength )
+	file.resize( history.validLength );
+
+    if ( ! file.open( QIODevice::WriteOnly | QIODevice::Append ) ||
+	 file.write( buf ) != buf.size() )
+    {
+	logError() << "Can't write " << fileName << ": " << file.errorString() << endl;
+	return false;
+    }
+
+    file.close();
+
+    history.sizes	 = newSizes;
+    history.lastTime	 = now;
+    history.validLength += buf.size();
+
+    logInfo() << "Recorded " << count << " changed dirs in " << fileName
+	      << " (" << history.validLength << " bytes)" << endl;
+
+    return true;
+}
+
+
+void GrowthHistory::collectDirs( FileInfo * dir, QList<FileInfo *> & dirs ) const
+{
+    if ( dir->totalSize() < (FileSize) _minDirSizeMB * 1024 * 1024 )
+	return;
+
+    dirs << dir;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() && ! child->isPseudoDir() )
+	    collectDirs( child, dirs );
+    }
+}
+
+
+QString GrowthHistory::relativePath( FileInfo * dir, const QString & toplevelUrl )
+{
+    QString url = dir->url();
+
+    if ( url == toplevelUrl )
+	return "";
+
+    return url.mid( toplevelUrl.endsWith( "/" ) ? toplevelUrl.size() : toplevelUrl.size() + 1 );
+}
+
+
+void GrowthHistory::clearing()
+{
+    _growth.clear();
+}
+
+
+void GrowthHistory::deletingChild( FileInfo * child )
+{
+    forget( child, true );
+}
+
+
+void GrowthHistory::clearingSubtree( DirInfo * subtree )
+{
+    forget( subtree, false );
+}
+
+
+void GrowthHistory::forget( FileInfo * dir, bool includeDir )
+{
+    if ( ! dir || _growth.isEmpty() )
+	return;
+
+    if ( includeDir )
+	_growth.remove( dir );
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() )
+	    forget( child, true );
+    }
+}
+
+
+void GrowthHistory::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "GrowthHistory" );
+
+    _enabled		    = settings.value( "Enabled",		false ).toBool();
+    _historyDir		    = settings.value( "HistoryDir",		"~/.local/share/QDirStat/history" ).toString();
+    _minDirSizeMB	    = settings.value( "MinDirSizeMB",		100  ).toInt();
+    _minSampleIntervalHours = settings.value( "MinSampleIntervalHours", 12	 ).toInt();
+    _windowDays[0]	    = settings.value( "ShortWindowDays",	7    ).toInt();
+    _windowDays[1]	    = settings.value( "LongWindowDays",		30   ).toInt();
+
+    settings.endGroup();
+}
+
+
+void GrowthHistory::writeSettings()
+{
+    Settings settings;
+    settings.beginGroup( "GrowthHistory" );
+
+    settings.setDefaultValue( "Enabled",		_enabled		);
+    settings.setDefaultValue( "HistoryDir",		_historyDir		);
+    settings.setDefaultValue( "MinDirSizeMB",		_minDirSizeMB		);
+    settings.setDefaultValue( "MinSampleIntervalHours", _minSampleIntervalHours );
+    settings.setDefaultValue( "ShortWindowDays",	_windowDays[0]		);
+    settings.setDefaultValue( "LongWindowDays",		_windowDays[1]		);
+
+    settings.endGroup();
+}
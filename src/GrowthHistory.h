@@ -0,0 +1,275 @@
+/*
+ *   File name: GrowthHistory.h
+ *   Summary:	Per-directory size history across scans for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+#ifndef GrowthHistory_h
+#define GrowthHistory_h
+
+
+#include <time.h>
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+
+#include "FileSize.h"
+#include "TreeSnapshot.h"
+
+
+// Number of growth windows (short and long)
+#define GROWTH_WINDOWS	2
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class DirInfo;
+    class FileInfo;
+
+
+    /**
+     * Growth of one directory over each of the growth windows.
+     **/
+    struct DirGrowth
+    {
+	DirGrowth()
+	{
+	    for ( int i = 0; i < GROWTH_WINDOWS; ++i )
+	    {
+		known[i]  = false;
+		growth[i] = 0LL;
+	    }
+	}
+
+	bool	 known [ GROWTH_WINDOWS ];
+	FileSize growth[ GROWTH_WINDOWS ];
+    };
+
+
+    /**
+     * History of directory sizes across many scans of the same directory:
+     * At the end of each complete scan of a directory tree, the totals of all
+     * directories above a minimum size are appended to a history file for
+     * that toplevel directory. Then the history is merged with the current
+     * tree to calculate how much each directory grew within a short and a
+     * long time window (by default 7 and 30 days) for the growth columns.
+     *
+     * This is disabled by default; set "Enabled" in the "GrowthHistory"
+     * settings group to use it. Refreshing a subtree, reading a cache file
+     * or the package database does not record anything.
+     *
+     * The history file is append-only and very compact: Each directory path
+     * is stored only once and referred to by its number afterwards, and each
+     * sample only contains the directories whose size changed since the
+     * last one, with the numbers and the size differences in separate
+     * columns, all as variable-length integers:
+     *
+     *	   "QDSHIST1\n"				  file header
+     *	   'P' <len> <path>			  new path (relative to the
+     *						  toplevel), gets the next id
+     *	   'S' <time delta> <n>			  sample
+     *	       <id delta> * n
+     *	       <size delta> * n			  (zigzag-encoded)
+     *
+     * A directory that disappeared or dropped below the minimum size is
+     * recorded with size 0. A half-written record at the end of the file
+     * (e.g. after a crash) is discarded before the next sample is appended.
+     *
+     * Reading and writing the history file and calculating the growth
+     * values is done in a worker thread on a snapshot of the tree. The
+     * result is handed over to the main thread; afterwards the growth
+     * values are only read, so they can safely be used for sorting in other
+     * threads.
+     *
+     * This is a singleton class.
+     **/
+    class GrowthHistory: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Return the singleton instance of this class.
+	 **/
+	static GrowthHistory * instance();
+
+	/**
+	 * Watch 'tree': Record a sample whenever reading it is finished.
+	 **/
+	void setTree( DirTree * tree );
+
+	/**
+	 * Return the growth of 'dir' within growth window no. 'window'
+	 * (0: short, 1: long) and set 'known' to 'true' if there is a value
+	 * for it. Growth may be negative.
+	 **/
+	FileSize growth( FileInfo * dir, int window, bool * known = 0 ) const;
+
+	/**
+	 * Return the size of growth window no. 'window' in days.
+	 **/
+	int windowDays( int window ) const;
+
+	/**
+	 * Return the history file name for toplevel directory 'url'.
+	 **/
+	QString historyFileName( const QString & url ) const;
+
+
+    public slots:
+
+	/**
+	 * Read the settings.
+	 **/
+	void readSettings();
+
+	/**
+	 * Write the settings.
+	 **/
+	void writeSettings();
+
+
+    protected slots:
+
+	/**
+	 * Reading the tree is finished: Record a sample and calculate the
+	 * growth values.
+	 **/
+	void readingFinished();
+
+	/**
+	 * The tree is being cleared: Forget all growth values.
+	 **/
+	void clearing();
+
+	/**
+	 * An item is about to be deleted: Forget the growth values for
+	 * it and its subtree.
+	 **/
+	void deletingChild( FileInfo * child );
+
+	/**
+	 * A subtree is about to be cleared: Forget the growth values for
+	 * the items below it.
+	 **/
+	void clearingSubtree( DirInfo * subtree );
+
+	/**
+	 * The worker job is finished: Take over its growth values if the tree
+	 * has not changed in the meantime.
+	 **/
+	void jobFinished();
+
+
+    protected:
+
+	friend class GrowthHistoryJob;
+
+	/**
+	 * Constructor. Use instance() instead.
+	 **/
+	GrowthHistory();
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~GrowthHistory();
+
+	/**
+	 * Content of a history file after replaying it.
+	 **/
+	struct History
+	{
+	    History(): lastTime( 0 ), validLength( 0 ) {}
+
+	    QStringList		paths;			// by id
+	    QHash<QString, int> pathIds;
+	    QVector<FileSize>	sizes;			// latest size by id
+	    QVector<FileSize>	windowSizes[ GROWTH_WINDOWS ];	// by id
+	    bool		windowValid[ GROWTH_WINDOWS ];
+	    time_t		lastTime;
+	    qint64		validLength;	// up to the last complete record
+	};
+
+	/**
+	 * Read and replay history file 'fileName' into 'history'. The window
+	 * sizes are the sizes at the newest sample that is at least that
+	 * many days older than 'now'.
+	 *
+	 * Return 'false' if the file exists, but is not a history file.
+	 **/
+	bool load( const QString & fileName, time_t now, History & history ) const;
+
+	/**
+	 * Append a sample with the sizes of 'dirs' to history file
+	 * 'fileName'.
+	 **/
+	bool append( const QString & fileName,
+		     const QString & toplevelUrl,
+		     const QList<FileInfo *> & dirs,
+		     time_t now,
+		     History & history );
+
+	/**
+	 * Record a sample of the tree of 'snapshot' in its history file and
+	 * calculate the growth values. This is called in a worker thread.
+	 **/
+	QHash<FileInfo *, DirGrowth> record( TreeSnapshotPtr snapshot );
+
+	/**
+	 * Store the result of the worker job for jobFinished(). This is
+	 * called in a worker thread.
+	 **/
+	void addResult( int generation, const QHash<FileInfo *, DirGrowth> & growth );
+
+	/**
+	 * Add 'dir' and (recursively) all its subdirectories that have at
+	 * least the minimum size to 'dirs'.
+	 **/
+	void collectDirs( FileInfo * dir, QList<FileInfo *> & dirs ) const;
+
+	/**
+	 * Remove the growth values of 'dir' and everything below it.
+	 **/
+	void forget( FileInfo * dir, bool includeDir );
+
+	/**
+	 * Return the path of 'dir' relative to 'toplevelUrl'.
+	 **/
+	static QString relativePath( FileInfo * dir, const QString & toplevelUrl );
+
+
+	//
+	// Data members
+	//
+
+	static GrowthHistory *		_instance;
+
+	DirTree *			_tree;
+	QHash<FileInfo *, DirGrowth>	_growth;
+	bool				_jobRunning;
+	bool				_rerunJob;
+
+	QMutex				_mutex;		// for the job result
+	QHash<FileInfo *, DirGrowth>	_jobGrowth;
+	int				_jobGeneration;
+
+	bool				_enabled;
+	QString				_historyDir;
+	int				_minDirSizeMB;
+	int				_minSampleIntervalHours;
+	int				_windowDays[ GROWTH_WINDOWS ];
+
+    };	// class GrowthHistory
+
+}	// namespace QDirStat
+
+#endif	// GrowthHistory_h
@@ -0,0 +1,393 @@
+/*
+ *   File name: GuiBenchmark.cpp
+ *   Summary:	Timing of the main window's views for large trees
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QApplication>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QScrollBar>
+#include <QTimer>
+#include <QVector>
+
+#include "GuiBenchmark.h"
+#include "MainWindow.h"
+#include "QDirStatApp.h"
+#include "DirTree.h"
+#include "DirTreeCache.h"
+#include "DirTreeModel.h"
+#include "DirTreeView.h"
+#include "DirInfo.h"
+#include "FileInfoIterator.h"
+#include "FileInfoSet.h"
+#include "SelectionModel.h"
+#include "TreemapView.h"
+#include "FileInfo.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Deepest level for the "expand" scenarios
+#define MAX_EXPAND_LEVEL	4
+
+// Maximum number of pages for the "scroll" scenario
+#define MAX_SCROLL_PAGES	500
+
+// Maximum number of files for the "delete" scenario
+#define MAX_DELETE_ITEMS	50000
+
+// Subdirectories of each directory in a generated tree
+#define GENERATED_FANOUT	8
+
+#define TREEMAP_WIDTH		3840
+#define TREEMAP_HEIGHT		2160
+
+
+using namespace QDirStat;
+
+
+GuiBenchmark::GuiBenchmark( MainWindow * mainWin ):
+    _mainWin( mainWin )
+{
+    CHECK_PTR( _mainWin );
+
+    _treeView	 = _mainWin->findChild<DirTreeView *>();
+    _treemapView = _mainWin->findChild<TreemapView *>();
+}
+
+
+GuiBenchmark::~GuiBenchmark()
+{
+    // NOP
+}
+
+
+bool GuiBenchmark::run( const QString & cacheFileName )
+{
+    if ( ! _treeView || ! _treemapView )
+    {
+	logError() << "Can't find the views in the main window" << endl;
+	return false;
+    }
+
+    _results.clear();
+
+    if ( ! readCache( cacheFileName ) )
+	return false;
+
+    expand();
+    sort();
+    scroll();
+    selectAll();
+    rebuildTreemap();
+    deleteItems();	// This must be the last one
+
+    return true;
+}
+
+
+bool GuiBenchmark::readCache( const QString & cacheFileName )
+{
+    app()->dirTreeModel()->clear();
+    settle();
+
+    QEventLoop eventLoop;
+
+    QObject::connect( app()->dirTree(), SIGNAL( finished() ),
+		      &eventLoop,	SLOT  ( quit()	   ) );
+
+    QObject::connect( app()->dirTree(), SIGNAL( aborted() ),
+		      &eventLoop,	SLOT  ( quit()	  ) );
+    QElapsedTimer timer;
+    timer.start();
+
+    if ( ! app()->dirTree()->readCache( cacheFileName ) )
+    {
+	logError() << "Can't read cache file " << cacheFileName << endl;
+	return false;
+    }
+
+    eventLoop.exec();
+
+    // This includes the updates of the model and the views while reading
+
+    addResult( "read with live updates", timer.elapsed() );
+    settle();
+
+    return app()->dirTree()->firstToplevel() != 0;
+}
+
+
+void GuiBenchmark::expand()
+{
+    for ( int level = 1; level <= MAX_EXPAND_LEVEL; ++level )
+    {
+	QElapsedTimer timer;
+	timer.start();
+
+	_mainWin->expandTreeToLevel( level );
+	paintTreeView();
+
+	addResult( QString( "expand to level %1" ).arg( level ), timer.elapsed() );
+	settle();
+    }
+}
+
+
+void GuiBenchmark::sort()
+{
+    QAbstractItemModel * model = _treeView->model();
+
+    for ( int col = 0; col < model->columnCount(); ++col )
+    {
+	if ( _treeView->isColumnHidden( col ) )
+	    continue;
+
+	QString name = model->headerData( col, Qt::Horizontal ).toString();
+
+	QElapsedTimer timer;
+	timer.start();
+
+	_treeView->sortByColumn( col, Qt::DescendingOrder );
+	paintTreeView();
+
+	addResult( QString( "sort by %1" ).arg( name ), timer.elapsed() );
+	settle();
+    }
+}
+
+
+void GuiBenchmark::scroll()
+{
+    QScrollBar * scrollBar = _treeView->verticalScrollBar();
+    scrollBar->setValue( scrollBar->minimum() );
+    settle();
+
+    QElapsedTimer timer;
+    timer.start();
+    int pages = 0;
+
+    for ( int pos = scrollBar->minimum();
+	  pos <= scrollBar->maximum() && pages < MAX_SCROLL_PAGES;
+	  pos += qMax( scrollBar->pageStep(), 1 ) )
+    {
+	scrollBar->setValue( pos );
+	paintTreeView();
+	++pages;
+    }
+
+    addResult( QString( "scroll %1 pages" ).arg( pages ), timer.elapsed() );
+    settle();
+}
+
+
+void GuiBenchmark::selectAll()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    _treeView->selectAll();
+    QCoreApplication::processEvents();
+    paintTreeView();
+
+    addResult( "select all", timer.elapsed() );
+
+    _treeView->clearSelection();
+    settle();
+}
+
+
+void GuiBenchmark::rebuildTreemap()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    _treemapView->rebuildTreemap( app()->dirTree()->firstToplevel(),
+				  QSizeF( TREEMAP_WIDTH, TREEMAP_HEIGHT ) );
+
+    addResult( "build treemap 4K", timer.elapsed() );
+    timer.start();
+
+    if ( _treemapView->scene() )
+    {
+	QImage image( TREEMAP_WIDTH, TREEMAP_HEIGHT, QImage::Format_RGB32 );
+	QPainter painter( &image );
+	_treemapView->scene()->render( &painter );
+    }
+
+    addResult( "paint treemap 4K", timer.elapsed() );
+    settle();
+}
+
+
+/**
+ * Add every second file in 'dir' and its subtree to 'items' until there are
+ * 'maxCount' of them.
+ **/
+static void collectFiles( FileInfo * dir, FileInfoSet & items, int maxCount )
+{
+    int		     fileNo = 0;
+    FileInfoIterator it( dir );
+
+    while ( *it && items.size() < maxCount )
+    {
+	FileInfo * child = *it;
+
+	if ( child->isDirInfo() )
+	    collectFiles( child, items, maxCount );
+	else if ( fileNo++ % 2 == 0 )
+	    items << child;
+
+	++it;
+    }
+}
+
+
+void GuiBenchmark::deleteItems()
+{
+    FileInfo * toplevel = app()->dirTree()->firstToplevel();
+
+    if ( ! toplevel )
+	return;
+
+    FileInfoSet items;
+    collectFiles( toplevel, items, MAX_DELETE_ITEMS );
+
+    app()->selectionModel()->setSelectedItems( items );
+    settle();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    app()->dirTree()->deleteSubtrees( items );
+    paintTreeView();
+
+    addResult( QString( "delete %1 selected items" ).arg( items.size() ), timer.elapsed() );
+    settle();
+}
+
+
+void GuiBenchmark::settle( int millisec )
+{
+    QEventLoop eventLoop;
+    QTimer::singleShot( millisec, &eventLoop, SLOT( quit() ) );
+    eventLoop.exec();
+
+    QCoreApplication::processEvents();
+}
+
+
+void GuiBenchmark::paintTreeView()
+{
+    QCoreApplication::processEvents();
+    _treeView->viewport()->repaint();
+}
+
+
+void GuiBenchmark::addResult( const QString & scenario, qint64 millisec )
+{
+    logInfo() << "Benchmark: " << scenario << ": " << millisec << " millisec" << endl;
+    _results << qMakePair( scenario, millisec );
+}
+
+
+void GuiBenchmark::writeResults( QTextStream & str ) const
+{
+    FileInfo * toplevel = app()->dirTree()->firstToplevel();
+
+    if ( toplevel )
+    {
+	str << "# " << toplevel->totalItems() << " items, "
+	    << toplevel->totalSubDirs() << " directories\n";
+    }
+
+    str << "# scenario\tmillisec\n";
+
+    for ( int i = 0; i < _results.size(); ++i )
+	str << _results.at( i ).first << "\t" << _results.at( i ).second << "\n";
+}
+
+
+/**
+ * Return the next number of a simple pseudo random sequence.
+ **/
+static quint32 nextRandom( quint64 & seed )
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (quint32) ( seed >> 33 );
+}
+
+
+bool GuiBenchmark::generateCache( const QString & fileName,
+				  int		  dirCount,
+				  int		  filesPerDir )
+{
+    static const char * suffixes[] =
+    {
+	".cpp", ".h", ".o", ".jpg", ".png", ".mp4", ".gz", ".txt", ".pdf", ".so", ""
+    };
+
+    const int suffixCount = sizeof( suffixes ) / sizeof( suffixes[0] );
+
+    QFile file( fileName );
+
+    if ( ! file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+    {
+	logError() << "Can't open " << fileName << endl;
+	return false;
+    }
+
+    file.write( "[qdirstat " CACHE_FORMAT_VERSION " cache file]\n"
+		"# Generated for benchmarking\n" );
+
+    // Directory i is a child of directory (i-1)/GENERATED_FANOUT. Writing
+    // them in that order guarantees that each parent comes before its
+    // children.
+
+    QVector<QByteArray> paths( qMax( dirCount, 1 ) );
+    paths[0] = "/benchmark";
+    quint64 seed  = 42;
+    time_t  mtime = 1600000000;
+
+    for ( int dir = 0; dir < paths.size(); ++dir )
+    {
+	if ( dir > 0 )
+	{
+	    paths[ dir ] = paths.at( ( dir - 1 ) / GENERATED_FANOUT ) +
+		"/dir" + QByteArray::number( dir );
+	}
+
+	QByteArray lines = "D " + paths.at( dir ) + "\t4096\t0x" +
+	    QByteArray::number( (qulonglong) mtime, 16 ) + "\n";
+
+	for ( int i = 0; i < filesPerDir; ++i )
+	{
+	    // Sizes from a few bytes up to 128 MB, evenly spread on a log scale
+
+	    quint32  random = nextRandom( seed );
+	    FileSize size   = ( 1LL << ( random % 28 ) ) + random % 4096;
+
+	    lines += "F\tfile" + QByteArray::number( i ) + suffixes[ random % suffixCount ] +
+		"\t" + QByteArray::number( size ) +
+		"\t0x" + QByteArray::number( (qulonglong) ( mtime - random % 100000000 ), 16 ) +
+		"\n";
+	}
+
+	if ( file.write( lines ) != lines.size() )
+	{
+	    logError() << "Can't write to " << fileName << endl;
+	    return false;
+	}
+    }
+
+    logInfo() << "Generated " << paths.size() << " directories with "
+	      << filesPerDir << " files each in " << fileName << endl;
+
+    return true;
+}
@@ -0,0 +1,140 @@
+/*
+ *   File name: GuiBenchmark.h
+ *   Summary:	Timing of the main window's views for large trees
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+#ifndef GuiBenchmark_h
+#define GuiBenchmark_h
+
+
+#include <QString>
+#include <QList>
+#include <QPair>
+#include <QTextStream>
+
+
+class MainWindow;
+
+
+namespace QDirStat
+{
+    class DirTreeView;
+    class TreemapView;
+
+    /**
+     * Benchmark for the parts of the GUI that get slow with large trees:
+     * The DirTreeModel with its notifications, the DirTreeView and the
+     * TreemapView.
+     *
+     * This reads a cache file into a real MainWindow and then runs a fixed
+     * set of scenarios on it, each one with a wall clock time:
+     *
+     *	 - reading the tree with the live updates of the views
+     *	 - expanding the tree to levels 1 to 4
+     *	 - sorting by each column
+     *	 - scrolling through the tree page by page
+     *	 - selecting all items
+     *	 - building and painting the treemap at 3840x2160 (4K)
+     *	 - deleting up to 50000 selected files at once
+     *
+     * Each scenario includes painting the affected view. With the Qt
+     * "offscreen" platform plugin, this does not need a display, so it can
+     * run in automated builds to catch regressions.
+     *
+     * Instead of a real cache file, a synthetic tree of a given size can be
+     * generated (see generateCache()).
+     *
+     * Usage:
+     *
+     *	   GuiBenchmark benchmark( mainWin );
+     *
+     *	   if ( benchmark.run( cacheFileName ) )
+     *	       benchmark.writeResults( stream );
+     **/
+    class GuiBenchmark
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	GuiBenchmark( MainWindow * mainWin );
+
+	/**
+	 * Destructor.
+	 **/
+	~GuiBenchmark();
+
+	/**
+	 * Read cache file 'cacheFileName' and run all scenarios.
+	 * Return 'true' on success, 'false' on error.
+	 **/
+	bool run( const QString & cacheFileName );
+
+	/**
+	 * Write the time of each scenario (one line each) and the size of the
+	 * tree to 'str'.
+	 **/
+	void writeResults( QTextStream & str ) const;
+
+	/**
+	 * Write a cache file 'fileName' with a synthetic tree of 'dirCount'
+	 * directories with 'filesPerDir' files each. The files have a mix of
+	 * sizes and suffixes; the result is always the same for the same
+	 * parameters.
+	 *
+	 * Return 'true' on success, 'false' on error.
+	 **/
+	static bool generateCache( const QString & fileName,
+				   int		   dirCount,
+				   int		   filesPerDir );
+
+    protected:
+
+	/**
+	 * Read the cache file into the main window and wait until it is
+	 * finished.
+	 **/
+	bool readCache( const QString & cacheFileName );
+
+	void expand();
+	void sort();
+	void scroll();
+	void selectAll();
+	void rebuildTreemap();
+	void deleteItems();
+
+	/**
+	 * Process all pending events, including those of timers that expire
+	 * within 'millisec', so nothing left over from one scenario is
+	 * counted for the next one.
+	 **/
+	void settle( int millisec = 500 );
+
+	/**
+	 * Paint the tree view now.
+	 **/
+	void paintTreeView();
+
+	/**
+	 * Add the result of a scenario.
+	 **/
+	void addResult( const QString & scenario, qint64 millisec );
+
+
+	//
+	// Data members
+	//
+
+	MainWindow *			_mainWin;
+	DirTreeView *			_treeView;
+	TreemapView *			_treemapView;
+	QList<QPair<QString, qint64> >	_results;
+    };
+
+}	// namespace QDirStat
+
+#endif	// GuiBenchmark_h
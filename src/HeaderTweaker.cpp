@@ -9,6 +9,10 @@
 
 #include <QMenu>
 #include <QAction>
+#include <QAbstractItemModel>
+#include <QFontMetrics>
+#include <QStyle>
+#include <QStyleOptionViewItem>
 
 #include "Qt4Compat.h"
 
@@ -19,6 +23,9 @@
 #include "Exception.h"
 #include "SignalBlocker.h"
 
+// Delay for resizing auto size columns after the cell widths changed
+#define AUTO_SIZE_DELAY_MILLISEC	100
+
 using namespace QDirStat;
 
 
@@ -35,6 +42,12 @@ HeaderTweaker::HeaderTweaker( QHeaderView * header, DirTreeView * parent ):
     _header->setStretchLastSection( false );
     _header->setContextMenuPolicy( Qt::CustomContextMenu );
 
+    _resizeTimer.setSingleShot( true );
+    _resizeTimer.setInterval( AUTO_SIZE_DELAY_MILLISEC );
+
+    connect( &_resizeTimer, SIGNAL( timeout()		 ),
+	     this,	    SLOT  ( resizeAutoSizeCols() ) );
+
     setAllColumnsAutoSize( true );
     createActions();
     createColumnLayouts();
@@ -44,6 +57,9 @@ HeaderTweaker::HeaderTweaker( QHeaderView * header, DirTreeView * parent ):
 
     connect( _header, SIGNAL( customContextMenuRequested( const QPoint & ) ),
 	     this,    SLOT  ( contextMenu		( const QPoint & ) ) );
+
+    connect( _treeView, SIGNAL( collapsed      ( QModelIndex ) ),
+	     this,	SLOT  ( clearCellWidths()		) );
 }
 
 
@@ -106,6 +122,18 @@ void HeaderTweaker::createColumnLayouts()
 
     layout->columns = DataColumns::instance()->allColumns();
 
+    // Columns that only have content if the user enabled the corresponding
+    // feature are not in any default layout; they can be shown with
+    // "Hidden Columns" in the header context menu.
+
+    layout->columns.removeAll( ShortGrowthCol      );
+    layout->columns.removeAll( LongGrowthCol       );
+    layout->columns.removeAll( ATimeCol            );
+    layout->columns.removeAll( CTimeCol            );
+    layout->columns.removeAll( BTimeCol            );
+    layout->columns.removeAll( CompressedSizeCol   );
+    layout->columns.removeAll( CompressionRatioCol );
+
     foreach ( layout, _layouts )
 	layout->defaultColumns = layout->columns;
 }
@@ -224,7 +252,7 @@ QString HeaderTweaker::colName( int section ) const
 
 bool HeaderTweaker::autoSizeCol( int section ) const
 {
-    return resizeMode( section ) == QHeaderView::ResizeToContents;
+    return _autoSizeSections.contains( section );
 }
 
 
@@ -528,15 +556,185 @@ void HeaderTweaker::fixupLayout( ColumnLayout * layout )
 
 QHeaderView::ResizeMode HeaderTweaker::resizeMode( int section ) const
 {
+    if ( _autoSizeSections.contains( section ) )
+	return QHeaderView::ResizeToContents;
+
     return _header->sectionResizeMode( section );
 }
 
 void HeaderTweaker::setResizeMode( int section, QHeaderView::ResizeMode resizeMode )
 {
+    if ( resizeMode == QHeaderView::ResizeToContents )
+    {
+	// See trackCellWidths(). Like with ResizeToContents, the user can't
+	// resize the column with the mouse.
+
+	_autoSizeSections.insert( section );
+	resizeMode = QHeaderView::Fixed;
+
+	// Measure that column again
+
+	QHash<void *, QVector<int> >::iterator it = _cellWidths.begin();
+
+	for ( ; it != _cellWidths.end(); ++it )
+	{
+	    if ( section < it.value().size() )
+		it.value()[ section ] = 0;
+	}
+
+	_treeView->viewport()->update();
+    }
+    else
+    {
+	_autoSizeSections.remove( section );
+    }
+
     _header->setSectionResizeMode( section, resizeMode );
 }
 
 
+void HeaderTweaker::trackCellWidths( const QStyleOptionViewItem & option,
+				     const QModelIndex		& index )
+{
+    if ( _autoSizeSections.isEmpty() || ! index.isValid() )
+	return;
+
+    QVector<int> & widths = _cellWidths[ index.internalPointer() ];
+
+    if ( widths.size() < _header->count() )
+	widths.resize( _header->count() );
+
+    foreach ( int section, _autoSizeSections )
+    {
+	// 0 means not measured yet
+
+	if ( section >= widths.size()	       ||
+	     widths[ section ] > 0	       ||
+	     _header->isSectionHidden( section ) )
+	{
+	    continue;
+	}
+
+	widths[ section ] = cellWidth( option, index.sibling( index.row(), section ) );
+
+	if ( ! _resizeTimer.isActive() )
+	    _resizeTimer.start();
+    }
+}
+
+
+int HeaderTweaker::cellWidth( const QStyleOptionViewItem & option,
+			      const QModelIndex		 & cell ) const
+{
+    if ( ! cell.isValid() )
+	return 0;
+
+    if ( DataColumns::fromViewCol( cell.column() ) == PercentBarCol )
+	return _treeView->itemDelegate( cell )->sizeHint( option, cell ).width();
+
+    // Like QStyledItemDelegate, but based only on the text (which the view
+    // just fetched anyway for painting that cell) and not going through all
+    // the style's size calculations.
+
+    int margin = _treeView->style()->pixelMetric( QStyle::PM_FocusFrameHMargin, 0, _treeView ) + 1;
+    QVariant font = cell.data( Qt::FontRole );
+    QFontMetrics fontMetrics( font.isValid() ? font.value<QFont>() : option.font );
+
+    int width = fontMetrics.width( cell.data( Qt::DisplayRole ).toString() ) + 2 * margin;
+
+    if ( ! cell.data( Qt::DecorationRole ).isNull() )
+	width += option.decorationSize.width() + 2 * margin;
+
+    if ( _header->visualIndex( cell.column() ) == 0 ) // The column with the tree branches
+    {
+	int depth = _treeView->rootIsDecorated() ? 1 : 0;
+
+	for ( QModelIndex parent = cell.parent(); parent.isValid(); parent = parent.parent() )
+	    ++depth;
+
+	width += depth * _treeView->indentation();
+    }
+
+    return width;
+}
+
+
+void HeaderTweaker::resetCellWidths()
+{
+    _cellWidths.clear();
+
+    if ( _treeView->model() == _model )
+	return;
+
+    if ( _model )
+	disconnect( _model, 0, this, 0 );
+
+    _model = _treeView->model();
+
+    if ( _model )
+    {
+	connect( _model, SIGNAL( dataChanged ( QModelIndex, QModelIndex ) ),
+		 this,	 SLOT  ( cellsChanged( QModelIndex, QModelIndex ) ) );
+
+	// The removed items might leave their addresses to new ones
+
+	connect( _model, SIGNAL( rowsAboutToBeRemoved( QModelIndex, int, int ) ),
+		 this,	 SLOT  ( clearCellWidths()			) );
+    }
+}
+
+
+void HeaderTweaker::cellsChanged( const QModelIndex & topLeft,
+				  const QModelIndex & bottomRight )
+{
+    if ( ! topLeft.isValid() || ! bottomRight.isValid() )
+	return;
+
+    for ( int row = topLeft.row(); row <= bottomRight.row(); ++row )
+	_cellWidths.remove( topLeft.sibling( row, 0 ).internalPointer() );
+
+    // If one of them was the widest cell, the column might become narrower
+    // now; if they are visible, they are measured again when they are
+    // painted, which happens before the timer times out.
+
+    if ( ! _resizeTimer.isActive() )
+	_resizeTimer.start();
+}
+
+
+void HeaderTweaker::clearCellWidths()
+{
+    _cellWidths.clear();
+    _treeView->viewport()->update();
+
+    if ( ! _resizeTimer.isActive() )
+	_resizeTimer.start();
+}
+
+
+void HeaderTweaker::resizeAutoSizeCols()
+{
+    QVector<int> maxWidths( _header->count() );
+
+    foreach ( const QVector<int> & widths, _cellWidths )
+    {
+	for ( int section = 0; section < widths.size() && section < maxWidths.size(); ++section )
+	    maxWidths[ section ] = qMax( maxWidths[ section ], widths[ section ] );
+    }
+
+    foreach ( int section, _autoSizeSections )
+    {
+	if ( section >= _header->count() || _header->isSectionHidden( section ) )
+	    continue;
+
+	int width = qMax( maxWidths[ section ], _header->sectionSizeHint( section ) );
+
+	if ( width != _header->sectionSize( section ) )
+	    _header->resizeSection( section, width );
+    }
+}
+
+
 void HeaderTweaker::resizeToContents( QHeaderView * header )
 {
     for ( int col = 0; col < header->count(); ++col )
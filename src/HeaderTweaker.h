@@ -10,13 +10,20 @@
 #define HeaderTweaker_h
 
 
+#include <QHash>
 #include <QHeaderView>
 #include <QMap>
+#include <QPointer>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
 #include "DataColumns.h"
 
 class QHeaderView;
+class QAbstractItemModel;
 class QAction;
 class QMenu;
+class QStyleOptionViewItem;
 
 
 namespace QDirStat
@@ -55,6 +62,29 @@ namespace QDirStat
 	 **/
 	static void resizeToContents( QHeaderView * header );
 
+	/**
+	 * Take the cells of the row of 'index' into account for the width of
+	 * the auto size columns. The tree view calls this for each row that
+	 * it paints.
+	 *
+	 * Auto size columns don't use QHeaderView::ResizeToContents: That
+	 * lets Qt measure the size hints of all the visible rows each time
+	 * any data changes, which is very expensive while the tree is being
+	 * read. Instead, each cell is measured when it is painted for the
+	 * first time, and again only after the model reported that its data
+	 * changed. Each auto size column becomes as wide as the widest cell
+	 * that was measured, so it also becomes narrower again when that cell
+	 * changes or goes away.
+	 **/
+	void trackCellWidths( const QStyleOptionViewItem & option,
+			      const QModelIndex		 & index );
+
+	/**
+	 * Forget the widths of all the cells that were painted so far
+	 * because the model was reset or the view got a new model.
+	 **/
+	void resetCellWidths();
+
     public slots:
 
 	/**
@@ -108,6 +138,19 @@ namespace QDirStat
 	 **/
 	void contextMenu( const QPoint & pos );
 
+	/**
+	 * Forget the widths of the cells from 'topLeft' to 'bottomRight'
+	 * since their data changed.
+	 **/
+	void cellsChanged( const QModelIndex & topLeft,
+			   const QModelIndex & bottomRight );
+
+	/**
+	 * Forget the widths of all the cells that were painted so far, e.g.
+	 * because rows were removed or collapsed.
+	 **/
+	void clearCellWidths();
+
 	/**
 	 * Hide the current column.
 	 **/
@@ -123,6 +166,11 @@ namespace QDirStat
 	 **/
 	void autoSizeCurrentCol();
 
+	/**
+	 * Resize all auto size columns to the widest cell that was painted.
+	 **/
+	void resizeAutoSizeCols();
+
 	/**
 	 * Read the settings for a layout.
 	 **/
@@ -204,6 +252,12 @@ namespace QDirStat
 	 **/
 	void setResizeMode( int section, QHeaderView::ResizeMode resizeMode );
 
+	/**
+	 * Return the width that 'cell' needs.
+	 **/
+	int cellWidth( const QStyleOptionViewItem & option,
+		       const QModelIndex	  & cell ) const;
+
 
 	//
 	// Data members
@@ -220,6 +274,10 @@ namespace QDirStat
 	int				_currentSection;
 	QMap<QString, ColumnLayout *>	_layouts;
 	ColumnLayout *			_currentLayout;
+	QSet<int>			_autoSizeSections;
+	QHash<void *, QVector<int> >	_cellWidths;	// by item, then section
+	QPointer<QAbstractItemModel>	_model;
+	QTimer				_resizeTimer;
 
     };	// class HeaderTweaker
 
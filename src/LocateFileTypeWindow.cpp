@@ -11,6 +11,7 @@
 #include "QDirStatApp.h"        // SelectionModel
 #include "DirTree.h"
 #include "DotEntry.h"
+#include "FileTypeStats.h"
 #include "SelectionModel.h"
 #include "SettingsHelpers.h"
 #include "HeaderTweaker.h"
@@ -52,6 +53,7 @@ LocateFileTypeWindow::~LocateFileTypeWindow()
 void LocateFileTypeWindow::clear()
 {
     _searchSuffix.clear();
+    _statsSuffix.clear();
     _ui->treeWidget->clear();
 }
 
@@ -90,7 +92,9 @@ QString LocateFileTypeWindow::searchSuffix() const
 }
 
 
-void LocateFileTypeWindow::populate( const QString & suffix, FileInfo * newSubtree )
+void LocateFileTypeWindow::populate( const QString &	     suffix,
+				     FileInfo *		     newSubtree,
+				     const FileTypeStats * stats )
 {
     clear();
 
@@ -100,6 +104,9 @@ void LocateFileTypeWindow::populate( const QString & suffix, FileInfo * newSubtr
     if ( _searchSuffix.startsWith( '*' ) )
 	_searchSuffix.remove( 0, 1 ); // Remove the leading '*'
 
+    // FileTypeStats uses the suffix without the leading '.'
+    _statsSuffix = _searchSuffix.startsWith( '.' ) ? _searchSuffix.mid( 1 ) : _searchSuffix;
+
     if ( ! _searchSuffix.startsWith( '.' ) )
 	_searchSuffix.prepend( '.' );
 
@@ -107,13 +114,16 @@ void LocateFileTypeWindow::populate( const QString & suffix, FileInfo * newSubtr
                            .arg( searchSuffix() )
                            .arg( _subtree.url() ) );
 
-    logDebug() << "Locating all files ending with \""
+    logDebug() << "Locating all files with suffix \""
 	       << _searchSuffix << "\" below " << _subtree.url() << endl;
 
     // For better Performance: Disable sorting while inserting many items
     _ui->treeWidget->setSortingEnabled( false );
 
-    populateRecursive( newSubtree ? newSubtree : _subtree() );
+    if ( stats && stats->hasValidSuffixDirs() )
+	populateFromIndex( stats, _statsSuffix );
+    else
+	populateRecursive( newSubtree ? newSubtree : _subtree() );
 
     _ui->treeWidget->setSortingEnabled( true );
     _ui->treeWidget->sortByColumn( SSR_PathCol, Qt::AscendingOrder );
@@ -182,6 +192,20 @@ void LocateFileTypeWindow::populateRecursive( FileInfo * dir )
 }
 
 
+void LocateFileTypeWindow::populateFromIndex( const FileTypeStats * stats,
+					      const QString &	    suffix )
+{
+    foreach ( const SuffixDirEntry & entry, stats->suffixDirs( suffix ) )
+    {
+	SuffixSearchResultItem * searchResultItem =
+	    new SuffixSearchResultItem( entry.dir->url(), entry.count, entry.size );
+	CHECK_NEW( searchResultItem );
+
+	_ui->treeWidget->addTopLevelItem( searchResultItem );
+    }
+}
+
+
 FileInfoSet LocateFileTypeWindow::matchingFiles( FileInfo * item )
 {
     FileInfoSet result;
@@ -198,8 +222,11 @@ FileInfoSet LocateFileTypeWindow::matchingFiles( FileInfo * item )
 
     while ( child )
     {
+	// Use the same suffix as FileTypeStats, so this finds exactly the
+	// files that were counted for it
+
 	if ( child->isFile() &&
-	     child->name().endsWith( _searchSuffix, Qt::CaseInsensitive ) )
+	     FileTypeStats::fileSuffix( child ) == _statsSuffix )
 	{
 	    result << child;
 	}
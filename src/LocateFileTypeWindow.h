@@ -84,8 +84,14 @@ namespace QDirStat
 	 * This clears the old search results first, then searches the subtree
 	 * and populates the search result list with the directories where
 	 * matching files were found.
+	 *
+	 * If 'stats' is non-null and its suffix index is still valid, the
+	 * directories are taken from there instead of searching the subtree
+	 * again. 'stats' has to be calculated for the same subtree.
 	 **/
-	void populate( const QString & suffix, FileInfo * subtree = 0 );
+	void populate( const QString &	     suffix,
+		       FileInfo *	     subtree = 0,
+		       const FileTypeStats * stats   = 0 );
 
 	/**
 	 * Refresh (reload) all data.
@@ -130,7 +136,14 @@ namespace QDirStat
 	void populateRecursive( FileInfo * dir );
 
 	/**
-	 * Return all direct file children matching the current search suffix.
+	 * Create a search result item for each directory in the suffix index
+	 * of 'stats' for 'suffix'.
+	 **/
+	void populateFromIndex( const FileTypeStats * stats, const QString & suffix );
+
+	/**
+	 * Return all direct file children that FileTypeStats counts for the
+	 * current search suffix.
 	 **/
 	FileInfoSet matchingFiles( FileInfo * dir );
 
@@ -142,6 +155,7 @@ namespace QDirStat
 	Ui::LocateFileTypeWindow * _ui;
         Subtree                    _subtree;
 	QString			   _searchSuffix;
+	QString			   _statsSuffix;
     };
 
 
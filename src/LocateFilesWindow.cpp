@@ -123,7 +123,21 @@ void LocateFilesWindow::populate( FileInfo * newSubtree )
     // For better Performance: Disable sorting while inserting many items
     _ui->treeWidget->setSortingEnabled( false );
 
-    populateRecursive( newSubtree ? newSubtree : _subtree() );
+    if ( _treeWalker->haveResults() )
+    {
+        foreach ( FileInfo * item, _treeWalker->results() )
+        {
+            LocateListItem * locateListItem = new LocateListItem( item );
+            CHECK_NEW( locateListItem );
+
+            _ui->treeWidget->addTopLevelItem( locateListItem );
+        }
+    }
+    else
+    {
+        populateRecursive( newSubtree ? newSubtree : _subtree() );
+    }
+
     showResultsCount();
 
     _ui->treeWidget->setSortingEnabled( true );
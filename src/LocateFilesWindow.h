@@ -95,7 +95,8 @@ namespace QDirStat
 	 *
 	 * This clears the old search results first, then searches the subtree
 	 * and populates the search result list with the items where
-	 * TreeWalker::check() returns 'true'.
+	 * TreeWalker::check() returns 'true' - or with TreeWalker::results()
+	 * if TreeWalker::prepare() already found them.
 	 **/
 	void populate( FileInfo * subtree = 0 );
 
@@ -21,6 +21,8 @@
 #include "BusyPopup.h"
 #include "CleanupCollection.h"
 #include "CleanupConfigPage.h"
+#include "CompressionAnalyzer.h"
+#include "ContentSniffer.h"
 #include "ConfigDialog.h"
 #include "DataColumns.h"
 #include "DebugHelpers.h"
@@ -30,6 +32,7 @@
 #include "Exception.h"
 #include "ExcludeRules.h"
 #include "FileDetailsView.h"
+#include "FileMover.h"
 #include "FileSearchFilter.h"
 #include "FileSizeStatsWindow.h"
 #include "FileTypeStatsWindow.h"
@@ -40,6 +43,7 @@
 #include "OpenPkgDialog.h"
 #include "OutputWindow.h"
 #include "PanelMessage.h"
+#include "PkgInfo.h"
 #include "PkgManager.h"
 #include "PkgQuery.h"
 #include "QDirStatApp.h"
@@ -56,6 +60,10 @@
 #define LONG_MESSAGE		25*1000
 #define UPDATE_MILLISEC		200
 
+// Number of directories in the tree from which on expanding the tree shows a
+// busy popup
+#define EXPAND_BUSY_POPUP_DIRS	10000
+
 #define USE_CUSTOM_OPEN_DIR_DIALOG 1
 
 using namespace QDirStat;
@@ -65,11 +73,13 @@ MainWindow::MainWindow():
     QMainWindow(),
     _ui( new Ui::MainWindow ),
     _configDialog( 0 ),
+    _fileMover( 0 ),
     _enableDirPermissionsWarning( false ),
     _verboseSelection( false ),
     _urlInWindowTitle( false ),
     _useTreemapHover( false ),
     _statusBarTimeout( 3000 ), // millisec
+    _maxExpandDirs( 20000 ),
     _treeLevelMapper(0),
     _currentLayout( 0 )
 {
@@ -92,6 +102,7 @@ MainWindow::MainWindow():
     // - the CleanupCollection.
 
     _ui->dirTreeView->setModel( app()->dirTreeModel() );
+    _ui->treeFilterBar->setModel( app()->dirTreeModel() );
     _ui->dirTreeView->setSelectionModel( app()->selectionModel() );
 
     _ui->treemapView->setDirTree( app()->dirTree() );
@@ -225,6 +236,9 @@ void MainWindow::connectSignals()
     connect( app()->dirTree(),		 SIGNAL( aborted()	   ),
 	     this,			 SLOT  ( readingAborted()  ) );
 
+    connect( app()->dirTree(),		 SIGNAL( lazyPkgReadFinished() ),
+	     this,			 SLOT  ( updateActions()       ) );
+
     connect( app()->selectionModel(),	 SIGNAL( selectionChanged() ),
 	     this,			 SLOT  ( updateActions()    ) );
 
@@ -240,6 +254,18 @@ void MainWindow::connectSignals()
     connect( app()->selectionModel(),	 SIGNAL( currentItemChanged  ( FileInfo *, FileInfo * ) ),
 	     this,      		 SLOT  ( updateBookmarkButton( FileInfo *             ) ) );
 
+    connect( CompressionAnalyzer::instance(), SIGNAL( progress	       ( int, int ) ),
+	     this,				SLOT  ( compressionProgress( int, int ) ) );
+
+    connect( CompressionAnalyzer::instance(), SIGNAL( finished	       () ),
+	     this,				SLOT  ( compressionFinished() ) );
+
+    connect( ContentSniffer::instance(),  SIGNAL( progress	   ( int, int ) ),
+	     this,			  SLOT  ( sniffingProgress( int, int ) ) );
+
+    connect( ContentSniffer::instance(),  SIGNAL( finished	   ( int ) ),
+	     this,			  SLOT  ( sniffingFinished( int ) ) );
+
     connect( _historyButtons,		 SIGNAL( navigateToUrl( QString ) ),
 	     this,			 SLOT  ( navigateToUrl( QString ) ) );
 
@@ -290,11 +316,14 @@ void MainWindow::updateActions()
     FileInfo * currentItem   = app()->selectionModel()->currentItem();
     FileInfo * firstToplevel = app()->dirTree()->firstToplevel();
     bool pkgView	     = firstToplevel && firstToplevel->isPkgInfo();
+    bool moving		     = _fileMover && _fileMover->isBusy();
 
-    _ui->actionStopReading->setEnabled( reading );
+    _ui->actionStopReading->setEnabled( reading || moving || ContentSniffer::instance()->isBusy() );
     _ui->actionRefreshAll->setEnabled	( ! reading );
     _ui->actionAskReadCache->setEnabled ( ! reading );
     _ui->actionAskWriteCache->setEnabled( ! reading );
+    _ui->actionShowFilterBar->setEnabled( ! reading && firstToplevel );
+    _ui->treeFilterBar->setEnabled      ( ! reading );
 
     _ui->actionCopyPathToClipboard->setEnabled( currentItem );
     _ui->actionGoUp->setEnabled( currentItem && currentItem->treeLevel() > 1 );
@@ -309,7 +338,12 @@ void MainWindow::updateActions()
     bool pkgSelected	   = selectedItems.containsPkg();
 
     _ui->actionMoveToTrash->setEnabled( sel && ! pseudoDirSelected && ! pkgSelected && ! reading );
+    _ui->actionMoveToFilesystem->setEnabled( sel && ! pseudoDirSelected && ! pkgSelected && ! reading && ! moving );
     _ui->actionRefreshSelected->setEnabled( selSize == 1 && ! sel->isExcluded() && ! sel->isMountPoint() && ! pkgView );
+    _ui->actionReadInFullDetail->setEnabled( selSize == 1 && ! reading && ! pkgView &&
+					     sel->isDirInfo() && ! sel->isAttic() &&
+					     app()->dirTree()->smallFileThreshold() > 0 );
+    _ui->actionReadAllPkgFileLists->setEnabled( ! reading && pkgView && app()->dirTree()->hasLazyPkg() );
     _ui->actionContinueReadingAtMountPoint->setEnabled( oneDirSelected && sel->isMountPoint() );
     _ui->actionReadExcludedDirectory->setEnabled      ( oneDirSelected && sel->isExcluded()   );
 
@@ -320,6 +354,12 @@ void MainWindow::updateActions()
     _ui->actionFileTypeStats->setEnabled( ! reading && nothingOrOneDirInfo );
     _ui->actionFileAgeStats->setEnabled ( ! reading && nothingOrOneDirInfo );
 
+    // Always allow cancelling a running compression analysis
+
+    bool analyzingCompression = CompressionAnalyzer::instance()->isBusy();
+    _ui->actionAnalyzeCompression->setEnabled( analyzingCompression ||
+					       ( ! reading && ! pkgView && nothingOrOneDirInfo ) );
+
     bool showingTreemap = _ui->treemapView->isVisible();
 
     _ui->actionTreemapAsSidePanel->setEnabled( showingTreemap );
@@ -344,6 +384,7 @@ void MainWindow::readSettings()
     _verboseSelection	  = settings.value( "VerboseSelection"	      , false ).toBool();
     _urlInWindowTitle	  = settings.value( "UrlInWindowTitle"	      , false ).toBool();
     _useTreemapHover	  = settings.value( "UseTreemapHover"	      , false ).toBool();
+    _maxExpandDirs	  = settings.value( "MaxExpandDirs"	      , 20000 ).toInt();
     _layoutName		  = settings.value( "Layout"		      , "L2"  ).toString();
 
     settings.endGroup();
@@ -404,6 +445,7 @@ void MainWindow::writeSettings()
     settings.setDefaultValue( "StatusBarTimeoutMillisec", _statusBarTimeout );
     settings.setDefaultValue( "UrlInWindowTitle"	, _urlInWindowTitle );
     settings.setDefaultValue( "UseTreemapHover"		, _useTreemapHover );
+    settings.setDefaultValue( "MaxExpandDirs"		, _maxExpandDirs );
 
     settings.endGroup();
 
@@ -547,6 +589,12 @@ void MainWindow::readingFinished()
 	showDirPermissionsWarning();
     }
 
+    // Detect the types of large files without a known suffix if that is
+    // enabled in the settings
+
+    if ( ContentSniffer::instance()->start( app()->dirTree()->firstToplevel() ) )
+	updateActions();
+
     // Debug::dumpModelTree( app()->dirTreeModel(), QModelIndex(), "" );
 }
 
@@ -771,6 +819,42 @@ void MainWindow::refreshSelected()
 }
 
 
+void MainWindow::readSelectedInFullDetail()
+{
+    busyDisplay();
+    _futureSelection.set( app()->selectionModel()->selectedItems().first() );
+    app()->dirTreeModel()->refreshSelected( true ); // fullDetail
+    updateActions();
+}
+
+
+void MainWindow::readAllPkgFileLists()
+{
+    app()->dirTree()->readAllLazyPkg();
+    updateActions();
+}
+
+
+void MainWindow::readLazySelectedPkg()
+{
+    FileInfo * firstToplevel = app()->dirTree()->firstToplevel();
+
+    if ( ! firstToplevel || ! firstToplevel->isPkgInfo() )
+	return;
+
+    QList<PkgInfo *> pkgList;
+
+    foreach ( FileInfo * item, app()->selectionModel()->selectedItems() )
+    {
+	if ( item->isPkgInfo() && item->toPkgInfo()->isLazy() )
+	    pkgList << item->toPkgInfo();
+    }
+
+    if ( ! pkgList.isEmpty() )
+	app()->dirTree()->readLazyPkg( pkgList );
+}
+
+
 void MainWindow::applyFutureSelection()
 {
     FileInfo * sel    = _futureSelection.subtree();
@@ -805,6 +889,19 @@ void MainWindow::stopReading()
 	app()->dirTree()->abortReading();
 	_ui->statusBar->showMessage( tr( "Reading aborted." ), LONG_MESSAGE );
     }
+    else if ( _fileMover && _fileMover->isBusy() )
+    {
+	// The items that are not completely copied yet are rolled back; this
+	// is reported with fileMoveFinished().
+
+	_fileMover->cancel();
+	_ui->statusBar->showMessage( tr( "Cancelling the move..." ), LONG_MESSAGE );
+    }
+    else if ( ContentSniffer::instance()->isBusy() )
+    {
+	ContentSniffer::instance()->cancel();
+	_ui->statusBar->showMessage( tr( "File type detection aborted." ), LONG_MESSAGE );
+    }
 }
 
 
@@ -900,6 +997,8 @@ void MainWindow::showCurrent( FileInfo * item )
 
 	if ( item->readState() == DirPermissionDenied )
 	    msg += tr( "  [Permission Denied]" );
+        else if ( item->readState() == DirError && item->tree()->isTimedOut( item->url() ) )
+	    msg += tr( "  [Timed Out]" );
         else if ( item->readState() == DirError )
 	    msg += tr( "  [Read Error]" );
 
@@ -985,9 +1084,33 @@ void MainWindow::expandTreeToLevel( int level )
     logDebug() << "Expanding tree to level " << level << endl;
 
     if ( level < 1 )
+    {
 	_ui->dirTreeView->collapseAll();
-    else
-	_ui->dirTreeView->expandToDepth( level - 1 );
+	return;
+    }
+
+    // Find out what to expand in the model (which also sorts the children
+    // of all those directories in advance) and let the view expand all of
+    // them at once: QTreeView::expandToDepth() does all that one by one
+    // which is painfully slow for large trees.
+
+    FileInfo * toplevel = app()->dirTree()->firstToplevel();
+    BusyPopup * busyPopup = 0;
+
+    if ( level > 1 && toplevel && toplevel->totalSubDirs() > EXPAND_BUSY_POPUP_DIRS )
+    {
+	busyPopup = new BusyPopup( tr( "Expanding tree..." ), this );
+	CHECK_NEW( busyPopup );
+    }
+
+    QModelIndexList indexes = app()->dirTreeModel()->indexesToExpand( level, _maxExpandDirs );
+    _ui->dirTreeView->expandIndexes( indexes );
+
+    if ( busyPopup )
+	delete busyPopup;
+
+    if ( indexes.size() >= _maxExpandDirs )
+	showProgress( tr( "Expanded only the first %1 directories" ).arg( _maxExpandDirs ) );
 }
 
 
@@ -1166,6 +1289,103 @@ void MainWindow::moveToTrash()
 }
 
 
+void MainWindow::moveToFilesystem()
+{
+    if ( _fileMover && _fileMover->isBusy() )
+	return;
+
+    FileInfoSet selectedItems = app()->selectionModel()->selectedItems().normalized();
+
+    if ( selectedItems.isEmpty() )
+	return;
+
+    QString targetDir = QFileDialog::getExistingDirectory( this, // parent
+							   tr( "Select target directory" ) );
+    if ( targetDir.isEmpty() )
+	return;
+
+    targetDir = QFileInfo( targetDir ).canonicalFilePath();
+
+    foreach ( FileInfo * item, selectedItems )
+    {
+	// Compare canonical paths on both sides, but don't resolve the item
+	// itself if it is a symlink: Only the link is moved.
+
+	QFileInfo fileInfo( item->path() );
+	QString	  parent = fileInfo.canonicalPath();
+	QString	  path	 = parent.isEmpty() ? item->path() : parent + "/" + fileInfo.fileName();
+
+	if ( parent == "/" )
+	    path = "/" + fileInfo.fileName();
+
+	if ( targetDir == path || targetDir.startsWith( path + "/" ) )
+	{
+	    QMessageBox::warning( this, tr( "Error" ),
+				  tr( "Can't move %1 into itself." ).arg( item->path() ) );
+	    return;
+	}
+    }
+
+    QString duplicate = FileMover::duplicateName( selectedItems );
+
+    if ( ! duplicate.isEmpty() )
+    {
+	QMessageBox::warning( this, tr( "Error" ),
+			      tr( "More than one of the selected items is named %1.\n"
+				  "They can't be moved to the same directory." )
+			      .arg( duplicate ) );
+	return;
+    }
+
+    QString msg = selectedItems.size() == 1 ?
+	tr( "Move %1 (%2) to %3?" )
+	.arg( selectedItems.first()->path() ) :
+	tr( "Move %1 items (%2) to %3?" )
+	.arg( selectedItems.size() );
+
+    msg = msg.arg( formatSize( selectedItems.totalSize() ) ).arg( targetDir );
+
+    int ret = QMessageBox::question( this,
+				     tr( "Please Confirm" ),
+				     msg,
+				     QMessageBox::Yes | QMessageBox::No );
+    if ( ret != QMessageBox::Yes )
+	return;
+
+    if ( ! _fileMover )
+    {
+	_fileMover = new FileMover( app()->dirTree(), this );
+	CHECK_NEW( _fileMover );
+
+	connect( _fileMover, SIGNAL( progress	     ( FileSize, FileSize, FileSize ) ),
+		 this,	     SLOT  ( fileMoveProgress( FileSize, FileSize, FileSize ) ) );
+
+	connect( _fileMover, SIGNAL( itemMoved	     ( QString, QString ) ),
+		 this,	     SLOT  ( fileMoved	     ( QString, QString ) ) );
+
+	connect( _fileMover, SIGNAL( itemFailed	     ( QString, QString ) ),
+		 this,	     SLOT  ( fileMoveFailed  ( QString, QString ) ) );
+
+	connect( _fileMover, SIGNAL( finished	     ( int, int ) ),
+		 this,	     SLOT  ( fileMoveFinished( int, int ) ) );
+    }
+
+    // Prepare output window
+
+    if ( _fileMoveOutput )
+	_fileMoveOutput->deleteLater();
+
+    _fileMoveOutput = new OutputWindow( this );
+    CHECK_NEW( _fileMoveOutput );
+
+    _fileMoveOutput->addCommandLine( tr( "Moving to %1" ).arg( targetDir ) );
+    _fileMoveOutput->showAfterTimeout();
+
+    if ( _fileMover->start( selectedItems, targetDir ) )
+	updateActions();
+}
+
+
 void MainWindow::openConfigDialog()
 {
     if ( _configDialog && _configDialog->isVisible() )
@@ -1230,6 +1450,119 @@ void MainWindow::showFileAgeStats()
 }
 
 
+void MainWindow::analyzeCompression()
+{
+    CompressionAnalyzer * analyzer = CompressionAnalyzer::instance();
+
+    if ( ! _ui->actionAnalyzeCompression->isChecked() )
+    {
+	analyzer->cancel();
+	showProgress( tr( "Compression analysis cancelled." ) );
+	return;
+    }
+
+    if ( ! CompressionAnalyzer::hasPermissions() )
+    {
+	_ui->actionAnalyzeCompression->setChecked( false );
+	showProgress( tr( "Analyzing the compression needs root permissions." ) );
+	return;
+    }
+
+    FileInfo * subtree = app()->selectedDirInfoOrRoot();
+
+    if ( ! subtree || ! analyzer->start( subtree ) )
+    {
+	_ui->actionAnalyzeCompression->setChecked( false );
+	showProgress( tr( "No files on btrfs to analyze." ) );
+    }
+
+    updateActions();
+}
+
+
+void MainWindow::compressionProgress( int filesDone, int filesTotal )
+{
+    showProgress( tr( "Analyzing compression... %1 of %2 files" )
+		  .arg( filesDone ).arg( filesTotal ) );
+}
+
+
+void MainWindow::compressionFinished()
+{
+    if ( _ui->actionAnalyzeCompression->isChecked() )
+    {
+	if ( CompressionAnalyzer::instance()->filesDone() > 0 )
+	    showProgress( tr( "Compression analysis finished." ) );
+	else
+	    showProgress( tr( "No files on btrfs to analyze." ) );
+    }
+
+    _ui->actionAnalyzeCompression->setChecked( false );
+    updateActions();
+}
+
+
+void MainWindow::sniffingProgress( int filesDone, int filesTotal )
+{
+    showProgress( tr( "Detecting file types... %1 of %2 files" )
+		  .arg( filesDone ).arg( filesTotal ) );
+}
+
+
+void MainWindow::sniffingFinished( int found )
+{
+    // The detected types change the colors in the treemap
+
+    if ( found > 0 && _ui->treemapView->isVisible() )
+	_ui->treemapView->rebuildTreemap();
+
+    // Don't hide the "Finished" message of reading the tree if there was
+    // nothing to do
+
+    if ( ContentSniffer::instance()->filesDone() > 0 )
+	showProgress( tr( "File type detection finished: %1 files detected." ).arg( found ) );
+
+    updateActions();
+}
+
+
+void MainWindow::fileMoveProgress( FileSize bytesDone, FileSize totalBytes, FileSize bytesPerSec )
+{
+    showProgress( tr( "Moving... %1 of %2 (%3/s)" )
+		  .arg( formatSize( bytesDone ) )
+		  .arg( formatSize( totalBytes ) )
+		  .arg( formatSize( bytesPerSec ) ) );
+}
+
+
+void MainWindow::fileMoved( const QString & path, const QString & target )
+{
+    if ( _fileMoveOutput )
+	_fileMoveOutput->addStdout( tr( "Moved %1 to %2" ).arg( path ).arg( target ) );
+}
+
+
+void MainWindow::fileMoveFailed( const QString & path, const QString & reason )
+{
+    if ( _fileMoveOutput )
+	_fileMoveOutput->addStderr( tr( "Moving %1 failed: %2" ).arg( path ).arg( reason ) );
+}
+
+
+void MainWindow::fileMoveFinished( int movedCount, int failedCount )
+{
+    if ( _fileMoveOutput )
+	_fileMoveOutput->noMoreProcesses();
+
+    if ( failedCount > 0 )
+	showProgress( tr( "Moved %1 items; %2 failed." ).arg( movedCount ).arg( failedCount ) );
+    else
+	showProgress( tr( "Moved %1 items." ).arg( movedCount ) );
+
+    updateActions();
+}
+
+
 void MainWindow::showFilesystems()
 {
     if ( ! _filesystemsWindow )
@@ -1278,6 +1611,7 @@ void MainWindow::selectionChanged()
 {
     showSummary();
     updateFileDetailsView();
+    readLazySelectedPkg();
 
     if ( _verboseSelection )
     {
@@ -19,6 +19,7 @@
 #include "ui_main-window.h"
 #include "FileAgeStatsWindow.h"
 #include "FilesystemsWindow.h"
+#include "FileSize.h"
 #include "HistoryButtons.h"
 #include "DiscoverActions.h"
 #include "PanelMessage.h"
@@ -32,12 +33,14 @@ class QSignalMapper;
 class TreeLayout;
 class SysCallFailedException;
 class QMenu;
+class OutputWindow;
 
 
 namespace QDirStat
 {
     class ConfigDialog;
     class FileInfo;
+    class FileMover;
     class DiscoverActions;
     class PkgManager;
     class UnpkgSettings;
@@ -45,6 +48,7 @@ namespace QDirStat
 
 using QDirStat::FileAgeStatsWindow;
 using QDirStat::FileInfo;
+using QDirStat::FileSize;
 using QDirStat::FilesystemsWindow;
 using QDirStat::PanelMessage;
 using QDirStat::PkgManager;
@@ -118,6 +122,19 @@ public slots:
      **/
     void refreshSelected();
 
+    /**
+     * Re-read the selected directory and create individual items for all
+     * its files, even those that would otherwise only be summarized
+     * because they are below the small file threshold.
+     **/
+    void readSelectedInFullDetail();
+
+    /**
+     * Read the file lists of all packages in the package view that were
+     * only shown with their size from the package database so far.
+     **/
+    void readAllPkgFileLists();
+
     /**
      * Stop reading if reading is in process.
      **/
@@ -194,6 +211,12 @@ public slots:
      **/
     void moveToTrash();
 
+    /**
+     * Ask for a target directory and move the selected items there,
+     * typically to another filesystem (see FileMover).
+     **/
+    void moveToFilesystem();
+
     /**
      * Open the "Find Files" dialog and display the results.
      **/
@@ -339,6 +362,53 @@ protected slots:
      **/
     void showFileAgeStats();
 
+    /**
+     * Start or cancel the compression analysis (see CompressionAnalyzer)
+     * for the currently selected directory, depending on the check state
+     * of the action.
+     **/
+    void analyzeCompression();
+
+    /**
+     * Show the progress of the compression analysis.
+     **/
+    void compressionProgress( int filesDone, int filesTotal );
+
+    /**
+     * Notification that the compression analysis is finished.
+     **/
+    void compressionFinished();
+
+    /**
+     * Show the progress of the file type detection (see ContentSniffer).
+     **/
+    void sniffingProgress( int filesDone, int filesTotal );
+
+    /**
+     * Notification that the file type detection is finished.
+     **/
+    void sniffingFinished( int found );
+
+    /**
+     * Show the progress of moving items to another filesystem.
+     **/
+    void fileMoveProgress( FileSize bytesDone, FileSize totalBytes, FileSize bytesPerSec );
+
+    /**
+     * Log that 'path' was moved to 'target'.
+     **/
+    void fileMoved( const QString & path, const QString & target );
+
+    /**
+     * Log that moving 'path' failed.
+     **/
+    void fileMoveFailed( const QString & path, const QString & reason );
+
+    /**
+     * Notification that moving items to another filesystem is finished.
+     **/
+    void fileMoveFinished( int movedCount, int failedCount );
+
     /**
      * Show detailed information about mounted filesystems in a separate window.
      **/
@@ -512,6 +582,12 @@ protected:
      **/
     virtual void mousePressEvent( QMouseEvent * event ) Q_DECL_OVERRIDE;
 
+    /**
+     * Read the file lists of the selected packages that were only shown
+     * with their size from the package database so far.
+     **/
+    void readLazySelectedPkg();
+
 
 private:
 
@@ -523,6 +599,8 @@ private:
     QPointer<FileAgeStatsWindow>   _fileAgeStatsWindow;
     QPointer<FilesystemsWindow>    _filesystemsWindow;
     QPointer<PanelMessage>	   _dirPermissionsWarning;
+    QPointer<OutputWindow>	   _fileMoveOutput;
+    QDirStat::FileMover		 * _fileMover;
     QString			   _dUrl;
     QElapsedTimer		   _stopWatch;
     bool			   _enableDirPermissionsWarning;
@@ -531,6 +609,7 @@ private:
     bool			   _useTreemapHover;
     QString			   _layoutName;
     int				   _statusBarTimeout; // millisec
+    int				   _maxExpandDirs;
     QSignalMapper	       *   _treeLevelMapper;
     QMap<QString, TreeLayout *>	   _layouts;
     TreeLayout *		   _currentLayout;
@@ -53,6 +53,8 @@ void MainWindow::connectFileMenu()
     CONNECT_ACTION( _ui->actionShowUnpkgFiles,		    this, askShowUnpkgFiles() );
     CONNECT_ACTION( _ui->actionRefreshAll,		    this, refreshAll()	      );
     CONNECT_ACTION( _ui->actionRefreshSelected,		    this, refreshSelected()   );
+    CONNECT_ACTION( _ui->actionReadInFullDetail,	    this, readSelectedInFullDetail() );
+    CONNECT_ACTION( _ui->actionReadAllPkgFileLists,	    this, readAllPkgFileLists() );
     CONNECT_ACTION( _ui->actionReadExcludedDirectory,	    this, refreshSelected()   );
     CONNECT_ACTION( _ui->actionContinueReadingAtMountPoint, this, refreshSelected()   );
     CONNECT_ACTION( _ui->actionStopReading,		    this, stopReading()	      );
@@ -67,6 +69,7 @@ void MainWindow::connectEditMenu()
 
     CONNECT_ACTION( _ui->actionCopyPathToClipboard, this, copyCurrentPathToClipboard() );
     CONNECT_ACTION( _ui->actionMoveToTrash,	    this, moveToTrash()                );
+    CONNECT_ACTION( _ui->actionMoveToFilesystem,    this, moveToFilesystem()           );
     CONNECT_ACTION( _ui->actionFindFiles,	    this, askFindFiles()               );
     CONNECT_ACTION( _ui->actionConfigure,           this, openConfigDialog()           );
 }
@@ -80,6 +83,15 @@ void MainWindow::connectViewMenu()
     connect( _ui->actionShowDetailsPanel, SIGNAL( toggled                       ( bool ) ),
              this,                        SLOT	( setDetailsPanelVisible        ( bool ) ) );
 
+    connect( _ui->actionShowFilterBar,	  SIGNAL( toggled			( bool ) ),
+	     _ui->treeFilterBar,	  SLOT	( setFilterBarVisible		( bool ) ) );
+
+    connect( _ui->treeFilterBar,	  SIGNAL( closed()			  ),
+	     _ui->actionShowFilterBar,	  SLOT	( toggle()			  ) );
+
+    connect( _ui->treeFilterBar,	  SIGNAL( filterApplied()		  ),
+	     _ui->actionExpandTreeLevel2, SLOT	( trigger()			  ) );
+
     CONNECT_ACTION( _ui->actionLayout1,		   this, changeLayout() );
     CONNECT_ACTION( _ui->actionLayout2,		   this, changeLayout() );
     CONNECT_ACTION( _ui->actionLayout3,		   this, changeLayout() );
@@ -90,6 +102,7 @@ void MainWindow::connectViewMenu()
     _ui->actionFileTypeStats->setShortcutContext( Qt::ApplicationShortcut );
 
     CONNECT_ACTION( _ui->actionFileAgeStats,	   this, showFileAgeStats()  );
+    CONNECT_ACTION( _ui->actionAnalyzeCompression, this, analyzeCompression() );
     CONNECT_ACTION( _ui->actionShowFilesystems,	   this, showFilesystems()   );
 }
 
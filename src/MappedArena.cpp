@@ -0,0 +1,206 @@
+/*
+ *   File name: MappedArena.cpp
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>	// posix_fallocate()
+#include <stdlib.h>	// mkstemp()
+#include <unistd.h>	// unlink(), close()
+#include <sys/mman.h>	// mmap(), munmap()
+
+#include <QDir>
+
+#include "MappedArena.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+#define CHUNK_SIZE	(64*1024*1024)
+#define ALIGNMENT	16
+
+
+using namespace QDirStat;
+
+
+MappedArena * MappedArena::_instance = 0;
+
+
+MappedArena::MappedArena():
+    _current( 0 ),
+    _currentEnd( 0 ),
+    _mappedSize( 0 ),
+    _failed( false )
+{
+
+}
+
+
+MappedArena::~MappedArena()
+{
+    foreach ( const Chunk & chunk, _chunks )
+	munmap( chunk.start, chunk.size );
+}
+
+
+void MappedArena::setScratchDir( const QString & dir )
+{
+    if ( dir.isEmpty() && ! _instance )
+	return;
+
+    if ( ! dir.isEmpty() && ! QDir( dir ).exists() )
+    {
+	logError() << "Scratch directory " << dir << " does not exist" << endl;
+	return;
+    }
+
+    if ( ! _instance )
+    {
+	_instance = new MappedArena();
+	CHECK_NEW( _instance );
+    }
+
+    if ( dir != _instance->_scratchDir )
+    {
+	logInfo() << "Using scratch directory \"" << dir << "\" for the tree" << endl;
+	_instance->_scratchDir = dir;
+	_instance->_failed     = false;
+    }
+}
+
+
+QString MappedArena::scratchDir()
+{
+    return _instance ? _instance->_scratchDir : QString();
+}
+
+
+void * MappedArena::allocate( size_t size )
+{
+    if ( ! isEnabled() )
+	return 0;
+
+    size = ( size + ALIGNMENT - 1 ) & ~( (size_t) ALIGNMENT - 1 );
+
+    // Reuse a slot of a node of the same size that was freed
+
+    void * ptr = _freeLists.value( size, 0 );
+
+    if ( ptr )
+    {
+	_freeLists[ size ] = *( (void **) ptr );
+	return ptr;
+    }
+
+    if ( _current + size > _currentEnd )
+    {
+	if ( _failed || ! addChunk( size ) )
+	    return 0;
+    }
+
+    ptr = _current;
+    _current += size;
+
+    return ptr;
+}
+
+
+void MappedArena::deallocate( void * ptr, size_t size )
+{
+    if ( ! ptr )
+	return;
+
+    size = ( size + ALIGNMENT - 1 ) & ~( (size_t) ALIGNMENT - 1 );
+
+    // Link the slot into the free list for that size. This overwrites only
+    // the first pointer-sized bytes of the dead object (the vptr in case of
+    // FileInfo), so the magic number that the destructor reset stays
+    // invalid until the slot is reused.
+
+    *( (void **) ptr ) = _freeLists.value( size, 0 );
+    _freeLists[ size ] = ptr;
+}
+
+
+bool MappedArena::contains( const void * ptr ) const
+{
+    if ( _chunks.isEmpty() )
+	return false;
+
+    quintptr addr = (quintptr) ptr;
+    QMap<quintptr, Chunk>::const_iterator it = _chunks.upperBound( addr );
+
+    if ( it == _chunks.constEnd() )
+	return false;
+
+    return addr >= (quintptr) it.value().start;
+}
+
+
+bool MappedArena::addChunk( size_t minSize )
+{
+    size_t size = minSize > CHUNK_SIZE ? minSize : CHUNK_SIZE;
+    QByteArray path = ( _scratchDir + "/qdirstat-tree-XXXXXX" ).toUtf8();
+
+    int fd = mkstemp( path.data() );
+
+    if ( fd < 0 )
+    {
+	logError() << "Can't create scratch file in " << _scratchDir
+		   << ": " << formatErrno() << endl;
+	_failed = true;
+
+	return false;
+    }
+
+    // Nobody else needs to see this file, and this makes sure it is gone
+    // when the last reference (the mapping) goes away, even after a crash.
+
+    unlink( path.constData() );
+
+    // Reserve the disk space right away: With just ftruncate(), the file
+    // would be sparse, and if the scratch filesystem fills up, the first
+    // write to a page without any disk space would kill the program with
+    // SIGBUS rather than letting us fall back to normal memory.
+
+    int result = posix_fallocate( fd, 0, size );
+
+    if ( result != 0 )
+    {
+	errno = result;
+	logError() << "Can't allocate " << formatSize( size )
+		   << " for a scratch file: " << formatErrno() << endl;
+	close( fd );
+	_failed = true;
+
+	return false;
+    }
+
+    void * start = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );	// The mapping keeps its own reference to the file
+
+    if ( start == MAP_FAILED )
+    {
+	logError() << "Can't map scratch file: " << formatErrno() << endl;
+	_failed = true;
+
+	return false;
+    }
+
+    Chunk chunk;
+    chunk.start = (char *) start;
+    chunk.size	= size;
+
+    _chunks.insert( (quintptr) ( chunk.start + size ), chunk );
+    _current	 = chunk.start;
+    _currentEnd	 = chunk.start + size;
+    _mappedSize += size;
+
+    logDebug() << "Mapped " << formatSize( _mappedSize ) << " of scratch files" << endl;
+
+    return true;
+}
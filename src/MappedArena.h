@@ -0,0 +1,142 @@
+/*
+ *   File name: MappedArena.h
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef MappedArena_h
+#define MappedArena_h
+
+
+#include <stddef.h>	// size_t
+
+#include <QMap>
+#include <QHash>
+#include <QString>
+
+
+namespace QDirStat
+{
+    /**
+     * Memory arena for the nodes of the DirTree (FileInfo and all its
+     * derived classes) that is backed by memory-mapped scratch files
+     * instead of anonymous memory.
+     *
+     * For very large trees (hundreds of millions of inodes), the tree
+     * nodes alone might not fit into RAM. With this arena, the kernel can
+     * write cold pages back to the scratch files and drop them from RAM
+     * rather than the process running out of memory.
+     *
+     * Nodes are allocated with a simple bump pointer, so nodes that are
+     * created one after another while reading a directory end up on the
+     * same pages. Freed nodes are kept in a free list for each size and
+     * reused for nodes of the same size.
+     *
+     * The scratch files are unlinked right after they are created, so
+     * nothing is left behind even if the program crashes.
+     *
+     * This is a singleton class. It is only used if a scratch directory
+     * was set with setScratchDir(); otherwise instance() returns 0 and the
+     * nodes are allocated with the normal global operator new.
+     *
+     * Nothing in here is locked: allocate() and deallocate() may only be
+     * used from the GUI thread, like creating and deleting tree nodes.
+     **/
+    class MappedArena
+    {
+    public:
+
+	/**
+	 * Return the singleton instance of this class or 0 if no scratch
+	 * directory is configured.
+	 **/
+	static MappedArena * instance() { return _instance; }
+
+	/**
+	 * Set the directory for the scratch files and create the singleton
+	 * if necessary. An empty directory disables the arena for all new
+	 * allocations; nodes that were already allocated in the arena are
+	 * still freed correctly.
+	 **/
+	static void setScratchDir( const QString & dir );
+
+	/**
+	 * Return the scratch directory or an empty string if the arena is
+	 * disabled.
+	 **/
+	static QString scratchDir();
+
+	/**
+	 * Allocate 'size' bytes from the arena. Return 0 if that is not
+	 * possible (e.g. the scratch filesystem is full); the caller should
+	 * then fall back to the global operator new.
+	 **/
+	void * allocate( size_t size );
+
+	/**
+	 * Return memory that was allocated with allocate() to the arena.
+	 * 'size' has to be the same size as for allocate().
+	 **/
+	void deallocate( void * ptr, size_t size );
+
+	/**
+	 * Return 'true' if 'ptr' points into memory of this arena.
+	 **/
+	bool contains( const void * ptr ) const;
+
+	/**
+	 * Return 'true' if new nodes should be allocated in this arena.
+	 **/
+	bool isEnabled() const { return ! _scratchDir.isEmpty(); }
+
+	/**
+	 * Total number of bytes of all scratch files.
+	 **/
+	size_t mappedSize() const { return _mappedSize; }
+
+
+    protected:
+
+	/**
+	 * Constructor. Use setScratchDir() to create the instance.
+	 **/
+	MappedArena();
+
+	/**
+	 * Destructor.
+	 **/
+	~MappedArena();
+
+	/**
+	 * Map a new chunk of at least 'minSize' bytes. Return 'true' on
+	 * success, 'false' on error.
+	 **/
+	bool addChunk( size_t minSize );
+
+
+	// Data members
+
+	static MappedArena *	_instance;
+
+	struct Chunk
+	{
+	    char *	start;
+	    size_t	size;
+	};
+
+	QString			_scratchDir;
+	QMap<quintptr, Chunk>	_chunks;	// key: end address of the chunk
+	char *			_current;	// bump pointer in the latest chunk
+	char *			_currentEnd;
+	QHash<size_t, void *>	_freeLists;	// size -> first free slot
+	size_t			_mappedSize;
+	bool			_failed;
+
+    };	// class MappedArena
+
+}	// namespace QDirStat
+
+#endif	// MappedArena_h
@@ -0,0 +1,253 @@
+/*
+ *   File name: MetricsExporter.cpp
+ *   Summary:	Headless export of directory sizes as Prometheus metrics
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <stdio.h>	// rename()
+#include <unistd.h>	// getpid(), fsync()
+#include <time.h>	// time()
+
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QFile>
+#include <QTextStream>
+
+#include "MetricsExporter.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+using namespace QDirStat;
+
+
+MetricsExporter::MetricsExporter( const QString & outputFile, QObject * parent ):
+    QObject( parent ),
+    _outputFile( outputFile ),
+    _maxDepth( 3 ),
+    _minSize( 0LL )
+{
+    _tree = new DirTree();
+    CHECK_NEW( _tree );
+
+    readSettings();
+
+    connect( _tree, SIGNAL( finished()	      ),
+	     this,  SLOT  ( readingFinished() ) );
+
+    connect( _tree, SIGNAL( aborted()	      ),
+	     this,  SLOT  ( readingAborted()  ) );
+}
+
+
+MetricsExporter::~MetricsExporter()
+{
+    delete _tree;
+}
+
+
+void MetricsExporter::readSettings()
+{
+    // Use the same settings as the DirTreeModel for the main window's tree
+    // so the numbers are the same as in the GUI
+
+    Settings settings;
+    settings.beginGroup( "DirectoryTree" );
+
+    _tree->setCrossFilesystems( settings.value( "CrossFilesystems", false ).toBool() );
+    FileInfo::setIgnoreHardLinks( settings.value( "IgnoreHardLinks", false ).toBool() );
+    _tree->setSmallFileThreshold( settings.value( "SmallFileAggregationThreshold", 0 ).toInt() );
+
+    settings.endGroup();
+}
+
+
+void MetricsExporter::readDir( const QString & path )
+{
+    logInfo() << "Reading " << path << endl;
+    _readTimer.start();
+    _tree->startReading( path );
+}
+
+
+void MetricsExporter::readCache( const QString & cacheFileName )
+{
+    logInfo() << "Reading cache file " << cacheFileName << endl;
+    _readTimer.start();
+
+    if ( ! _tree->readCache( cacheFileName ) )
+    {
+	// The event loop might not be running yet, so exiting it right here
+	// would have no effect
+
+	QMetaObject::invokeMethod( this, "readingAborted", Qt::QueuedConnection );
+    }
+}
+
+
+void MetricsExporter::readingFinished()
+{
+    logInfo() << "Reading finished after " << _readTimer.elapsed() << " millisec" << endl;
+
+    QCoreApplication::exit( writeMetrics() ? 0 : 1 );
+}
+
+
+void MetricsExporter::readingAborted()
+{
+    logError() << "Reading aborted - not writing " << _outputFile << endl;
+
+    QCoreApplication::exit( 1 );
+}
+
+
+void MetricsExporter::collectDirs( FileInfo * dir, int depth, QList<FileInfo *> & dirs )
+{
+    if ( dir->totalSize() < _minSize )
+	return;
+
+    dirs << dir;
+
+    if ( depth >= _maxDepth )
+	return;
+
+    for ( FileInfo * child = dir->firstChild(); child; child = child->next() )
+    {
+	if ( child->isDirInfo() && ! child->isPseudoDir() )
+	    collectDirs( child, depth + 1, dirs );
+    }
+}
+
+
+bool MetricsExporter::writeMetrics()
+{
+    FileInfo * toplevel = _tree->firstToplevel();
+
+    if ( ! toplevel )
+    {
+	logError() << "Empty tree - not writing " << _outputFile << endl;
+	return false;
+    }
+
+    QList<FileInfo *> dirs;
+    collectDirs( toplevel, 0, dirs );
+
+
+    // Write everything to a temporary file in the same directory (so it is
+    // on the same filesystem) and rename it to the real name only when it is
+    // complete: The textfile collector might read it at any time.
+
+    QString tmpName = QString( "%1.%2.tmp" ).arg( _outputFile ).arg( getpid() );
+    QFile   file( tmpName );
+
+    if ( ! file.open( QIODevice::WriteOnly | QIODevice::Text ) )
+    {
+	logError() << "Can't open " << tmpName << ": " << file.errorString() << endl;
+	return false;
+    }
+
+    const char * names[] =
+    {
+	"qdirstat_dir_size_bytes",
+	"qdirstat_dir_allocated_bytes",
+	"qdirstat_dir_files",
+	"qdirstat_dir_latest_mtime_seconds"
+    };
+
+    const char * help[] =
+    {
+	"Total size of the directory and everything below it",
+	"Total allocated disk space of the directory and everything below it",
+	"Number of files in the directory and below it",
+	"Latest modification time in the directory and below it"
+    };
+
+    QTextStream str( &file );
+
+    for ( int metric = 0; metric < 4; ++metric )
+    {
+	str << "# HELP " << names[ metric ] << " " << help[ metric ] << "\n"
+	    << "# TYPE " << names[ metric ] << " gauge\n";
+
+	foreach ( FileInfo * dir, dirs )
+	{
+	    qlonglong value = 0;
+
+	    switch ( metric )
+	    {
+		case 0: value = dir->totalSize();		break;
+		case 1: value = dir->totalAllocatedSize();	break;
+		case 2: value = dir->totalFiles();		break;
+		case 3: value = dir->latestMtime();		break;
+	    }
+
+	    str << names[ metric ]
+		<< "{path=\"" << escapedLabel( dir->url() ) << "\"} "
+		<< value << "\n";
+	}
+    }
+
+    str << "# HELP qdirstat_read_duration_seconds Time it took to read the tree\n"
+	<< "# TYPE qdirstat_read_duration_seconds gauge\n"
+	<< "qdirstat_read_duration_seconds " << _readTimer.elapsed() / 1000.0 << "\n"
+	<< "# HELP qdirstat_last_read_timestamp_seconds When the tree was read\n"
+	<< "# TYPE qdirstat_last_read_timestamp_seconds gauge\n"
+	<< "qdirstat_last_read_timestamp_seconds " << (qlonglong) time( 0 ) << "\n";
+
+    // A write error might only show up when the last buffer is written, so
+    // check only after close(). Get the data to the disk before the rename:
+    // Otherwise, after a crash, the new name might point to an empty file.
+
+    str.flush();
+    bool ok = str.status() == QTextStream::Ok && file.flush();
+
+    if ( ok && fsync( file.handle() ) != 0 )
+    {
+	logError() << "Can't sync " << tmpName << ": " << formatErrno() << endl;
+	ok = false;
+    }
+
+    file.close();
+
+    if ( ok && file.error() != QFile::NoError )
+    {
+	logError() << "Can't write " << tmpName << ": " << file.errorString() << endl;
+	ok = false;
+    }
+
+    if ( ok && rename( tmpName.toUtf8(), _outputFile.toUtf8() ) != 0 )
+    {
+	logError() << "Can't rename " << tmpName << " to " << _outputFile
+		   << ": " << formatErrno() << endl;
+	ok = false;
+    }
+
+    if ( ! ok )
+    {
+	logError() << "Writing " << _outputFile << " failed" << endl;
+	QFile::remove( tmpName );
+	return false;
+    }
+
+    logInfo() << "Wrote " << dirs.size() << " directories to " << _outputFile << endl;
+
+    return true;
+}
+
+
+QString MetricsExporter::escapedLabel( const QString & value )
+{
+    QString escaped = value;
+
+    escaped.replace( "\\", "\\\\" );
+    escaped.replace( "\"", "\\\"" );
+    escaped.replace( "\n", "\\n"  );
+
+    return escaped;
+}
@@ -0,0 +1,133 @@
+/*
+ *   File name: MetricsExporter.h
+ *   Summary:	Headless export of directory sizes as Prometheus metrics
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+#ifndef MetricsExporter_h
+#define MetricsExporter_h
+
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QElapsedTimer>
+
+#include "FileSize.h"
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class FileInfo;
+
+    /**
+     * Headless exporter that reads a directory tree (or a cache file) and
+     * then writes the sizes of its directories as metrics in the text format
+     * of the Prometheus node_exporter textfile collector:
+     *
+     *	   qdirstat_dir_size_bytes{path="/var/log"} 1234567
+     *	   qdirstat_dir_allocated_bytes{path="/var/log"} 1236992
+     *	   qdirstat_dir_files{path="/var/log"} 318
+     *	   qdirstat_dir_latest_mtime_seconds{path="/var/log"} 1710000000
+     *
+     * To keep the number of time series bounded, only directories up to a
+     * maximum depth below the toplevel directory and with at least a
+     * minimum total size are exported.
+     *
+     * The output file is replaced atomically: The metrics are written to a
+     * temporary file in the same directory which is then renamed, so the
+     * collector never sees a half-written file.
+     *
+     * This does not need a GUI; when done, it exits the application's event
+     * loop with 0 for success or 1 for failure.
+     **/
+    class MetricsExporter: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor. 'outputFile' is the file to write the metrics to.
+	 **/
+	MetricsExporter( const QString & outputFile, QObject * parent = 0 );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~MetricsExporter();
+
+	/**
+	 * Set the maximum depth below the toplevel directory. 0 exports only
+	 * the toplevel directory.
+	 **/
+	void setMaxDepth( int depth ) { _maxDepth = depth; }
+
+	/**
+	 * Set the minimum total size of a directory to be exported.
+	 **/
+	void setMinSize( FileSize size ) { _minSize = size; }
+
+	/**
+	 * Start reading directory 'path' from disk.
+	 **/
+	void readDir( const QString & path );
+
+	/**
+	 * Start reading cache file 'cacheFileName'.
+	 **/
+	void readCache( const QString & cacheFileName );
+
+	/**
+	 * Write the metrics for the current tree to the output file.
+	 * Return 'true' if success, 'false' if error.
+	 **/
+	bool writeMetrics();
+
+
+    protected slots:
+
+	/**
+	 * Reading the tree is finished: Write the metrics and exit.
+	 **/
+	void readingFinished();
+
+	/**
+	 * Reading the tree was aborted: Exit with an error.
+	 **/
+	void readingAborted();
+
+
+    protected:
+
+	/**
+	 * Read the relevant settings for the tree.
+	 **/
+	void readSettings();
+
+	/**
+	 * Add 'dir' and (recursively) its subdirectories up to the maximum
+	 * depth to 'dirs' if they have at least the minimum size.
+	 **/
+	void collectDirs( FileInfo * dir, int depth, QList<FileInfo *> & dirs );
+
+	/**
+	 * Escape a label value: Backslash, double quote and newline need to
+	 * be escaped with a backslash.
+	 **/
+	static QString escapedLabel( const QString & value );
+
+
+	DirTree *	_tree;
+	QString		_outputFile;
+	int		_maxDepth;
+	FileSize	_minSize;
+	QElapsedTimer	_readTimer;
+    };
+
+}	// namespace QDirStat
+
+#endif	// MetricsExporter_h
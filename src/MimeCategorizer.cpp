@@ -6,7 +6,10 @@
  *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
  */
 
+#include <QMutexLocker>
+
 #include "MimeCategorizer.h"
+#include "ContentSniffer.h"
 #include "FileInfo.h"
 #include "Settings.h"
 #include "SettingsHelpers.h"
@@ -49,6 +52,8 @@ MimeCategorizer::~MimeCategorizer()
 
 void MimeCategorizer::clear()
 {
+    QMutexLocker locker( &_mutex );
+
     qDeleteAll( _categories );
     _categories.clear();
     _mapsDirty = true;
@@ -75,6 +80,17 @@ MimeCategory * MimeCategorizer::category( FileInfo * item )
     else if ( item->isFile() )
     {
 	MimeCategory *matchedCategory = category( item->name() );
+
+	if ( ! matchedCategory )
+	{
+	    // Use the file type that was detected from the content, if any
+
+	    QString sniffedSuffix = ContentSniffer::sniffedSuffix( item );
+
+	    if ( ! sniffedSuffix.isEmpty() )
+		matchedCategory = category( "x." + sniffedSuffix );
+	}
+
 	if ( ! matchedCategory && ( item->mode() & S_IXUSR  ) == S_IXUSR )
 	    return matchCategoryName( CATEGORY_EXECUTABLES );
 
@@ -96,6 +112,9 @@ MimeCategory * MimeCategorizer::category( const QString & filename,
     if ( filename.isEmpty() )
 	return 0;
 
+    // The maps are built on demand, and matching a QRegExp changes it
+    QMutexLocker locker( &_mutex );
+
     // Build suffix maps for fast lookup
 
     if ( _mapsDirty )
@@ -165,6 +184,8 @@ MimeCategory * MimeCategorizer::matchPatterns( const QString & filename ) const
 
 MimeCategory * MimeCategorizer::matchCategoryName( const QString & categoryName ) const
 {
+    QMutexLocker locker( &_mutex );
+
     foreach ( MimeCategory * category, _categories )
     {
 	if ( category && category->name() == categoryName )
@@ -179,6 +200,7 @@ void MimeCategorizer::add( MimeCategory * category )
 {
     CHECK_PTR( category );
 
+    QMutexLocker locker( &_mutex );
     _categories << category;
     _mapsDirty = true;
 }
@@ -188,6 +210,7 @@ void MimeCategorizer::remove( MimeCategory * category )
 {
     CHECK_PTR( category );
 
+    QMutexLocker locker( &_mutex );
     _categories.removeAll( category );
     delete category;
     _mapsDirty = true;
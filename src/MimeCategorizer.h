@@ -11,6 +11,7 @@
 
 #include <QObject>
 #include <QMap>
+#include <QMutex>
 
 #include "MimeCategory.h"
 
@@ -32,6 +33,9 @@ namespace QDirStat
      * This is a singleton class. Use instance() to get the instance. Remember
      * to call instance()->writeSettings() in an appropriate destructor in the
      * application to write the settings to disk.
+     *
+     * The category() lookups may be used from other threads once the
+     * instance exists.
      **/
     class MimeCategorizer: public QObject
     {
@@ -166,6 +170,7 @@ namespace QDirStat
 
 	static MimeCategorizer *	_instance;
 
+	mutable QMutex			_mutex;
 	bool				_mapsDirty;
 	MimeCategoryList		_categories;
 
@@ -317,6 +317,10 @@ void MimeCategoryConfigPage::populateTreemapView()
 	parent->insertChild( file );
     }
 
+    // Move the files to dot entries where there are also subdirectories
+
+    topDir->finalizeAll();
+
     logDebug() << "Demo tree: " << fileCount << " files with "
 	       << formatSize( topDir->totalSize() ) << " total"
 	       << endl;
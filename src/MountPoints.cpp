@@ -308,6 +308,18 @@ bool MountPoints::hasBtrfs()
 }
 
 
+QMap<QString, bool> MountPoints::btrfsByPath()
+{
+    instance()->ensurePopulated();
+    QMap<QString, bool> result;
+
+    foreach ( MountPoint * mountPoint, _instance->_mountPointList )
+	result.insert( mountPoint->path(), mountPoint->isBtrfs() );
+
+    return result;
+}
+
+
 void MountPoints::ensurePopulated()
 {
     if ( _isPopulated )
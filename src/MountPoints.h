@@ -242,6 +242,13 @@ namespace QDirStat
 	 **/
 	static bool hasBtrfs();
 
+	/**
+	 * Return the paths of all mount points and for each of them 'true'
+	 * if it has filesystem type "btrfs". Unlike the MountPoint pointers,
+	 * the result may be used in other threads.
+	 **/
+	static QMap<QString, bool> btrfsByPath();
+
 	/**
 	 * Ensure the mount points are populated with the content of
 	 * /proc/mounts, falling back to /etc/mtab if /proc/mounts cannot be
@@ -9,7 +9,6 @@
 
 #include <QPushButton>
 #include <QDir>
-#include <QFileSystemModel>
 #include <QTimer>
 
 #include "Qt4Compat.h"
@@ -18,6 +17,8 @@
 #include "MountPoints.h"
 #include "ExistingDirCompleter.h"
 #include "ExistingDirValidator.h"
+#include "ExistingDirModel.h"
+#include "QDirStatApp.h"
 #include "Settings.h"
 #include "SettingsHelpers.h"
 #include "SignalBlocker.h"
@@ -46,11 +47,11 @@ bool OpenDirDialog::_crossFilesystems = false;
 OpenDirDialog::OpenDirDialog( QWidget * parent ):
     QDialog( parent ),
     _ui( new Ui::OpenDirDialog ),
-    _filesystemModel( new QFileSystemModel( this ) ),
+    _dirModel( new ExistingDirModel( this ) ),
     _settingPath( false )
 {
     CHECK_NEW( _ui );
-    CHECK_NEW( _filesystemModel );
+    CHECK_NEW( _dirModel );
     _ui->setupUi( this );
     MountPoints::reload();
 
@@ -81,10 +82,13 @@ void OpenDirDialog::initPathComboBox()
     qEnableClearButton( _ui->pathComboBox );
 
 #if USE_COMPLETER
-    QCompleter * completer = new ExistingDirCompleter( this );
+    QCompleter * completer = new ExistingDirCompleter( this, app()->dirTree() );
     CHECK_NEW( completer );
 
     _ui->pathComboBox->setCompleter( completer );
+
+    connect( _ui->pathComboBox, SIGNAL( editTextChanged  ( QString ) ),
+             completer,         SLOT  ( updateCompletions( QString ) ) );
 #endif
 
     _validator = new ExistingDirValidator( this );
@@ -96,17 +100,10 @@ void OpenDirDialog::initPathComboBox()
 
 void OpenDirDialog::initDirTree()
 {
-    _filesystemModel->setRootPath( "/" );
-    _filesystemModel->setFilter( QDir::Dirs       |
-                                 QDir::NoDot      |
-                                 QDir::NoDotDot   |
-                                 QDir::NoSymLinks |
-                                 QDir::Drives      );
-
-    _ui->dirTreeView->setModel( _filesystemModel );
-    _ui->dirTreeView->hideColumn( 3 );  // Date Modified
-    _ui->dirTreeView->hideColumn( 2 );  // Type
-    _ui->dirTreeView->hideColumn( 1 );  // Size
+    // Not a QFileSystemModel: That one stats and watches directories in the
+    // GUI thread, so a slow or dead network mount would block the dialog.
+
+    _ui->dirTreeView->setModel( _dirModel );
     _ui->dirTreeView->setHeaderHidden( true );
 }
 
@@ -189,7 +186,7 @@ void OpenDirDialog::setPath( const QString & path )
 
     populatePathComboBox( path );
     qSetComboBoxText( _ui->pathComboBox, path );
-    QModelIndex index = _filesystemModel->index( path );
+    QModelIndex index = _dirModel->indexForPath( path );
     _ui->dirTreeView->setCurrentIndex( index );
     _ui->dirTreeView->scrollTo( index );
 
@@ -203,7 +200,7 @@ void OpenDirDialog::setPathAndExpand( const QString & path )
     setPath( path );
 
     SignalBlocker sigBlockerPathSelector( _ui->pathSelector );
-    QModelIndex index = _filesystemModel->index( path );
+    QModelIndex index = _dirModel->indexForPath( path );
     _ui->dirTreeView->collapseAll();
     _ui->dirTreeView->setExpanded( index, true );
     _ui->dirTreeView->scrollTo( index, QAbstractItemView::PositionAtTop );
@@ -244,7 +241,7 @@ void OpenDirDialog::treeSelection( const QModelIndex & newCurrentItem,
                                    const QModelIndex & oldCurrentItem )
 {
     Q_UNUSED( oldCurrentItem );
-    QString path = _filesystemModel->filePath( newCurrentItem );
+    QString path = _dirModel->path( newCurrentItem );
 
     if ( path != _lastPath )
     {
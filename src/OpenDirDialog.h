@@ -15,12 +15,11 @@
 
 #include "ui_open-dir-dialog.h"
 
-class QFileSystemModel;
-
 
 namespace QDirStat
 {
     class ExistingDirValidator;
+    class ExistingDirModel;
 
     /**
      * Dialog to let the user select installed packages to open, very much like
@@ -135,7 +134,7 @@ namespace QDirStat
 
 
 	Ui::OpenDirDialog *     _ui;
-        QFileSystemModel *      _filesystemModel;
+        ExistingDirModel *      _dirModel;
 	QPushButton *           _okButton;
         ExistingDirValidator *  _validator;
         bool                    _settingPath;
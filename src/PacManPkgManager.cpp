@@ -7,6 +7,8 @@
  */
 
 
+#include <QFile>
+
 #include "PacManPkgManager.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -89,6 +91,7 @@ PkgInfoList PacManPkgManager::parsePkgList( const QString & output )
 
                 PkgInfo * pkg = new PkgInfo( name, version, arch, this );
                 CHECK_NEW( pkg );
+                pkg->setDbSize( installedSize( name, version ) );
 
                 pkgList << pkg;
             }
@@ -99,6 +102,29 @@ PkgInfoList PacManPkgManager::parsePkgList( const QString & output )
 }
 
 
+FileSize PacManPkgManager::installedSize( const QString & name, const QString & version )
+{
+    // pacman -Qi has the size only in a rounded and localized format; the
+    // database has it in bytes:
+    //
+    //   %SIZE%
+    //   1535604
+
+    QFile desc( QString( "/var/lib/pacman/local/%1-%2/desc" ).arg( name ).arg( version ) );
+
+    if ( ! desc.open( QIODevice::ReadOnly ) )
+        return 0;
+
+    while ( ! desc.atEnd() )
+    {
+        if ( desc.readLine().trimmed() == "%SIZE%" )
+            return desc.readLine().trimmed().toLongLong();
+    }
+
+    return 0;
+}
+
+
 QString PacManPkgManager::fileListCommand( PkgInfo * pkg )
 {
     return QString( "/usr/bin/pacman -Qlq %1" ).arg( pkg->baseName() );
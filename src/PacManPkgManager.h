@@ -116,6 +116,12 @@ namespace QDirStat
          **/
         PkgInfoList parsePkgList( const QString & output );
 
+        /**
+         * Return the installed size of a package from the %SIZE% field of
+         * its "desc" file in the local pacman database or 0 if unknown.
+         **/
+        FileSize installedSize( const QString & name, const QString & version );
+
     }; // class PacManPkgManager
 
 } // namespace QDirStat
@@ -8,6 +8,9 @@
 
 
 #include <QPainter>
+#include <QPaintDevice>
+#include <QPixmapCache>
+#include <QtCore/qmath.h>
 #include <QTreeView>
 
 #include "PercentBar.h"
@@ -194,6 +197,78 @@ QSize PercentBarDelegate::sizeHint( const QStyleOptionViewItem & option,
 
 namespace QDirStat
 {
+    /**
+     * Paint the bar itself (without any indentation) into 'painter' with
+     * the upper left corner at 0, 0. This is what ends up in the pixmap
+     * cache.
+     **/
+    static void paintPercentBarSprite( QPainter *     painter,
+				       int	      w,
+				       int	      h,
+				       int	      fillWidth,
+				       const QColor & fillColor,
+				       const QColor & barBackground,
+				       const QColor & background )
+    {
+	int penWidth = 2;
+	int x = 0;
+	int y = 0;
+
+	QPen pen( painter->pen() );
+	pen.setWidth( 0 );
+	painter->setPen( pen );
+	painter->setBrush( Qt::NoBrush );
+
+
+	// Fill bar background.
+
+	painter->fillRect( x + penWidth, y + penWidth,
+			   w - 2 * penWidth + 1, h - 2 * penWidth + 1,
+			   barBackground );
+	/*
+	 * Notice: The Xlib XDrawRectangle() function always fills one
+	 * pixel less than specified. Although this is very likely just a
+	 * plain old bug, it is documented that way. Obviously, Qt just
+	 * maps the fillRect() call directly to XDrawRectangle() so they
+	 * inherited that bug (although the Qt doc stays silent about
+	 * it). So it is really necessary to compensate for that missing
+	 * pixel in each dimension.
+	 *
+	 * If you don't believe it, see for yourself.
+	 * Hint: Try the xmag program to zoom into the drawn pixels.
+	 **/
+
+	// Fill the desired percentage.
+
+	painter->fillRect( x + penWidth, y + penWidth,
+			   fillWidth+1, h - 2 * penWidth+1,
+			   fillColor );
+
+
+	// Draw 3D shadows.
+
+	pen.setColor( contrastingColor ( Qt::black, background ) );
+	painter->setPen( pen );
+	painter->drawLine( x, y, x+w, y );
+	painter->drawLine( x, y, x, y+h );
+
+	pen.setColor( contrastingColor( barBackground.darker(), background ) );
+	painter->setPen( pen );
+	painter->drawLine( x+1, y+1, x+w-1, y+1 );
+	painter->drawLine( x+1, y+1, x+1, y+h-1 );
+
+	pen.setColor( contrastingColor( barBackground.lighter(), background ) );
+	painter->setPen( pen );
+	painter->drawLine( x+1, y+h, x+w, y+h );
+	painter->drawLine( x+w, y, x+w, y+h );
+
+	pen.setColor( contrastingColor( Qt::white, background ) );
+	painter->setPen( pen );
+	painter->drawLine( x+2, y+h-1, x+w-1, y+h-1 );
+	painter->drawLine( x+w-1, y+1, x+w-1, y+h-1 );
+    }
+
+
     void paintPercentBar( float		 percent,
 			  QPainter *	 painter,
 			  int		 indentPixel,
@@ -208,7 +283,6 @@ namespace QDirStat
 	int y = cellRect.y() + extraMargin;
 	int w = cellRect.width() - 2 * itemMargin;
 	int h = cellRect.height() - 2 * extraMargin;
-	int fillWidth;
 
 	painter->eraseRect( cellRect );
 	w -= indentPixel;
@@ -216,61 +290,52 @@ namespace QDirStat
 
 	if ( w > 0 )
 	{
-	    QPen pen( painter->pen() );
-	    pen.setWidth( 0 );
-	    painter->setPen( pen );
-	    painter->setBrush( Qt::NoBrush );
-	    fillWidth = (int) ( ( w - 2 * penWidth ) * percent / 100.0);
+	    int fillWidth = (int) ( ( w - 2 * penWidth ) * percent / 100.0);
+	    QColor background = painter->background().color();
 
+	    // There are only so many different bars in a tree view: They only
+	    // differ in size, fill level (in pixels) and color. So they are
+	    // rendered only once, and after that they are simply copied from
+	    // the pixmap cache which is a lot faster than drawing them again
+	    // and again while scrolling or while the tree is being read.
+	    //
+	    // On a high-DPI screen, the sprite needs as many device pixels as
+	    // the bar covers there, or it would be scaled up and blurred.
 
-	    // Fill bar background.
+	    qreal dpr = 1.0;
 
-	    painter->fillRect( x + penWidth, y + penWidth,
-			       w - 2 * penWidth + 1, h - 2 * penWidth + 1,
-			       barBackground );
-	    /*
-	     * Notice: The Xlib XDrawRectangle() function always fills one
-	     * pixel less than specified. Although this is very likely just a
-	     * plain old bug, it is documented that way. Obviously, Qt just
-	     * maps the fillRect() call directly to XDrawRectangle() so they
-	     * inherited that bug (although the Qt doc stays silent about
-	     * it). So it is really necessary to compensate for that missing
-	     * pixel in each dimension.
-	     *
-	     * If you don't believe it, see for yourself.
-	     * Hint: Try the xmag program to zoom into the drawn pixels.
-	     **/
+#if (QT_VERSION >= QT_VERSION_CHECK( 5, 6, 0 ))
+	    if ( painter->device() )
+		dpr = painter->device()->devicePixelRatioF();
+#endif
 
-	    // Fill the desired percentage.
+	    QString key = QString( "PercentBar-%1x%2-%3-%4-%5-%6-%7" )
+		.arg( w ).arg( h ).arg( fillWidth )
+		.arg( fillColor.rgba() )
+		.arg( barBackground.rgba() )
+		.arg( background.rgba() )
+		.arg( dpr );
 
-	    painter->fillRect( x + penWidth, y + penWidth,
-			       fillWidth+1, h - 2 * penWidth+1,
-			       fillColor );
+	    QPixmap sprite;
 
+	    if ( ! QPixmapCache::find( key, &sprite ) )
+	    {
+		sprite = QPixmap( qCeil( ( w + 1 ) * dpr ), qCeil( ( h + 1 ) * dpr ) );
 
-	    // Draw 3D shadows.
+#if (QT_VERSION >= QT_VERSION_CHECK( 5, 6, 0 ))
+		sprite.setDevicePixelRatio( dpr );
+#endif
+		sprite.fill( background );
 
-	    QColor background = painter->background().color();
+		QPainter spritePainter( &sprite );
+		paintPercentBarSprite( &spritePainter, w, h, fillWidth,
+				       fillColor, barBackground, background );
+		spritePainter.end();
+
+		QPixmapCache::insert( key, sprite );
+	    }
 
-	    pen.setColor( contrastingColor ( Qt::black, background ) );
-	    painter->setPen( pen );
-	    painter->drawLine( x, y, x+w, y );
-	    painter->drawLine( x, y, x, y+h );
-
-	    pen.setColor( contrastingColor( barBackground.darker(), background ) );
-	    painter->setPen( pen );
-	    painter->drawLine( x+1, y+1, x+w-1, y+1 );
-	    painter->drawLine( x+1, y+1, x+1, y+h-1 );
-
-	    pen.setColor( contrastingColor( barBackground.lighter(), background ) );
-	    painter->setPen( pen );
-	    painter->drawLine( x+1, y+h, x+w, y+h );
-	    painter->drawLine( x+w, y, x+w, y+h );
-
-	    pen.setColor( contrastingColor( Qt::white, background ) );
-	    painter->setPen( pen );
-	    painter->drawLine( x+2, y+h-1, x+w-1, y+h-1 );
-	    painter->drawLine( x+w-1, y+1, x+w-1, y+h-1 );
+	    painter->drawPixmap( x, y, sprite );
 	}
     }
 
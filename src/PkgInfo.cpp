@@ -28,8 +28,10 @@ PkgInfo::PkgInfo( const QString & name,
     _version( version ),
     _arch( arch ),
     _pkgManager( pkgManager ),
+    _dbSize( 0 ),
     _multiVersion( false ),
-    _multiArch( false )
+    _multiArch( false ),
+    _lazy( false )
 {
     // logDebug() << "Creating " << this << endl;
 }
@@ -47,8 +49,10 @@ PkgInfo::PkgInfo( DirTree *       tree,
              0 ), // mtime
     _baseName( name ),
     _pkgManager( pkgManager ),
+    _dbSize( 0 ),
     _multiVersion( false ),
-    _multiArch( false )
+    _multiArch( false ),
+    _lazy( false )
 {
     // logDebug() << "Creating " << this << endl;
 }
@@ -60,6 +64,28 @@ PkgInfo::~PkgInfo()
 }
 
 
+void PkgInfo::setLazy( bool lazy )
+{
+    FileSize size = lazy ? _dbSize : 0;
+
+    _lazy          = lazy;
+    _size          = size;
+    _allocatedSize = size;
+    _blocks        = size / 512;
+
+    if ( lazy )
+        setReadState( DirOnRequestOnly );
+
+    markAsDirty();
+}
+
+
+QString PkgInfo::sizePrefix() const
+{
+    return _lazy ? "~" : DirInfo::sizePrefix();
+}
+
+
 QString PkgInfo::url() const
 {
     QString name = _name;
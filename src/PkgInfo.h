@@ -105,6 +105,33 @@ namespace QDirStat
          **/
         void setMultiVersion( bool val ) { _multiVersion = val; }
 
+        /**
+         * Return the installed size of this package according to the
+         * package database (0 if unknown). This is only an estimate: It
+         * does not include files that were created after the installation,
+         * and it may count files that are shared with other packages.
+         **/
+        FileSize dbSize() const { return _dbSize; }
+
+        /**
+         * Set the installed size from the package database.
+         **/
+        void setDbSize( FileSize size ) { _dbSize = size; }
+
+        /**
+         * Return 'true' if the file list of this package is not read yet,
+         * and its size is only the one from the package database.
+         **/
+        bool isLazy() const { return _lazy; }
+
+        /**
+         * Set or clear the lazy flag: A lazy package has no children; it
+         * uses dbSize() as its own size until its file list is read, and it
+         * has read state DirOnRequestOnly until then. Clearing the flag
+         * resets the size to 0 so only the files count.
+         **/
+        void setLazy( bool lazy );
+
         /**
          * Returns true if this is a PkgInfo object.
          *
@@ -120,6 +147,14 @@ namespace QDirStat
 	 **/
 	virtual QString url() const Q_DECL_OVERRIDE;
 
+        /**
+         * Returns "~" for a lazy package since its size is only the estimate
+         * from the package database.
+         *
+         * Reimplemented - inherited from DirInfo.
+         **/
+        virtual QString sizePrefix() const Q_DECL_OVERRIDE;
+
         /**
          * Return 'true' if this is a package URL, i.e. it starts with "Pkg:".
          **/
@@ -159,9 +194,11 @@ namespace QDirStat
         QString      _version;
         QString      _arch;
         PkgManager * _pkgManager;
+        FileSize     _dbSize;
 
         bool         _multiVersion :1;
         bool         _multiArch    :1;
+        bool         _lazy         :1;
 
     };  // class PkgInfo
 
@@ -137,6 +137,13 @@ namespace QDirStat
 	 **/
 	virtual bool supportsFileList() { return false; }
 
+	/**
+	 * Return 'true' if fileList() reads the package database directly
+	 * instead of starting an external command, so it is cheap enough to
+	 * simply call it for one package after the other.
+	 **/
+	virtual bool supportsDirectFileList() { return false; }
+
 	/**
 	 * Return the command for getting the list of files and directories
 	 * owned by a package.
@@ -25,7 +25,8 @@ bool PkgReader::_verboseMissingPkgFiles = false;
 PkgReader::PkgReader( DirTree * tree ):
     _tree( tree ),
     _maxParallelProcesses( 6 ),
-    _minCachePkgListSize( 200 )
+    _minCachePkgListSize( 200 ),
+    _lazyRead( false )
 {
     // logInfo() << endl;
     readSettings();
@@ -55,18 +56,18 @@ void PkgReader::read( const PkgFilter & filter )
     }
 
     handleMultiPkg();
-    addPkgToTree();
+    addPkgToTree( _lazyRead );
 
-    PkgManager * pkgManager = PkgQuery::primaryPkgManager();
-
-    if ( pkgManager && pkgManager->supportsFileListCache() &&
-	 _pkgList.size() >= _minCachePkgListSize )
+    if ( _lazyRead )
     {
-	createCachePkgReadJobs();
+	// The file lists are read only when a package is expanded, selected
+	// or visible in the treemap, so the tree is complete for now.
+
+	_tree->sendFinished();
     }
     else
     {
-	createAsyncPkgReadJobs();
+	createReadJobs();
     }
 
     // Ownership of the PkgInfo * items in _pkgList was transferred to the
@@ -77,6 +78,36 @@ void PkgReader::read( const PkgFilter & filter )
 }
 
 
+void PkgReader::readFileLists( const PkgInfoList & pkgList )
+{
+    logInfo() << "Reading the file lists of " << pkgList.size() << " packages" << endl;
+
+    _pkgList = pkgList;
+    createReadJobs();
+    _pkgList.clear();
+}
+
+
+void PkgReader::createReadJobs()
+{
+    PkgManager * pkgManager = PkgQuery::primaryPkgManager();
+
+    if ( pkgManager && pkgManager->supportsFileListCache() &&
+	 _pkgList.size() >= _minCachePkgListSize )
+    {
+	createCachePkgReadJobs();
+    }
+    else if ( pkgManager && pkgManager->supportsDirectFileList() )
+    {
+	createPkgReadJobs();
+    }
+    else
+    {
+	createAsyncPkgReadJobs();
+    }
+}
+
+
 void PkgReader::filterPkgList( const PkgFilter & filter )
 {
     if ( filter.filterMode() == PkgFilter::SelectAll )
@@ -164,7 +195,7 @@ void PkgReader::createDisplayName( const QString & pkgName )
 }
 
 
-void PkgReader::addPkgToTree()
+void PkgReader::addPkgToTree( bool lazy )
 {
     CHECK_PTR( _tree );
     CHECK_PTR( _tree->root() );
@@ -176,6 +207,10 @@ void PkgReader::addPkgToTree()
     foreach ( PkgInfo * pkg, _pkgList )
     {
 	pkg->setTree( _tree );
+
+	if ( lazy )
+	    pkg->setLazy( true );
+
 	top->insertChild( pkg );
     }
 
@@ -208,6 +243,17 @@ void PkgReader::createCachePkgReadJobs()
 }
 
 
+void PkgReader::createPkgReadJobs()
+{
+    foreach ( PkgInfo * pkg, _pkgList )
+    {
+	PkgReadJob * job = new PkgReadJob( _tree, pkg );
+	CHECK_NEW( job );
+	_tree->addJob( job );
+    }
+}
+
+
 void PkgReader::createAsyncPkgReadJobs()
 {
     logDebug() << endl;
@@ -273,6 +319,7 @@ void PkgReader::readSettings()
     _maxParallelProcesses   = settings.value( "MaxParallelProcesses"  ,  6    ).toInt();
     _minCachePkgListSize    = settings.value( "MinCachePkgListSize"   , 200   ).toInt();
     _verboseMissingPkgFiles = settings.value( "VerboseMissingPkgFiles", false ).toBool();
+    _lazyRead               = settings.value( "LazyRead"              , false ).toBool();
 
     settings.endGroup();
 }
@@ -286,6 +333,7 @@ void PkgReader::writeSettings()
     settings.setValue( "MaxParallelProcesses"  , _maxParallelProcesses   );
     settings.setValue( "MinCachePkgListSize"   , _minCachePkgListSize    );
     settings.setValue( "VerboseMissingPkgFiles", _verboseMissingPkgFiles );
+    settings.setValue( "LazyRead"              , _lazyRead               );
 
     settings.endGroup();
 }
@@ -351,6 +399,12 @@ void PkgReadJob::startReading()
 
     _pkg->setReadState( DirReading );
 
+    // Only the files count from now on, not the size from the package
+    // database.
+
+    if ( _pkg->isLazy() )
+	_pkg->setLazy( false );
+
     foreach ( const QString & path, fileList() )
     {
 	addFile( path );
@@ -60,6 +60,14 @@ namespace QDirStat
 	 **/
 	void read( const PkgFilter & filter );
 
+	/**
+	 * Create a PkgReadJob for each package of 'pkgList' that is already
+	 * in the tree to read its file list. This is used for packages that
+	 * were added lazily by read(), i.e. only with their size from the
+	 * package database.
+	 **/
+	void readFileLists( const PkgInfoList & pkgList );
+
 	/**
 	 * Read parameters from the settings file.
 	 **/
@@ -103,9 +111,16 @@ namespace QDirStat
 	void createDisplayName( const QString & pkgName );
 
 	/**
-	 * Add the packages to the DirTree.
+	 * Add the packages to the DirTree. If 'lazy' is 'true', they get their
+	 * size from the package database, and their file list is not read.
 	 **/
-	void addPkgToTree();
+	void addPkgToTree( bool lazy );
+
+	/**
+	 * Create the read jobs for the file lists of all packages in
+	 * _pkgList.
+	 **/
+	void createReadJobs();
 
         /**
          * Create a read job for each package to read its file list from a file
@@ -113,6 +128,14 @@ namespace QDirStat
          **/
         void createCachePkgReadJobs();
 
+        /**
+         * Create a simple read job for each package that gets its file list
+         * directly from the package manager and add it to the read job queue.
+         * This is for package managers that don't need an external command
+         * for that (see PkgManager::supportsDirectFileList()).
+         **/
+        void createPkgReadJobs();
+
         /**
          * Create a read job for each package with a background process to read
          * its file list and add it as a blocked job to the read job queue.
@@ -133,6 +156,7 @@ namespace QDirStat
 	QMultiMap<QString, PkgInfo *>	_multiPkg;
         int                             _maxParallelProcesses;
         int                             _minCachePkgListSize;
+        bool                            _lazyRead;
         static bool                     _verboseMissingPkgFiles;
 
     };	// class PkgReader
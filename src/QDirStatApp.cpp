@@ -17,6 +17,10 @@
 #include "SelectionModel.h"
 #include "CleanupCollection.h"
 #include "BookmarksManager.h"
+#include "QueryServer.h"
+#include "GrowthHistory.h"
+#include "CompressionAnalyzer.h"
+#include "ContentSniffer.h"
 #include "MainWindow.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -77,6 +81,19 @@ QDirStatApp::QDirStatApp()
 
     _bookmarksManager = new BookmarksManager();
     CHECK_NEW( _bookmarksManager );
+
+    _queryServer = new QueryServer( dirTree() );
+    CHECK_NEW( _queryServer );
+
+    GrowthHistory::instance()->setTree( dirTree() );
+
+    CompressionAnalyzer * compressionAnalyzer = CompressionAnalyzer::instance();
+    compressionAnalyzer->setTree( dirTree() );
+
+    connect( compressionAnalyzer, SIGNAL( dirChanged	    ( DirInfo * ) ),
+	     _dirTreeModel,	  SLOT  ( compressionChanged( DirInfo * ) ) );
+
+    ContentSniffer::instance()->setTree( dirTree() );
 }
 
 
@@ -84,6 +101,10 @@ QDirStatApp::~QDirStatApp()
 {
     // logDebug() << "Destroying app" << endl;
 
+    CompressionAnalyzer::instance()->setTree( 0 );
+    ContentSniffer::instance()->setTree( 0 );
+
+    delete _queryServer;
     delete _bookmarksManager;
     delete _cleanupCollection;
     delete _selectionModel;
@@ -20,6 +20,7 @@ namespace QDirStat
     class SelectionModel;
     class CleanupCollection;
     class BookmarksManager;
+    class QueryServer;
     class QDirStatApp;
     class FileInfo;
 
@@ -133,6 +134,13 @@ namespace QDirStat
          **/
         BookmarksManager * bookmarksManager() const { return _bookmarksManager; }
 
+        /**
+         * Return the QueryServer that answers queries about the tree from
+         * other processes over a local socket. It only listens if a socket
+         * path is configured.
+         **/
+        QueryServer * queryServer() const { return _queryServer; }
+
 
         //
         // Convenience methods
@@ -193,6 +201,7 @@ namespace QDirStat
         SelectionModel          * _selectionModel;
         CleanupCollection       * _cleanupCollection;
         BookmarksManager        * _bookmarksManager;
+        QueryServer             * _queryServer;
 
         static QDirStatApp      * _instance;
 
@@ -0,0 +1,434 @@
+/*
+ *   File name: QueryServer.cpp
+ *   Summary:	Local socket for queries about the directory tree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <algorithm>
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPair>
+#include <QVector>
+#include <QThreadPool>
+
+#include "QueryServer.h"
+#include "DirTree.h"
+#include "FileInfo.h"
+#include "FileInfoIterator.h"
+#include "FileTypeStats.h"
+#include "MimeCategory.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Maximum length of a request line. A client that sends more than that
+// without a newline is disconnected.
+#define MAX_REQUEST_LENGTH	4096
+
+// Timeout for finding out if another instance is listening on the socket
+#define PROBE_TIMEOUT_MILLISEC	1000
+
+
+using namespace QDirStat;
+
+
+static bool sizeGreaterThan( FileInfo * a, FileInfo * b )
+{
+    return a->totalSize() > b->totalSize();
+}
+
+
+QueryServer::QueryServer( DirTree * tree, QObject * parent ):
+    QObject( parent ),
+    _tree( tree ),
+    _server( 0 ),
+    _nextRequestId( 0 )
+{
+    readSettings();
+
+    if ( ! _socketPath.isEmpty() )
+	listen( _socketPath );
+}
+
+
+QueryServer::~QueryServer()
+{
+    writeSettings();
+
+    if ( _server )
+    {
+	_server->close();
+	delete _server;
+    }
+}
+
+
+void QueryServer::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "QueryServer" );
+    _socketPath = settings.value( "SocketPath", "" ).toString();
+    settings.endGroup();
+}
+
+
+void QueryServer::writeSettings()
+{
+    Settings settings;
+    settings.beginGroup( "QueryServer" );
+
+    // This is only set if not already in the settings (it is an expert
+    // setting that is only changed manually in the settings file).
+    settings.setDefaultValue( "SocketPath", _socketPath );
+
+    settings.endGroup();
+}
+
+
+bool QueryServer::listen( const QString & socketPath )
+{
+    if ( ! _server )
+    {
+	_server = new QLocalServer( this );
+	CHECK_NEW( _server );
+
+#if (QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 ))
+	// Only the same user may connect
+	_server->setSocketOptions( QLocalServer::UserAccessOption );
+#endif
+
+	connect( _server, SIGNAL( newConnection() ),
+		 this,	  SLOT	( newConnection() ) );
+    }
+
+    // Remove a leftover socket from a previous instance that crashed, but
+    // not the one of another instance that is still running
+
+    QLocalSocket probe;
+    probe.connectToServer( socketPath );
+
+    if ( probe.waitForConnected( PROBE_TIMEOUT_MILLISEC ) )
+    {
+	probe.disconnectFromServer();
+	logError() << "Another instance is already listening on " << socketPath << endl;
+
+	return false;
+    }
+
+    if ( probe.error() == QLocalSocket::ConnectionRefusedError )
+	QLocalServer::removeServer( socketPath );	// Nobody is listening there
+
+    if ( ! _server->listen( socketPath ) )
+    {
+	logError() << "Can't listen on " << socketPath << ": "
+		   << _server->errorString() << endl;
+	return false;
+    }
+
+    logInfo() << "Listening for queries on " << socketPath << endl;
+
+    return true;
+}
+
+
+bool QueryServer::isListening() const
+{
+    return _server && _server->isListening();
+}
+
+
+void QueryServer::newConnection()
+{
+    while ( _server->hasPendingConnections() )
+    {
+	QLocalSocket * socket = _server->nextPendingConnection();
+
+	connect( socket, SIGNAL( readyRead()	),
+		 this,	 SLOT  ( readRequests() ) );
+
+	connect( socket, SIGNAL( disconnected() ),
+		 socket, SLOT  ( deleteLater()	) );
+    }
+}
+
+
+void QueryServer::readRequests()
+{
+    processRequests( qobject_cast<QLocalSocket *>( sender() ) );
+}
+
+
+void QueryServer::processRequests( QLocalSocket * socket )
+{
+    if ( ! socket )
+	return;
+
+    // Only one request at a time for each client, so it gets the replies
+    // in the right order
+
+    while ( ! isWaiting( socket ) && socket->canReadLine() )
+    {
+	QString request = QString::fromUtf8( socket->readLine() );
+
+	if ( request.endsWith( '\n' ) )
+	    request.chop( 1 );
+
+	QString reply = query( request, socket );
+
+	if ( ! reply.isEmpty() )	// Otherwise a QueryJob will answer
+	    socket->write( ( reply + "\n" ).toUtf8() );
+    }
+
+    if ( socket->bytesAvailable() > MAX_REQUEST_LENGTH )
+    {
+	logWarning() << "Request too long - disconnecting client" << endl;
+	socket->disconnectFromServer();
+    }
+}
+
+
+bool QueryServer::isWaiting( QLocalSocket * socket ) const
+{
+    foreach ( const QPointer<QLocalSocket> & waiting, _pendingReplies )
+    {
+	if ( waiting == socket )
+	    return true;
+    }
+
+    return false;
+}
+
+
+void QueryServer::queryFinished( int requestId, const QString & reply )
+{
+    QPointer<QLocalSocket> socket = _pendingReplies.take( requestId );
+
+    if ( ! socket )	// The client is gone
+	return;
+
+    socket->write( ( reply + "\n" ).toUtf8() );
+    processRequests( socket );
+}
+
+
+QString QueryServer::query( const QString & request, QLocalSocket * socket )
+{
+    QString command = request.section( ' ', 0, 0 );
+    QString args    = request.section( ' ', 1 );
+
+    if ( command == "help" )
+    {
+	QStringList lines;
+	lines << "size <path>"
+	      << "top <n> <path>"
+	      << "categories <path>"
+	      << "help";
+
+	return okReply( lines );
+    }
+
+    if ( command != "size" && command != "top" && command != "categories" )
+	return errorReply( QString( "Unknown command \"%1\"" ).arg( command ) );
+
+    if ( ! _tree || ! _tree->firstToplevel() )
+	return errorReply( "No tree" );
+
+    if ( _tree->isBusy() )
+	return errorReply( "Tree is being read" );
+
+    int count = 0;
+
+    if ( command == "top" )
+    {
+	bool ok = true;
+	count = args.section( ' ', 0, 0 ).toInt( &ok );
+
+	if ( ! ok || count < 1 )
+	    return errorReply( "Usage: top <n> <path>" );
+
+	args = args.section( ' ', 1 );
+    }
+
+    FileInfo * item = locate( args );
+
+    if ( ! item )
+	return errorReply( QString( "Not found: %1" ).arg( args ) );
+
+    if ( command == "size" )
+	return sizeReply( item );
+
+    // "top" only looks at the direct children of 'item', so it is cheaper
+    // to answer right here than to freeze the tree for a snapshot.
+
+    if ( command == "top" )
+	return topReply( item, count );
+
+    if ( ! socket )
+	return categoriesReply( item );
+
+    // Go through the subtree in another thread; the snapshot keeps the tree
+    // unchanged until the job is done.
+
+    int requestId = _nextRequestId++;
+    QueryJob * job = new QueryJob( requestId, _tree->snapshot( item ) );
+    CHECK_NEW( job );
+
+    connect( job,  SIGNAL( finished	( int, QString ) ),
+	     this, SLOT	 ( queryFinished( int, QString ) ),
+	     Qt::QueuedConnection );
+
+    _pendingReplies.insert( requestId, socket );
+    QThreadPool::globalInstance()->start( job ); // The pool deletes the job
+
+    return QString();
+}
+
+
+FileInfo * QueryServer::locate( QString path ) const
+{
+    if ( path.isEmpty() )
+	return 0;
+
+    if ( path.length() > 1 && path.endsWith( "/" ) )
+	path.chop( 1 );
+
+    return _tree->locate( path,
+			  true ); // findPseudoDirs
+}
+
+
+QString QueryServer::sizeReply( FileInfo * item ) const
+{
+    QString line = QString( "path=%1\tsize=%2\tallocated=%3\titems=%4\tfiles=%5\tdirs=%6\tmtime=%7" )
+	.arg( item->url() )
+	.arg( item->totalSize() )
+	.arg( item->totalAllocatedSize() )
+	.arg( item->totalItems() )
+	.arg( item->totalFiles() )
+	.arg( item->totalSubDirs() )
+	.arg( (qulonglong) item->latestMtime() );
+
+    return okReply( QStringList() << line );
+}
+
+
+QString QueryServer::topReply( FileInfo * item, int count )
+{
+    QVector<FileInfo *> children;
+    FileInfoIterator it( item );
+
+    while ( *it )
+    {
+	FileInfo * child = *it;
+
+	if ( child->isDotEntry() )
+	{
+	    // List the files directly in this directory, not their <Files>
+	    // pseudo directory
+
+	    for ( FileInfo * file = child->firstChild(); file; file = file->next() )
+		children << file;
+	}
+	else if ( ! child->isAttic() )
+	{
+	    children << child;
+	}
+
+	++it;
+    }
+
+    count = qMin( count, children.size() );
+    std::partial_sort( children.begin(), children.begin() + count, children.end(),
+		       sizeGreaterThan );
+
+    QStringList lines;
+
+    for ( int i = 0; i < count; ++i )
+    {
+	FileInfo * child = children.at( i );
+	lines << QString( "%1\t%2" ).arg( child->totalSize() ).arg( child->name() );
+    }
+
+    return okReply( lines );
+}
+
+
+QString QueryServer::categoriesReply( FileInfo * item )
+{
+    FileTypeStats stats;
+    stats.calc( item );
+
+    QList<QPair<FileSize, QString> > sums;
+
+    for ( CategoryFileSizeMapIterator it = stats.categorySumBegin();
+	  it != stats.categorySumEnd();
+	  ++it )
+    {
+	MimeCategory * category = it.key();
+	QString line = QString( "%1\t%2\t%3" )
+	    .arg( category->name() )
+	    .arg( stats.categoryCount( category ) )
+	    .arg( it.value() );
+
+	sums << qMakePair( it.value(), line );
+    }
+
+    std::sort( sums.begin(), sums.end() );
+    QStringList lines;
+
+    for ( int i = sums.size() - 1; i >= 0; --i ) // Largest first
+	lines << sums.at( i ).second;
+
+    return okReply( lines );
+}
+
+
+QString QueryServer::okReply( const QStringList & lines )
+{
+    QString reply = QString( "OK %1" ).arg( lines.size() );
+
+    foreach ( const QString & line, lines )
+	reply += "\n" + line;
+
+    return reply;
+}
+
+
+QString QueryServer::errorReply( const QString & message )
+{
+    return "ERR " + message;
+}
+
+
+
+
+QueryJob::QueryJob( int		    requestId,
+		    TreeSnapshotPtr snapshot ):
+    QObject(),
+    QRunnable(),
+    _requestId( requestId ),
+    _snapshot( snapshot )
+{
+
+}
+
+
+void QueryJob::run()
+{
+    QString reply;
+
+    if ( ! _snapshot || _snapshot->isCancelled() )
+	reply = QueryServer::errorReply( "Tree was cleared" );
+    else
+	reply = QueryServer::categoriesReply( _snapshot->subtree() );
+
+    // Thaw the tree as soon as possible
+
+    _snapshot.clear();
+
+    emit finished( _requestId, reply );
+}
@@ -0,0 +1,239 @@
+/*
+ *   File name: QueryServer.h
+ *   Summary:	Local socket for queries about the directory tree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+#ifndef QueryServer_h
+#define QueryServer_h
+
+
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QPointer>
+#include <QLocalSocket>
+
+#include "TreeSnapshot.h"
+
+class QLocalServer;
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class FileInfo;
+
+    /**
+     * Unix domain socket server that answers queries about the tree of a
+     * running QDirStat, e.g. for monitoring scripts. All answers come
+     * directly from the in-memory DirTree, so nothing needs to be read
+     * from disk again.
+     *
+     * This is disabled by default; it is only started if a socket path is
+     * configured ("SocketPath" in the "QueryServer" settings group).
+     *
+     * The protocol is line-based: Each request is one line with a command
+     * and its arguments; the last argument is always a path which may
+     * contain blanks.
+     *
+     *	   size <path>
+     *	   top <n> <path>
+     *	   categories <path>
+     *	   help
+     *
+     * The first line of each reply is either
+     *
+     *	   OK <lines>
+     *
+     * followed by that number of lines with the result, or
+     *
+     *	   ERR <message>
+     *
+     * Result lines consist of tab-separated fields. Sizes are in bytes,
+     * times in seconds since the epoch.
+     *
+     * Requests are read in the main thread's event loop, one line at a
+     * time as it arrives, so the GUI never waits for a client. "size" and
+     * "top" only need the item itself and its direct children, so they are
+     * answered right away. "categories" needs to go through the whole
+     * subtree; it is answered by a QueryJob in another thread from a
+     * snapshot of the tree. Each client gets its replies in the order of
+     * its requests.
+     **/
+    class QueryServer: public QObject
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor. This reads the settings and starts listening if a
+	 * socket path is configured.
+	 **/
+	QueryServer( DirTree * tree, QObject * parent = 0 );
+
+	/**
+	 * Destructor. This removes the socket.
+	 **/
+	virtual ~QueryServer();
+
+	/**
+	 * Start listening on the Unix domain socket 'socketPath'. Return
+	 * 'true' if success, 'false' if error.
+	 **/
+	bool listen( const QString & socketPath );
+
+	/**
+	 * Return 'true' if the server is listening.
+	 **/
+	bool isListening() const;
+
+	/**
+	 * Answer one request line and return the reply (without the final
+	 * newline).
+	 *
+	 * If 'socket' is non-null, requests that go through a subtree are
+	 * answered in another thread: This returns an empty string, and the
+	 * reply is written to 'socket' when it is ready.
+	 **/
+	QString query( const QString & request, QLocalSocket * socket = 0 );
+
+
+    protected slots:
+
+	/**
+	 * Accept all pending new connections.
+	 **/
+	void newConnection();
+
+	/**
+	 * Read and answer all complete lines from the client socket that
+	 * sent this signal.
+	 **/
+	void readRequests();
+
+	/**
+	 * A QueryJob is finished: Send its reply to the client that is
+	 * waiting for it and continue with that client's next requests.
+	 **/
+	void queryFinished( int requestId, const QString & reply );
+
+
+    protected:
+
+	/**
+	 * Read parameters from the settings file.
+	 **/
+	void readSettings();
+
+	/**
+	 * Write parameters to the settings file.
+	 **/
+	void writeSettings();
+
+	/**
+	 * Answer all complete request lines from 'socket' until one of them
+	 * is answered in another thread.
+	 **/
+	void processRequests( QLocalSocket * socket );
+
+	/**
+	 * Return 'true' if 'socket' is waiting for the reply of a QueryJob.
+	 **/
+	bool isWaiting( QLocalSocket * socket ) const;
+
+	/**
+	 * Locate 'path' in the tree. Return 0 if there is no such item.
+	 **/
+	FileInfo * locate( QString path ) const;
+
+	/**
+	 * Return the reply for the 'size' command.
+	 **/
+	QString sizeReply( FileInfo * item ) const;
+
+	/**
+	 * Return the reply for the 'top' command. This only looks at the
+	 * direct children of 'item'.
+	 **/
+	static QString topReply( FileInfo * item, int count );
+
+	/**
+	 * Return the reply for the 'categories' command. This may be called
+	 * in any thread while the tree is frozen.
+	 **/
+	static QString categoriesReply( FileInfo * item );
+
+	/**
+	 * Return an OK reply with 'lines'.
+	 **/
+	static QString okReply( const QStringList & lines );
+
+	/**
+	 * Return an error reply with 'message'.
+	 **/
+	static QString errorReply( const QString & message );
+
+
+	//
+	// Data members
+	//
+
+	DirTree *	_tree;
+	QLocalServer *	_server;
+	QString		_socketPath;
+	int		_nextRequestId;
+
+	QHash<int, QPointer<QLocalSocket> > _pendingReplies;
+
+
+	friend class QueryJob;
+
+    };	// class QueryServer
+
+
+
+    /**
+     * Job for the global thread pool: Answer one "categories" request
+     * from a snapshot of the tree.
+     **/
+    class QueryJob: public QObject, public QRunnable
+    {
+	Q_OBJECT
+
+    public:
+
+	/**
+	 * Constructor. 'snapshot' is a snapshot of the subtree the request
+	 * is about; it is released as soon as the reply is ready.
+	 **/
+	QueryJob( int		  requestId,
+		  TreeSnapshotPtr snapshot );
+
+	/**
+	 * Answer the request and emit finished().
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+    signals:
+
+	/**
+	 * Emitted in the worker thread with the complete reply.
+	 **/
+	void finished( int requestId, const QString & reply );
+
+    protected:
+
+	int		_requestId;
+	TreeSnapshotPtr	_snapshot;
+
+    };	// class QueryJob
+
+}	// namespace QDirStat
+
+#endif	// QueryServer_h
@@ -29,7 +29,10 @@ using namespace QDirStat;
 
 
 RpmPkgManager::RpmPkgManager():
-    _getPkgListWarningSec( 7 )
+    _getPkgListWarningSec( 7 ),
+    _useSqliteDb( true ),
+    _sqliteDbChecked( false ),
+    _sqliteDb( 0 )
 {
     readSettings();
 
@@ -49,6 +52,12 @@ RpmPkgManager::RpmPkgManager():
 }
 
 
+RpmPkgManager::~RpmPkgManager()
+{
+    delete _sqliteDb;
+}
+
+
 bool RpmPkgManager::isPrimaryPkgManager()
 {
     return tryRunCommand( QString( "%1 -qf %1" ).arg( _rpmCommand ),
@@ -80,6 +89,11 @@ QString RpmPkgManager::owningPkg( const QString & path )
 
 PkgInfoList RpmPkgManager::installedPkg()
 {
+    PkgInfoList pkgList;
+
+    if ( installedPkgFromDb( pkgList ) )
+	return pkgList;
+
     int exitCode = -1;
     QElapsedTimer timer;
     timer.start();
@@ -88,15 +102,13 @@ PkgInfoList RpmPkgManager::installedPkg()
 				 QStringList()
 				 << "-qa"
 				 << "--queryformat"
-				 << "%{name} | %{version}-%{release} | %{arch}\n",
+				 << "%{name} | %{version}-%{release} | %{arch} | %{size}\n",
 				 &exitCode,
 				 LONG_CMD_TIMEOUT_SEC );
 
     if ( timer.hasExpired( _getPkgListWarningSec * 1000 ) )
 	rebuildRpmDbWarning();
 
-    PkgInfoList pkgList;
-
     if ( exitCode == 0 )
 	pkgList = parsePkgList( output );
 
@@ -114,19 +126,21 @@ PkgInfoList RpmPkgManager::parsePkgList( const QString & output )
 	{
 	    QStringList fields = line.split( " | ", QString::KeepEmptyParts );
 
-	    if ( fields.size() != 3 )
+	    if ( fields.size() != 4 )
 		logError() << "Invalid rpm -qa output: " << line << "\n" << endl;
 	    else
 	    {
 		QString name	= fields.takeFirst();
 		QString version = fields.takeFirst(); // includes release
 		QString arch	= fields.takeFirst();
+		QString size	= fields.takeFirst(); // bytes
 
 		if ( arch == "(none)" )
 		    arch = "";
 
 		PkgInfo * pkg = new PkgInfo( name, version, arch, this );
 		CHECK_NEW( pkg );
+		pkg->setDbSize( size.toLongLong() );
 
 		pkgList << pkg;
 	    }
@@ -137,6 +151,56 @@ PkgInfoList RpmPkgManager::parsePkgList( const QString & output )
 }
 
 
+bool RpmPkgManager::installedPkgFromDb( PkgInfoList & pkgList )
+{
+    if ( ! sqliteDb() )
+	return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    QList<RpmHeader> headers;
+
+    if ( ! _sqliteDb->readAll( headers, false ) ) // withFileLists
+	return false;
+
+    if ( headers.isEmpty() )
+    {
+	// Probably a stale database that rpm no longer uses: Don't use it
+	// for the file lists either.
+
+	logWarning() << "No packages in the RPM database - falling back to the rpm command" << endl;
+
+	delete _sqliteDb;
+	_sqliteDb = 0;
+
+	return false;
+    }
+
+    foreach ( const RpmHeader & header, headers )
+    {
+	PkgInfo * pkg = new PkgInfo( header.name, header.version, header.arch, this );
+	CHECK_NEW( pkg );
+	pkg->setDbSize( header.size );
+
+	pkgList << pkg;
+    }
+
+    logInfo() << "Read " << pkgList.size() << " packages from the RPM database in "
+	      << timer.elapsed() << " millisec" << endl;
+
+    return true;
+}
+
+
+QStringList RpmPkgManager::fileList( PkgInfo * pkg )
+{
+    if ( sqliteDb() )
+	return _sqliteDb->fileList( pkg->baseName(), pkg->version(), pkg->arch() );
+
+    return PkgManager::fileList( pkg );
+}
+
+
 QString RpmPkgManager::fileListCommand( PkgInfo * pkg )
 {
     return QString( "%1 -ql %2" )
@@ -174,6 +238,11 @@ QString RpmPkgManager::queryName( PkgInfo * pkg )
 
 PkgFileListCache * RpmPkgManager::createFileListCache( PkgFileListCache::LookupType lookupType )
 {
+    PkgFileListCache * cache = createFileListCacheFromDb( lookupType );
+
+    if ( cache )
+	return cache;
+
     int exitCode = -1;
     QString queryFormat = "[%{=NAME}-%{=VERSION}-%{=RELEASE}.%{=ARCH} | %{FILENAMES}\n]";
 
@@ -189,7 +258,7 @@ PkgFileListCache * RpmPkgManager::createFileListCache( PkgFileListCache::LookupT
     output.clear(); // Free all that text ASAP
     logDebug() << lines.size() << " output lines" << endl;
 
-    PkgFileListCache * cache = new PkgFileListCache( this, lookupType );
+    cache = new PkgFileListCache( this, lookupType );
     CHECK_NEW( cache );
 
     // Sample output:
@@ -225,17 +294,88 @@ PkgFileListCache * RpmPkgManager::createFileListCache( PkgFileListCache::LookupT
 }
 
 
+PkgFileListCache * RpmPkgManager::createFileListCacheFromDb( PkgFileListCache::LookupType lookupType )
+{
+    if ( ! sqliteDb() )
+	return 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    QList<RpmHeader> headers;
+
+    if ( ! _sqliteDb->readAll( headers, true ) ) // withFileLists
+	return 0;
+
+    PkgFileListCache * cache = new PkgFileListCache( this, lookupType );
+    CHECK_NEW( cache );
+
+    while ( ! headers.isEmpty() )
+    {
+	// Take each header out of the list right away to free its file list
+	// as soon as it is in the cache
+
+	RpmHeader header = headers.takeFirst();
+
+	// The same as queryName() and the "rpm -qa" query format above
+	QString pkgName = header.name + "-" + header.version;
+
+	if ( ! header.arch.isEmpty() )
+	    pkgName += "." + header.arch;
+
+	foreach ( const QString & path, header.fileList )
+	    cache->add( pkgName, path );
+    }
+
+    logDebug() << "file list cache from the RPM database finished after "
+	       << timer.elapsed() << " millisec" << endl;
+
+    return cache;
+}
+
+
+RpmSqliteDb * RpmPkgManager::sqliteDb()
+{
+    if ( ! _sqliteDbChecked )
+    {
+	_sqliteDbChecked = true;
+
+	if ( _useSqliteDb && RpmSqliteDb::isSupported() )
+	{
+	    QString dbPath = RpmSqliteDb::findDb();
+
+	    if ( ! dbPath.isEmpty() )
+	    {
+		_sqliteDb = new RpmSqliteDb();
+		CHECK_NEW( _sqliteDb );
+
+		if ( ! _sqliteDb->open( dbPath ) )
+		{
+		    logWarning() << "Falling back to the rpm command" << endl;
+
+		    delete _sqliteDb;
+		    _sqliteDb = 0;
+		}
+	    }
+	}
+    }
+
+    return _sqliteDb;
+}
+
+
 void RpmPkgManager::readSettings()
 {
     Settings settings;
     settings.beginGroup( "Pkg" );
-    _getPkgListWarningSec = settings.value( "GetRpmPkgListWarningSec", 7 ).toInt();
+    _getPkgListWarningSec = settings.value( "GetRpmPkgListWarningSec", 7    ).toInt();
+    _useSqliteDb          = settings.value( "UseRpmSqliteDb"         , true ).toBool();
 
     // Write the value right back to the settings if it isn't there already:
     // Since package manager objects are never really destroyed, this can't
     // reliably be done in the destructor.
 
     settings.setDefaultValue( "GetRpmPkgListWarningSec", _getPkgListWarningSec );
+    settings.setDefaultValue( "UseRpmSqliteDb"         , _useSqliteDb          );
     settings.endGroup();
 }
 
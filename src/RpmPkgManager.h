@@ -14,6 +14,7 @@
 
 #include "PkgManager.h"
 #include "PkgInfo.h"
+#include "RpmSqliteDb.h"
 
 
 namespace QDirStat
@@ -32,7 +33,7 @@ namespace QDirStat
     public:
 
 	RpmPkgManager();
-	virtual ~RpmPkgManager() {}
+	virtual ~RpmPkgManager();
 
 	/**
 	 * Return the name of this package manager.
@@ -100,6 +101,24 @@ namespace QDirStat
 	virtual bool supportsFileList() Q_DECL_OVERRIDE
 	    { return true; }
 
+	/**
+	 * Return 'true' if the file lists are read directly from the RPM
+	 * sqlite database, not with the rpm command.
+	 *
+	 * Reimplemented from PkgManager.
+	 **/
+	virtual bool supportsDirectFileList() Q_DECL_OVERRIDE
+	    { return sqliteDb() != 0; }
+
+	/**
+	 * Return the list of files and directories owned by a package. This
+	 * uses the RPM sqlite database if possible and the rpm command
+	 * otherwise.
+	 *
+	 * Reimplemented from PkgManager.
+	 **/
+	virtual QStringList fileList( PkgInfo * pkg ) Q_DECL_OVERRIDE;
+
 	/**
 	 * Return the command for getting the list of files and directories
 	 * owned by a package.
@@ -162,6 +181,25 @@ namespace QDirStat
 	 **/
 	PkgInfoList parsePkgList( const QString & output );
 
+	/**
+	 * Return the RPM sqlite database if it can be used or 0 if not (no
+	 * sqlite support, an old RPM database, disabled in the settings).
+	 * The database is opened upon the first call.
+	 **/
+	RpmSqliteDb * sqliteDb();
+
+	/**
+	 * Get the list of installed packages from the RPM sqlite database.
+	 * Return 'false' if that is not possible.
+	 **/
+	bool installedPkgFromDb( PkgInfoList & pkgList );
+
+	/**
+	 * Create a file list cache from the RPM sqlite database.
+	 * Return 0 if that is not possible.
+	 **/
+	PkgFileListCache * createFileListCacheFromDb( PkgFileListCache::LookupType lookupType );
+
 	/**
 	 * Show a warning that the RPM database should be rebuilt
 	 * ("sudo rpm --rebuilddb").
@@ -171,8 +209,11 @@ namespace QDirStat
 
 	// Data members
 
-	QString _rpmCommand;
-	int	_getPkgListWarningSec;
+	QString	      _rpmCommand;
+	int	      _getPkgListWarningSec;
+	bool	      _useSqliteDb;
+	bool	      _sqliteDbChecked;
+	RpmSqliteDb * _sqliteDb;
 
     }; // class RpmPkgManager
 
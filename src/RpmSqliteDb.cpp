@@ -0,0 +1,513 @@
+/*
+ *   File name: RpmSqliteDb.cpp
+ *   Summary:	Direct read access to the RPM sqlite database
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <string.h>	// memchr()
+
+#include <QFile>
+#include <QVector>
+
+#if HAVE_SQLITE
+#  include <sqlite3.h>
+#endif
+
+#include "RpmSqliteDb.h"
+#include "Logger.h"
+#include "Exception.h"
+
+
+// The tags and data types of an RPM header (see rpmtag.h in the rpm sources)
+
+#define RPMTAG_NAME		1000
+#define RPMTAG_VERSION		1001
+#define RPMTAG_RELEASE		1002
+#define RPMTAG_SIZE		1009
+#define RPMTAG_ARCH		1022
+#define RPMTAG_DIRINDEXES	1116
+#define RPMTAG_BASENAMES	1117
+#define RPMTAG_DIRNAMES		1118
+#define RPMTAG_LONGSIZE		5009
+
+#define RPM_INT32_TYPE		4
+#define RPM_INT64_TYPE		5
+#define RPM_STRING_TYPE		6
+#define RPM_STRING_ARRAY_TYPE	8
+#define RPM_I18NSTRING_TYPE	9
+
+// Sanity limits for the size of a header
+#define MAX_HEADER_TAGS		0xFFFF
+#define MAX_HEADER_DATA		( 256 * 1024 * 1024 )
+
+#define INDEX_ENTRY_SIZE	16
+
+// Wait this long if rpm is writing to the database at the same time
+#define BUSY_TIMEOUT_MILLISEC	5000
+
+
+using namespace QDirStat;
+
+
+/**
+ * Return the 32 bit big endian (network byte order) number at 'pos'.
+ **/
+static quint32 bigEndian32( const char * pos )
+{
+    const uchar * p = (const uchar *) pos;
+
+    return ( (quint32) p[0] << 24 ) | ( (quint32) p[1] << 16 ) |
+	   ( (quint32) p[2] <<  8 ) |   (quint32) p[3];
+}
+
+
+/**
+ * Return the 64 bit big endian (network byte order) number at 'pos'.
+ **/
+static quint64 bigEndian64( const char * pos )
+{
+    return ( (quint64) bigEndian32( pos ) << 32 ) | bigEndian32( pos + 4 );
+}
+
+
+namespace
+{
+    /**
+     * Accessor for the entries of a header blob. A header consists of:
+     *
+     *	 - the number of index entries (32 bit)
+     *	 - the size of the data area (32 bit)
+     *	 - the index entries, each with tag, type, offset and count (32 bit)
+     *	 - the data area that the offsets refer to
+     *
+     * All numbers are in big endian byte order. Anything that would go
+     * beyond the end of the blob is treated as missing.
+     **/
+    class HeaderBlob
+    {
+    public:
+
+	HeaderBlob( const char * blob, int size ):
+	    _index( 0 ),
+	    _indexCount( 0 ),
+	    _data( 0 ),
+	    _dataSize( 0 )
+	{
+	    if ( ! blob || size < 8 )
+		return;
+
+	    quint32 indexCount = bigEndian32( blob );
+	    quint32 dataSize   = bigEndian32( blob + 4 );
+
+	    if ( indexCount == 0 || indexCount > MAX_HEADER_TAGS || dataSize > MAX_HEADER_DATA )
+		return;
+
+	    if ( 8 + (qint64) indexCount * INDEX_ENTRY_SIZE + dataSize > (qint64) size )
+		return;
+
+	    _index	= blob + 8;
+	    _indexCount = indexCount;
+	    _data	= _index + indexCount * INDEX_ENTRY_SIZE;
+	    _dataSize	= dataSize;
+	}
+
+	bool isValid() const { return _index != 0; }
+
+	/**
+	 * Find the entry for 'tag'. Return 'true' if there is one and set
+	 * 'type', 'offset' and 'count'.
+	 **/
+	bool find( quint32 tag, quint32 & type, quint32 & offset, quint32 & count ) const
+	{
+	    for ( quint32 i = 0; i < _indexCount; ++i )
+	    {
+		const char * entry = _index + i * INDEX_ENTRY_SIZE;
+
+		if ( bigEndian32( entry ) == tag )
+		{
+		    type   = bigEndian32( entry +  4 );
+		    offset = bigEndian32( entry +  8 );
+		    count  = bigEndian32( entry + 12 );
+
+		    return offset < _dataSize;
+		}
+	    }
+
+	    return false;
+	}
+
+	/**
+	 * Return the string value of 'tag' or an empty string if there is
+	 * none.
+	 **/
+	QString string( quint32 tag ) const
+	{
+	    QStringList list = strings( tag, 1 );
+
+	    return list.isEmpty() ? QString() : list.first();
+	}
+
+	/**
+	 * Return the string array value of 'tag'.
+	 **/
+	QStringList stringArray( quint32 tag ) const
+	{
+	    return strings( tag, 0 );
+	}
+
+	/**
+	 * Return the numeric value of 'tag' (32 or 64 bit) or 0 if there is
+	 * none.
+	 **/
+	quint64 number( quint32 tag ) const
+	{
+	    quint32 type, offset, count;
+
+	    if ( ! find( tag, type, offset, count ) || count < 1 )
+		return 0;
+
+	    if ( type == RPM_INT64_TYPE && (qint64) offset + 8 <= _dataSize )
+		return bigEndian64( _data + offset );
+
+	    if ( type == RPM_INT32_TYPE && (qint64) offset + 4 <= _dataSize )
+		return bigEndian32( _data + offset );
+
+	    return 0;
+	}
+
+	/**
+	 * Return the 32 bit array value of 'tag'.
+	 **/
+	QVector<quint32> int32Array( quint32 tag ) const
+	{
+	    QVector<quint32> result;
+	    quint32 type, offset, count;
+
+	    if ( ! find( tag, type, offset, count ) || type != RPM_INT32_TYPE )
+		return result;
+
+	    if ( (qint64) offset + (qint64) count * 4 > _dataSize )
+		return result;
+
+	    result.reserve( count );
+
+	    for ( quint32 i = 0; i < count; ++i )
+		result << bigEndian32( _data + offset + i * 4 );
+
+	    return result;
+	}
+
+    protected:
+
+	/**
+	 * Return the strings of 'tag': 'maxCount' of them or all of them if
+	 * 'maxCount' is 0.
+	 **/
+	QStringList strings( quint32 tag, quint32 maxCount ) const
+	{
+	    QStringList result;
+	    quint32 type, offset, count;
+
+	    if ( ! find( tag, type, offset, count ) )
+		return result;
+
+	    if ( type != RPM_STRING_TYPE	  &&
+		 type != RPM_STRING_ARRAY_TYPE &&
+		 type != RPM_I18NSTRING_TYPE )
+	    {
+		return result;
+	    }
+
+	    if ( type == RPM_STRING_TYPE )
+		count = 1;
+
+	    if ( maxCount > 0 )
+		count = qMin( count, maxCount );
+
+	    const char * pos = _data + offset;
+	    const char * end = _data + _dataSize;
+
+	    for ( quint32 i = 0; i < count && pos < end; ++i )
+	    {
+		const char * nul = (const char *) memchr( pos, 0, end - pos );
+
+		if ( ! nul )
+		    break;
+
+		result << QString::fromUtf8( pos, nul - pos );
+		pos = nul + 1;
+	    }
+
+	    return result;
+	}
+
+
+	const char * _index;
+	quint32	     _indexCount;
+	const char * _data;
+	quint32	     _dataSize;
+    };
+
+}	// namespace
+
+
+
+RpmSqliteDb::RpmSqliteDb():
+    _db( 0 )
+{
+    // NOP
+}
+
+
+RpmSqliteDb::~RpmSqliteDb()
+{
+    close();
+}
+
+
+bool RpmSqliteDb::isSupported()
+{
+#if HAVE_SQLITE
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+QString RpmSqliteDb::findDb()
+{
+    // /var/lib/rpm is often only a symlink to /usr/lib/sysimage/rpm
+
+    QStringList candidates;
+    candidates << "/usr/lib/sysimage/rpm/rpmdb.sqlite"
+	       << "/var/lib/rpm/rpmdb.sqlite";
+
+    foreach ( const QString & path, candidates )
+    {
+	if ( QFile::exists( path ) )
+	    return path;
+    }
+
+    return "";
+}
+
+
+bool RpmSqliteDb::open( const QString & dbPath )
+{
+    close();
+
+    if ( dbPath.isEmpty() )
+	return false;
+
+#if HAVE_SQLITE
+
+    _dbPath = dbPath;
+    int result = sqlite3_open_v2( dbPath.toUtf8().constData(), &_db,
+				  SQLITE_OPEN_READONLY, 0 );
+
+    if ( result != SQLITE_OK )
+    {
+	logDbError( "Can't open" );
+	close();
+
+	return false;
+    }
+
+    sqlite3_busy_timeout( _db, BUSY_TIMEOUT_MILLISEC );
+    logInfo() << "Using the RPM database " << dbPath << endl;
+
+    return true;
+
+#else
+
+    logWarning() << "No sqlite support; can't open " << dbPath << endl;
+    return false;
+
+#endif
+}
+
+
+void RpmSqliteDb::close()
+{
+#if HAVE_SQLITE
+
+    if ( _db )
+	sqlite3_close( _db );
+
+#endif
+
+    _db = 0;
+}
+
+
+bool RpmSqliteDb::readAll( QList<RpmHeader> & headers, bool withFileLists )
+{
+    return readHeaders( "SELECT blob FROM Packages", "", headers, withFileLists );
+}
+
+
+QStringList RpmSqliteDb::fileList( const QString & name,
+				   const QString & version,
+				   const QString & arch )
+{
+    QList<RpmHeader> headers;
+
+    // The "Name" table is an index of the package names maintained by rpm;
+    // fall back to reading all headers if it's missing for some reason.
+
+    if ( ! readHeaders( "SELECT blob FROM Packages WHERE hnum IN "
+			"( SELECT hnum FROM Name WHERE key = ?1 )",
+			name, headers, true ) )
+    {
+	readAll( headers, true );
+    }
+
+    foreach ( const RpmHeader & header, headers )
+    {
+	if ( header.name == name && header.version == version && header.arch == arch )
+	    return header.fileList;
+    }
+
+    return QStringList();
+}
+
+
+bool RpmSqliteDb::readHeaders( const char *	  sql,
+			       const QString &	  name,
+			       QList<RpmHeader> & headers,
+			       bool		  withFileLists )
+{
+#if HAVE_SQLITE
+
+    if ( ! _db )
+	return false;
+
+    sqlite3_stmt * stmt = 0;
+
+    if ( sqlite3_prepare_v2( _db, sql, -1, &stmt, 0 ) != SQLITE_OK )
+    {
+	logDbError( QString( "Can't prepare \"%1\" for" ).arg( sql ) );
+	return false;
+    }
+
+    QByteArray utf8Name = name.toUtf8();
+
+    if ( ! name.isEmpty() )
+	sqlite3_bind_text( stmt, 1, utf8Name.constData(), utf8Name.size(), SQLITE_STATIC );
+
+    int result;
+    int invalidCount = 0;
+
+    while ( ( result = sqlite3_step( stmt ) ) == SQLITE_ROW )
+    {
+	RpmHeader header;
+
+	const char * blob = (const char *) sqlite3_column_blob( stmt, 0 );
+	int	     size = sqlite3_column_bytes( stmt, 0 );
+
+	if ( parseHeader( blob, size, header, withFileLists ) )
+	    headers << header;
+	else
+	    ++invalidCount;
+    }
+
+    sqlite3_finalize( stmt );
+
+    if ( invalidCount > 0 )
+	logWarning() << "Skipped " << invalidCount << " invalid headers in " << _dbPath << endl;
+
+    if ( result != SQLITE_DONE )
+    {
+	logDbError( "Error reading" );
+	return false;
+    }
+
+    return true;
+
+#else
+
+    Q_UNUSED( sql );
+    Q_UNUSED( name );
+    Q_UNUSED( headers );
+    Q_UNUSED( withFileLists );
+
+    return false;
+
+#endif
+}
+
+
+bool RpmSqliteDb::parseHeader( const char * blob,
+			       int	    size,
+			       RpmHeader &  header,
+			       bool	    withFileList )
+{
+    HeaderBlob hdr( blob, size );
+
+    if ( ! hdr.isValid() )
+	return false;
+
+    header.name = hdr.string( RPMTAG_NAME );
+
+    if ( header.name.isEmpty() )
+	return false;
+
+    header.version = hdr.string( RPMTAG_VERSION );
+    QString release = hdr.string( RPMTAG_RELEASE );
+
+    if ( ! release.isEmpty() )
+	header.version += "-" + release;
+
+    header.arch = hdr.string( RPMTAG_ARCH );
+    header.size = hdr.number( RPMTAG_LONGSIZE );
+
+    if ( header.size == 0 )
+	header.size = hdr.number( RPMTAG_SIZE );
+
+    if ( withFileList )
+    {
+	// The paths are split into the directories and the base names, and
+	// each base name has the index of its directory.
+
+	QStringList	 baseNames  = hdr.stringArray( RPMTAG_BASENAMES );
+	QStringList	 dirNames   = hdr.stringArray( RPMTAG_DIRNAMES  );
+	QVector<quint32> dirIndexes = hdr.int32Array ( RPMTAG_DIRINDEXES );
+
+	if ( dirIndexes.size() != baseNames.size() )
+	{
+	    logWarning() << "Inconsistent file list in the header of " << header.name << endl;
+	    return true;
+	}
+
+	header.fileList.reserve( baseNames.size() );
+
+	for ( int i = 0; i < baseNames.size(); ++i )
+	{
+	    quint32 dirIndex = dirIndexes.at( i );
+
+	    if ( dirIndex < (quint32) dirNames.size() )
+		header.fileList << dirNames.at( dirIndex ) + baseNames.at( i );
+	}
+    }
+
+    return true;
+}
+
+
+void RpmSqliteDb::logDbError( const QString & msg ) const
+{
+#if HAVE_SQLITE
+
+    logError() << msg << " " << _dbPath << ": "
+	       << ( _db ? sqlite3_errmsg( _db ) : "out of memory" ) << endl;
+
+#else
+
+    logError() << msg << " " << _dbPath << endl;
+
+#endif
+}
@@ -0,0 +1,162 @@
+/*
+ *   File name: RpmSqliteDb.h
+ *   Summary:	Direct read access to the RPM sqlite database
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef RpmSqliteDb_h
+#define RpmSqliteDb_h
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+#include "FileSize.h"
+
+
+struct sqlite3;
+
+
+namespace QDirStat
+{
+    /**
+     * The information from one package header of the RPM database.
+     **/
+    struct RpmHeader
+    {
+	RpmHeader(): size( 0 ) {}
+
+	QString	    name;
+	QString	    version;	// "version-release" like "rpm -qa"
+	QString	    arch;	// empty for "(none)"
+	FileSize    size;	// installed size in bytes
+	QStringList fileList;	// only if requested
+    };
+
+
+    /**
+     * Read-only access to the RPM database in rpmdb.sqlite as used by rpm
+     * 4.16 and later (Fedora 33, RHEL 9, openSUSE Tumbleweed): This gets the
+     * package list and the file lists directly from the package headers in
+     * that database without starting any "rpm" processes, which takes only a
+     * fraction of the time.
+     *
+     * This is only available if QDirStat was built with sqlite support
+     * (HAVE_SQLITE); otherwise open() always fails, and the caller should
+     * fall back to the rpm command.
+     *
+     * Usage:
+     *
+     *	   RpmSqliteDb db;
+     *
+     *	   if ( db.open( RpmSqliteDb::findDb() ) )
+     *	   {
+     *	       QList<RpmHeader> headers;
+     *
+     *	       if ( db.readAll( headers, false ) )
+     *		   ...
+     *	   }
+     **/
+    class RpmSqliteDb
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	RpmSqliteDb();
+
+	/**
+	 * Destructor. This closes the database.
+	 **/
+	~RpmSqliteDb();
+
+	/**
+	 * Return 'true' if QDirStat was built with sqlite support.
+	 **/
+	static bool isSupported();
+
+	/**
+	 * Return the path of the RPM sqlite database on this system or an
+	 * empty string if there is none, e.g. because the RPM database still
+	 * uses the old Berkeley DB format.
+	 **/
+	static QString findDb();
+
+	/**
+	 * Open the database 'dbPath' read-only. Return 'true' on success,
+	 * 'false' on error.
+	 **/
+	bool open( const QString & dbPath );
+
+	/**
+	 * Close the database. It is closed automatically in the destructor.
+	 **/
+	void close();
+
+	/**
+	 * Return 'true' if the database is open.
+	 **/
+	bool isOpen() const { return _db != 0; }
+
+	/**
+	 * Read all package headers into 'headers', with their file lists if
+	 * 'withFileLists' is 'true'. Return 'true' on success, 'false' on
+	 * error.
+	 **/
+	bool readAll( QList<RpmHeader> & headers, bool withFileLists );
+
+	/**
+	 * Return the file list of the package with the specified name,
+	 * version ("version-release") and architecture, i.e. the same as
+	 * "rpm -ql". Return an empty list if there is no such package or if
+	 * the package does not contain any files.
+	 **/
+	QStringList fileList( const QString & name,
+			      const QString & version,
+			      const QString & arch );
+
+	/**
+	 * Parse the package header in 'blob' with 'size' bytes as it is
+	 * stored in the "Packages" table into 'header'. Get the file list only
+	 * if 'withFileList' is 'true'.
+	 *
+	 * Return 'true' on success, 'false' if 'blob' is not a valid header.
+	 **/
+	static bool parseHeader( const char * blob,
+				 int	      size,
+				 RpmHeader &  header,
+				 bool	      withFileList );
+
+    protected:
+
+	/**
+	 * Read all headers that the prepared 'sql' statement returns in its
+	 * first column; 'name' (if non-empty) is bound to its first
+	 * parameter.
+	 **/
+	bool readHeaders( const char *	     sql,
+			  const QString &    name,
+			  QList<RpmHeader> & headers,
+			  bool		     withFileLists );
+
+	/**
+	 * Log the last sqlite error message with 'msg'.
+	 **/
+	void logDbError( const QString & msg ) const;
+
+
+	// Data members
+
+	sqlite3 * _db;
+	QString	  _dbPath;
+
+    };	// class RpmSqliteDb
+
+}	// namespace QDirStat
+
+
+#endif	// RpmSqliteDb_h
@@ -15,6 +15,7 @@
 #include "ShowUnpkgFilesDialog.h"
 #include "ExistingDirCompleter.h"
 #include "ExistingDirValidator.h"
+#include "QDirStatApp.h"
 #include "Settings.h"
 #include "SettingsHelpers.h"
 #include "Logger.h"
@@ -34,11 +35,14 @@ ShowUnpkgFilesDialog::ShowUnpkgFilesDialog( QWidget * parent ):
     _okButton = _ui->buttonBox->button( QDialogButtonBox::Ok );
     CHECK_PTR( _okButton );
 
-    QCompleter * completer = new ExistingDirCompleter( this );
+    QCompleter * completer = new ExistingDirCompleter( this, app()->dirTree() );
     CHECK_NEW( completer );
 
     _ui->startingDirComboBox->setCompleter( completer );
 
+    connect( _ui->startingDirComboBox, SIGNAL( editTextChanged  ( QString ) ),
+	     completer,		       SLOT  ( updateCompletions( QString ) ) );
+
     QValidator * validator = new ExistingDirValidator( this );
     CHECK_NEW( validator );
 
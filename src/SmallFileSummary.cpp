@@ -0,0 +1,115 @@
+/*
+ *   File name: SmallFileSummary.cpp
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "SmallFileSummary.h"
+
+
+using namespace QDirStat;
+
+
+SmallFileSummary::SmallFileSummary():
+    _count( 0 ),
+    _totalSize( 0LL ),
+    _totalAllocatedSize( 0LL ),
+    _totalBlocks( 0LL ),
+    _latestMtime( 0 ),
+    _oldestMtime( 0 )
+{
+
+}
+
+
+void SmallFileSummary::add( FileSize	    size,
+			    FileSize	    allocatedSize,
+			    FileSize	    blocks,
+			    time_t	    mtime,
+			    const QString & category )
+{
+    ++_count;
+    _totalSize		+= size;
+    _totalAllocatedSize += allocatedSize;
+    _totalBlocks	+= blocks;
+
+    if ( mtime > _latestMtime )
+	_latestMtime = mtime;
+
+    if ( mtime > 0 && ( _oldestMtime == 0 || mtime < _oldestMtime ) )
+	_oldestMtime = mtime;
+
+    if ( ! category.isEmpty() )
+    {
+	_categoryCounts[ category ] += 1;
+	_categorySums  [ category ] += size;
+    }
+}
+
+
+void SmallFileSummary::add( const SmallFileSummary * other )
+{
+    if ( ! other )
+	return;
+
+    _count		+= other->count();
+    _totalSize		+= other->totalSize();
+    _totalAllocatedSize += other->totalAllocatedSize();
+    _totalBlocks	+= other->totalBlocks();
+
+    if ( other->latestMtime() > _latestMtime )
+	_latestMtime = other->latestMtime();
+
+    if ( other->oldestMtime() > 0 &&
+	 ( _oldestMtime == 0 || other->oldestMtime() < _oldestMtime ) )
+    {
+	_oldestMtime = other->oldestMtime();
+    }
+
+    for ( SmallFileCategoryCountMap::const_iterator it = other->categoryCounts().constBegin();
+	  it != other->categoryCounts().constEnd();
+	  ++it )
+    {
+	_categoryCounts[ it.key() ] += it.value();
+    }
+
+    for ( SmallFileCategorySumMap::const_iterator it = other->categorySums().constBegin();
+	  it != other->categorySums().constEnd();
+	  ++it )
+    {
+	_categorySums[ it.key() ] += it.value();
+    }
+}
+
+
+void SmallFileSummary::addFiles( int	  count,
+				 FileSize totalSize,
+				 FileSize totalAllocatedSize,
+				 FileSize totalBlocks,
+				 time_t	  latestMtime,
+				 time_t	  oldestMtime )
+{
+    _count		+= count;
+    _totalSize		+= totalSize;
+    _totalAllocatedSize += totalAllocatedSize;
+    _totalBlocks	+= totalBlocks;
+
+    if ( latestMtime > _latestMtime )
+	_latestMtime = latestMtime;
+
+    if ( oldestMtime > 0 && ( _oldestMtime == 0 || oldestMtime < _oldestMtime ) )
+	_oldestMtime = oldestMtime;
+}
+
+
+void SmallFileSummary::addCategory( const QString & category, int count, FileSize sum )
+{
+    if ( category.isEmpty() )
+	return;
+
+    _categoryCounts[ category ] += count;
+    _categorySums  [ category ] += sum;
+}
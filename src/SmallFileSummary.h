@@ -0,0 +1,151 @@
+/*
+ *   File name: SmallFileSummary.h
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SmallFileSummary_h
+#define SmallFileSummary_h
+
+
+#include <sys/types.h>	// time_t
+
+#include <QMap>
+#include <QString>
+
+#include "FileSize.h"
+
+
+namespace QDirStat
+{
+    typedef QMap<QString, int>		SmallFileCategoryCountMap;
+    typedef QMap<QString, FileSize>	SmallFileCategorySumMap;
+
+
+    /**
+     * Summary record for small files that were not materialized as FileInfo
+     * nodes during directory reading.
+     *
+     * On filesystems with many millions of tiny files (cache directories,
+     * mail spools, object stores) one FileInfo for each of them dominates the
+     * memory footprint even though nobody ever looks at them individually.
+     * If the DirTree has a small file threshold, files below that size are
+     * only counted in an object of this class in their parent directory (or
+     * that directory's dot entry). They still contribute to all the
+     * accumulated sums of that directory and its ancestors.
+     *
+     * The user can always re-read a directory in full detail to get
+     * individual FileInfo nodes again.
+     **/
+    class SmallFileSummary
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	SmallFileSummary();
+
+	/**
+	 * Add one file to this summary. 'category' is the name of the
+	 * MimeCategory of that file or empty if it is unclassified.
+	 **/
+	void add( FileSize	  size,
+		  FileSize	  allocatedSize,
+		  FileSize	  blocks,
+		  time_t	  mtime,
+		  const QString & category = QString() );
+
+	/**
+	 * Add all the content of another summary to this one.
+	 **/
+	void add( const SmallFileSummary * other );
+
+	/**
+	 * Add 'count' files with the specified totals at once without any
+	 * category information. This is used when reading a cache file.
+	 **/
+	void addFiles( int	count,
+		       FileSize totalSize,
+		       FileSize totalAllocatedSize,
+		       FileSize totalBlocks,
+		       time_t	latestMtime,
+		       time_t	oldestMtime );
+
+	/**
+	 * Add category information for 'count' files with a total size of
+	 * 'sum' that are already included in the totals of this summary.
+	 **/
+	void addCategory( const QString & category, int count, FileSize sum );
+
+	/**
+	 * Return 'true' if this summary does not contain any files.
+	 **/
+	bool isEmpty() const { return _count == 0; }
+
+	/**
+	 * Number of files in this summary.
+	 **/
+	int count() const { return _count; }
+
+	/**
+	 * Total size in bytes of all files in this summary.
+	 **/
+	FileSize totalSize() const { return _totalSize; }
+
+	/**
+	 * Total allocated size in bytes of all files in this summary.
+	 **/
+	FileSize totalAllocatedSize() const { return _totalAllocatedSize; }
+
+	/**
+	 * Total number of 512 byte blocks of all files in this summary.
+	 **/
+	FileSize totalBlocks() const { return _totalBlocks; }
+
+	/**
+	 * The latest modification time of any file in this summary.
+	 **/
+	time_t latestMtime() const { return _latestMtime; }
+
+	/**
+	 * The oldest modification time of any file in this summary or 0 if
+	 * there is none.
+	 **/
+	time_t oldestMtime() const { return _oldestMtime; }
+
+	/**
+	 * Number of files for each MimeCategory name. Unclassified files are
+	 * not included in this map.
+	 **/
+	const SmallFileCategoryCountMap & categoryCounts() const
+	    { return _categoryCounts; }
+
+	/**
+	 * Total size of the files for each MimeCategory name. Unclassified
+	 * files are not included in this map.
+	 **/
+	const SmallFileCategorySumMap & categorySums() const
+	    { return _categorySums; }
+
+
+    protected:
+
+	int			  _count;
+	FileSize		  _totalSize;
+	FileSize		  _totalAllocatedSize;
+	FileSize		  _totalBlocks;
+	time_t			  _latestMtime;
+	time_t			  _oldestMtime;
+	SmallFileCategoryCountMap _categoryCounts;
+	SmallFileCategorySumMap	  _categorySums;
+
+    };	// class SmallFileSummary
+
+}	// namespace QDirStat
+
+
+#endif // ifndef SmallFileSummary_h
@@ -0,0 +1,48 @@
+/*
+ *   File name: SnapshotCollectJob.cpp
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QThreadPool>
+
+#include "SnapshotCollectJob.h"
+
+
+using namespace QDirStat;
+
+
+SnapshotCollectJob::SnapshotCollectJob( int		generation,
+					TreeSnapshotPtr snapshot ):
+    QRunnable(),
+    _generation( generation ),
+    _snapshot( snapshot )
+{
+
+}
+
+
+void SnapshotCollectJob::run()
+{
+    QVector<FileInfo *> items;
+    collect( _snapshot->subtree(), items );
+
+    if ( _snapshot->isCancelled() )
+	items.clear();
+
+    handOver( items );
+    _snapshot.clear();
+}
+
+
+void SnapshotCollectJob::start( SnapshotCollectJob * job )
+{
+    // Collecting only walks the tree in memory. The analyses have pools of
+    // their own for the file I/O, but a collect job must not queue up
+    // behind those: Their threads might all hang on a dead mount.
+
+    QThreadPool::globalInstance()->start( job );
+}
@@ -0,0 +1,83 @@
+/*
+ *   File name: SnapshotCollectJob.h
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef SnapshotCollectJob_h
+#define SnapshotCollectJob_h
+
+
+#include <QRunnable>
+#include <QVector>
+
+#include "TreeSnapshot.h"
+
+
+namespace QDirStat
+{
+    class FileInfo;
+
+
+    /**
+     * Abstract base class for jobs that collect the items a background
+     * analysis has to work on from a snapshot of the tree, so the GUI
+     * thread doesn't have to go through a large subtree.
+     *
+     * The collected items are handed over while the snapshot is still
+     * held, so they can't be deleted before the receiver tracks them.
+     * After that, the snapshot is released.
+     *
+     * Derived classes implement collect() and handOver(). The receiver
+     * should start a new generation when it is cancelled and ignore
+     * items that are handed over for an old one.
+     **/
+    class SnapshotCollectJob: public QRunnable
+    {
+    public:
+
+	/**
+	 * Constructor. 'generation' is the generation of the receiver when
+	 * it started this job.
+	 **/
+	SnapshotCollectJob( int generation, TreeSnapshotPtr snapshot );
+
+	/**
+	 * Collect the items and hand them over.
+	 **/
+	virtual void run() Q_DECL_OVERRIDE;
+
+	/**
+	 * Start 'job' in the global thread pool which takes ownership of
+	 * it.
+	 **/
+	static void start( SnapshotCollectJob * job );
+
+    protected:
+
+	/**
+	 * Collect the items in 'subtree' (which might also be a single
+	 * file). This is called in the worker thread while the tree is
+	 * frozen.
+	 **/
+	virtual void collect( FileInfo * subtree, QVector<FileInfo *> & items ) = 0;
+
+	/**
+	 * Hand 'items' over to the receiver. They are empty if the snapshot
+	 * was cancelled. This is called in the worker thread while the tree
+	 * is still frozen.
+	 **/
+	virtual void handOver( const QVector<FileInfo *> & items ) = 0;
+
+
+	int		_generation;
+	TreeSnapshotPtr	_snapshot;
+
+    };	// class SnapshotCollectJob
+
+}	// namespace QDirStat
+
+#endif	// SnapshotCollectJob_h
@@ -0,0 +1,189 @@
+/*
+ *   File name: TopFiles.cpp
+ *   Summary:	Index of the largest / newest / oldest files of a subtree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <algorithm>
+
+#include "TopFiles.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "FileInfoIterator.h"
+#include "Settings.h"
+#include "Logger.h"
+#include "Exception.h"
+
+#define DEFAULT_MAX_COUNT	1000
+
+
+using namespace QDirStat;
+
+
+static bool largerSize( FileInfo * a, FileInfo * b )
+{
+    return a->size() > b->size();
+}
+
+
+static bool newerMTime( FileInfo * a, FileInfo * b )
+{
+    return a->mtime() > b->mtime();
+}
+
+
+static bool olderMTime( FileInfo * a, FileInfo * b )
+{
+    return a->mtime() < b->mtime();
+}
+
+
+
+
+TopFiles::TopFiles( DirTree * tree ):
+    _tree( tree ),
+    _maxCount( DEFAULT_MAX_COUNT ),
+    _generation( -1 )
+{
+    CHECK_PTR( tree );
+    readSettings();
+}
+
+
+TopFiles::~TopFiles()
+{
+    writeSettings();
+}
+
+
+void TopFiles::setMaxCount( int maxCount )
+{
+    if ( maxCount < 1 )
+	maxCount = 1;
+
+    if ( maxCount != _maxCount )
+    {
+	_maxCount = maxCount;
+	clear();
+    }
+}
+
+
+void TopFiles::clear()
+{
+    for ( int i = 0; i <= OldestFiles; ++i )
+	_cache[ i ].clear();
+}
+
+
+FileInfoList TopFiles::files( FileInfo * subtree,
+			      Category	 category,
+			      int	 count )
+{
+    FileInfoList result;
+
+    if ( ! subtree )
+	return result;
+
+    if ( _tree->generation() != _generation )
+    {
+	// Something was added or removed since the lists were built, and the
+	// cached DirInfo pointers might even be dangling now.
+
+	clear();
+	_generation = _tree->generation();
+    }
+
+    if ( subtree->isDirInfo() )
+	result = collect( subtree->toDirInfo(), category );
+    else if ( subtree->isFile() )
+	result << subtree;
+
+    if ( count < 0 || count > _maxCount )
+	count = _maxCount;
+
+    if ( result.size() > count )
+	result = result.mid( 0, count );
+
+    return result;
+}
+
+
+FileInfoList TopFiles::collect( DirInfo * dir, Category category )
+{
+    QHash<DirInfo *, FileInfoList> & cache = _cache[ category ];
+    QHash<DirInfo *, FileInfoList>::const_iterator cached = cache.constFind( dir );
+
+    if ( cached != cache.constEnd() )
+	return cached.value();
+
+    FileInfoList list;
+    FileInfoIterator it( dir );
+
+    while ( *it )
+    {
+	FileInfo * item = *it;
+
+	if ( item->isDirInfo() )
+	    list << collect( item->toDirInfo(), category );
+	else if ( item->isFile() )
+	    list << item;
+
+	++it;
+    }
+
+    sortAndTruncate( list, category );
+
+    if ( dir->totalFiles() > _maxCount )
+	cache.insert( dir, list );
+
+    return list;
+}
+
+
+void TopFiles::sortAndTruncate( FileInfoList & list, Category category ) const
+{
+    bool (*lessThan)( FileInfo *, FileInfo * ) = largerSize;
+
+    switch ( category )
+    {
+	case LargestFiles: lessThan = largerSize; break;
+	case NewestFiles:  lessThan = newerMTime; break;
+	case OldestFiles:  lessThan = olderMTime; break;
+    }
+
+    if ( list.size() > _maxCount )
+    {
+	std::partial_sort( list.begin(), list.begin() + _maxCount, list.end(), lessThan );
+	list.erase( list.begin() + _maxCount, list.end() );
+    }
+    else
+    {
+	std::sort( list.begin(), list.end(), lessThan );
+    }
+}
+
+
+void TopFiles::readSettings()
+{
+    Settings settings;
+    settings.beginGroup( "TopFiles" );
+
+    setMaxCount( settings.value( "MaxCount", DEFAULT_MAX_COUNT ).toInt() );
+
+    settings.endGroup();
+}
+
+
+void TopFiles::writeSettings()
+{
+    Settings settings;
+    settings.beginGroup( "TopFiles" );
+
+    settings.setDefaultValue( "MaxCount", _maxCount );
+
+    settings.endGroup();
+}
@@ -0,0 +1,125 @@
+/*
+ *   File name: TopFiles.h
+ *   Summary:	Index of the largest / newest / oldest files of a subtree
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TopFiles_h
+#define TopFiles_h
+
+#include <QHash>
+
+#include "FileInfo.h"
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class DirInfo;
+
+
+    /**
+     * Index of the K largest, newest and oldest files for the subtrees of a
+     * DirTree. This is what the "Discover" actions use so they don't have to
+     * collect statistics of a whole subtree and then walk it a second time
+     * each time they are called.
+     *
+     * The list for a directory is merged from the lists of its
+     * subdirectories and its own files. It is kept for each directory that
+     * has more than K files in its subtree, so the list for any subtree is
+     * obtained by merging only a few lists that are already sorted; smaller
+     * subtrees are simply traversed. The lists are built on demand when they
+     * are first requested, and all of them are dropped when the tree
+     * generation changes, i.e. when any item is added to or removed from the
+     * tree.
+     *
+     * K can be configured with "MaxCount" in the "TopFiles" settings group.
+     **/
+    class TopFiles
+    {
+    public:
+
+	enum Category
+	{
+	    LargestFiles,
+	    NewestFiles,
+	    OldestFiles
+	};
+
+	/**
+	 * Constructor.
+	 **/
+	TopFiles( DirTree * tree );
+
+	/**
+	 * Destructor.
+	 **/
+	~TopFiles();
+
+	/**
+	 * Return up to 'count' files of 'subtree' of the specified category,
+	 * sorted with the largest / newest / oldest first. 'count' is
+	 * limited to maxCount(); a negative value means maxCount().
+	 **/
+	FileInfoList files( FileInfo * subtree,
+			    Category   category,
+			    int	       count = -1 );
+
+	/**
+	 * Return the maximum number of files per category, i.e. K.
+	 **/
+	int maxCount() const { return _maxCount; }
+
+	/**
+	 * Set the maximum number of files per category. This clears all
+	 * cached lists if it changes.
+	 **/
+	void setMaxCount( int maxCount );
+
+	/**
+	 * Drop all cached lists.
+	 **/
+	void clear();
+
+	/**
+	 * Read the settings.
+	 **/
+	void readSettings();
+
+	/**
+	 * Write the settings.
+	 **/
+	void writeSettings();
+
+    protected:
+
+	/**
+	 * Return the top files of 'dir' of the specified category, up to
+	 * maxCount(). Use a cached list if there is one, and cache the result
+	 * if the subtree of 'dir' has more than maxCount() files.
+	 **/
+	FileInfoList collect( DirInfo * dir, Category category );
+
+	/**
+	 * Sort 'list' with the top files of 'category' first and cut it off
+	 * after maxCount() items.
+	 **/
+	void sortAndTruncate( FileInfoList & list, Category category ) const;
+
+
+	// Data members
+
+	DirTree *			   _tree;
+	int				   _maxCount;
+	int				   _generation;
+	QHash<DirInfo *, FileInfoList>	   _cache[ OldestFiles + 1 ];
+
+    };	// class TopFiles
+
+}	// namespace QDirStat
+
+
+#endif	// TopFiles_h
@@ -0,0 +1,356 @@
+/*
+ *   File name: TreeFilter.cpp
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QElapsedTimer>
+#include <QPair>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+
+#include "TreeFilter.h"
+#include "DirTree.h"
+#include "DirInfo.h"
+#include "FileInfoIterator.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// How many tree levels to split up at most for the parallel jobs
+#define MAX_SPLIT_LEVELS	4
+
+// How many jobs to create for each CPU if the tree permits it
+#define JOBS_PER_THREAD		4
+
+
+using namespace QDirStat;
+
+
+namespace QDirStat
+{
+    /**
+     * One job for the parallel pass of TreeFilter::apply(): Process one
+     * subtree. Each job has its own SearchFilter (QRegExp is not
+     * thread-safe) and its own results.
+     **/
+    class TreeFilterJob: public QRunnable
+    {
+    public:
+
+	TreeFilterJob( FileInfo *	   subtree,
+		       bool		   insideMatch,
+		       const QString &	   pattern,
+		       FileSize		   minSize,
+		       TreeSnapshotPtr	   snapshot ):
+	    _subtree( subtree ),
+	    _insideMatch( insideMatch ),
+	    _filter( pattern, SearchFilter::Auto, SearchFilter::Contains ),
+	    _matchName( ! pattern.isEmpty() ),
+	    _minSize( minSize ),
+	    _snapshot( snapshot ),
+	    _matchCount( 0 )
+	{
+	    setAutoDelete( false );
+	}
+
+	virtual void run() Q_DECL_OVERRIDE
+	{
+	    TreeFilterSums sums;
+	    process( _subtree, _insideMatch, sums );
+	}
+
+	const TreeFilterSumsHash & sums() const { return _sums; }
+
+	const QSet<FileInfo *> & nameMatches() const { return _nameMatches; }
+
+	int matchCount() const { return _matchCount; }
+
+    protected:
+
+	/**
+	 * Process 'item' and (recursively) all its children, add the
+	 * filtered sums to 'parentSums' and return 'true' if 'item' is
+	 * visible with this filter.
+	 **/
+	bool process( FileInfo * item, bool insideMatch, TreeFilterSums & parentSums )
+	{
+	    if ( ! item->isDirInfo() )
+	    {
+		bool visible = item->size() >= _minSize &&
+		    ( insideMatch || ! _matchName || _filter.matches( item->name() ) );
+
+		if ( visible )
+		{
+		    parentSums.size += item->size();
+		    ++parentSums.files;
+		    ++_matchCount;
+		}
+
+		return visible;
+	    }
+
+	    if ( _snapshot->isCancelled() )
+		return false;
+
+	    bool nameMatch = _matchName && ! item->isPseudoDir() && _filter.matches( item->name() );
+	    bool visible   = nameMatch && _minSize == 0;
+	    TreeFilterSums sums;
+
+	    if ( nameMatch )
+		_nameMatches << item;
+
+	    FileInfoIterator it( item );
+
+	    while ( *it )
+	    {
+		if ( process( *it, insideMatch || nameMatch, sums ) )
+		    visible = true;
+
+		++it;
+	    }
+
+	    if ( item->attic() && process( item->attic(), insideMatch || nameMatch, sums ) )
+		visible = true;
+
+	    if ( visible )
+	    {
+		_sums.insert( item, sums );
+		parentSums.size	 += sums.size;
+		parentSums.files += sums.files;
+	    }
+
+	    return visible;
+	}
+
+
+	FileInfo *		_subtree;
+	bool			_insideMatch;
+	SearchFilter		_filter;
+	bool			_matchName;
+	FileSize		_minSize;
+	TreeSnapshotPtr		_snapshot;
+	int			_matchCount;
+	TreeFilterSumsHash	_sums;
+	QSet<FileInfo *>	_nameMatches;
+
+    };	// class TreeFilterJob
+
+}	// namespace QDirStat
+
+
+
+TreeFilter::TreeFilter( const QString & pattern,
+			FileSize	minSize ):
+    _pattern( pattern ),
+    _minSize( minSize ),
+    _filter( pattern, SearchFilter::Auto, SearchFilter::Contains ),
+    _matchCount( 0 )
+{
+
+}
+
+
+bool TreeFilter::isVisible( FileInfo * item ) const
+{
+    if ( item->isDirInfo() )
+	return _sums.contains( item );
+
+    if ( item->size() < _minSize )
+	return false;
+
+    if ( _pattern.isEmpty() || _filter.matches( item->name() ) )
+	return true;
+
+    for ( FileInfo * dir = item->parent(); dir; dir = dir->parent() )
+    {
+	if ( _nameMatches.contains( dir ) )
+	    return true;
+    }
+
+    return false;
+}
+
+
+void TreeFilter::apply( TreeSnapshotPtr snapshot )
+{
+    _sums.clear();
+    _nameMatches.clear();
+    _matchCount = 0;
+
+    FileInfo * subtree = snapshot ? snapshot->subtree() : 0;
+
+    if ( ! subtree )
+	return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    SearchFilter filter( _pattern, SearchFilter::Auto, SearchFilter::Contains );
+    bool	 matchName = ! _pattern.isEmpty();
+
+
+    // Split up the upper levels of the tree into independent subtrees for
+    // the parallel jobs. Directories on those upper levels are processed
+    // here after the jobs are finished; files on those levels are processed
+    // right away.
+
+    typedef QPair<FileInfo *, bool> Unit;	// subtree, insideMatch
+
+    QList<Unit>	      units;
+    QList<FileInfo *> upperDirs;		// top-down
+    QSet<FileInfo *>  upperVisibleFiles;
+    int		      wantedJobs = JOBS_PER_THREAD * QThread::idealThreadCount();
+
+    units << Unit( subtree, false );
+
+    for ( int level = 0; level < MAX_SPLIT_LEVELS && units.size() < wantedJobs; ++level )
+    {
+	QList<Unit> nextUnits;
+
+	foreach ( const Unit & unit, units )
+	{
+	    FileInfo * dir = unit.first;
+	    bool nameMatch = matchName && dir->parent() &&
+		! dir->isPseudoDir() && filter.matches( dir->name() );
+
+	    upperDirs << dir;
+
+	    if ( nameMatch )
+		_nameMatches << dir;
+
+	    QList<FileInfo *> children;
+	    FileInfoIterator  it( dir );
+
+	    while ( *it )
+	    {
+		children << *it;
+		++it;
+	    }
+
+	    if ( dir->attic() )
+		children << dir->attic();
+
+	    foreach ( FileInfo * child, children )
+	    {
+		bool insideMatch = unit.second || nameMatch;
+
+		if ( child->isDirInfo() )
+		{
+		    nextUnits << Unit( child, insideMatch );
+		}
+		else if ( child->size() >= _minSize &&
+			  ( insideMatch || ! matchName || filter.matches( child->name() ) ) )
+		{
+		    upperVisibleFiles << child;
+		    ++_matchCount;
+		}
+	    }
+	}
+
+	units = nextUnits;
+    }
+
+
+    // Process the remaining subtrees in parallel
+
+    QList<TreeFilterJob *> jobs;
+    QThreadPool		   pool;
+
+    foreach ( const Unit & unit, units )
+    {
+	TreeFilterJob * job = new TreeFilterJob( unit.first, unit.second, _pattern, _minSize, snapshot );
+	CHECK_NEW( job );
+
+	jobs << job;
+	pool.start( job );
+    }
+
+    pool.waitForDone();	// this is a worker thread, not the GUI thread
+
+    foreach ( TreeFilterJob * job, jobs )
+    {
+	_matchCount += job->matchCount();
+	_nameMatches.unite( job->nameMatches() );
+
+	for ( TreeFilterSumsHash::const_iterator it = job->sums().constBegin();
+	      it != job->sums().constEnd();
+	      ++it )
+	{
+	    _sums.insert( it.key(), it.value() );
+	}
+    }
+
+    int jobCount = jobs.size();
+    qDeleteAll( jobs );
+
+
+    // Now that all subtrees are done, process the upper levels bottom-up
+
+    for ( int i = upperDirs.size() - 1; i >= 0; --i )
+    {
+	FileInfo * dir	   = upperDirs.at( i );
+	bool	   visible = _nameMatches.contains( dir ) && _minSize == 0;
+	TreeFilterSums sums;
+
+	QList<FileInfo *> children;
+	FileInfoIterator  it( dir );
+
+	while ( *it )
+	{
+	    children << *it;
+	    ++it;
+	}
+
+	if ( dir->attic() )
+	    children << dir->attic();
+
+	foreach ( FileInfo * child, children )
+	{
+	    if ( child->isDirInfo() )
+	    {
+		TreeFilterSumsHash::const_iterator childSums = _sums.constFind( child );
+
+		if ( childSums == _sums.constEnd() )
+		    continue;
+
+		visible	    = true;
+		sums.size  += childSums.value().size;
+		sums.files += childSums.value().files;
+	    }
+	    else if ( upperVisibleFiles.contains( child ) )
+	    {
+		visible	    = true;
+		sums.size  += child->size();
+		++sums.files;
+	    }
+	}
+
+	if ( visible )
+	    _sums.insert( dir, sums );
+    }
+
+    // Always show the toplevel directory, even if nothing matches
+
+    DirTree * tree = snapshot->tree();
+
+    if ( tree->firstToplevel() && ! _sums.contains( tree->firstToplevel() ) )
+    {
+	_sums.insert( tree->firstToplevel(), TreeFilterSums() );
+
+	if ( ! _sums.contains( tree->root() ) )
+	    _sums.insert( tree->root(), TreeFilterSums() );
+    }
+
+    logDebug() << "Filter \"" << _pattern << "\" min size " << formatSize( _minSize )
+	       << ": " << _matchCount << " matches"
+	       << " in " << jobCount << " jobs"
+	       << " (" << timer.elapsed() << " millisec)"
+	       << ( snapshot->isCancelled() ? " - cancelled" : "" )
+	       << endl;
+}
@@ -0,0 +1,126 @@
+/*
+ *   File name: TreeFilter.h
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreeFilter_h
+#define TreeFilter_h
+
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+#include "SearchFilter.h"
+#include "FileSize.h"
+#include "TreeSnapshot.h"
+
+
+namespace QDirStat
+{
+    class FileInfo;
+
+
+    /**
+     * Filtered sums for one directory.
+     **/
+    struct TreeFilterSums
+    {
+	TreeFilterSums(): size( 0LL ), files( 0 ) {}
+
+	FileSize size;	// Total size of all matching files
+	int	 files;	// Number of matching files
+    };
+
+    typedef QHash<FileInfo *, TreeFilterSums> TreeFilterSumsHash;
+
+
+    /**
+     * Filter for the main tree view: Only files whose name matches a
+     * pattern and that have a minimum size are shown, together with the
+     * directories that lead to them.
+     *
+     * apply() walks the complete tree in a number of parallel jobs. It only
+     * reads the tree, so it can run in a worker thread with a tree
+     * snapshot: It stores the filtered totals of each visible directory
+     * and the directories whose name matches; whether a file is visible is
+     * decided by isVisible() when it is needed.
+     *
+     * A directory whose name matches the pattern makes all its files visible
+     * that have the minimum size.
+     **/
+    class TreeFilter
+    {
+    public:
+
+	/**
+	 * Constructor. 'pattern' is interpreted like in the "Find Files"
+	 * dialog, i.e. it may be a fixed string, a wildcard pattern or a
+	 * regular expression (see SearchFilter). An empty pattern matches
+	 * all names.
+	 **/
+	TreeFilter( const QString & pattern,
+		    FileSize	    minSize = 0 );
+
+	/**
+	 * Return 'true' if this filter actually filters anything.
+	 **/
+	bool isActive() const
+	    { return ! _pattern.isEmpty() || _minSize > 0; }
+
+	/**
+	 * Apply this filter to the subtree of 'snapshot' (normally the
+	 * complete tree): Calculate the filtered sums and find out which
+	 * directories are visible. This blocks until all the parallel jobs
+	 * are done, so call it in a worker thread. It returns early if the
+	 * snapshot is cancelled.
+	 **/
+	void apply( TreeSnapshotPtr snapshot );
+
+	/**
+	 * Return 'true' if 'item' is visible with this filter: A file that
+	 * matches, or a directory that contains a matching file somewhere in
+	 * its subtree. Use this only in the GUI thread after apply().
+	 **/
+	bool isVisible( FileInfo * item ) const;
+
+	/**
+	 * Return the filtered sums of directory 'dir'.
+	 **/
+	TreeFilterSums sums( FileInfo * dir ) const
+	    { return _sums.value( dir ); }
+
+	/**
+	 * Return the number of matching files in the complete tree.
+	 **/
+	int matchCount() const { return _matchCount; }
+
+	/**
+	 * Return the pattern.
+	 **/
+	const QString & pattern() const { return _pattern; }
+
+	/**
+	 * Return the minimum size.
+	 **/
+	FileSize minSize() const { return _minSize; }
+
+
+    protected:
+
+	QString			_pattern;
+	FileSize		_minSize;
+	SearchFilter		_filter;	// only for isVisible()
+	TreeFilterSumsHash	_sums;		// for each visible directory
+	QSet<FileInfo *>	_nameMatches;	// directories whose name matches
+	int			_matchCount;
+
+    };	// class TreeFilter
+
+}	// namespace QDirStat
+
+#endif	// TreeFilter_h
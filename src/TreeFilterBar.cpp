@@ -0,0 +1,163 @@
+/*
+ *   File name: TreeFilterBar.cpp
+ *   Summary:	QDirStat main window filter bar for the tree view
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include "TreeFilterBar.h"
+#include "TreeFilter.h"
+#include "DirTreeModel.h"
+#include "FormatUtil.h"
+#include "Logger.h"
+#include "Exception.h"
+
+// Delay after the last keystroke before the filter is applied
+#define FILTER_DELAY_MILLISEC	300
+
+
+using namespace QDirStat;
+
+
+TreeFilterBar::TreeFilterBar( QWidget * parent ):
+    QWidget( parent ),
+    _ui( new Ui::TreeFilterBar ),
+    _model( 0 )
+{
+    CHECK_NEW( _ui );
+
+    _ui->setupUi( this );
+    _ui->matchCountLabel->clear();
+    populateMinSizeComboBox();
+
+    _delayTimer.setSingleShot( true );
+    _delayTimer.setInterval( FILTER_DELAY_MILLISEC );
+
+    connect( &_delayTimer,	    SIGNAL( timeout()		       ),
+	     this,		    SLOT  ( applyFilter()	       ) );
+
+    connect( _ui->patternField,	    SIGNAL( textChanged( QString )     ),
+	     this,		    SLOT  ( scheduleFilter()	       ) );
+
+    connect( _ui->patternField,	    SIGNAL( returnPressed()	       ),
+	     this,		    SLOT  ( applyFilter()	       ) );
+
+    connect( _ui->minSizeComboBox,  SIGNAL( currentIndexChanged( int ) ),
+	     this,		    SLOT  ( applyFilter()	       ) );
+
+    connect( _ui->closeButton,	    SIGNAL( clicked()		       ),
+	     this,		    SLOT  ( closeFilterBar()	       ) );
+}
+
+
+TreeFilterBar::~TreeFilterBar()
+{
+    delete _ui;
+}
+
+
+void TreeFilterBar::setModel( DirTreeModel * model )
+{
+    _model = model;
+
+    if ( _model )
+    {
+	connect( _model, SIGNAL( filterChanged()      ),
+		 this,	 SLOT  ( modelFilterChanged() ) );
+    }
+}
+
+
+void TreeFilterBar::populateMinSizeComboBox()
+{
+    QList<FileSize> sizes;
+    sizes << 0
+	  << 1024LL * 1024
+	  << 10LL * 1024 * 1024
+	  << 100LL * 1024 * 1024
+	  << 1024LL * 1024 * 1024;
+
+    foreach ( FileSize size, sizes )
+    {
+	QString text = size == 0 ? tr( "Any" ) : formatSize( size );
+	_ui->minSizeComboBox->addItem( text, QVariant( (qlonglong) size ) );
+    }
+}
+
+
+FileSize TreeFilterBar::minSize() const
+{
+    return _ui->minSizeComboBox->itemData( _ui->minSizeComboBox->currentIndex() ).toLongLong();
+}
+
+
+void TreeFilterBar::setFilterBarVisible( bool visible )
+{
+    if ( visible )
+    {
+	show();
+	_ui->patternField->setFocus();
+	_ui->patternField->selectAll();
+
+	if ( ! _ui->patternField->text().isEmpty() || minSize() > 0 )
+	    applyFilter();
+    }
+    else
+    {
+	_delayTimer.stop();
+	hide();
+
+	if ( _model )
+	    _model->clearFilter();
+    }
+}
+
+
+void TreeFilterBar::closeFilterBar()
+{
+    setFilterBarVisible( false );
+    emit closed();
+}
+
+
+void TreeFilterBar::scheduleFilter()
+{
+    _delayTimer.start();
+}
+
+
+void TreeFilterBar::applyFilter()
+{
+    _delayTimer.stop();
+
+    if ( ! _model || ! isVisible() )
+	return;
+
+    TreeFilter * filter = new TreeFilter( _ui->patternField->text(), minSize() );
+    CHECK_NEW( filter );
+
+    if ( filter->isActive() )
+	_ui->matchCountLabel->setText( tr( "Filtering..." ) );
+    else
+	_ui->matchCountLabel->clear();
+
+    _model->setFilter( filter ); // takes over ownership; applied in the background
+}
+
+
+void TreeFilterBar::modelFilterChanged()
+{
+    const TreeFilter * filter = _model ? _model->filter() : 0;
+
+    if ( filter )
+    {
+	_ui->matchCountLabel->setText( tr( "%1 matches" ).arg( filter->matchCount() ) );
+	emit filterApplied();
+    }
+    else
+    {
+	_ui->matchCountLabel->clear();
+    }
+}
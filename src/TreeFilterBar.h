@@ -0,0 +1,119 @@
+/*
+ *   File name: TreeFilterBar.h
+ *   Summary:	QDirStat main window filter bar for the tree view
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+#ifndef TreeFilterBar_h
+#define TreeFilterBar_h
+
+#include <QWidget>
+#include <QTimer>
+
+#include "ui_tree-filter-bar.h"
+#include "FileSize.h"
+
+
+namespace QDirStat
+{
+    class DirTreeModel;
+
+    /**
+     * Filter bar above the tree view: Search-as-you-type for file names
+     * and a minimum file size. Each change (after a short delay so not
+     * every single keystroke triggers a pass over the complete tree) sets
+     * a new TreeFilter in the DirTreeModel.
+     *
+     * Hiding this widget switches filtering off.
+     **/
+    class TreeFilterBar: public QWidget
+    {
+	Q_OBJECT
+
+    public:
+	/**
+	 * Constructor.
+	 **/
+	TreeFilterBar( QWidget * parent );
+
+	/**
+	 * Destructor.
+	 **/
+	virtual ~TreeFilterBar();
+
+	/**
+	 * Set the model to filter.
+	 **/
+	void setModel( DirTreeModel * model );
+
+
+    signals:
+
+	/**
+	 * Emitted when the filter was applied to the tree.
+	 **/
+	void filterApplied();
+
+	/**
+	 * Emitted when the user closed the filter bar.
+	 **/
+	void closed();
+
+
+    public slots:
+
+	/**
+	 * Show the filter bar and put the keyboard focus into the pattern
+	 * field, or hide it and switch filtering off.
+	 **/
+	void setFilterBarVisible( bool visible );
+
+	/**
+	 * Close the filter bar and switch filtering off.
+	 **/
+	void closeFilterBar();
+
+
+    protected slots:
+
+	/**
+	 * Start the delay timer for applying the filter.
+	 **/
+	void scheduleFilter();
+
+	/**
+	 * Apply the current pattern and minimum size to the model.
+	 **/
+	void applyFilter();
+
+	/**
+	 * Notification that the model's filter changed: Update the match
+	 * count label, and emit filterApplied() if there is a filter now.
+	 **/
+	void modelFilterChanged();
+
+
+    protected:
+
+	/**
+	 * Fill the combo box with the minimum size presets.
+	 **/
+	void populateMinSizeComboBox();
+
+	/**
+	 * Return the currently selected minimum size.
+	 **/
+	FileSize minSize() const;
+
+
+	Ui::TreeFilterBar * _ui;
+	DirTreeModel *	    _model;
+	QTimer		    _delayTimer;
+
+    };	// class TreeFilterBar
+
+}	// namespace QDirStat
+
+#endif	// TreeFilterBar_h
@@ -0,0 +1,134 @@
+/*
+ *   File name: TreeSnapshot.cpp
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#include <QElapsedTimer>
+
+#include "TreeSnapshot.h"
+#include "DirTree.h"
+
+
+using namespace QDirStat;
+
+
+TreeSnapshot::TreeSnapshot( DirTree *	     tree,
+			    FileInfo *	     subtree,
+			    int		     generation,
+			    SnapshotStatePtr state ):
+    _tree( tree ),
+    _subtree( subtree ),
+    _generation( generation ),
+    _state( state ),
+    _epoch( state->epoch() )
+{
+
+}
+
+
+TreeSnapshot::~TreeSnapshot()
+{
+    _state->release( _epoch );
+}
+
+
+bool TreeSnapshot::isCurrent() const
+{
+    return ! isCancelled() && _state->isCurrent( _generation );
+}
+
+
+bool TreeSnapshot::isCancelled() const
+{
+    return _state->isCancelled( _epoch );
+}
+
+
+
+
+SnapshotState::SnapshotState( DirTree * tree ):
+    _tree( tree ),
+    _count( 0 ),
+    _epoch( 0 ),
+    _cancelled( 0 )
+{
+
+}
+
+
+bool SnapshotState::add()
+{
+    QMutexLocker locker( &_mutex );
+
+    return _count.fetchAndAddOrdered( 1 ) == 0;
+}
+
+
+void SnapshotState::release( int epoch )
+{
+    QMutexLocker locker( &_mutex );
+
+    if ( epoch != this->epoch() )	// The tree gave up waiting for it
+	return;
+
+    if ( ! _count.deref() )
+    {
+	_released.wakeAll();
+
+	// Leave everything else to the thread of the tree
+
+	if ( _tree )
+	    QMetaObject::invokeMethod( _tree, "thaw", Qt::QueuedConnection );
+    }
+}
+
+
+bool SnapshotState::cancel( int timeoutMillisec )
+{
+    QMutexLocker locker( &_mutex );
+
+    _cancelled.fetchAndStoreOrdered( 1 );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while ( count() > 0 )
+    {
+	qint64 remaining = timeoutMillisec - timer.elapsed();
+
+	if ( remaining <= 0 || ! _released.wait( &_mutex, (unsigned long) remaining ) )
+	    break;
+    }
+
+    bool released = count() == 0;
+
+    if ( ! released )
+    {
+	_epoch.fetchAndAddOrdered( 1 );
+	_count.fetchAndStoreOrdered( 0 );
+    }
+
+    _cancelled.fetchAndStoreOrdered( 0 );
+
+    return released;
+}
+
+
+void SnapshotState::detach()
+{
+    QMutexLocker locker( &_mutex );
+
+    _tree = 0;
+}
+
+
+bool SnapshotState::isCurrent( int generation ) const
+{
+    QMutexLocker locker( &_mutex );
+
+    return _tree && _tree->generation() == generation;
+}
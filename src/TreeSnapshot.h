@@ -0,0 +1,199 @@
+/*
+ *   File name: TreeSnapshot.h
+ *   Summary:	Support classes for QDirStat
+ *   License:	GPL V2 - See file LICENSE for details.
+ *
+ *   Author:	Stefan Hundhammer <Stefan.Hundhammer@gmx.de>
+ */
+
+
+#ifndef TreeSnapshot_h
+#define TreeSnapshot_h
+
+
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+
+
+namespace QDirStat
+{
+    class DirTree;
+    class FileInfo;
+    class TreeSnapshot;
+    class SnapshotState;
+
+    typedef QSharedPointer<TreeSnapshot>  TreeSnapshotPtr;
+    typedef QSharedPointer<SnapshotState> SnapshotStatePtr;
+
+
+    /**
+     * Read-only view of a subtree of a DirTree for use in other threads.
+     *
+     * As long as any snapshot of a DirTree exists, that tree is frozen:
+     * Directory reading is paused, and deleting or refreshing subtrees is
+     * deferred until the last snapshot is gone. So all FileInfo pointers in
+     * the tree remain valid, and the tree structure and all the summary
+     * fields remain unchanged. A worker thread can safely iterate over the
+     * subtree with firstChild() / next(), dotEntry(), attic() and call all
+     * the const accessors of FileInfo and DirInfo.
+     *
+     * Do not use sortedChildren() or anything else that changes internal
+     * caches of the tree from a worker thread; DirInfo::createSortedChildren()
+     * sorts into a separate list instead. The category() lookups of the
+     * MimeCategorizer and ContentSniffer::sniffedSuffix() are safe.
+     *
+     * Create snapshots only in the GUI thread with DirTree::snapshot().
+     * They can be released in any thread; simply let the last
+     * TreeSnapshotPtr go out of scope.
+     *
+     * Operations that have to discard the complete tree (e.g. reading a
+     * different directory) cannot be deferred. In that case the tree sets
+     * the 'cancelled' flag of all snapshots and waits until they are
+     * released, so long-running analyses should check isCancelled() from
+     * time to time. If a snapshot is not released within a few seconds
+     * (e.g. because its thread hangs in a system call), the tree gives up
+     * waiting and leaves the old items to that snapshot: They are never
+     * deleted, and the snapshot remains cancelled.
+     **/
+    class TreeSnapshot
+    {
+    public:
+
+	/**
+	 * Destructor. Thaws the tree when the last snapshot is gone.
+	 **/
+	~TreeSnapshot();
+
+	/**
+	 * The tree this snapshot belongs to.
+	 **/
+	DirTree * tree() const { return _tree; }
+
+	/**
+	 * The subtree this snapshot is about.
+	 **/
+	FileInfo * subtree() const { return _subtree; }
+
+	/**
+	 * The generation of the tree when this snapshot was taken.
+	 **/
+	int generation() const { return _generation; }
+
+	/**
+	 * Return 'true' if the tree has not changed since this snapshot was
+	 * taken, i.e. if results based on this snapshot are still up to date.
+	 **/
+	bool isCurrent() const;
+
+	/**
+	 * Return 'true' if the tree needs to discard its content and the
+	 * owner of this snapshot should release it as soon as possible.
+	 **/
+	bool isCancelled() const;
+
+
+    protected:
+
+	friend class DirTree;
+
+	/**
+	 * Constructor. Use DirTree::snapshot() to create snapshots.
+	 **/
+	TreeSnapshot( DirTree *		 tree,
+		      FileInfo *	 subtree,
+		      int		 generation,
+		      SnapshotStatePtr	 state );
+
+
+	DirTree *	 _tree;
+	FileInfo *	 _subtree;
+	int		 _generation;
+	SnapshotStatePtr _state;
+	int		 _epoch;
+
+    };	// class TreeSnapshot
+
+
+    /**
+     * State shared by a DirTree and all of its snapshots: The number of
+     * snapshots that freeze the tree and the 'cancelled' flag.
+     *
+     * The snapshots keep this alive, so a snapshot that is only released
+     * after the tree gave up waiting for it (or after the tree was
+     * destroyed) does not touch the tree anymore: Each time the tree gives
+     * up waiting, a new epoch starts, and snapshots of an older epoch no
+     * longer count.
+     **/
+    class SnapshotState
+    {
+    public:
+
+	/**
+	 * Constructor.
+	 **/
+	SnapshotState( DirTree * tree );
+
+	/**
+	 * Add a snapshot. Return 'true' if it is the first one, i.e. if the
+	 * tree needs to be frozen now. Call this only from the GUI thread.
+	 **/
+	bool add();
+
+	/**
+	 * Release a snapshot of epoch 'epoch'. If this was the last one,
+	 * thaw the tree. This may be called from any thread.
+	 **/
+	void release( int epoch );
+
+	/**
+	 * Set the 'cancelled' flag and wait up to 'timeoutMillisec' until
+	 * all snapshots are released. Return 'true' if they are; otherwise
+	 * start a new epoch, i.e. forget about the snapshots that are still
+	 * there, and return 'false'.
+	 **/
+	bool cancel( int timeoutMillisec );
+
+	/**
+	 * The tree is being destroyed: Never access it again.
+	 **/
+	void detach();
+
+	/**
+	 * Return the number of snapshots of the current epoch.
+	 **/
+	int count() const { return _count.fetchAndAddOrdered( 0 ); }
+
+	/**
+	 * Return the current epoch.
+	 **/
+	int epoch() const { return _epoch.fetchAndAddOrdered( 0 ); }
+
+	/**
+	 * Return 'true' if snapshots of epoch 'epoch' should be released as
+	 * soon as possible.
+	 **/
+	bool isCancelled( int epoch ) const
+	    { return _cancelled.fetchAndAddOrdered( 0 ) != 0 || epoch != this->epoch(); }
+
+	/**
+	 * Return 'true' if the tree still has generation 'generation'.
+	 **/
+	bool isCurrent( int generation ) const;
+
+
+    protected:
+
+	mutable QMutex		_mutex;
+	QWaitCondition		_released;
+	DirTree *		_tree;		// 0 after detach()
+	mutable QAtomicInt	_count;
+	mutable QAtomicInt	_epoch;
+	mutable QAtomicInt	_cancelled;
+
+    };	// class SnapshotState
+
+}	// namespace QDirStat
+
+#endif	// TreeSnapshot_h
@@ -8,70 +8,39 @@
 
 
 #include "TreeWalker.h"
-#include "FileSizeStats.h"
-#include "FileMTimeStats.h"
+#include "DirTree.h"
 #include "SysUtil.h"
 #include "Logger.h"
 #include "Exception.h"
 
-#define MAX_RESULTS              200
 #define MAX_FIND_FILES_RESULTS  1000
 
 
 using namespace QDirStat;
 
 
-qreal TreeWalker::upperPercentileThreshold( PercentileStats & stats )
+void TreeWalker::findTopFiles( FileInfo * subtree, TopFiles::Category category )
 {
-    int percentile = 0;
+    _haveResults = true;
+    _results.clear();
 
-    if      ( stats.dataSize() <= 100 )                 percentile = 80;
-    else if ( stats.dataSize() * 0.10 <= MAX_RESULTS )  percentile = 90;
-    else if ( stats.dataSize() * 0.05 <= MAX_RESULTS )  percentile = 95;
-    else if ( stats.dataSize() * 0.01 <= MAX_RESULTS )  percentile = 99;
+    if ( ! subtree || ! subtree->tree() )
+        return;
 
-    qreal threshold = 0.0;
+    TopFiles * topFiles   = subtree->tree()->topFiles();
+    int        files      = subtree->isDirInfo() ? subtree->totalFiles() : 1;
+    int        maxResults = topFiles->maxCount();
+    int        count      = maxResults;
 
-    if ( percentile > 0 )
-    {
-        logDebug() << "Threshold: " << percentile << ". percentile" << endl;
-        threshold = stats.percentile( percentile );
-    }
-    else
-    {
-        logDebug() << "Threshold: " << MAX_RESULTS << " items" << endl;
-        int index = stats.dataSize() - MAX_RESULTS;
-        threshold = stats.data().at( index );
-    }
+    if      ( files <= 100 )                   count = files / 5;
+    else if ( files * 0.10 <= maxResults )     count = files / 10;
+    else if ( files * 0.05 <= maxResults )     count = files / 20;
+    else if ( files * 0.01 <= maxResults )     count = files / 100;
 
-    return threshold;
-}
-
-
-qreal TreeWalker::lowerPercentileThreshold( PercentileStats & stats )
-{
-    int percentile = 0;
-
-    if      ( stats.dataSize() <= 100 )                 percentile = 20;
-    else if ( stats.dataSize() * 0.10 <= MAX_RESULTS )  percentile = 10;
-    else if ( stats.dataSize() * 0.05 <= MAX_RESULTS )  percentile =  5;
-    else if ( stats.dataSize() * 0.01 <= MAX_RESULTS )  percentile =  1;
-
-    qreal threshold = 0.0;
-
-    if ( percentile > 0 )
-    {
-        logDebug() << "Threshold: " << percentile << ". percentile" << endl;
-        threshold = stats.percentile( percentile );
-    }
-    else
-    {
-        logDebug() << "Threshold: " << MAX_RESULTS << " items" << endl;
-        int index = MAX_RESULTS;
-        threshold = stats.data().at( index );
-    }
+    count    = qBound( 1, count, maxResults );
+    _results = topFiles->files( subtree, category, count );
 
-    return threshold;
+    logDebug() << _results.size() << " of " << files << " files" << endl;
 }
 
 
@@ -80,24 +49,24 @@ qreal TreeWalker::lowerPercentileThreshold( PercentileStats & stats )
 void LargestFilesTreeWalker::prepare( FileInfo * subtree )
 {
     TreeWalker::prepare( subtree );
-    FileSizeStats stats( subtree );
-    _threshold = (FileSize) upperPercentileThreshold( stats );
+    findTopFiles( subtree, TopFiles::LargestFiles );
+    _threshold = _results.isEmpty() ? 0 : _results.last()->size();
 }
 
 
 void NewFilesTreeWalker::prepare( FileInfo * subtree )
 {
     TreeWalker::prepare( subtree );
-    FileMTimeStats stats( subtree );
-    _threshold = (time_t) upperPercentileThreshold( stats );
+    findTopFiles( subtree, TopFiles::NewestFiles );
+    _threshold = _results.isEmpty() ? 0 : _results.last()->mtime();
 }
 
 
 void OldFilesTreeWalker::prepare( FileInfo * subtree )
 {
     TreeWalker::prepare( subtree );
-    FileMTimeStats stats( subtree );
-    _threshold = (time_t) lowerPercentileThreshold( stats );
+    findTopFiles( subtree, TopFiles::OldestFiles );
+    _threshold = _results.isEmpty() ? 0 : _results.last()->mtime();
 }
 
 
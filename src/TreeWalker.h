@@ -12,13 +12,11 @@
 
 #include "FileInfo.h"
 #include "FileSearchFilter.h"
+#include "TopFiles.h"
 
 
 namespace QDirStat
 {
-    class PercentileStats;
-
-
     /**
      * Abstract base class to walk recursively through a FileInfo tree to check
      * for each tree item whether or not it should be used for further
@@ -38,7 +36,8 @@ namespace QDirStat
     public:
 
         TreeWalker():
-            _overflow( false )
+            _overflow( false ),
+            _haveResults( false )
             {}
 
         virtual ~TreeWalker() {}
@@ -54,7 +53,12 @@ namespace QDirStat
          * Derived classes can reimplement this, but the new implementation
          * should call this base class method in the new implementation.
          **/
-        virtual void prepare( FileInfo * /* subtree */ ) { _overflow = false; }
+        virtual void prepare( FileInfo * /* subtree */ )
+            {
+                _overflow    = false;
+                _haveResults = false;
+                _results.clear();
+            }
 
         /**
          * Check if 'item' fits into the category (largest / newest / oldest
@@ -72,27 +76,38 @@ namespace QDirStat
          **/
         bool overflow() const { return _overflow; }
 
-
-    protected:
+        /**
+         * Return 'true' if prepare() already found all the results, so there
+         * is no need to walk the tree and check() each item; the results are
+         * in results() then.
+         **/
+        bool haveResults() const { return _haveResults; }
 
         /**
-         * Calculate a data value threshold from a set of PercentileStats from
-         * an upper percentile up to the maximum value (P100).
+         * Return the results that prepare() found if haveResults() is
+         * 'true'.
          **/
-        qreal upperPercentileThreshold( PercentileStats & stats );
+        const FileInfoList & results() const { return _results; }
+
+
+    protected:
 
         /**
-         * Calculate a data value threshold from a set of PercentileStats from
-         * an the minimum value (P0) to a lower percentile.
+         * Get the top files of 'category' in 'subtree' from the TopFiles
+         * index of its tree as the results: About the top 20% for small
+         * subtrees, going down to 1% for larger ones, but no more than the
+         * maximum count of that index.
          **/
-        qreal lowerPercentileThreshold( PercentileStats & stats );
+        void findTopFiles( FileInfo * subtree, TopFiles::Category category );
 
 
         //
         // Data members
         //
 
-        bool _overflow;
+        bool         _overflow;
+        bool         _haveResults;
+        FileInfoList _results;
 
     };  // class TreeWalker
 
@@ -105,7 +120,8 @@ namespace QDirStat
     public:
 
         /**
-         * Find the threshold for what is considered a "large file".
+         * Find the largest files in the TopFiles index. This also
+         * sets the threshold for check().
          **/
         virtual void prepare( FileInfo * subtree );
 
@@ -126,7 +142,8 @@ namespace QDirStat
     public:
 
         /**
-         * Find the threshold for what is considered a "new file".
+         * Find the newest files in the TopFiles index. This also
+         * sets the threshold for check().
          **/
         virtual void prepare( FileInfo * subtree );
 
@@ -147,7 +164,8 @@ namespace QDirStat
     public:
 
         /**
-         * Find the threshold for what is considered an "old file".
+         * Find the oldest files in the TopFiles index. This also
+         * sets the threshold for check().
          **/
         virtual void prepare( FileInfo * subtree );
 
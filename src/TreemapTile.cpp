@@ -16,6 +16,7 @@
 
 #include "TreemapTile.h"
 #include "TreemapView.h"
+#include "PkgInfo.h"
 #include "SelectionModel.h"
 #include "ActionManager.h"
 #include "CleanupCollection.h"
@@ -119,6 +120,16 @@ void TreemapTile::init()
     if ( ( _orig->isDir() && _orig->totalSubDirs() == 0 ) || _orig->isDotEntry() )
         setAcceptHoverEvents( true );
 
+    if ( _orig->isPkgInfo() &&
+         rect().width()  >= MinLazyPkgTileSize &&
+         rect().height() >= MinLazyPkgTileSize )
+    {
+        PkgInfo * pkg = _orig->toPkgInfo();
+
+        if ( pkg && pkg->isLazy() && pkg->readState() == DirOnRequestOnly )
+            _parentView->addLazyPkg( pkg );
+    }
+
     if ( ! _parentTile )
 	_parentView->scene()->addItem( this );
 
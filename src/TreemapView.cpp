@@ -15,6 +15,8 @@
 #include "TreemapView.h"
 #include "DirTree.h"
 #include "DirInfo.h"
+#include "FileInfoIterator.h"
+#include "PkgInfo.h"
 #include "FormatUtil.h"
 #include "SelectionModel.h"
 #include "Settings.h"
@@ -97,6 +99,7 @@ void TreemapView::clear()
     _newRoot         = 0;
     _sceneMask       = 0;
     _parentHighlightList.clear();
+    _lazyPkgNames.clear();
 }
 
 
@@ -131,6 +134,9 @@ void TreemapView::setDirTree( DirTree * newTree )
 
     connect( _tree, SIGNAL( finished()	     ),
 	     this,  SLOT  ( rebuildTreemap() ) );
+
+    connect( _tree, SIGNAL( lazyPkgReadFinished() ),
+	     this,  SLOT  ( rebuildTreemap()	  ) );
 }
 
 
@@ -366,6 +372,13 @@ void TreemapView::rebuildTreemap( FileInfo *	 newRoot,
 					 rect,
 					 TreemapAuto );
 
+	    // The tiles of lazy packages were collected while building the
+	    // treemap. Read their file lists when control is back in the event
+	    // loop; this will rebuild the treemap again when it is done.
+
+	    if ( ! _lazyPkgNames.isEmpty() )
+		QTimer::singleShot( 0, this, SLOT( readLazyPkg() ) );
+
 #if REBUILD_STOPWATCH
             logDebug() << "Treemap finished after "
                        << formatMillisec( stopwatch.elapsed() )
@@ -408,6 +421,45 @@ void TreemapView::rebuildTreemapDelayed()
 }
 
 
+void TreemapView::addLazyPkg( PkgInfo * pkg )
+{
+    // Only the name is stored: The tree might be cleared or read again
+    // before readLazyPkg() is called.
+
+    _lazyPkgNames.insert( pkg->name() );
+}
+
+
+void TreemapView::readLazyPkg()
+{
+    PkgInfoList pkgList;
+    FileInfo *	top = _tree ? _tree->firstToplevel() : 0;
+
+    if ( top && top->isPkgInfo() && ! _lazyPkgNames.isEmpty() )
+    {
+	FileInfoIterator it( top );
+
+	while ( *it )
+	{
+	    PkgInfo * pkg = (*it)->toPkgInfo();
+
+	    if ( pkg && _lazyPkgNames.contains( pkg->name() ) )
+		pkgList << pkg;
+
+	    ++it;
+	}
+    }
+
+    _lazyPkgNames.clear();
+
+    if ( ! pkgList.isEmpty() )
+    {
+	logInfo() << "Reading " << pkgList.size() << " packages in the treemap" << endl;
+	_tree->readLazyPkg( pkgList );
+    }
+}
+
+
 void TreemapView::deleteNotify( FileInfo * )
 {
     if ( _rootTile )
@@ -15,6 +15,7 @@
 #include <QGraphicsRectItem>
 #include <QGraphicsPathItem>
 #include <QList>
+#include <QSet>
 
 #include "MimeCategorizer.h"
 #include "FileInfo.h"
@@ -29,6 +30,10 @@
 
 #define DefaultMinTileSize	   3
 
+// Minimum width and height of the tile of a package that was only added with
+// its size from the package database to read its file list
+#define MinLazyPkgTileSize	   20
+
 
 class QMouseEvent;
 class QSettings;
@@ -45,6 +50,7 @@ namespace QDirStat
     class CleanupCollection;
     class FileInfoSet;
     class DelayedRebuilder;
+    class PkgInfo;
 
     typedef QList<HighlightRect *> HighlightRectList;
 
@@ -384,6 +390,14 @@ namespace QDirStat
 	 **/
 	int minTileSize() const { return _minTileSize; }
 
+	/**
+	 * Notification from a tile that it is for package 'pkg' whose file
+	 * list is not read yet (see PkgInfo::isLazy()), and that it is large
+	 * enough to be worthwhile to show its files. The file lists of all
+	 * such packages are read after the treemap is built.
+	 **/
+	void addLazyPkg( PkgInfo * pkg );
+
 	/**
 	 * Returns the cushion grid color.
 	 **/
@@ -494,6 +508,12 @@ namespace QDirStat
 	 **/
 	void rebuildTreemapDelayed();
 
+	/**
+	 * Read the file lists of the packages that were added with
+	 * addLazyPkg() while building the treemap.
+	 **/
+	void readLazyPkg();
+
     protected:
 
 	/**
@@ -521,6 +541,7 @@ namespace QDirStat
         TreemapTile         * _highlightedTile;
         HighlightRectList     _parentHighlightList;
 	QString		      _savedRootUrl;
+	QSet<QString>	      _lazyPkgNames;
 
 	bool   _squarify;
 	bool   _doCushionShading;
@@ -8,11 +8,22 @@
 
 
 #include <iostream>	// cerr
+#include <string.h>	// strcmp()
 
 #include <QApplication>
+#include <QTextStream>
+#include <QTemporaryFile>
+#if (QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 ))
+#  include <QTemporaryDir>
+#endif
 #include "QDirStatApp.h"
 #include "MainWindow.h"
 #include "DirTreeModel.h"
+#include "CacheQuery.h"
+#include "CacheDiff.h"
+#include "MetricsExporter.h"
+#include "GuiBenchmark.h"
+#include "RpmSqliteDb.h"
 #include "Settings.h"
 #include "Logger.h"
 #include "Exception.h"
@@ -34,9 +45,40 @@ void usage( const QStringList & argList )
 	 << "  " << progName << " unpkg:/dir\n"
 	 << "  " << progName << " --dont-ask|-d\n"
 	 << "  " << progName << " --cache|-c <cache-file-name>\n"
+	 << "  " << progName << " --query|-q <cache-file-name> <query>...\n"
+	 << "  " << progName << " --diff <old-cache-file> <new-cache-file>\n"
+	 << "  " << progName << " --metrics|-m <output-file> [--depth <n>] [--min-size <size>]\n"
+	 << "                         <directory-name>|--cache <cache-file-name>\n"
+	 << "  " << progName << " --benchmark <cache-file-name>|--generate <dirs> <files-per-dir>\n"
+	 << "  " << progName << " --rpm-db <rpmdb.sqlite>\n"
 	 << "  " << progName << " --help|-h\n"
 	 << "\n"
 	 << "\n"
+	 << "Supported queries (all in one pass over the cache file):\n"
+	 << "\n"
+	 << "- top-files <n>     The n largest files\n"
+	 << "- top-dirs <n>      The n largest directories (subtree totals)\n"
+	 << "- total <path>      Total size below path\n"
+	 << "- categories        Sums for each MIME category\n"
+	 << "- owners            Sums for each owner\n"
+	 << "\n"
+	 << "\n"
+	 << "--diff lists what was added, removed or changed between two cache files\n"
+	 << "of the same directory tree.\n"
+	 << "\n"
+	 << "\n"
+	 << "--metrics writes Prometheus textfile collector metrics for each directory\n"
+	 << "up to <n> levels deep (default 3) that has at least <size> (e.g. 500M).\n"
+	 << "\n"
+	 << "\n"
+	 << "--benchmark times expanding, sorting, scrolling, selecting, the treemap and\n"
+	 << "deleting for a cache file or a generated tree; it needs no display.\n"
+	 << "\n"
+	 << "\n"
+	 << "--rpm-db lists the packages and their files in an RPM sqlite database\n"
+	 << "the way the packages view reads them.\n"
+	 << "\n"
+	 << "\n"
          << "Supported pkg patterns:\n"
 	 << "\n"
          << "- Default: \"Starts with\" \"pkg:/mypkg\"\n"
@@ -93,6 +135,291 @@ bool commandLineSwitch( const QString & longName,
 }
 
 
+/**
+ * Headless mode: Run the queries in 'argList' (everything after --query)
+ * over a cache file and write the results to stdout.
+ * Return the exit code.
+ **/
+int runCacheQuery( const QStringList & argList )
+{
+    if ( argList.isEmpty() )
+    {
+	usage( argList );
+	return 1;
+    }
+
+    QDirStat::CacheQuery query( argList.first() );
+    bool ok = true;
+
+    for ( int i = 1; i < argList.size() && ok; ++i )
+    {
+	QString arg = argList.at( i );
+
+	if ( arg == "top-files" || arg == "top-dirs" )
+	{
+	    int count = ++i < argList.size() ? argList.at( i ).toInt( &ok ) : 0;
+	    ok = ok && count > 0;
+
+	    if ( arg == "top-files" )
+		query.setTopFiles( count );
+	    else
+		query.setTopDirs( count );
+	}
+	else if ( arg == "total" && ++i < argList.size() )
+	    query.addPrefix( argList.at( i ) );
+	else if ( arg == "categories" )
+	    query.setCategories();
+	else if ( arg == "owners" )
+	    query.setOwners();
+	else
+	    ok = false;
+    }
+
+    if ( ! ok )
+    {
+	usage( argList );
+	return 1;
+    }
+
+    if ( ! query.run() )
+    {
+	cerr << "Error reading " << qPrintable( argList.first() ) << std::endl;
+	return 2;
+    }
+
+    QTextStream out( stdout );
+    query.writeResults( out );
+
+    return 0;
+}
+
+
+/**
+ * Headless mode: Compare the two cache files in 'argList' (everything after
+ * --diff) and write the differences to stdout.
+ * Return the exit code.
+ **/
+int runCacheDiff( const QStringList & argList )
+{
+    if ( argList.size() != 2 )
+    {
+	usage( argList );
+	return 1;
+    }
+
+    QDirStat::CacheDiff diff( argList.at( 0 ), argList.at( 1 ) );
+
+    if ( ! diff.run() )
+    {
+	cerr << "Error reading " << qPrintable( argList.join( " or " ) ) << std::endl;
+	return 2;
+    }
+
+    QTextStream out( stdout );
+    diff.writeResults( out );
+
+    return 0;
+}
+
+
+/**
+ * Headless mode: List the packages and their files in the RPM sqlite
+ * database in 'argList' (everything after --rpm-db) on stdout.
+ * Return the exit code; 3 if QDirStat was built without sqlite support.
+ **/
+int runRpmDbList( const QStringList & argList )
+{
+    if ( argList.size() != 1 )
+    {
+	usage( argList );
+	return 1;
+    }
+
+    if ( ! QDirStat::RpmSqliteDb::isSupported() )
+    {
+	cerr << "Built without sqlite support" << std::endl;
+	return 3;
+    }
+
+    QDirStat::RpmSqliteDb	    db;
+    QList<QDirStat::RpmHeader> headers;
+
+    if ( ! db.open( argList.first() ) || ! db.readAll( headers, false ) )
+    {
+	cerr << "Error reading " << qPrintable( argList.first() ) << std::endl;
+	return 2;
+    }
+
+    QTextStream out( stdout );
+
+    foreach ( const QDirStat::RpmHeader & header, headers )
+    {
+	// Same format as the "rpm -qa" query of RpmPkgManager
+
+	out << header.name << " | " << header.version << " | "
+	    << ( header.arch.isEmpty() ? QString( "(none)" ) : header.arch ) << " | "
+	    << header.size << "\n";
+
+	// Get the file lists like the packages view does for a single package
+
+	foreach ( const QString & file, db.fileList( header.name, header.version, header.arch ) )
+	    out << "    " << file << "\n";
+    }
+
+    return 0;
+}
+
+
+/**
+ * Parse a size with an optional K/M/G/T suffix. Return -1 if invalid.
+ **/
+QDirStat::FileSize parseSize( const QString & sizeArg )
+{
+    QString		str  = sizeArg.toUpper();
+    QDirStat::FileSize	unit = 1;
+
+    if	    ( str.endsWith( "K" ) ) unit = 1024LL;
+    else if ( str.endsWith( "M" ) ) unit = 1024LL*1024;
+    else if ( str.endsWith( "G" ) ) unit = 1024LL*1024*1024;
+    else if ( str.endsWith( "T" ) ) unit = 1024LL*1024*1024*1024;
+
+    if ( unit > 1 )
+	str.chop( 1 );
+
+    bool ok = false;
+    QDirStat::FileSize size = str.toLongLong( &ok );
+
+    return ok && size >= 0 ? size * unit : -1;
+}
+
+
+/**
+ * Headless mode: Read a directory or a cache file and write Prometheus
+ * metrics. 'argList' is everything after --metrics.
+ * Return the exit code.
+ **/
+int runMetricsExport( QStringList argList )
+{
+    if ( argList.size() < 2 )
+    {
+	usage( argList );
+	return 1;
+    }
+
+    QDirStat::MetricsExporter exporter( argList.takeFirst() );
+    QString cacheFileName;
+    QString dirName;
+    bool    ok = true;
+
+    while ( ! argList.isEmpty() && ok )
+    {
+	QString arg = argList.takeFirst();
+
+	if ( arg == "--depth" && ! argList.isEmpty() )
+	{
+	    int depth = argList.takeFirst().toInt( &ok );
+	    ok = ok && depth >= 0;
+	    exporter.setMaxDepth( depth );
+	}
+	else if ( arg == "--min-size" && ! argList.isEmpty() )
+	{
+	    QDirStat::FileSize minSize = parseSize( argList.takeFirst() );
+	    ok = minSize >= 0;
+	    exporter.setMinSize( minSize );
+	}
+	else if ( ( arg == "--cache" || arg == "-c" ) && ! argList.isEmpty() )
+	    cacheFileName = argList.takeFirst();
+	else if ( ! arg.startsWith( "-" ) && dirName.isEmpty() )
+	    dirName = arg;
+	else
+	    ok = false;
+    }
+
+    if ( ! ok || cacheFileName.isEmpty() == dirName.isEmpty() )
+    {
+	usage( argList );
+	return 1;
+    }
+
+    if ( ! cacheFileName.isEmpty() )
+	exporter.readCache( cacheFileName );
+    else
+	exporter.readDir( dirName );
+
+    return QCoreApplication::exec();
+}
+
+
+/**
+ * Benchmark mode: Load a cache file (or a generated tree) into the main
+ * window, time some typical operations and write the results to stdout.
+ * 'argList' is everything after --benchmark.
+ * Return the exit code.
+ **/
+int runBenchmark( const QStringList & argList )
+{
+    QString cacheFileName;
+    QTemporaryFile generatedCache;
+
+    if ( argList.size() == 1 && ! argList.first().startsWith( "-" ) )
+    {
+	cacheFileName = argList.first();
+    }
+    else if ( argList.size() == 3 && argList.first() == "--generate" )
+    {
+	bool okDirs  = false;
+	bool okFiles = false;
+	int  dirs    = argList.at( 1 ).toInt( &okDirs  );
+	int  files   = argList.at( 2 ).toInt( &okFiles );
+
+	if ( ! okDirs || ! okFiles || dirs < 1 || files < 0 )
+	{
+	    usage( argList );
+	    return 1;
+	}
+
+	if ( ! generatedCache.open() ||
+	     ! QDirStat::GuiBenchmark::generateCache( generatedCache.fileName(), dirs, files ) )
+	{
+	    cerr << "Can't write a temporary cache file" << std::endl;
+	    return 2;
+	}
+
+	cacheFileName = generatedCache.fileName();
+    }
+    else
+    {
+	usage( argList );
+	return 1;
+    }
+
+#if (QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 ))
+    // Use the default settings, so the results do not depend on the user's
+    // configuration, and leave that configuration alone
+
+    QTemporaryDir settingsDir;
+    QSettings::setPath( QSettings::NativeFormat, QSettings::UserScope, settingsDir.path() );
+#endif
+
+    MainWindow * mainWin = new MainWindow();
+    CHECK_PTR( mainWin );
+    mainWin->show();
+
+    QDirStat::GuiBenchmark benchmark( mainWin );
+    bool ok = benchmark.run( cacheFileName );
+
+    if ( ok )
+    {
+	QTextStream out( stdout );
+	benchmark.writeResults( out );
+    }
+
+    delete mainWin;
+
+    return ok ? 0 : 2;
+}
+
+
 int main( int argc, char *argv[] )
 {
     Logger logger( "/tmp/qdirstat-$USER", "qdirstat.log" );
@@ -102,6 +429,57 @@ int main( int argc, char *argv[] )
     QCoreApplication::setOrganizationName( "QDirStat" );
     QCoreApplication::setApplicationName ( "QDirStat" );
 
+    if ( argc > 1 && ( strcmp( argv[1], "--query" ) == 0 || strcmp( argv[1], "-q" ) == 0 ) )
+    {
+	// No GUI at all for this, so this also works without an X server
+
+	QCoreApplication coreApp( argc, argv );
+	QStringList argList = QCoreApplication::arguments().mid( 2 );
+
+	return runCacheQuery( argList );
+    }
+
+    if ( argc > 1 && strcmp( argv[1], "--diff" ) == 0 )
+    {
+	QCoreApplication coreApp( argc, argv );
+	QStringList argList = QCoreApplication::arguments().mid( 2 );
+
+	return runCacheDiff( argList );
+    }
+
+    if ( argc > 1 && strcmp( argv[1], "--rpm-db" ) == 0 )
+    {
+	QCoreApplication coreApp( argc, argv );
+	QStringList argList = QCoreApplication::arguments().mid( 2 );
+
+	return runRpmDbList( argList );
+    }
+
+    if ( argc > 1 && ( strcmp( argv[1], "--metrics" ) == 0 || strcmp( argv[1], "-m" ) == 0 ) )
+    {
+	QCoreApplication coreApp( argc, argv );
+	QStringList argList = QCoreApplication::arguments().mid( 2 );
+
+	int exitCode = runMetricsExport( argList );
+	QDirStat::Settings::fixFileOwners();
+
+	return exitCode;
+    }
+
+    if ( argc > 1 && strcmp( argv[1], "--benchmark" ) == 0 )
+    {
+#if (QT_VERSION >= QT_VERSION_CHECK( 5, 0, 0 ))
+	// No display needed unless the user asks for a specific platform
+
+	if ( qgetenv( "QT_QPA_PLATFORM" ).isEmpty() )
+	    qputenv( "QT_QPA_PLATFORM", "offscreen" );
+#endif
+	QApplication qtApp( argc, argv );
+	QStringList argList = QCoreApplication::arguments().mid( 2 );
+
+	return runBenchmark( argList );
+    }
+
     QApplication qtApp( argc, argv);
     QStringList argList = QCoreApplication::arguments();
     argList.removeFirst(); // Remove program name
@@ -11,7 +11,7 @@
 
 TEMPLATE	 = app
 
-QT		+= widgets
+QT		+= widgets network
 # Commented out to get -O2 optimization by default (issue #160)
 # CONFIG	+= debug
 DEPENDPATH	+= .
@@ -19,6 +19,17 @@ MOC_DIR		 = .moc
 OBJECTS_DIR	 = .obj
 LIBS		+= -lz
 
+# Read the RPM sqlite database directly; this needs the sqlite3 library and
+# header file. Enable it with
+#
+#     qmake CONFIG+=rpm_sqlite
+#
+# Without it, RpmPkgManager always uses the rpm command.
+rpm_sqlite {
+    DEFINES	+= HAVE_SQLITE=1
+    LIBS	+= -lsqlite3
+}
+
 major_is_less_5 = $$find(QT_MAJOR_VERSION, [234])
 !isEmpty(major_is_less_5):DEFINES += 'Q_DECL_OVERRIDE=""'
 isEmpty(INSTALL_PREFIX):INSTALL_PREFIX = /usr
@@ -56,9 +67,13 @@ SOURCES	  = main.cpp			\
 	    BreadcrumbNavigator.cpp	\
 	    BucketsTableModel.cpp	\
 	    BusyPopup.cpp		\
+	    CacheDiff.cpp		\
+	    CacheQuery.cpp		\
 	    Cleanup.cpp			\
 	    CleanupCollection.cpp	\
 	    CleanupConfigPage.cpp	\
+	    CompressionAnalyzer.cpp	\
+	    ContentSniffer.cpp		\
 	    ConfigDialog.cpp		\
 	    DataColumns.cpp		\
 	    DebugHelpers.cpp		\
@@ -79,7 +94,10 @@ SOURCES	  = main.cpp			\
 	    ExcludeRules.cpp		\
 	    ExcludeRulesConfigPage.cpp	\
 	    ExistingDirCompleter.cpp	\
+	    ExistingDirLister.cpp	\
+	    ExistingDirModel.cpp	\
             ExistingDirValidator.cpp	\
+	    ExtTimeStore.cpp		\
 	    FileAgeStats.cpp		\
 	    FileAgeStatsWindow.cpp	\
 	    FileDetailsView.cpp		\
@@ -87,17 +105,21 @@ SOURCES	  = main.cpp			\
 	    FileInfoIterator.cpp	\
 	    FileInfoSet.cpp		\
 	    FileInfoSorter.cpp		\
+	    FileMover.cpp		\
             FileMTimeStats.cpp		\
             FileSearchFilter.cpp        \
 	    FileSizeLabel.cpp		\
 	    FileSizeStats.cpp		\
 	    FileSizeStatsWindow.cpp	\
+	    FileSystemAccess.cpp	\
 	    FileSystemsWindow.cpp	\
 	    FileTypeStats.cpp		\
 	    FileTypeStatsWindow.cpp	\
             FindFilesDialog.cpp         \
 	    FormatUtil.cpp		\
 	    GeneralConfigPage.cpp	\
+	    GrowthHistory.cpp		\
+	    GuiBenchmark.cpp		\
 	    HeaderTweaker.cpp		\
 	    HistogramDraw.cpp		\
 	    HistogramItems.cpp		\
@@ -114,7 +136,9 @@ SOURCES	  = main.cpp			\
 	    MainWindowLayout.cpp	\
 	    MainWindowMenus.cpp		\
 	    MainWindowUnpkg.cpp		\
+	    MappedArena.cpp		\
 	    MessagePanel.cpp		\
+	    MetricsExporter.cpp		\
 	    MimeCategorizer.cpp		\
 	    MimeCategory.cpp		\
 	    MimeCategoryConfigPage.cpp	\
@@ -136,19 +160,27 @@ SOURCES	  = main.cpp			\
 	    PopupLabel.cpp		\
 	    Process.cpp			\
 	    ProcessStarter.cpp		\
+	    QueryServer.cpp		\
 	    Refresher.cpp		\
 	    RpmPkgManager.cpp		\
+	    RpmSqliteDb.cpp		\
 	    SearchFilter.cpp		\
 	    SelectionModel.cpp		\
 	    Settings.cpp		\
 	    SettingsHelpers.cpp		\
 	    ShowUnpkgFilesDialog.cpp	\
 	    SizeColDelegate.cpp		\
+	    SmallFileSummary.cpp	\
+	    SnapshotCollectJob.cpp	\
 	    StdCleanup.cpp		\
 	    Subtree.cpp			\
 	    SysUtil.cpp			\
 	    SystemFileChecker.cpp	\
+	    TopFiles.cpp		\
 	    Trash.cpp			\
+	    TreeFilter.cpp		\
+	    TreeFilterBar.cpp		\
+	    TreeSnapshot.cpp		\
 	    TreeWalker.cpp		\
 	    TreemapTile.cpp		\
 	    TreemapView.cpp		\
@@ -166,9 +198,13 @@ HEADERS	  =				\
             BrokenLibc.h                \
 	    BucketsTableModel.h		\
 	    BusyPopup.h			\
+	    CacheDiff.h			\
+	    CacheQuery.h		\
 	    Cleanup.h			\
 	    CleanupCollection.h		\
 	    CleanupConfigPage.h		\
+	    CompressionAnalyzer.h	\
+	    ContentSniffer.h		\
 	    ConfigDialog.h		\
 	    DataColumns.h		\
 	    DebugHelpers.h		\
@@ -190,20 +226,27 @@ HEADERS	  =				\
 	    ExcludeRules.h		\
 	    ExcludeRulesConfigPage.h	\
 	    ExistingDirCompleter.h	\
+	    ExistingDirLister.h		\
+	    ExistingDirModel.h		\
 	    ExistingDirValidator.h	\
+	    ExtTimeStore.h		\
 	    FileDetailsView.h		\
 	    FileInfo.h			\
 	    FileInfoIterator.h		\
 	    FileInfoSet.h		\
 	    FileInfoSorter.h		\
+	    FileMover.h		\
 	    FileMTimeStats.h		\
             FileSearchFilter.h          \
 	    FileSizeLabel.h		\
 	    FileSizeStats.h		\
 	    FileSizeStatsWindow.h	\
+	    FileSystemAccess.h	\
 	    FileSystemsWindow.h		\
 	    FileTypeStats.h		\
 	    GeneralConfigPage.h		\
+	    GrowthHistory.h		\
+	    GuiBenchmark.h		\
 	    HeaderTweaker.h		\
 	    HistogramItems.h		\
 	    HistogramView.h		\
@@ -213,7 +256,9 @@ HEADERS	  =				\
 	    LocateFilesWindow.h		\
 	    Logger.h			\
 	    MainWindow.h		\
+	    MappedArena.h		\
 	    MessagePanel.h		\
+	    MetricsExporter.h		\
 	    MimeCategorizer.h		\
 	    MimeCategory.h		\
 	    MimeCategoryConfigPage.h	\
@@ -236,8 +281,10 @@ HEADERS	  =				\
 	    Process.h			\
 	    ProcessStarter.h		\
 	    Qt4Compat.h			\
+	    QueryServer.h		\
 	    Refresher.h			\
 	    RpmPkgManager.h		\
+	    RpmSqliteDb.h		\
 	    SearchFilter.h              \
 	    SelectionModel.h		\
 	    Settings.h			\
@@ -245,10 +292,12 @@ HEADERS	  =				\
 	    ShowUnpkgFilesDialog.h	\
 	    SignalBlocker.h		\
 	    SizeColDelegate.h		\
+	    SmallFileSummary.h		\
 	    StdCleanup.h		\
 	    Subtree.h			\
 	    SysUtil.h			\
 	    SystemFileChecker.h		\
+	    TopFiles.h		\
 	    Trash.h			\
 	    TreemapTile.h		\
 	    UnpkgSettings.cpp		\
@@ -261,6 +310,10 @@ HEADERS	  =				\
 	    FormatUtil.h		\
 	    History.h			\
 	    HistoryButtons.h		\
+	    TreeFilter.h		\
+	    TreeFilterBar.h		\
+	    TreeSnapshot.h		\
+	    SnapshotCollectJob.h	\
 	    TreeWalker.h		\
 	    TreemapView.h		\
 	    Version.h
@@ -287,6 +340,7 @@ FORMS	  = main-window.ui		   \
 	    output-window.ui		   \
 	    panel-message.ui		   \
 	    show-unpkg-files-dialog.ui	   \
+	    tree-filter-bar.ui		   \
 	    unreadable-dirs-window.ui
 
 